@@ -0,0 +1,1687 @@
+// Benchmarks of the algorithms, matrix2, matrix2_expr, matrix2_small, sparse2
+// and matrix2_io operations for every dtype of FOR_ALL_TYPES, and of the
+// matrix2_factor ones for f32 and f64.
+//
+// Every case runs over a list of working set sizes, from L1 resident to DRAM
+// sized. A case is warmed up first, then timed in repetitions of batches long
+// enough for the clock to be precise. The median, minimum, mean and standard
+// deviation of the repetitions are reported as ns per element, together with
+// the GB/s and GFLOP/s of the median. Bytes count the minimal traffic of the
+// operation (every input read and every output written once), not what the
+// implementation actually moves, so they compare against memory bandwidth.
+//
+// Cases that destroy their input (sorts, partitions, factorizations, ...)
+// restore it before every iteration, outside of the timed region.
+//
+// Build it together with the library sources, for example
+//     cc -O2 -Iinclude -Iinclude/math bench/benchmark.c src/*.c -lpthread -lm
+// and run it with --help for the options. --format csv or --format json give
+// machine readable results for comparisons between releases.
+
+#include <algorithms.h>
+#include <algorithms_parallel.h>
+#include <gemm.h>
+#include <matrix2.h>
+#include <matrix2_expr.h>
+#include <matrix2_factor.h>
+#include <matrix2_gemv.h>
+#include <matrix2_io.h>
+#include <matrix2_macro_helpers.h>
+#include <matrix2_small.h>
+#include <sparse2.h>
+//
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+// queries answered per iteration by the search cases
+#define BENCH_QUERIES 4096
+// length of the needle of the search cases
+#define BENCH_NEEDLE 8
+// values stored by the cases are at most this, predicates compare against it
+#define BENCH_MAX_VALUE 100
+// values per row of the sparse cases and columns of the dense rhs of SpMM
+#define BENCH_SPARSE_ROW 16
+#define BENCH_SPMM_COLS 8
+// vectors multiplied at once by the m2_gemv_multi and m2_gevm_multi cases
+#define BENCH_GEMV_VECTORS 8
+// a batch of iterations is timed as a whole once it takes this long
+#define BENCH_MIN_BATCH 1e-3
+// cubic cases running a callback per element get a smaller work limit
+#define BENCH_CALLBACK_WORK_SHIFT 6
+
+// options
+
+typedef enum {
+    BENCH_TABLE,
+    BENCH_CSV,
+    BENCH_JSON,
+} bench_format;
+
+typedef struct {
+    bench_format format;
+    char const *filter;
+    size_t sizes[32];
+    size_t size_count;
+    double min_time;
+    double warmup;
+    size_t min_reps;
+    size_t max_reps;
+    double max_work;
+    bool io;
+    bool list;
+} bench_options;
+
+// cases
+
+typedef enum {
+    BENCH_SHAPE_LINEAR,   // n elements per buffer
+    BENCH_SHAPE_QUERIES,  // BENCH_QUERIES lookups in n sorted elements
+    BENCH_SHAPE_SQUARE,   // n x n matrices, elementwise
+    BENCH_SHAPE_CUBIC,    // n x n matrices, n^3 multiply adds
+    BENCH_SHAPE_SPARSE,   // n stored values, BENCH_SPARSE_ROW per row
+    BENCH_SHAPE_CALL,     // one call working on n x n matrices
+} bench_shape;
+
+typedef struct {
+    size_t n;
+    size_t dtype;
+    size_t bytes;
+    char *a;
+    char *b;
+    char *c;
+    char *pristine;
+    char *needle;
+    size_t *ranks;
+    matrix2 *ma;
+    matrix2 *mb;
+    matrix2 *mc;
+    m2_arena *arena;
+    m2_expr *expr;
+    search_index *index;
+    sparse2 csr;
+    sparse2 csc;
+    sparse2 coo;
+    matrix2 *dense;
+    char path[3][64];
+} bench_state;
+
+typedef void (*BenchRun)(bench_state *);
+
+typedef struct {
+    char const *group;
+    char const *name;
+    char const *type;
+    size_t dtype;
+    bench_shape shape;
+    bool destructive;  // `a` is restored from `pristine` every iteration, the
+                       // mc of matrix shapes from mb
+    double bytes;      // elements read or written per element of work
+    double flops;      // per element, cubic cases multiply it by n
+    BenchRun setup;    // optional, after the buffers of the shape exist
+    BenchRun run;
+} bench_case;
+
+static volatile size_t _bench_sink;
+
+static void _bench_consume(void const *const ptr) {
+    _bench_sink += (size_t)ptr;
+}
+
+static u64 _bench_random_state = 0x9e3779b97f4a7c15ull;
+
+static int64_t _bench_random() {
+    _bench_random_state ^= _bench_random_state << 13;
+    _bench_random_state ^= _bench_random_state >> 7;
+    _bench_random_state ^= _bench_random_state << 17;
+    return (int64_t)(_bench_random_state >> 1);
+}
+
+static matrix2 *_bench_matrix(size_t const rows, size_t const cols,
+                              size_t const dtype) {
+    matrix2 const m = m2_alloc(rows, cols, dtype);
+    assert(m.data);
+    matrix2 *const heap = malloc(sizeof(matrix2));
+    assert(heap);
+    memcpy(heap, &m, sizeof(m));
+    return heap;
+}
+
+static void _bench_matrix_free(matrix2 *const m) {
+    if (m) {
+        m2_free(m);
+        free(m);
+    }
+}
+
+static char *_bench_buffer(size_t const bytes) {
+    char *const buffer = aligned_alloc(M2_ALIGNMENT,
+                                       (bytes + M2_ALIGNMENT) / M2_ALIGNMENT *
+                                           M2_ALIGNMENT);
+    assert(buffer);
+    return buffer;
+}
+
+// typed cases
+
+#define BENCH_FIRST(Type) Type *const a = (Type *)s->a
+#define BENCH_LAST(Type) Type *const last = (Type *)s->a + s->n
+
+#define DEFINE_BENCH_TYPE(Type)                                                \
+    static void _bench_##Type##_store(void *const dest, size_t const i,        \
+                                      size_t const value) {                    \
+        ((Type *)dest)[i] = (Type)value;                                       \
+    }                                                                          \
+                                                                               \
+    static bool _bench_##Type##_above(const void *const v) {                   \
+        return *(const Type *)v > (Type)BENCH_MAX_VALUE;                       \
+    }                                                                          \
+                                                                               \
+    static bool _bench_##Type##_below(const void *const v) {                   \
+        return *(const Type *)v <= (Type)BENCH_MAX_VALUE;                      \
+    }                                                                          \
+                                                                               \
+    static bool _bench_##Type##_half(const void *const v) {                    \
+        return *(const Type *)v < (Type)(BENCH_MAX_VALUE / 2);                 \
+    }                                                                          \
+                                                                               \
+    static bool _bench_##Type##_above_ctx(const void *const v, void *ctx) {    \
+        return *(const Type *)v > *(const Type *)ctx;                          \
+    }                                                                          \
+                                                                               \
+    static bool _bench_##Type##_equal_ctx(const void *const lhs,               \
+                                          const void *const rhs, void *ctx) {  \
+        (void)ctx;                                                             \
+        return *(const Type *)lhs == *(const Type *)rhs;                       \
+    }                                                                          \
+                                                                               \
+    static bool _bench_##Type##_less_callback(const void *const lhs,           \
+                                              const void *const rhs) {         \
+        return *(const Type *)lhs < *(const Type *)rhs;                        \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_accum_callback(void *const accum,              \
+                                               const void *const v) {          \
+        *(Type *)accum += *(const Type *)v;                                    \
+    }                                                                          \
+                                                                               \
+    static void *_bench_##Type##_increment(const void *const v) {              \
+        static Type out;                                                       \
+        out = *(const Type *)v + 1;                                            \
+        return &out;                                                           \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_increment_ctx(void *const dest,                \
+                                              const void *const v,             \
+                                              void *ctx) {                     \
+        (void)ctx;                                                             \
+        *(Type *)dest = *(const Type *)v + 1;                                  \
+    }                                                                          \
+                                                                               \
+    static void *_bench_##Type##_counter() {                                   \
+        static Type value;                                                     \
+        value = value < BENCH_MAX_VALUE ? value + 1 : 0;                       \
+        return &value;                                                         \
+    }                                                                          \
+                                                                               \
+    /* filling and transforming */                                             \
+                                                                               \
+    static void _bench_##Type##_fill(bench_state *s) {                         \
+        Type const value = 1;                                                  \
+        fill(s->a, (Type *)s->a + s->n, sizeof(Type), &value);                 \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_fill_typed(bench_state *s) {                   \
+        fill_##Type((Type *)s->a, (Type *)s->a + s->n, 1);                     \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_generate(bench_state *s) {                     \
+        generate(s->a, (Type *)s->a + s->n, sizeof(Type),                      \
+                 &_bench_##Type##_counter);                                    \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_transform(bench_state *s) {                    \
+        transform(s->a, (Type *)s->a + s->n, sizeof(Type), s->b,               \
+                  (Type *)s->b + s->n, sizeof(Type),                           \
+                  &_bench_##Type##_increment);                                 \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_transform_add(bench_state *s) {                \
+        transform_add_##Type((Type *)s->a, (Type *)s->a + s->n,                \
+                             (Type *)s->b, 1);                                 \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_transform_mult(bench_state *s) {               \
+        transform_mult_##Type((Type *)s->a, (Type *)s->a + s->n,               \
+                              (Type *)s->b, 1);                                \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_memswap(bench_state *s) {                      \
+        memswap(s->a, s->b, s->n * sizeof(Type));                              \
+    }                                                                          \
+                                                                               \
+    /* reductions */                                                           \
+                                                                               \
+    static void _bench_##Type##_reduce(bench_state *s) {                       \
+        Type accum = 0;                                                        \
+        reduce(s->a, (Type *)s->a + s->n, sizeof(Type), &accum,                \
+               &Type##_accum_add);                                             \
+        _bench_sink += (size_t)accum;                                          \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_reduce_callback(bench_state *s) {              \
+        Type accum = 0;                                                        \
+        reduce(s->a, (Type *)s->a + s->n, sizeof(Type), &accum,                \
+               &_bench_##Type##_accum_callback);                               \
+        _bench_sink += (size_t)accum;                                          \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_reduce_add(bench_state *s) {                   \
+        BENCH_FIRST(Type);                                                     \
+        BENCH_LAST(Type);                                                      \
+        _bench_sink += (size_t)reduce_add_##Type(a, last, 0);                  \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_reduce_mult(bench_state *s) {                  \
+        /* the zeros of s->c, products of the pattern overflow */              \
+        Type *const c = (Type *)s->c;                                          \
+        _bench_sink += (size_t)reduce_mult_##Type(c, c + s->n, 1);             \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_reduce_min(bench_state *s) {                   \
+        BENCH_FIRST(Type);                                                     \
+        BENCH_LAST(Type);                                                      \
+        _bench_sink += (size_t)reduce_min_##Type(a, last, a[0]);               \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_reduce_max(bench_state *s) {                   \
+        BENCH_FIRST(Type);                                                     \
+        BENCH_LAST(Type);                                                      \
+        _bench_sink += (size_t)reduce_max_##Type(a, last, a[0]);               \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_reduce_par(bench_state *s) {                   \
+        Type accum = 0;                                                        \
+        Type const identity = 0;                                               \
+        reduce_par(s->a, (Type *)s->a + s->n, sizeof(Type), &accum,            \
+                   &Type##_accum_add, &Type##_accum_add, &identity, NULL);     \
+        _bench_sink += (size_t)accum;                                          \
+    }                                                                          \
+                                                                               \
+    /* scans, none of them finds a match so the whole range is read */         \
+                                                                               \
+    static void _bench_##Type##_find(bench_state *s) {                         \
+        _bench_consume(find(s->a, (Type *)s->a + s->n, sizeof(Type),           \
+                            &_bench_##Type##_above));                          \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_find_typed(bench_state *s) {                   \
+        BENCH_FIRST(Type);                                                     \
+        BENCH_LAST(Type);                                                      \
+        _bench_consume(find_##Type(a, last, BENCH_MAX_VALUE + 1));             \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_find_value(bench_state *s) {                   \
+        Type const value = BENCH_MAX_VALUE + 1;                                \
+        _bench_consume(                                                        \
+            find_value(s->a, (Type *)s->a + s->n, sizeof(Type), &value));      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_find_ctx(bench_state *s) {                     \
+        Type limit = BENCH_MAX_VALUE;                                          \
+        _bench_consume(                                                        \
+            find_ctx(s->a, (Type *)s->a + s->n, sizeof(Type),                  \
+                     unary_closure(&_bench_##Type##_above_ctx, &limit)));      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_find_par(bench_state *s) {                     \
+        _bench_consume(                                                        \
+            find_par(s->a, (Type *)s->a + s->n, sizeof(Type),                  \
+                     unary_closure_from(&_bench_##Type##_above), NULL));       \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_all(bench_state *s) {                          \
+        _bench_sink += all(s->a, (Type *)s->a + s->n, sizeof(Type),            \
+                           &_bench_##Type##_below);                            \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_any(bench_state *s) {                          \
+        _bench_sink += any(s->a, (Type *)s->a + s->n, sizeof(Type),            \
+                           &_bench_##Type##_above);                            \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_count(bench_state *s) {                        \
+        _bench_sink += count(s->a, (Type *)s->a + s->n, sizeof(Type),          \
+                             &_bench_##Type##_half);                           \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_all_ctx(bench_state *s) {                      \
+        Type limit = BENCH_MAX_VALUE;                                          \
+        _bench_sink += all_ctx(                                                \
+            s->a, (Type *)s->a + s->n, sizeof(Type),                           \
+            unary_closure_not(                                                 \
+                unary_closure(&_bench_##Type##_above_ctx, &limit)));           \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_any_ctx(bench_state *s) {                      \
+        Type limit = BENCH_MAX_VALUE;                                          \
+        _bench_sink +=                                                         \
+            any_ctx(s->a, (Type *)s->a + s->n, sizeof(Type),                   \
+                    unary_closure(&_bench_##Type##_above_ctx, &limit));        \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_count_ctx(bench_state *s) {                    \
+        Type limit = BENCH_MAX_VALUE / 2;                                      \
+        _bench_sink +=                                                         \
+            count_ctx(s->a, (Type *)s->a + s->n, sizeof(Type),                 \
+                      unary_closure(&_bench_##Type##_above_ctx, &limit));      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_count_par(bench_state *s) {                    \
+        _bench_sink +=                                                         \
+            count_par(s->a, (Type *)s->a + s->n, sizeof(Type),                 \
+                      unary_closure_from(&_bench_##Type##_half), NULL);        \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_any_par(bench_state *s) {                      \
+        _bench_sink +=                                                         \
+            any_par(s->a, (Type *)s->a + s->n, sizeof(Type),                   \
+                    unary_closure_from(&_bench_##Type##_above), NULL);         \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_all_par(bench_state *s) {                      \
+        _bench_sink +=                                                         \
+            all_par(s->a, (Type *)s->a + s->n, sizeof(Type),                   \
+                    unary_closure_from(&_bench_##Type##_below), NULL);         \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_count_eq(bench_state *s) {                     \
+        BENCH_FIRST(Type);                                                     \
+        BENCH_LAST(Type);                                                      \
+        _bench_sink += count_eq_##Type(a, last, 1);                            \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_any_eq(bench_state *s) {                       \
+        BENCH_FIRST(Type);                                                     \
+        BENCH_LAST(Type);                                                      \
+        _bench_sink += any_eq_##Type(a, last, BENCH_MAX_VALUE + 1);            \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_all_eq(bench_state *s) {                       \
+        _bench_sink +=                                                         \
+            all_eq_##Type((Type *)s->c, (Type *)s->c + s->n, 0);               \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_mismatch(bench_state *s) {                     \
+        Pair const p =                                                         \
+            mismatch(s->a, (Type *)s->a + s->n, sizeof(Type), s->b,            \
+                     (Type *)s->b + s->n, sizeof(Type), &Type##_equal);        \
+        _bench_consume(p._1);                                                  \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_mismatch_bytes(bench_state *s) {               \
+        Pair const p = mismatch_bytes(s->a, (Type *)s->a + s->n, s->b,         \
+                                      (Type *)s->b + s->n, sizeof(Type));      \
+        _bench_consume(p._1);                                                  \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_mismatch_ctx(bench_state *s) {                 \
+        Pair const p = mismatch_ctx(                                           \
+            s->a, (Type *)s->a + s->n, sizeof(Type), s->b,                     \
+            (Type *)s->b + s->n, sizeof(Type),                                 \
+            binary_closure(&_bench_##Type##_equal_ctx, NULL));                 \
+        _bench_consume(p._1);                                                  \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_adjacent_find(bench_state *s) {                \
+        _bench_consume(adjacent_find(s->a, (Type *)s->a + s->n, sizeof(Type),  \
+                                     &Type##_equal));                          \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_adjacent_find_eq(bench_state *s) {             \
+        _bench_consume(                                                        \
+            adjacent_find_eq(s->a, (Type *)s->a + s->n, sizeof(Type)));        \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_adjacent_find_ctx(bench_state *s) {            \
+        _bench_consume(adjacent_find_ctx(                                      \
+            s->a, (Type *)s->a + s->n, sizeof(Type),                           \
+            binary_closure(&_bench_##Type##_equal_ctx, NULL)));                \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_search(bench_state *s) {                       \
+        _bench_consume(search(s->a, (Type *)s->a + s->n, sizeof(Type),         \
+                              s->needle, (Type *)s->needle + BENCH_NEEDLE,     \
+                              sizeof(Type), &Type##_equal));                   \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_search_bytes(bench_state *s) {                 \
+        _bench_consume(search_bytes(s->a, (Type *)s->a + s->n, s->needle,      \
+                                    (Type *)s->needle + BENCH_NEEDLE,          \
+                                    sizeof(Type)));                            \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_search_ctx(bench_state *s) {                   \
+        _bench_consume(search_ctx(                                             \
+            s->a, (Type *)s->a + s->n, sizeof(Type), s->needle,                \
+            (Type *)s->needle + BENCH_NEEDLE, sizeof(Type),                    \
+            binary_closure(&_bench_##Type##_equal_ctx, NULL)));                \
+    }                                                                          \
+                                                                               \
+    /* permutations */                                                         \
+                                                                               \
+    static void _bench_##Type##_reverse(bench_state *s) {                      \
+        reverse(s->a, (Type *)s->a + s->n, sizeof(Type));        \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_rotate(bench_state *s) {                       \
+        _bench_consume(rotate(s->a, (Type *)s->a + s->n / 3,                   \
+                              (Type *)s->a + s->n, sizeof(Type)));             \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_shuffle(bench_state *s) {                      \
+        shuffle(s->a, (Type *)s->a + s->n, sizeof(Type), &_bench_random);      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_unique(bench_state *s) {                       \
+        _bench_consume(unique(s->a, (Type *)s->a + s->n, sizeof(Type),         \
+                              &Type##_equal));                                 \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_unique_ctx(bench_state *s) {                   \
+        _bench_consume(                                                        \
+            unique_ctx(s->a, (Type *)s->a + s->n, sizeof(Type),                \
+                       binary_closure(&_bench_##Type##_equal_ctx, NULL)));     \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_sort(bench_state *s) {                         \
+        sort(s->a, (Type *)s->a + s->n, sizeof(Type), &Type##_less);           \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_sort_callback(bench_state *s) {                \
+        sort(s->a, (Type *)s->a + s->n, sizeof(Type),                          \
+             &_bench_##Type##_less_callback);                                  \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_stable_sort(bench_state *s) {                  \
+        stable_sort(s->a, (Type *)s->a + s->n, sizeof(Type), &Type##_less);    \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_stable_sort_callback(bench_state *s) {         \
+        stable_sort(s->a, (Type *)s->a + s->n, sizeof(Type),                   \
+                    &_bench_##Type##_less_callback);                           \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_sort_typed(bench_state *s) {                   \
+        sort_##Type((Type *)s->a, (Type *)s->a + s->n);                        \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_sort_par(bench_state *s) {                     \
+        sort_par(s->a, (Type *)s->a + s->n, sizeof(Type), &Type##_less,        \
+                 NULL);                                                        \
+    }                                                                          \
+                                                                               \
+    /* the same sorts on input holding a single value */                       \
+    static void _bench_##Type##_fill_equal(bench_state *s) {                   \
+        Type const value = 1;                                                  \
+        fill(s->pristine, (Type *)s->pristine + s->n, sizeof(Type), &value);   \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_sort_equal(bench_state *s) {                   \
+        _bench_##Type##_sort(s);                                               \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_sort_par_equal(bench_state *s) {               \
+        _bench_##Type##_sort_par(s);                                           \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_transform_par(bench_state *s) {                \
+        transform_par(s->a, (Type *)s->a + s->n, sizeof(Type), s->b,           \
+                      (Type *)s->b + s->n, sizeof(Type),                       \
+                      &_bench_##Type##_increment_ctx, NULL, NULL);             \
+    }                                                                          \
+                                                                               \
+    /* compaction, about half of the random values satisfy the predicate */    \
+                                                                               \
+    static void _bench_##Type##_filter(bench_state *s) {                       \
+        _bench_consume(filter(s->a, (Type *)s->a + s->n, sizeof(Type),         \
+                              &_bench_##Type##_half));                         \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_remove_if(bench_state *s) {                    \
+        _bench_consume(remove_if(s->a, (Type *)s->a + s->n, sizeof(Type),      \
+                                 &_bench_##Type##_half));                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_copy_if(bench_state *s) {                      \
+        _bench_consume(copy_if(s->a, (Type *)s->a + s->n, sizeof(Type), s->b,  \
+                               &_bench_##Type##_half));                        \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_partition(bench_state *s) {                    \
+        _bench_consume(partition(s->a, (Type *)s->a + s->n, sizeof(Type),      \
+                                 &_bench_##Type##_half));                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_stable_partition(bench_state *s) {             \
+        _bench_consume(stable_partition(s->a, (Type *)s->a + s->n,             \
+                                        sizeof(Type), &_bench_##Type##_half)); \
+    }                                                                          \
+                                                                               \
+    /* searches in a sorted range, s->c holds the queries */                   \
+                                                                               \
+    static void _bench_##Type##_lower_bound(bench_state *s) {                  \
+        for (size_t q = 0; q < BENCH_QUERIES; ++q) {                           \
+            _bench_consume(lower_bound(s->a, (Type *)s->a + s->n,              \
+                                       sizeof(Type), (Type *)s->c + q,         \
+                                       &Type##_less));                         \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_lower_bound_callback(bench_state *s) {         \
+        for (size_t q = 0; q < BENCH_QUERIES; ++q) {                           \
+            _bench_consume(lower_bound(s->a, (Type *)s->a + s->n,              \
+                                       sizeof(Type), (Type *)s->c + q,         \
+                                       &_bench_##Type##_less_callback));       \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_upper_bound(bench_state *s) {                  \
+        for (size_t q = 0; q < BENCH_QUERIES; ++q) {                           \
+            _bench_consume(upper_bound(s->a, (Type *)s->a + s->n,              \
+                                       sizeof(Type), (Type *)s->c + q,         \
+                                       &Type##_less));                         \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_equal_range(bench_state *s) {                  \
+        for (size_t q = 0; q < BENCH_QUERIES; ++q) {                           \
+            Pair const p =                                                     \
+                equal_range(s->a, (Type *)s->a + s->n, sizeof(Type),           \
+                            (Type *)s->c + q, &Type##_less);                   \
+            _bench_consume(p._2);                                              \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_binary_search(bench_state *s) {                \
+        for (size_t q = 0; q < BENCH_QUERIES; ++q) {                           \
+            _bench_sink +=                                                     \
+                binary_search(s->a, (Type *)s->a + s->n, sizeof(Type),         \
+                              (Type *)s->c + q, &Type##_less);                 \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_lower_bound_typed(bench_state *s) {            \
+        BENCH_FIRST(Type);                                                     \
+        BENCH_LAST(Type);                                                      \
+        for (size_t q = 0; q < BENCH_QUERIES; ++q) {                           \
+            _bench_consume(lower_bound_##Type(a, last, ((Type *)s->c)[q]));    \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_upper_bound_typed(bench_state *s) {            \
+        BENCH_FIRST(Type);                                                     \
+        BENCH_LAST(Type);                                                      \
+        for (size_t q = 0; q < BENCH_QUERIES; ++q) {                           \
+            _bench_consume(upper_bound_##Type(a, last, ((Type *)s->c)[q]));    \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_index_create(bench_state *s) {                 \
+        s->index = search_index_create(s->a, (Type *)s->a + s->n,              \
+                                       sizeof(Type), &Type##_less);            \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_index_lower_bound(bench_state *s) {            \
+        for (size_t q = 0; q < BENCH_QUERIES; ++q) {                           \
+            _bench_sink +=                                                     \
+                search_index_lower_bound(s->index, (Type *)s->c + q);          \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_index_upper_bound(bench_state *s) {            \
+        for (size_t q = 0; q < BENCH_QUERIES; ++q) {                           \
+            _bench_sink +=                                                     \
+                search_index_upper_bound(s->index, (Type *)s->c + q);          \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_index_lower_bound_batch(bench_state *s) {      \
+        search_index_lower_bound_batch(s->index, s->c, BENCH_QUERIES,          \
+                                       s->ranks);                              \
+        _bench_sink += s->ranks[0];                                            \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_index_upper_bound_batch(bench_state *s) {      \
+        search_index_upper_bound_batch(s->index, s->c, BENCH_QUERIES,          \
+                                       s->ranks);                              \
+        _bench_sink += s->ranks[0];                                            \
+    }                                                                          \
+                                                                               \
+    /* matrix2 */                                                              \
+                                                                               \
+    static void _bench_##Type##_m2_set_all(bench_state *s) {                   \
+        Type value = 1;                                                        \
+        m2_set_all(s->mc, &value);                                             \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_set_row(bench_state *s) {                   \
+        for (size_t i = 0; i < s->n; ++i) {                                    \
+            m2_set_row(s->mc, i, s->ma->data);                                 \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_set_column(bench_state *s) {                \
+        for (size_t j = 0; j < s->n; ++j) {                                    \
+            m2_set_column(s->mc, j, s->ma->data);                              \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_apply(bench_state *s) {                     \
+        m2_apply(s->mc, s->ma, s->mb, &Type##_apply_add);                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_apply_parallel(bench_state *s) {            \
+        m2_apply_parallel(s->mc, s->ma, s->mb, &Type##_apply_add, NULL);       \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_transpose(bench_state *s) {                 \
+        m2_transpose(s->mc, s->ma);                                            \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_transpose_inplace(bench_state *s) {         \
+        m2_transpose_inplace(s->mc);                                           \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_compare(bench_state *s) {                   \
+        _bench_sink += m2_compare(s->ma, s->mb);                               \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_expr_create(bench_state *s) {               \
+        m2_expr *const a = m2_expr_matrix(s->arena, s->ma);                    \
+        m2_expr *const b = m2_expr_matrix(s->arena, s->mb);                    \
+        m2_expr *const sum = m2_expr_binary(s->arena, &Type##_op_add, a, b);   \
+        m2_expr *const product =                                               \
+            m2_expr_binary(s->arena, &Type##_op_mult, sum, b);                 \
+        s->expr = m2_expr_binary(s->arena, &Type##_op_sub, product, a);        \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_expr_eval(bench_state *s) {                 \
+        m2_expr_eval(s->mc, s->expr);                                          \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_mult(bench_state *s) {                      \
+        m2_mult(s->mc, s->ma, s->mb, &Type##_apply_add);                       \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_mult_add(bench_state *s) {                  \
+        m2_mult_add(s->mc, s->ma, s->mb, &Type##_apply_add);                   \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_mult_parallel(bench_state *s) {             \
+        m2_mult_parallel(s->mc, s->ma, s->mb, &Type##_apply_add, NULL);        \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_mult_strassen(bench_state *s) {             \
+        m2_mult_strassen(s->mc, s->ma, s->mb, &Type##_apply_add, 0,            \
+                         s->arena);                                            \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_mult_auto(bench_state *s) {                 \
+        m2_mult_auto(s->mc, s->ma, s->mb, &Type##_apply_add, s->arena);        \
+    }                                                                          \
+                                                                               \
+    /* rows of mb are the vectors and rows of mc the results */               \
+                                                                               \
+    static void _bench_##Type##_m2_gemv(bench_state *s) {                      \
+        m2_gemv(s->mc->data, s->ma, s->mb->data, &Type##_apply_add);           \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_gevm(bench_state *s) {                      \
+        m2_gevm(s->mc->data, s->mb->data, s->ma, &Type##_apply_add);           \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_gemv_multi(bench_state *s) {                \
+        size_t const k = MIN(BENCH_GEMV_VECTORS, s->n);                        \
+        matrix2 const xs = m2_slice(s->mb, 0, 0, k, s->n);                     \
+        matrix2 ys = m2_slice(s->mc, 0, 0, k, s->n);                           \
+        m2_gemv_multi(&ys, s->ma, &xs, &Type##_apply_add);                     \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_gevm_multi(bench_state *s) {                \
+        size_t const k = MIN(BENCH_GEMV_VECTORS, s->n);                        \
+        matrix2 const xs = m2_slice(s->mb, 0, 0, k, s->n);                     \
+        matrix2 ys = m2_slice(s->mc, 0, 0, k, s->n);                           \
+        m2_gevm_multi(&ys, &xs, s->ma, &Type##_apply_add);                     \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_alloc(bench_state *s) {                     \
+        matrix2 const m = m2_alloc(s->n, s->n, sizeof(Type));                  \
+        _bench_consume(m.data);                                                \
+        m2_free(&m);                                                           \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_arena_alloc(bench_state *s) {               \
+        m2_arena_mark const mark = m2_arena_save(s->arena);                    \
+        matrix2 const m =                                                      \
+            m2_arena_alloc(s->arena, s->n, s->n, sizeof(Type));                \
+        _bench_consume(m.data);                                                \
+        m2_arena_release(s->arena, mark);                                      \
+    }                                                                          \
+                                                                               \
+    /* matrix2_small, the buffers hold consecutive N x N matrices, or one */   \
+    /* batch of them in the SoA layout of m2_mult_batched */                   \
+                                                                               \
+    static void _bench_##Type##_m2_mult_2x2(bench_state *s) {                  \
+        for (size_t i = 0; i + 4 <= s->n; i += 4) {                            \
+            m2_mult_2x2_##Type((Type *)s->c + i, (Type *)s->a + i,             \
+                               (Type *)s->b + i);                              \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_mult_3x3(bench_state *s) {                  \
+        for (size_t i = 0; i + 9 <= s->n; i += 9) {                            \
+            m2_mult_3x3_##Type((Type *)s->c + i, (Type *)s->a + i,             \
+                               (Type *)s->b + i);                              \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_mult_4x4(bench_state *s) {                  \
+        for (size_t i = 0; i + 16 <= s->n; i += 16) {                          \
+            m2_mult_4x4_##Type((Type *)s->c + i, (Type *)s->a + i,             \
+                               (Type *)s->b + i);                              \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_det_4x4(bench_state *s) {                   \
+        Type sum = 0;                                                          \
+        for (size_t i = 0; i + 16 <= s->n; i += 16) {                          \
+            sum += m2_det_4x4_##Type((Type *)s->a + i);                        \
+        }                                                                      \
+        _bench_sink += sum > 0;                                                \
+    }                                                                          \
+                                                                               \
+    /* unit upper triangular matrices, every one of them is invertible */      \
+    static void _bench_##Type##_fill_unit(bench_state *s) {                    \
+        for (size_t i = 0; i + 16 <= s->n; i += 16) {                          \
+            for (size_t e = 0; e < 16; ++e) {                                  \
+                if (e / 4 >= e % 4) {                                          \
+                    ((Type *)s->a)[i + e] = e / 4 == e % 4;                    \
+                }                                                              \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_inverse_4x4(bench_state *s) {               \
+        for (size_t i = 0; i + 16 <= s->n; i += 16) {                          \
+            _bench_sink +=                                                     \
+                m2_inverse_4x4_##Type((Type *)s->c + i, (Type *)s->a + i);     \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_mult_batched_4x4(bench_state *s) {          \
+        m2_mult_batched(s->c, s->a, s->b, 4, s->n / 16, sizeof(Type),          \
+                        &Type##_apply_add);                                    \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_mult_batched_5x5(bench_state *s) {          \
+        m2_mult_batched(s->c, s->a, s->b, 5, s->n / 25, sizeof(Type),          \
+                        &Type##_apply_add);                                    \
+    }                                                                          \
+                                                                               \
+    /* sparse2, s->a holds x and s->b the result */                            \
+                                                                               \
+    static void _bench_##Type##_s2_mult_vector_csr(bench_state *s) {           \
+        s2_mult_vector(s->b, &s->csr, s->a, &Type##_apply_add);                \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_s2_mult_vector_csc(bench_state *s) {           \
+        s2_mult_vector(s->b, &s->csc, s->a, &Type##_apply_add);                \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_s2_mult_vector_coo(bench_state *s) {           \
+        s2_mult_vector(s->b, &s->coo, s->a, &Type##_apply_add);                \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_s2_mult_vector_parallel(bench_state *s) {      \
+        s2_mult_vector_parallel(s->b, &s->csr, s->a, &Type##_apply_add, NULL); \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_s2_mult_dense(bench_state *s) {                \
+        s2_mult_dense(s->mc, &s->csr, s->ma, &Type##_apply_add);               \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_s2_convert(bench_state *s) {                   \
+        sparse2 const converted = s2_convert(&s->csr, S2_CSC);                 \
+        s2_free(&converted);                                                   \
+    }                                                                          \
+                                                                               \
+    /* matrix2_io, the files live in the temporary directory */                \
+                                                                               \
+    static void _bench_##Type##_m2_save(bench_state *s) {                      \
+        _bench_sink += m2_save(s->ma, s->path[0]);                             \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_map(bench_state *s) {                       \
+        matrix2 const m = m2_map(s->path[0], M2_ACCESS_SEQUENTIAL);            \
+        _bench_sink += m2_compare(&m, s->ma);                                  \
+        m2_unmap(&m);                                                          \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_mult_file(bench_state *s) {                 \
+        _bench_sink += m2_mult_file(s->path[2], s->path[0], s->path[1],        \
+                                    &Type##_apply_add, s->bytes);              \
+    }
+
+FOR_ALL_TYPES(DEFINE_BENCH_TYPE)
+
+// matrix2_factor. Factorizations work on mc, restored from the symmetric
+// positive definite mb, and solves on mc, restored from mb, with the factors
+// of ma. s->ranks holds the pivots of LU
+
+#define DEFINE_BENCH_FACTOR(Type)                                              \
+    /* diagonally dominant, so both factorizations run to the end */           \
+    static void _bench_##Type##_spd(matrix2 const *const m) {                  \
+        for (size_t i = 0; i < m->rows; ++i) {                                 \
+            Type *const row = m2_get_from_matrix(m, 0, i);                     \
+            for (size_t j = 0; j < m->cols; ++j) {                             \
+                row[j] = (Type)((i + j) * 37 % (BENCH_MAX_VALUE + 1));         \
+            }                                                                  \
+            row[i] += (Type)(m->rows * BENCH_MAX_VALUE);                       \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_factor_create(bench_state *s) {                \
+        _bench_##Type##_spd(s->mb);                                            \
+        s->ranks = malloc(s->n * sizeof(size_t));                              \
+        assert(s->ranks);                                                      \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_lu_create(bench_state *s) {                    \
+        _bench_##Type##_spd(s->ma);                                            \
+        s->ranks = malloc(s->n * sizeof(size_t));                              \
+        assert(s->ranks);                                                      \
+        bool const factored = m2_lu_##Type(s->ma, s->ranks);                   \
+        assert(factored);                                                      \
+        (void)factored;                                                        \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_cholesky_create(bench_state *s) {              \
+        _bench_##Type##_spd(s->ma);                                            \
+        bool const factored = m2_cholesky_##Type(s->ma);                       \
+        assert(factored);                                                      \
+        (void)factored;                                                        \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_lu(bench_state *s) {                        \
+        _bench_sink += m2_lu_##Type(s->mc, s->ranks);                          \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_cholesky(bench_state *s) {                  \
+        _bench_sink += m2_cholesky_##Type(s->mc);                              \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_lu_solve(bench_state *s) {                  \
+        m2_lu_solve_##Type(s->ma, s->ranks, s->mc);                            \
+    }                                                                          \
+                                                                               \
+    static void _bench_##Type##_m2_cholesky_solve(bench_state *s) {            \
+        m2_cholesky_solve_##Type(s->ma, s->mc);                                \
+    }
+
+DEFINE_BENCH_FACTOR(f32)
+DEFINE_BENCH_FACTOR(f64)
+
+// registry
+
+#define BENCH_CASE(Type, group, name, shape, destructive, bytes, flops, setup) \
+    {group,   #name, #Type,         sizeof(Type),         shape,              \
+     destructive,    bytes, flops, setup, &_bench_##Type##_##name},
+
+#define BENCH_ALGORITHM(Type, name, destructive, bytes, flops)            \
+    BENCH_CASE(Type, "algorithms", name, BENCH_SHAPE_LINEAR, destructive, \
+               bytes, flops, NULL)
+
+#define BENCH_QUERY(Type, name, setup)                                     \
+    BENCH_CASE(Type, "algorithms", name, BENCH_SHAPE_QUERIES, false, 0, 0, \
+               setup)
+
+#define BENCH_PARALLEL(Type, name, destructive, bytes, flops)          \
+    BENCH_CASE(Type, "algorithms_parallel", name, BENCH_SHAPE_LINEAR, \
+               destructive, bytes, flops, NULL)
+
+#define BENCH_MATRIX(Type, name, shape, bytes, flops, setup) \
+    BENCH_CASE(Type, "matrix2", name, shape, false, bytes, flops, setup)
+
+#define BENCH_SPARSE(Type, name, bytes, flops)                                 \
+    BENCH_CASE(Type, "sparse2", name, BENCH_SHAPE_SPARSE, false, bytes, flops, \
+               NULL)
+
+#define BENCH_SMALL(Type, name, bytes, flops, setup)                         \
+    BENCH_CASE(Type, "matrix2_small", name, BENCH_SHAPE_LINEAR, false, bytes, \
+               flops, setup)
+
+#define BENCH_IO(Type, name, shape, bytes, flops) \
+    BENCH_CASE(Type, "matrix2_io", name, shape, false, bytes, flops, NULL)
+
+#define BENCH_FACTOR(Type, name, bytes, flops, setup)                        \
+    BENCH_CASE(Type, "matrix2_factor", name, BENCH_SHAPE_CUBIC, true, bytes, \
+               flops, setup)
+
+#define BENCH_TYPE_CASES(Type)                                                 \
+    BENCH_ALGORITHM(Type, fill, false, 1, 0)                                   \
+    BENCH_ALGORITHM(Type, fill_typed, false, 1, 0)                             \
+    BENCH_ALGORITHM(Type, generate, false, 1, 0)                               \
+    BENCH_ALGORITHM(Type, transform, false, 2, 1)                              \
+    BENCH_ALGORITHM(Type, transform_add, false, 2, 1)                          \
+    BENCH_ALGORITHM(Type, transform_mult, false, 2, 1)                         \
+    BENCH_ALGORITHM(Type, memswap, false, 4, 0)                                \
+    BENCH_ALGORITHM(Type, reduce, false, 1, 1)                                 \
+    BENCH_ALGORITHM(Type, reduce_callback, false, 1, 1)                        \
+    BENCH_ALGORITHM(Type, reduce_add, false, 1, 1)                             \
+    BENCH_ALGORITHM(Type, reduce_mult, false, 1, 1)                            \
+    BENCH_ALGORITHM(Type, reduce_min, false, 1, 1)                             \
+    BENCH_ALGORITHM(Type, reduce_max, false, 1, 1)                             \
+    BENCH_ALGORITHM(Type, find, false, 1, 0)                                   \
+    BENCH_ALGORITHM(Type, find_typed, false, 1, 0)                             \
+    BENCH_ALGORITHM(Type, find_value, false, 1, 0)                             \
+    BENCH_ALGORITHM(Type, find_ctx, false, 1, 0)                               \
+    BENCH_ALGORITHM(Type, all, false, 1, 0)                                    \
+    BENCH_ALGORITHM(Type, any, false, 1, 0)                                    \
+    BENCH_ALGORITHM(Type, count, false, 1, 0)                                  \
+    BENCH_ALGORITHM(Type, all_ctx, false, 1, 0)                                \
+    BENCH_ALGORITHM(Type, any_ctx, false, 1, 0)                                \
+    BENCH_ALGORITHM(Type, count_ctx, false, 1, 0)                              \
+    BENCH_ALGORITHM(Type, count_eq, false, 1, 0)                               \
+    BENCH_ALGORITHM(Type, any_eq, false, 1, 0)                                 \
+    BENCH_ALGORITHM(Type, all_eq, false, 1, 0)                                 \
+    BENCH_ALGORITHM(Type, mismatch, false, 2, 0)                               \
+    BENCH_ALGORITHM(Type, mismatch_bytes, false, 2, 0)                         \
+    BENCH_ALGORITHM(Type, mismatch_ctx, false, 2, 0)                           \
+    BENCH_ALGORITHM(Type, adjacent_find, false, 1, 0)                          \
+    BENCH_ALGORITHM(Type, adjacent_find_eq, false, 1, 0)                       \
+    BENCH_ALGORITHM(Type, adjacent_find_ctx, false, 1, 0)                      \
+    BENCH_ALGORITHM(Type, search, false, 1, 0)                                 \
+    BENCH_ALGORITHM(Type, search_bytes, false, 1, 0)                           \
+    BENCH_ALGORITHM(Type, search_ctx, false, 1, 0)                             \
+    BENCH_ALGORITHM(Type, reverse, false, 2, 0)                                \
+    BENCH_ALGORITHM(Type, rotate, false, 2, 0)                                 \
+    BENCH_ALGORITHM(Type, shuffle, false, 2, 0)                                \
+    BENCH_ALGORITHM(Type, unique, true, 2, 0)                                  \
+    BENCH_ALGORITHM(Type, unique_ctx, true, 2, 0)                              \
+    BENCH_ALGORITHM(Type, sort, true, 2, 0)                                    \
+    BENCH_ALGORITHM(Type, sort_callback, true, 2, 0)                           \
+    BENCH_ALGORITHM(Type, stable_sort, true, 2, 0)                             \
+    BENCH_ALGORITHM(Type, stable_sort_callback, true, 2, 0)                    \
+    BENCH_ALGORITHM(Type, sort_typed, true, 2, 0)                              \
+    BENCH_ALGORITHM(Type, filter, true, 2, 0)                                  \
+    BENCH_ALGORITHM(Type, remove_if, true, 2, 0)                               \
+    BENCH_ALGORITHM(Type, copy_if, false, 2, 0)                                \
+    BENCH_ALGORITHM(Type, partition, true, 2, 0)                               \
+    BENCH_ALGORITHM(Type, stable_partition, true, 2, 0)                        \
+    BENCH_QUERY(Type, lower_bound, NULL)                                       \
+    BENCH_QUERY(Type, lower_bound_callback, NULL)                              \
+    BENCH_QUERY(Type, upper_bound, NULL)                                       \
+    BENCH_QUERY(Type, equal_range, NULL)                                       \
+    BENCH_QUERY(Type, binary_search, NULL)                                     \
+    BENCH_QUERY(Type, lower_bound_typed, NULL)                                 \
+    BENCH_QUERY(Type, upper_bound_typed, NULL)                                 \
+    BENCH_QUERY(Type, index_lower_bound, &_bench_##Type##_index_create)        \
+    BENCH_QUERY(Type, index_upper_bound, &_bench_##Type##_index_create)        \
+    BENCH_QUERY(Type, index_lower_bound_batch, &_bench_##Type##_index_create)  \
+    BENCH_QUERY(Type, index_upper_bound_batch, &_bench_##Type##_index_create)  \
+    BENCH_PARALLEL(Type, reduce_par, false, 1, 1)                              \
+    BENCH_PARALLEL(Type, find_par, false, 1, 0)                                \
+    BENCH_PARALLEL(Type, count_par, false, 1, 0)                               \
+    BENCH_PARALLEL(Type, any_par, false, 1, 0)                                 \
+    BENCH_PARALLEL(Type, all_par, false, 1, 0)                                 \
+    BENCH_PARALLEL(Type, transform_par, false, 2, 1)                           \
+    BENCH_PARALLEL(Type, sort_par, true, 2, 0)                                 \
+    BENCH_CASE(Type, "algorithms", sort_equal, BENCH_SHAPE_LINEAR, true, 2, 0, \
+               &_bench_##Type##_fill_equal)                                    \
+    BENCH_CASE(Type, "algorithms_parallel", sort_par_equal,                    \
+               BENCH_SHAPE_LINEAR, true, 2, 0, &_bench_##Type##_fill_equal)    \
+    BENCH_MATRIX(Type, m2_set_all, BENCH_SHAPE_SQUARE, 1, 0, NULL)             \
+    BENCH_MATRIX(Type, m2_set_row, BENCH_SHAPE_SQUARE, 2, 0, NULL)             \
+    BENCH_MATRIX(Type, m2_set_column, BENCH_SHAPE_SQUARE, 2, 0, NULL)          \
+    BENCH_MATRIX(Type, m2_apply, BENCH_SHAPE_SQUARE, 4, 2, NULL)               \
+    BENCH_MATRIX(Type, m2_apply_parallel, BENCH_SHAPE_SQUARE, 4, 2, NULL)      \
+    BENCH_MATRIX(Type, m2_transpose, BENCH_SHAPE_SQUARE, 2, 0, NULL)           \
+    BENCH_MATRIX(Type, m2_transpose_inplace, BENCH_SHAPE_SQUARE, 2, 0, NULL)   \
+    BENCH_MATRIX(Type, m2_compare, BENCH_SHAPE_SQUARE, 2, 0, NULL)             \
+    BENCH_MATRIX(Type, m2_expr_eval, BENCH_SHAPE_SQUARE, 3, 3,                 \
+                 &_bench_##Type##_m2_expr_create)                              \
+    BENCH_MATRIX(Type, m2_mult, BENCH_SHAPE_CUBIC, 3, 2, NULL)                 \
+    BENCH_MATRIX(Type, m2_mult_add, BENCH_SHAPE_CUBIC, 4, 2, NULL)             \
+    BENCH_MATRIX(Type, m2_mult_parallel, BENCH_SHAPE_CUBIC, 3, 2, NULL)        \
+    BENCH_MATRIX(Type, m2_mult_strassen, BENCH_SHAPE_CUBIC, 3, 2, NULL)        \
+    BENCH_MATRIX(Type, m2_mult_auto, BENCH_SHAPE_CUBIC, 3, 2, NULL)            \
+    BENCH_MATRIX(Type, m2_gemv, BENCH_SHAPE_SQUARE, 1, 2, NULL)                \
+    BENCH_MATRIX(Type, m2_gevm, BENCH_SHAPE_SQUARE, 1, 2, NULL)                \
+    BENCH_MATRIX(Type, m2_gemv_multi, BENCH_SHAPE_SQUARE, 1,                   \
+                 2 * BENCH_GEMV_VECTORS, NULL)                                 \
+    BENCH_MATRIX(Type, m2_gevm_multi, BENCH_SHAPE_SQUARE, 1,                   \
+                 2 * BENCH_GEMV_VECTORS, NULL)                                 \
+    BENCH_MATRIX(Type, m2_alloc, BENCH_SHAPE_CALL, 0, 0, NULL)                 \
+    BENCH_MATRIX(Type, m2_arena_alloc, BENCH_SHAPE_CALL, 0, 0, NULL)           \
+    BENCH_SMALL(Type, m2_mult_2x2, 3, 4, NULL)                                 \
+    BENCH_SMALL(Type, m2_mult_3x3, 3, 6, NULL)                                 \
+    BENCH_SMALL(Type, m2_mult_4x4, 3, 8, NULL)                                 \
+    BENCH_SMALL(Type, m2_det_4x4, 1, 0, NULL)                                  \
+    BENCH_SMALL(Type, m2_inverse_4x4, 2, 0, &_bench_##Type##_fill_unit)        \
+    BENCH_SMALL(Type, m2_mult_batched_4x4, 3, 8, NULL)                         \
+    BENCH_SMALL(Type, m2_mult_batched_5x5, 3, 10, NULL)                        \
+    BENCH_SPARSE(Type, s2_mult_vector_csr, 3, 2)                               \
+    BENCH_SPARSE(Type, s2_mult_vector_csc, 3, 2)                               \
+    BENCH_SPARSE(Type, s2_mult_vector_coo, 3, 2)                               \
+    BENCH_SPARSE(Type, s2_mult_vector_parallel, 3, 2)                          \
+    BENCH_SPARSE(Type, s2_mult_dense, 2 * BENCH_SPMM_COLS + 1,                 \
+                 2 * BENCH_SPMM_COLS)                                          \
+    BENCH_SPARSE(Type, s2_convert, 4, 0)                                       \
+    BENCH_IO(Type, m2_save, BENCH_SHAPE_SQUARE, 2, 0)                          \
+    BENCH_IO(Type, m2_map, BENCH_SHAPE_SQUARE, 2, 0)                           \
+    BENCH_IO(Type, m2_mult_file, BENCH_SHAPE_CUBIC, 3, 2)
+
+// n^3 / 3 multiply adds for LU, n^3 / 6 for Cholesky and n^3 for the solves
+// of n right hand sides, as flops they compare directly with m2_mult
+#define BENCH_FACTOR_CASES(Type)                                               \
+    BENCH_FACTOR(Type, m2_lu, 2, 2.0 / 3, &_bench_##Type##_factor_create)      \
+    BENCH_FACTOR(Type, m2_cholesky, 2, 1.0 / 3,                                \
+                 &_bench_##Type##_factor_create)                               \
+    BENCH_FACTOR(Type, m2_lu_solve, 3, 2, &_bench_##Type##_lu_create)          \
+    BENCH_FACTOR(Type, m2_cholesky_solve, 3, 2,                                \
+                 &_bench_##Type##_cholesky_create)
+
+static bench_case const _bench_cases[] = {
+    FOR_ALL_TYPES(BENCH_TYPE_CASES) BENCH_FACTOR_CASES(f32)
+        BENCH_FACTOR_CASES(f64)};
+
+#define BENCH_CASE_COUNT (sizeof(_bench_cases) / sizeof(_bench_cases[0]))
+
+// state
+
+typedef void (*BenchStore)(void *, size_t, size_t);
+
+#define BENCH_STORE(Type)                 \
+    if (strcmp(c->type, #Type) == 0) {   \
+        return &_bench_##Type##_store;    \
+    }
+
+static BenchStore _bench_store(bench_case const *const c) {
+    FOR_ALL_TYPES(BENCH_STORE)
+    return NULL;
+}
+
+static size_t _bench_sqrt(size_t const value) {
+    size_t root = (size_t)sqrt((double)value);
+    while (root * root > value) {
+        --root;
+    }
+    return root;
+}
+
+// elements per buffer, or side of the matrices, for a working set of `bytes`
+static size_t _bench_size(bench_case const *const c, size_t const bytes) {
+    size_t const elements = bytes / c->dtype;
+    switch (c->shape) {
+        case BENCH_SHAPE_LINEAR:
+        case BENCH_SHAPE_QUERIES:
+        case BENCH_SHAPE_SPARSE:
+            return elements;
+        case BENCH_SHAPE_SQUARE:
+        case BENCH_SHAPE_CUBIC:
+        case BENCH_SHAPE_CALL:
+            return _bench_sqrt(elements);
+    }
+    return 0;
+}
+
+static double _bench_elements(bench_case const *const c, size_t const n) {
+    switch (c->shape) {
+        case BENCH_SHAPE_LINEAR:
+        case BENCH_SHAPE_SPARSE:
+            return n;
+        case BENCH_SHAPE_QUERIES:
+            return BENCH_QUERIES;
+        case BENCH_SHAPE_SQUARE:
+        case BENCH_SHAPE_CUBIC:
+            return (double)n * n;
+        case BENCH_SHAPE_CALL:
+            return 1;
+    }
+    return 0;
+}
+
+// the float products run on gemm, the others call `perf` per multiply add
+static bool _bench_accelerated(bench_case const *const c) {
+    return c->type[0] == 'f';
+}
+
+static void _bench_fill_pattern(BenchStore store, void *const dest,
+                                size_t const n) {
+    // neighbours always differ, so adjacent_find and unique scan everything
+    for (size_t i = 0; i < n; ++i) {
+        store(dest, i, i * 37 % (BENCH_MAX_VALUE + 1));
+    }
+}
+
+static void _bench_fill_random(BenchStore store, void *const dest,
+                               size_t const n) {
+    for (size_t i = 0; i < n; ++i) {
+        store(dest, i, (size_t)_bench_random() % (BENCH_MAX_VALUE + 1));
+    }
+}
+
+static void _bench_fill_matrix(BenchStore store, matrix2 const *const m) {
+    for (size_t i = 0; i < m->rows; ++i) {
+        _bench_fill_pattern(store, m2_get_from_matrix(m, 0, i), m->cols);
+    }
+}
+
+static void _bench_setup_sparse(bench_case const *const c,
+                                bench_state *const s, BenchStore store) {
+    size_t const rows =
+        s->n / BENCH_SPARSE_ROW ? s->n / BENCH_SPARSE_ROW : 1;
+    size_t const nnz = rows * BENCH_SPARSE_ROW;
+    u32 *const row_indices = malloc(nnz * sizeof(u32));
+    u32 *const col_indices = malloc(nnz * sizeof(u32));
+    char *const values = _bench_buffer(nnz * c->dtype);
+    assert(row_indices and col_indices);
+    for (size_t p = 0; p < nnz; ++p) {
+        row_indices[p] = p / BENCH_SPARSE_ROW;
+        col_indices[p] = (size_t)_bench_random() % rows;
+    }
+    _bench_fill_pattern(store, values, nnz);
+    s->csr = s2_from_triplets(rows, rows, c->dtype, nnz, row_indices,
+                              col_indices, values, S2_CSR);
+    s->csc = s2_convert(&s->csr, S2_CSC);
+    s->coo = s2_convert(&s->csr, S2_COO);
+    free(row_indices);
+    free(col_indices);
+    free(values);
+
+    s->ma = _bench_matrix(rows, BENCH_SPMM_COLS, c->dtype);
+    s->mc = _bench_matrix(rows, BENCH_SPMM_COLS, c->dtype);
+    _bench_fill_matrix(store, s->ma);
+}
+
+static void _bench_setup(bench_case const *const c, bench_state *const s,
+                         size_t const n, size_t const bytes) {
+    BenchStore const store = _bench_store(c);
+    size_t const dtype = c->dtype;
+    memset(s, 0, sizeof(*s));
+    s->n = n;
+    s->dtype = dtype;
+    s->bytes = bytes;
+    s->arena = m2_arena_create(0);
+    assert(store and s->arena);
+
+    switch (c->shape) {
+        case BENCH_SHAPE_LINEAR:
+        case BENCH_SHAPE_QUERIES:
+        case BENCH_SHAPE_SPARSE:
+            s->a = _bench_buffer(n * dtype);
+            s->b = _bench_buffer(n * dtype);
+            s->c = _bench_buffer((n > BENCH_QUERIES ? n : BENCH_QUERIES) *
+                                 dtype);
+            s->pristine = _bench_buffer(n * dtype);
+            s->needle = _bench_buffer(BENCH_NEEDLE * dtype);
+            s->ranks = malloc(BENCH_QUERIES * sizeof(size_t));
+            assert(s->ranks);
+            _bench_fill_pattern(store, s->a, n);
+            _bench_fill_random(store, s->pristine, n);
+            memcpy(s->b, s->a, n * dtype);
+            memset(s->c, 0, n * dtype);
+            // the needle matches the head of every period of the pattern but
+            // its last value never occurs
+            _bench_fill_pattern(store, s->needle, BENCH_NEEDLE);
+            store(s->needle, BENCH_NEEDLE - 1, BENCH_MAX_VALUE + 1);
+            break;
+        case BENCH_SHAPE_SQUARE:
+        case BENCH_SHAPE_CUBIC:
+        case BENCH_SHAPE_CALL:
+            s->ma = _bench_matrix(n, n, dtype);
+            s->mb = _bench_matrix(n, n, dtype);
+            s->mc = _bench_matrix(n, n, dtype);
+            _bench_fill_matrix(store, s->ma);
+            _bench_fill_matrix(store, s->mb);
+            _bench_fill_matrix(store, s->mc);
+            break;
+    }
+
+    if (c->shape == BENCH_SHAPE_QUERIES) {
+        // sorted values with runs of duplicates and random queries among them
+        for (size_t i = 0; i < n; ++i) {
+            store(s->a, i, i * (BENCH_MAX_VALUE + 1) / n);
+        }
+        _bench_fill_random(store, s->c, BENCH_QUERIES);
+    }
+    if (c->shape == BENCH_SHAPE_SPARSE) {
+        _bench_setup_sparse(c, s, store);
+    }
+    if (strcmp(c->group, "matrix2_io") == 0) {
+        char const *const dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+        for (size_t i = 0; i < 3; ++i) {
+            snprintf(s->path[i], sizeof(s->path[i]), "%s/m2_bench_%d_%zu",
+                     dir, (int)getpid(), i);
+        }
+        bool const saved =
+            m2_save(s->ma, s->path[0]) and m2_save(s->mb, s->path[1]);
+        assert(saved);
+        (void)saved;
+    }
+    if (c->setup) {
+        c->setup(s);
+    }
+}
+
+static void _bench_teardown(bench_case const *const c, bench_state *const s) {
+    free(s->a);
+    free(s->b);
+    free(s->c);
+    free(s->pristine);
+    free(s->needle);
+    free(s->ranks);
+    _bench_matrix_free(s->ma);
+    _bench_matrix_free(s->mb);
+    _bench_matrix_free(s->mc);
+    if (s->index) {
+        search_index_destroy(s->index);
+    }
+    if (c->shape == BENCH_SHAPE_SPARSE) {
+        s2_free(&s->csr);
+        s2_free(&s->csc);
+        s2_free(&s->coo);
+    }
+    for (size_t i = 0; i < 3; ++i) {
+        if (s->path[i][0]) {
+            unlink(s->path[i]);
+        }
+    }
+    m2_arena_destroy(s->arena);
+}
+
+// measurement
+
+typedef struct {
+    bench_case const *c;
+    size_t working_set;  // bytes of one buffer or matrix
+    size_t n;
+    size_t reps;
+    size_t batch;
+    double min;  // ns per element
+    double median;
+    double mean;
+    double stddev;
+    double gbps;
+    double gflops;
+} bench_result;
+
+static double _bench_now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+// seconds taken by `count` iterations, restoring destroyed input is excluded
+static double _bench_batch(bench_case const *const c, bench_state *const s,
+                           size_t const count) {
+    if (not c->destructive) {
+        double const start = _bench_now();
+        for (size_t i = 0; i < count; ++i) {
+            c->run(s);
+        }
+        return _bench_now() - start;
+    }
+    double total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (s->pristine) {
+            memcpy(s->a, s->pristine, s->n * s->dtype);
+        } else {
+            for (size_t row = 0; row < s->n; ++row) {
+                memcpy(m2_get_from_matrix(s->mc, 0, row),
+                       m2_get_from_matrix(s->mb, 0, row), s->n * s->dtype);
+            }
+        }
+        double const start = _bench_now();
+        c->run(s);
+        total += _bench_now() - start;
+    }
+    return total;
+}
+
+static int _bench_compare_double(const void *const lhs,
+                                 const void *const rhs) {
+    double const l = *(double const *)lhs;
+    double const r = *(double const *)rhs;
+    return (l > r) - (l < r);
+}
+
+static bench_result _bench_measure(bench_options const *const options,
+                                   bench_case const *const c,
+                                   bench_state *const s,
+                                   size_t const working_set) {
+    bench_result result = {.c = c, .working_set = working_set, .n = s->n};
+    double const elements = _bench_elements(c, s->n);
+
+    double const warmup_end = _bench_now() + options->warmup;
+    do {
+        _bench_batch(c, s, 1);
+    } while (_bench_now() < warmup_end);
+
+    size_t batch = 1;
+    while (_bench_batch(c, s, batch) < BENCH_MIN_BATCH) {
+        batch *= 2;
+    }
+
+    double *const samples = malloc(options->max_reps * sizeof(double));
+    assert(samples);
+    double total = 0;
+    size_t reps = 0;
+    while (reps < options->max_reps and
+           (reps < options->min_reps or total < options->min_time)) {
+        double const seconds = _bench_batch(c, s, batch);
+        total += seconds;
+        samples[reps++] = seconds * 1e9 / ((double)batch * elements);
+    }
+
+    qsort(samples, reps, sizeof(double), &_bench_compare_double);
+    double sum = 0;
+    for (size_t i = 0; i < reps; ++i) {
+        sum += samples[i];
+    }
+    double const mean = sum / reps;
+    double squares = 0;
+    for (size_t i = 0; i < reps; ++i) {
+        squares += (samples[i] - mean) * (samples[i] - mean);
+    }
+
+    result.reps = reps;
+    result.batch = batch;
+    result.min = samples[0];
+    result.median = reps % 2 ? samples[reps / 2]
+                             : (samples[reps / 2 - 1] + samples[reps / 2]) / 2;
+    result.mean = mean;
+    result.stddev = reps > 1 ? sqrt(squares / (reps - 1)) : 0;
+
+    double bytes = c->bytes * c->dtype;
+    double flops = c->flops;
+    if (c->shape == BENCH_SHAPE_CUBIC) {
+        flops *= s->n;
+    }
+    if (c->shape == BENCH_SHAPE_SPARSE) {
+        // indices of the stored values and the offsets of CSR and CSC
+        bytes += sizeof(u32);
+    }
+    result.gbps = bytes / result.median;
+    result.gflops = flops / result.median;
+    free(samples);
+    return result;
+}
+
+// reporting
+
+static char const *_bench_isa() {
+    switch (gemm_detect_isa()) {
+        case GEMM_ISA_SCALAR:
+            return "scalar";
+        case GEMM_ISA_SSE2:
+            return "sse2";
+        case GEMM_ISA_AVX2:
+            return "avx2";
+        case GEMM_ISA_AVX512_VNNI:
+            return "avx512_vnni";
+    }
+    return "unknown";
+}
+
+static void _bench_begin(bench_options const *const options) {
+    size_t const threads = thread_pool_size(thread_pool_default());
+    switch (options->format) {
+        case BENCH_TABLE:
+            printf("# isa %s, %zu threads\n", _bench_isa(), threads);
+            printf("%-20s %-24s %-4s %10s %9s %6s %12s %12s %7s %9s %9s\n",
+                   "group", "name", "type", "bytes", "n", "reps",
+                   "median ns/e", "min ns/e", "stddev%", "GB/s", "GFLOP/s");
+            break;
+        case BENCH_CSV:
+            printf("group,name,type,bytes,n,reps,batch,min_ns,median_ns,"
+                   "mean_ns,stddev_ns,gbps,gflops\n");
+            break;
+        case BENCH_JSON:
+            printf("{\n  \"isa\": \"%s\",\n  \"threads\": %zu,\n"
+                   "  \"results\": [",
+                   _bench_isa(), threads);
+            break;
+    }
+}
+
+static void _bench_report(bench_options const *const options,
+                          bench_result const *const r, bool const first) {
+    bench_case const *const c = r->c;
+    switch (options->format) {
+        case BENCH_TABLE:
+            printf("%-20s %-24s %-4s %10zu %9zu %6zu %12.4g %12.4g %7.2f "
+                   "%9.3f %9.3f\n",
+                   c->group, c->name, c->type, r->working_set, r->n, r->reps,
+                   r->median, r->min,
+                   r->mean > 0 ? 100 * r->stddev / r->mean : 0, r->gbps,
+                   r->gflops);
+            break;
+        case BENCH_CSV:
+            printf("%s,%s,%s,%zu,%zu,%zu,%zu,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g\n",
+                   c->group, c->name, c->type, r->working_set, r->n, r->reps,
+                   r->batch, r->min, r->median, r->mean, r->stddev, r->gbps,
+                   r->gflops);
+            break;
+        case BENCH_JSON:
+            printf("%s\n    {\"group\": \"%s\", \"name\": \"%s\", "
+                   "\"type\": \"%s\", \"bytes\": %zu, \"n\": %zu, "
+                   "\"reps\": %zu, \"batch\": %zu, \"min_ns\": %.6g, "
+                   "\"median_ns\": %.6g, \"mean_ns\": %.6g, "
+                   "\"stddev_ns\": %.6g, \"gbps\": %.6g, \"gflops\": %.6g}",
+                   first ? "" : ",", c->group, c->name, c->type,
+                   r->working_set, r->n, r->reps, r->batch, r->min,
+                   r->median, r->mean, r->stddev, r->gbps, r->gflops);
+            break;
+    }
+    fflush(stdout);
+}
+
+static void _bench_end(bench_options const *const options) {
+    if (options->format == BENCH_JSON) {
+        printf("\n  ]\n}\n");
+    }
+}
+
+// driver
+
+static bool _bench_selected(bench_options const *const options,
+                            bench_case const *const c) {
+    if (strcmp(c->group, "matrix2_io") == 0 and not options->io) {
+        return false;
+    }
+    if (not options->filter) {
+        return true;
+    }
+    char name[128];
+    snprintf(name, sizeof(name), "%s/%s/%s", c->group, c->name, c->type);
+    return strstr(name, options->filter) != NULL;
+}
+
+// cubic cases above the work limit are skipped, as are repeated sizes of
+// the square cases once the side stops changing
+static bool _bench_feasible(bench_options const *const options,
+                            bench_case const *const c, size_t const n) {
+    if (not n) {
+        return false;
+    }
+    if (c->shape != BENCH_SHAPE_CUBIC) {
+        return true;
+    }
+    double limit = options->max_work;
+    if (not _bench_accelerated(c)) {
+        limit /= 1 << BENCH_CALLBACK_WORK_SHIFT;
+    }
+    return (double)n * n * n <= limit;
+}
+
+static size_t _bench_parse_size(char const *const text) {
+    char *end = NULL;
+    double value = strtod(text, &end);
+    switch (*end) {
+        case 'k':
+        case 'K':
+            value *= 1 << 10;
+            break;
+        case 'm':
+        case 'M':
+            value *= 1 << 20;
+            break;
+        case 'g':
+        case 'G':
+            value *= 1 << 30;
+            break;
+    }
+    return value > 0 ? (size_t)value : 0;
+}
+
+static void _bench_usage(char const *const program) {
+    printf(
+        "usage: %s [options]\n"
+        "  --format table|csv|json  output format, table by default\n"
+        "  --filter TEXT            only cases whose group/name/type "
+        "contains TEXT\n"
+        "  --sizes A,B,...          working set of every buffer in bytes, "
+        "K, M and G\n"
+        "                           suffixes allowed, "
+        "4K,32K,256K,2M,16M,64M by default\n"
+        "  --min-time SECONDS       measuring time per case and size, "
+        "0.1 by default\n"
+        "  --warmup SECONDS         untimed runs first, 0.02 by default\n"
+        "  --reps-min N             repetitions at least, 5 by default\n"
+        "  --reps-max N             repetitions at most, 1000 by default\n"
+        "  --max-work N             multiply adds of the largest product, "
+        "2^31 by default\n"
+        "  --io                     include the matrix2_io cases, which "
+        "write to TMPDIR\n"
+        "  --list                   print the cases and exit\n",
+        program);
+}
+
+static bool _bench_parse(int const argc, char **const argv,
+                         bench_options *const options) {
+    static size_t const default_sizes[] = {4 << 10,   32 << 10, 256 << 10,
+                                           2 << 20,   16 << 20, 64 << 20};
+    *options = (bench_options){
+        .format = BENCH_TABLE,
+        .min_time = 0.1,
+        .warmup = 0.02,
+        .min_reps = 5,
+        .max_reps = 1000,
+        .max_work = (double)(1ull << 31),
+    };
+    options->size_count = sizeof(default_sizes) / sizeof(default_sizes[0]);
+    memcpy(options->sizes, default_sizes, sizeof(default_sizes));
+
+    for (int i = 1; i < argc; ++i) {
+        char const *const arg = argv[i];
+        char const *const value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--io") == 0) {
+            options->io = true;
+            continue;
+        }
+        if (strcmp(arg, "--list") == 0) {
+            options->list = true;
+            continue;
+        }
+        if (not value) {
+            return false;
+        }
+        ++i;
+        if (strcmp(arg, "--format") == 0) {
+            if (strcmp(value, "table") == 0) {
+                options->format = BENCH_TABLE;
+            } else if (strcmp(value, "csv") == 0) {
+                options->format = BENCH_CSV;
+            } else if (strcmp(value, "json") == 0) {
+                options->format = BENCH_JSON;
+            } else {
+                return false;
+            }
+        } else if (strcmp(arg, "--filter") == 0) {
+            options->filter = value;
+        } else if (strcmp(arg, "--sizes") == 0) {
+            options->size_count = 0;
+            for (char const *p = value; *p and options->size_count < 32;) {
+                size_t const size = _bench_parse_size(p);
+                if (not size) {
+                    return false;
+                }
+                options->sizes[options->size_count++] = size;
+                p = strchr(p, ',');
+                p = p ? p + 1 : "";
+            }
+        } else if (strcmp(arg, "--min-time") == 0) {
+            options->min_time = atof(value);
+        } else if (strcmp(arg, "--warmup") == 0) {
+            options->warmup = atof(value);
+        } else if (strcmp(arg, "--reps-min") == 0) {
+            options->min_reps = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--reps-max") == 0) {
+            options->max_reps = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--max-work") == 0) {
+            options->max_work = _bench_parse_size(value);
+        } else {
+            return false;
+        }
+    }
+    if (options->max_reps < 1) {
+        options->max_reps = 1;
+    }
+    return options->size_count > 0;
+}
+
+int main(int argc, char **argv) {
+    bench_options options;
+    if (not _bench_parse(argc, argv, &options)) {
+        _bench_usage(argv[0]);
+        return 1;
+    }
+
+    if (options.list) {
+        for (size_t i = 0; i < BENCH_CASE_COUNT; ++i) {
+            bench_case const *const c = _bench_cases + i;
+            if (_bench_selected(&options, c)) {
+                printf("%s/%s/%s\n", c->group, c->name, c->type);
+            }
+        }
+        return 0;
+    }
+
+    _bench_begin(&options);
+    bool first = true;
+    for (size_t i = 0; i < BENCH_CASE_COUNT; ++i) {
+        bench_case const *const c = _bench_cases + i;
+        if (not _bench_selected(&options, c)) {
+            continue;
+        }
+        size_t previous = 0;
+        for (size_t k = 0; k < options.size_count; ++k) {
+            size_t const n = _bench_size(c, options.sizes[k]);
+            if (n == previous or not _bench_feasible(&options, c, n)) {
+                continue;
+            }
+            previous = n;
+            bench_state state;
+            _bench_setup(c, &state, n, options.sizes[k]);
+            bench_result const result =
+                _bench_measure(&options, c, &state, options.sizes[k]);
+            _bench_teardown(c, &state);
+            _bench_report(&options, &result, first);
+            first = false;
+        }
+    }
+    _bench_end(&options);
+    return 0;
+}
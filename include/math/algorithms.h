@@ -96,6 +96,119 @@ typedef void *(*Generator)();
  */
 typedef int64_t (*RandomGenerator)();
 
+/**
+ * @brief Predicate for value of certain size that additionally receives user context
+ *
+ */
+typedef bool (*UnaryPredicateCtx)(const void *const, void *);
+
+/**
+ * @brief Binary predicate that accepts two values of the same sized type and user context
+ *
+ */
+typedef bool (*BinaryPredicateCtx)(const void *const, const void *const, void *);
+
+/**
+ * @brief Unary predicate bound to its context.
+ * Closures are plain values with no hidden global state, so they can be copied,
+ * negated and called from any number of threads at once, as long as the
+ * predicate itself does not modify the shared context.
+ *
+ */
+typedef struct UnaryClosure {
+    UnaryPredicateCtx fn;
+    void *ctx;
+    bool negate;
+} UnaryClosure;
+
+/**
+ * @brief Binary predicate bound to its context, see UnaryClosure
+ *
+ */
+typedef struct BinaryClosure {
+    BinaryPredicateCtx fn;
+    void *ctx;
+    bool negate;
+} BinaryClosure;
+
+/**
+ * @brief Calls unary closure with given value
+ *
+ * @param c closure to call
+ * @param value parameter of a predicate
+ * @return result of the predicate, inverted if the closure is negated
+ */
+static inline bool unary_closure_call(const UnaryClosure *const c,
+                                      const void *const value) {
+    return c->fn(value, c->ctx) != c->negate;
+}
+
+/**
+ * @brief Calls binary closure with given values
+ *
+ * @param c closure to call
+ * @param lhs left hand side parameter of a predicate
+ * @param rhs right hand side parameter of a predicate
+ * @return result of the predicate, inverted if the closure is negated
+ */
+static inline bool binary_closure_call(const BinaryClosure *const c,
+                                       const void *const lhs,
+                                       const void *const rhs) {
+    return c->fn(lhs, rhs, c->ctx) != c->negate;
+}
+
+/**
+ * @brief Binds unary predicate to its context
+ *
+ * @param fn predicate receiving `ctx` as the last argument
+ * @param ctx context passed to every call of the predicate, may be NULL
+ * @return UnaryClosure closure calling `fn` with `ctx`
+ */
+UnaryClosure unary_closure(UnaryPredicateCtx fn, void *ctx);
+
+/**
+ * @brief Binds binary predicate to its context
+ *
+ * @param fn predicate receiving `ctx` as the last argument
+ * @param ctx context passed to every call of the predicate, may be NULL
+ * @return BinaryClosure closure calling `fn` with `ctx`
+ */
+BinaryClosure binary_closure(BinaryPredicateCtx fn, void *ctx);
+
+/**
+ * @brief Wraps context free unary predicate into a closure
+ *
+ * @param p unary predicate
+ * @return UnaryClosure closure calling `p`
+ */
+UnaryClosure unary_closure_from(UnaryPredicate p);
+
+/**
+ * @brief Wraps context free binary predicate into a closure
+ *
+ * @param p binary predicate
+ * @return BinaryClosure closure calling `p`
+ */
+BinaryClosure binary_closure_from(BinaryPredicate p);
+
+/**
+ * @brief Negates given unary closure. Unlike not_unary_predicate this stores no global state,
+ * the returned closure simply has its negation flag flipped
+ *
+ * @param c unary closure
+ * @return UnaryClosure negated closure
+ */
+UnaryClosure unary_closure_not(UnaryClosure c);
+
+/**
+ * @brief Negates given binary closure. Unlike not_binary_predicate this stores no global state,
+ * the returned closure simply has its negation flag flipped
+ *
+ * @param c binary closure
+ * @return BinaryClosure negated closure
+ */
+BinaryClosure binary_closure_not(BinaryClosure c);
+
 /**
  * @brief Intermediate variable to store predicate received by not_unary_predicate. Used in _unary_not_predicate_wrapper
  *
@@ -127,6 +240,9 @@ bool _binary_not_predicate_wrapper(const void *const lhs,
 /**
  * @brief Negates given unary predicate. The negation is equivalent to calling the predicate with not operator
  *
+ * @note The predicate is stored in a global variable, so only one negated predicate may be alive at a time
+ *       and it must not be used from several threads. Prefer unary_closure_not
+ *
  * @param p unary predicate
  * @return UnaryPredicate pointer to negated unary predicate
  */
@@ -135,6 +251,9 @@ UnaryPredicate not_unary_predicate(UnaryPredicate p);
 /**
  * @brief Negates given binary predicate. The negation is equivalent to calling the predicate with not operator
  *
+ * @note The predicate is stored in a global variable, so only one negated predicate may be alive at a time
+ *       and it must not be used from several threads. Prefer binary_closure_not
+ *
  * @param p binary predicate
  * @return UnaryPredicate pointer to negated unary predicate
  */
@@ -143,9 +262,9 @@ BinaryPredicate not_binary_predicate(BinaryPredicate p);
 /**
  * @brief Swaps the contents of two memory blocks.
  *
- * This function swaps the contents of two memory blocks, byte by byte,
- * using a temporary variable. The size of each element in the blocks is
- * determined by `nbytes`.
+ * This function swaps the contents of two memory blocks through a small
+ * bounce buffer, in vector sized blocks first, then in words and finally in
+ * bytes. The blocks must not partially overlap.
  *
  * @param lhs A pointer to the first memory block.
  * @param rhs A pointer to the second memory block.
@@ -171,6 +290,9 @@ void memswap(void *lhs, void *rhs, size_t nbytes);
  *           in the range. It should take two arguments of type `void*` - the accumulated value and the current
  *           element - and modify the accumulated value accordingly. The function is expected to have side effects,
  *           as it modifies the state of the `accum` variable.
+ *
+ * @note If `op` is one of the typed accumulators (e.g. `f64_accum_add`) and `dtype` matches its type,
+ *       the call is dispatched to the corresponding typed kernel (e.g. `reduce_add_f64`).
  */
 void reduce(const void *first,
             const void *const last,
@@ -201,19 +323,24 @@ const void *find(const void *first,
                  UnaryPredicate p);
 
 /**
- * @brief Filters elements in a range based on a unary predicate.
+ * @brief Filters out the elements of a range satisfying a unary predicate.
  *
  * This function iterates over the elements in the range defined by the pointers `first` and `last`,
- * and filters the elements based on a unary predicate `p`. The filtered elements are moved to the beginning
- * of the range pointed to by `first`, and the pointer `first` is updated to point to the new end of the filtered range.
+ * and removes the elements for which the unary predicate `p` returns `true`. The remaining elements are moved
+ * to the beginning of the range pointed to by `first`, and the returned pointer points to the new end of that range.
+ * The relative order of the remaining elements is preserved and `p` is called exactly once per element.
  *
- * @param first A pointer to the beginning of the range. After filtering, this pointer will be updated to point to the new end of the filtered range.
+ * @param first A pointer to the beginning of the range.
  * @param last A pointer to the end of the range.
  * @param dtype The size of the type stored by the pointers.
- * @param p The unary predicate function that determines whether an element should be included in the filtered range or not.
- *          It should take one argument of type `void*` - the current element - and return a `bool` value indicating whether the element passes the filter or not.
+ * @param p The unary predicate function that determines whether an element is filtered out.
+ *          It should take one argument of type `void*` - the current element - and return `true` if the element
+ *          has to be removed from the range.
+ *
+ * @return A pointer to the new end of the range of remaining elements.
  *
- * @return A pointer to the new end of the filtered range, which is also the updated value of the `first` parameter.
+ * @note Equivalent to remove_if, see it for the details of the compaction. copy_if keeps the elements
+ *       satisfying the predicate instead.
  */
 void *filter(void *first,
              const void *const last,
@@ -293,6 +420,9 @@ size_t count(const void *first,
  * @param dtype2 The size (in bytes) of each element in the second range
  * @param p The binary predicate used for comparison
  * @return A Pair struct containing the first mismatched elements as void pointers
+ *
+ * @note If `p` is the typed equality of an integer type (e.g. `i32_equal`) and both dtypes match it,
+ *       the call is dispatched to mismatch_bytes.
  */
 Pair mismatch(const void *first1,
               const void *const last1,
@@ -310,6 +440,9 @@ Pair mismatch(const void *first1,
  * @param dtype Size of each element in the range.
  * @param p Binary predicate function used to compare elements.
  * @return const void* Pointer to the first element of the pair satisfying the condition. Returns last if no such element is found.
+ *
+ * @note If `p` is the typed equality of an integer type (e.g. `i32_equal`) and `dtype` matches it,
+ *       the call is dispatched to adjacent_find_eq.
  */
 const void *adjacent_find(const void *first,
                           const void *last,
@@ -332,6 +465,9 @@ const void *adjacent_find(const void *first,
  * @param p A binary predicate used to compare elements in the two sequences.
  * @return const void* A pointer to the first element in the first sequence that matches the second sequence,
  *         or a pointer to last1 if the second sequence is not found.
+ *
+ * @note If `p` is the typed equality of an integer type (e.g. `i32_equal`) and both dtypes match it,
+ *       the call is dispatched to search_bytes.
  */
 const void *search(const void *first1,
                    const void *last1,
@@ -381,6 +517,7 @@ void generate(void *first,
  *
  * @note Both `first` and `last` should point to memory blocks large enough to accommodate elements of size `dtype`.
  * @note The `dtype` parameter should be greater than or equal to zero.
+ * @note Ranges aligned to a `dtype` of 1, 2, 4 or 8 bytes are filled by a typed kernel.
  */
 void fill(void *first,
           const void *const last,
@@ -424,6 +561,9 @@ void transform(const void *source_first,
  * @param last A pointer to one past the last element of the range.
  * @param dtype The size of each element in the array in bytes.
  * @return void* A pointer to the first element of the rotated range.
+ *
+ * @note The rotation is iterative and uses O(1) extra memory. When the shorter side is small it is moved
+ *       through a stack buffer with a single memmove, otherwise the sides are exchanged by block swaps.
  */
 void *rotate(void *first,
              void *around,
@@ -469,4 +609,567 @@ void shuffle(void *first,
              int64_t dtype,
              RandomGenerator rnd);
 
+/**
+ * @brief Sorts a range of elements.
+ *
+ * This function sorts the elements in the range defined by `first` and `last` in ascending order
+ * according to the strict weak ordering `less`. The sort is not stable. The generic path is a
+ * pattern-defeating quicksort, that falls back to heapsort when the partitions become too unbalanced,
+ * so the worst case is O(n log n).
+ *
+ * @param first A pointer to the first element in the range.
+ * @param last A pointer to one past the last element in the range.
+ * @param dtype The size of each element in bytes, must be positive.
+ * @param less The binary predicate returning `true` if the first argument is ordered before the second.
+ *
+ * @note If `less` is one of the typed comparators (e.g. `i32_less`) and `dtype` matches its type,
+ *       the range is sorted by the typed LSD radix sort (e.g. `sort_i32`).
+ */
+void sort(void *first,
+          void *last,
+          int64_t dtype,
+          BinaryPredicate less);
+
+/**
+ * @brief Sorts a range of elements preserving the order of equal elements.
+ *
+ * This function sorts the elements in the range defined by `first` and `last` in ascending order
+ * according to the strict weak ordering `less`. Elements that are equal keep their relative order.
+ * The generic path is a merge sort that allocates a buffer for half of the range.
+ *
+ * @param first A pointer to the first element in the range.
+ * @param last A pointer to one past the last element in the range.
+ * @param dtype The size of each element in bytes, must be positive.
+ * @param less The binary predicate returning `true` if the first argument is ordered before the second.
+ *
+ * @note Typed comparators are dispatched to the typed radix sort exactly like in sort, as it is stable.
+ */
+void stable_sort(void *first,
+                 void *last,
+                 int64_t dtype,
+                 BinaryPredicate less);
+
+/**
+ * @brief Searches for a sequence within another sequence comparing elements bitwise.
+ *
+ * Equivalent to search with a predicate comparing the elements with memcmp, but runs in linear
+ * time. Short patterns are located by comparing their first and last bytes against 16 or 32
+ * positions at once with SSE2/AVX2, long patterns are located with the Two-Way algorithm.
+ * Only matches starting at an element boundary of the first sequence are reported, Two-Way steps
+ * over the other ones like over any match without rescanning them, so the time stays linear even
+ * when most matches are off the boundaries.
+ *
+ * @param first1 A pointer to the beginning of the first sequence.
+ * @param last1 A pointer to the end of the first sequence.
+ * @param first2 A pointer to the beginning of the second sequence.
+ * @param last2 A pointer to the end of the second sequence.
+ * @param dtype The size of the elements in both sequences, must be positive.
+ * @return const void* A pointer to the first element in the first sequence that matches the second sequence,
+ *         or a pointer to last1 if the second sequence is not found.
+ */
+const void *search_bytes(const void *first1,
+                         const void *last1,
+                         const void *first2,
+                         const void *last2,
+                         int64_t dtype);
+
+/**
+ * @brief Finds the first element bitwise equal to a value.
+ *
+ * Compares 16 or 32 bytes per instruction with SSE2/AVX2 when `dtype` is a power of two dividing
+ * the vector width, single byte elements go through memchr and other sizes through memcmp.
+ *
+ * @param first A pointer to the beginning of the range.
+ * @param last A pointer to the end of the range.
+ * @param dtype The size of the type stored by the pointers, must be positive.
+ * @param value A pointer to the value of `dtype` bytes to look for.
+ *
+ * @return A pointer to the found element, or `last` if no element is found.
+ */
+const void *find_value(const void *first,
+                       const void *const last,
+                       int64_t dtype,
+                       const void *const value);
+
+/**
+ * @brief Finds the first pair of elements that differ bitwise in two ranges.
+ *
+ * Both ranges are compared 16 or 32 bytes per instruction with SSE2/AVX2, the element is then
+ * located from the first differing byte, so any `dtype` is accelerated.
+ *
+ * @param first1 A pointer to the beginning of the first range
+ * @param last1 A pointer to the end of the first range (exclusive)
+ * @param first2 A pointer to the beginning of the second range
+ * @param last2 A pointer to the end of the second range (exclusive)
+ * @param dtype The size (in bytes) of each element in both ranges, must be positive
+ * @return A Pair struct containing the first mismatched elements as void pointers
+ */
+Pair mismatch_bytes(const void *first1,
+                    const void *const last1,
+                    const void *first2,
+                    const void *const last2,
+                    int64_t dtype);
+
+/**
+ * @brief Finds the first pair of adjacent elements that are bitwise equal.
+ *
+ * Compares every element with its successor 16 or 32 bytes per instruction with SSE2/AVX2 when
+ * `dtype` is a power of two dividing the vector width, other sizes go through memcmp.
+ *
+ * @param first Pointer to the beginning of the range.
+ * @param last Pointer to the end of the range (one past the last element).
+ * @param dtype Size of each element in the range, must be positive.
+ * @return const void* Pointer to the first element of the equal pair. Returns last if no such element is found.
+ */
+const void *adjacent_find_eq(const void *first,
+                             const void *last,
+                             size_t dtype);
+
+/**
+ * @brief Removes the elements satisfying a unary predicate preserving the order of the rest.
+ *
+ * The predicate is evaluated for a block of up to 64 elements into a bit mask, the kept elements of the
+ * block are then moved with one memmove per run of consecutive kept elements. For 4 and 8 byte elements
+ * the block is compacted with AVX2 left-packing instead, moving 8 or 4 elements per instruction.
+ * `p` is called exactly once per element, in order.
+ *
+ * @param first A pointer to the beginning of the range.
+ * @param last A pointer to the end of the range.
+ * @param dtype The size of the type stored by the pointers, must be positive.
+ * @param p The unary predicate returning `true` for the elements to remove.
+ *
+ * @return A pointer to the new end of the range, the elements past it are left in an unspecified state.
+ */
+void *remove_if(void *first,
+                const void *const last,
+                size_t dtype,
+                UnaryPredicate p);
+
+/**
+ * @brief Copies the elements satisfying a unary predicate preserving their order.
+ *
+ * Uses the same block compaction as remove_if.
+ *
+ * @param first A pointer to the beginning of the source range.
+ * @param last A pointer to the end of the source range.
+ * @param dtype The size of the type stored by the pointers, must be positive.
+ * @param dest A pointer to the beginning of the destination range, must not overlap the source range
+ *             and must have room for all the copied elements.
+ * @param p The unary predicate returning `true` for the elements to copy.
+ *
+ * @return A pointer to the end of the copied elements in the destination range.
+ */
+void *copy_if(const void *first,
+              const void *const last,
+              size_t dtype,
+              void *dest,
+              UnaryPredicate p);
+
+/**
+ * @brief Reorders the elements so that the ones satisfying a unary predicate precede the others.
+ *
+ * Swaps the misplaced elements from both ends towards the middle, so every element is moved at most
+ * once. The relative order of the elements is not preserved.
+ *
+ * @param first A pointer to the beginning of the range.
+ * @param last A pointer to the end of the range.
+ * @param dtype The size of the type stored by the pointers, must be positive.
+ * @param p The unary predicate returning `true` for the elements of the first group.
+ *
+ * @return A pointer to the first element of the second group.
+ */
+void *partition(void *first,
+                void *last,
+                size_t dtype,
+                UnaryPredicate p);
+
+/**
+ * @brief Reorders the elements so that the ones satisfying a unary predicate precede the others,
+ * preserving the relative order within both groups.
+ *
+ * The elements satisfying `p` are compacted in place like in copy_if while the others are compacted
+ * into a temporary buffer, which is then copied behind them. `p` is called exactly once per element.
+ *
+ * @param first A pointer to the beginning of the range.
+ * @param last A pointer to the end of the range.
+ * @param dtype The size of the type stored by the pointers, must be positive.
+ * @param p The unary predicate returning `true` for the elements of the first group.
+ *
+ * @return A pointer to the first element of the second group.
+ */
+void *stable_partition(void *first,
+                       void *last,
+                       size_t dtype,
+                       UnaryPredicate p);
+
+/**
+ * @brief Finds the first element of a sorted range that is not ordered before a value.
+ *
+ * The range is halved a fixed number of times, the comparison only selects the next base with a
+ * conditional move instead of a branch, and both possible next probes are prefetched.
+ *
+ * @param first A pointer to the first element of the range, sorted with respect to `less`.
+ * @param last A pointer to one past the last element of the range.
+ * @param dtype The size of each element in bytes, must be positive.
+ * @param value A pointer to the value to compare the elements with.
+ * @param less The binary predicate returning `true` if the first argument is ordered before the second.
+ *
+ * @return A pointer to the first element `e` for which `less(e, value)` is `false`, or `last`.
+ *
+ * @note If `less` is one of the typed comparators (e.g. `i32_less`) and `dtype` matches its type,
+ *       the search is dispatched to the typed version (e.g. `lower_bound_i32`).
+ */
+const void *lower_bound(const void *first,
+                        const void *last,
+                        int64_t dtype,
+                        const void *const value,
+                        BinaryPredicate less);
+
+/**
+ * @brief Finds the first element of a sorted range that is ordered after a value.
+ *
+ * Same as lower_bound, including the typed dispatch.
+ *
+ * @param first A pointer to the first element of the range, sorted with respect to `less`.
+ * @param last A pointer to one past the last element of the range.
+ * @param dtype The size of each element in bytes, must be positive.
+ * @param value A pointer to the value to compare the elements with.
+ * @param less The binary predicate returning `true` if the first argument is ordered before the second.
+ *
+ * @return A pointer to the first element `e` for which `less(value, e)` is `true`, or `last`.
+ */
+const void *upper_bound(const void *first,
+                        const void *last,
+                        int64_t dtype,
+                        const void *const value,
+                        BinaryPredicate less);
+
+/**
+ * @brief Finds the subrange of a sorted range whose elements are equivalent to a value.
+ *
+ * @param first A pointer to the first element of the range, sorted with respect to `less`.
+ * @param last A pointer to one past the last element of the range.
+ * @param dtype The size of each element in bytes, must be positive.
+ * @param value A pointer to the value to compare the elements with.
+ * @param less The binary predicate returning `true` if the first argument is ordered before the second.
+ *
+ * @return A Pair holding the results of lower_bound and upper_bound.
+ */
+Pair equal_range(const void *first,
+                 const void *last,
+                 int64_t dtype,
+                 const void *const value,
+                 BinaryPredicate less);
+
+/**
+ * @brief Checks whether a sorted range contains an element equivalent to a value.
+ *
+ * @param first A pointer to the first element of the range, sorted with respect to `less`.
+ * @param last A pointer to one past the last element of the range.
+ * @param dtype The size of each element in bytes, must be positive.
+ * @param value A pointer to the value to look for.
+ * @param less The binary predicate returning `true` if the first argument is ordered before the second.
+ *
+ * @return `true` if an element neither ordered before nor after `value` exists, `false` otherwise.
+ */
+bool binary_search(const void *first,
+                   const void *last,
+                   int64_t dtype,
+                   const void *const value,
+                   BinaryPredicate less);
+
+/**
+ * @brief Read-only search index over a sorted range.
+ *
+ * Stores a copy of the range in Eytzinger (breadth-first) order, where the descendants of a node
+ * several levels down share a cache line and are prefetched ahead of the lookup. Batched lookups
+ * descend in lockstep, so the latencies of their cache misses overlap. Indices built with a typed
+ * comparator (e.g. `u32_less`) store order preserving integer keys and never call the predicate.
+ * The index may be queried from several threads at once.
+ *
+ */
+typedef struct search_index search_index;
+
+/**
+ * @brief Builds a search index over a sorted range.
+ *
+ * @param first A pointer to the first element of the range, sorted with respect to `less`.
+ * @param last A pointer to one past the last element of the range.
+ * @param dtype The size of each element in bytes, must be positive.
+ * @param less The binary predicate returning `true` if the first argument is ordered before the second.
+ *
+ * @return The index, the range is no longer referenced by it.
+ */
+search_index *search_index_create(const void *first,
+                                  const void *last,
+                                  int64_t dtype,
+                                  BinaryPredicate less);
+
+/**
+ * @brief Frees the index, NULL is ignored.
+ *
+ */
+void search_index_destroy(search_index *index);
+
+/**
+ * @brief Number of elements in the indexed range.
+ *
+ */
+size_t search_index_size(const search_index *index);
+
+/**
+ * @brief Position of lower_bound of a value in the indexed range.
+ *
+ * @param index The index to search.
+ * @param value A pointer to the value to look for.
+ *
+ * @return Index of the first element not ordered before `value`, or the size of the range.
+ */
+size_t search_index_lower_bound(const search_index *index,
+                                const void *const value);
+
+/**
+ * @brief Position of upper_bound of a value in the indexed range.
+ *
+ * @param index The index to search.
+ * @param value A pointer to the value to look for.
+ *
+ * @return Index of the first element ordered after `value`, or the size of the range.
+ */
+size_t search_index_upper_bound(const search_index *index,
+                                const void *const value);
+
+/**
+ * @brief Looks up the lower_bound positions of many values at once.
+ *
+ * @param index The index to search.
+ * @param values A pointer to `count` values of the indexed `dtype`.
+ * @param count The number of values.
+ * @param ranks Receives the position for every value.
+ */
+void search_index_lower_bound_batch(const search_index *index,
+                                    const void *values,
+                                    size_t count,
+                                    size_t *ranks);
+
+/**
+ * @brief Looks up the upper_bound positions of many values at once.
+ *
+ * @param index The index to search.
+ * @param values A pointer to `count` values of the indexed `dtype`.
+ * @param count The number of values.
+ * @param ranks Receives the position for every value.
+ */
+void search_index_upper_bound_batch(const search_index *index,
+                                    const void *values,
+                                    size_t count,
+                                    size_t *ranks);
+
+/**
+ * @brief Finds an element in a range that satisfies a given closure, see find.
+ *
+ * @param first A pointer to the beginning of the range.
+ * @param last A pointer to the end of the range.
+ * @param dtype The size of the type stored by the pointers. If a negative value is used, the traversal
+ *              will be done in reverse order.
+ * @param p The unary closure that determines if an element satisfies the desired condition.
+ *
+ * @return A pointer to the found element, or `last` if no element is found.
+ */
+const void *find_ctx(const void *first,
+                     const void *const last,
+                     int64_t dtype,
+                     UnaryClosure p);
+
+/**
+ * @brief Checks if all elements in a range satisfy a unary closure, see all.
+ *
+ * @param first A pointer to the beginning of the range.
+ * @param last A pointer to the end of the range.
+ * @param dtype The size of the type stored by the pointers.
+ * @param p The unary closure that determines whether an element satisfies a condition or not.
+ *
+ * @return `true` if all elements in the range satisfy the closure, `false` otherwise.
+ */
+bool all_ctx(const void *first,
+             const void *const last,
+             size_t dtype,
+             UnaryClosure p);
+
+/**
+ * @brief Checks if at least one element in a range satisfy a unary closure, see any.
+ *
+ * @param first A pointer to the beginning of the range.
+ * @param last A pointer to the end of the range.
+ * @param dtype The size of the type stored by the pointers.
+ * @param p The unary closure that determines whether an element satisfies a condition or not.
+ *
+ * @return `true` if at least one element in the range satisfy the closure, `false` otherwise.
+ */
+bool any_ctx(const void *first,
+             const void *const last,
+             size_t dtype,
+             UnaryClosure p);
+
+/**
+ * @brief Counts the number of elements in a range that satisfy a given closure, see count.
+ *
+ * @param first A pointer to the beginning of the range.
+ * @param last A pointer to the end of the range (one-past-the-end).
+ * @param dtype The size of each element in the range, in bytes.
+ * @param p The unary closure to be applied to each element.
+ * @return The number of elements in the range that satisfy the closure.
+ */
+size_t count_ctx(const void *first,
+                 const void *const last,
+                 size_t dtype,
+                 UnaryClosure p);
+
+/**
+ * @brief Finds the first mismatched pair of elements in two ranges using a binary closure, see mismatch.
+ *
+ * @param first1 A pointer to the beginning of the first range
+ * @param last1 A pointer to the end of the first range (exclusive)
+ * @param dtype1 The size (in bytes) of each element in the first range
+ * @param first2 A pointer to the beginning of the second range
+ * @param last2 A pointer to the end of the second range (exclusive)
+ * @param dtype2 The size (in bytes) of each element in the second range
+ * @param p The binary closure used for comparison
+ * @return A Pair struct containing the first mismatched elements as void pointers
+ */
+Pair mismatch_ctx(const void *first1,
+                  const void *const last1,
+                  int64_t dtype1,
+                  const void *first2,
+                  const void *const last2,
+                  int64_t dtype2,
+                  BinaryClosure p);
+
+/**
+ * @brief Finds the first pair of adjacent elements satisfying a binary closure, see adjacent_find.
+ *
+ * @param first Pointer to the beginning of the range.
+ * @param last Pointer to the end of the range (one past the last element).
+ * @param dtype Size of each element in the range.
+ * @param p Binary closure used to compare elements.
+ * @return const void* Pointer to the first element of the pair satisfying the condition. Returns last if no such element is found.
+ */
+const void *adjacent_find_ctx(const void *first,
+                              const void *last,
+                              size_t dtype,
+                              BinaryClosure p);
+
+/**
+ * @brief Searches for a sequence within another sequence using a binary closure, see search.
+ *
+ * @param first1 A pointer to the beginning of the first sequence.
+ * @param last1 A pointer to the end of the first sequence.
+ * @param dtype1 The size of the elements in the first sequence.
+ * @param first2 A pointer to the beginning of the second sequence.
+ * @param last2 A pointer to the end of the second sequence.
+ * @param dtype2 The size of the elements in the second sequence.
+ * @param p A binary closure used to compare elements in the two sequences.
+ * @return const void* A pointer to the first element in the first sequence that matches the second sequence,
+ *         or a pointer to last1 if the second sequence is not found.
+ */
+const void *search_ctx(const void *first1,
+                       const void *last1,
+                       int64_t dtype1,
+                       const void *first2,
+                       const void *last2,
+                       int64_t dtype2,
+                       BinaryClosure p);
+
+/**
+ * @brief Removes consecutive duplicate elements in a range using a binary closure, see unique.
+ *
+ * @param first A pointer to the first element in the range.
+ * @param last A pointer to one past the last element in the range.
+ * @param dtype The size of the type stored by the pointers.
+ * @param p The binary closure used to compare elements.
+ * @return A pointer to the new end of the range, after removing duplicates.
+ */
+void *unique_ctx(void *first,
+                 void *last,
+                 int64_t dtype,
+                 BinaryClosure p);
+
+/**
+ * @brief Declares the type-specialized family of algorithms for `Type`.
+ *
+ * Every function in the family works on a contiguous forward range of `Type`
+ * values, has no indirect calls and no per-element `memcpy`, so the compiler
+ * is free to inline and auto-vectorize the loops. The family consists of:
+ *
+ * - `fill_##Type(first, last, value)` - assigns `value` to every element.
+ * - `find_##Type(first, last, value)` - first element equal to `value`, or
+ *   `last` if there is none.
+ * - `count_eq_##Type(first, last, value)` - number of elements equal to
+ *   `value`.
+ * - `any_eq_##Type` / `all_eq_##Type(first, last, value)` - whether any / all
+ *   elements are equal to `value` (`all` of an empty range is `true`).
+ * - `reduce_add_##Type`, `reduce_mult_##Type`, `reduce_min_##Type`,
+ *   `reduce_max_##Type(first, last, init)` - folds the range into `init`.
+ *   Floating point sums and products are computed with several partial
+ *   accumulators, so the rounding may differ from a strictly sequential fold.
+ * - `transform_add_##Type` / `transform_mult_##Type(first, last, dest, value)`
+ *   - writes `*first op value` into `dest` for every element, `dest` may
+ *   alias `first`.
+ * - `sort_##Type(first, last)` - stable LSD radix sort in ascending order.
+ *   Floating point values are ordered by IEEE 754 totalOrder: -NaN, -inf,
+ *   negative values, -0, +0, positive values, +inf, +NaN.
+ * - `lower_bound_##Type` / `upper_bound_##Type(first, last, value)` -
+ *   branch-free binary searches of a range sorted in the same order.
+ * - `Type##_less(lhs, rhs)` - BinaryPredicate implementing the same order.
+ *   When passed to the generic `sort`, `stable_sort`, `lower_bound`,
+ *   `upper_bound` or `search_index_create` together with a matching `dtype`,
+ *   they dispatch to the typed versions.
+ * - `Type##_equal(lhs, rhs)` - BinaryPredicate comparing values with `==`.
+ *   For integer types it is recognized by the generic algorithms as bitwise
+ *   equality.
+ *
+ * Additionally `Type##_accum_add`, `Type##_accum_mult`, `Type##_accum_min` and
+ * `Type##_accum_max` are ordinary BinaryLApplicator callbacks. When one of
+ * them is passed to the generic `reduce` together with a matching `dtype`,
+ * `reduce` dispatches to the corresponding typed kernel.
+ *
+ * @param Type one of the types enumerated by FOR_ALL_TYPES
+ *
+ */
+#define DECLARE_TYPED_ALGORITHMS(Type)                                       \
+    void Type##_accum_add(void *const accum, const void *const value);       \
+    void Type##_accum_mult(void *const accum, const void *const value);      \
+    void Type##_accum_min(void *const accum, const void *const value);       \
+    void Type##_accum_max(void *const accum, const void *const value);       \
+    void fill_##Type(Type *first, const Type *const last, const Type value); \
+    const Type *find_##Type(const Type *first, const Type *const last,       \
+                            const Type value);                               \
+    size_t count_eq_##Type(const Type *first, const Type *const last,        \
+                           const Type value);                                \
+    bool any_eq_##Type(const Type *first, const Type *const last,            \
+                       const Type value);                                    \
+    bool all_eq_##Type(const Type *first, const Type *const last,            \
+                       const Type value);                                    \
+    Type reduce_add_##Type(const Type *first, const Type *const last,        \
+                           Type init);                                       \
+    Type reduce_mult_##Type(const Type *first, const Type *const last,       \
+                            Type init);                                      \
+    Type reduce_min_##Type(const Type *first, const Type *const last,        \
+                           Type init);                                       \
+    Type reduce_max_##Type(const Type *first, const Type *const last,        \
+                           Type init);                                       \
+    void transform_add_##Type(const Type *first, const Type *const last,     \
+                              Type *dest, const Type value);                 \
+    void transform_mult_##Type(const Type *first, const Type *const last,    \
+                               Type *dest, const Type value);                \
+    bool Type##_less(const void *const lhs, const void *const rhs);          \
+    bool Type##_equal(const void *const lhs, const void *const rhs);         \
+    void sort_##Type(Type *first, Type *last);                               \
+    const Type *lower_bound_##Type(const Type *first, const Type *last,      \
+                                   const Type value);                        \
+    const Type *upper_bound_##Type(const Type *first, const Type *last,      \
+                                   const Type value);
+
+FOR_ALL_TYPES(DECLARE_TYPED_ALGORITHMS)
+
 #endif  // MY_ALGORITMS_LIBRARY
@@ -0,0 +1,169 @@
+#ifndef MY_ALGORITHMS_PARALLEL_LIB
+#define MY_ALGORITHMS_PARALLEL_LIB
+
+#include <algorithms.h>
+#include <thread_pool.h>
+
+/**
+ * @brief Size in bytes of a chunk processed by a single task of the parallel
+ * algorithms. Chosen to fit in a per-core L2 cache
+ *
+ */
+#define PARALLEL_CHUNK_BYTES (256 * 1024)
+
+/**
+ * @brief Operator that writes result computed from the source value into the
+ * destination, receives user context.
+ * Unlike UnaryOperator it does not return a pointer to shared storage, so it
+ * can be called from several threads at once
+ *
+ */
+typedef void (*UnaryOperatorCtx)(void *const, const void *const, void *);
+
+/**
+ * @brief Parallel version of reduce.
+ *
+ * The range is split into chunks of PARALLEL_CHUNK_BYTES, each chunk is
+ * reduced on its own starting from a copy of `identity` and the partial results
+ * are then folded into `accum` with `combine` in the order of the chunks.
+ * Typed accumulators such as `f64_accum_add` are dispatched to the typed
+ * kernels inside every chunk, exactly like in reduce.
+ *
+ * @param first A pointer to the beginning of the range.
+ * @param last A pointer to the end of the range.
+ * @param dtype The size of the type stored by the pointers, must be positive.
+ * @param accum A pointer to the variable where the accumulated value will be stored.
+ * @param op The binary applicator that accumulates an element into the partial result.
+ *           Must not depend on global state, as it is called from several threads.
+ * @param combine The binary applicator that accumulates a partial result into `accum`.
+ * @param identity A pointer to the identity value of `op` (e.g. 0 for addition).
+ * @param pool The pool to run on, NULL selects thread_pool_default.
+ */
+void reduce_par(const void *first,
+                const void *const last,
+                int64_t dtype,
+                void *const accum,
+                BinaryLApplicator op,
+                BinaryLApplicator combine,
+                const void *const identity,
+                thread_pool *pool);
+
+/**
+ * @brief Parallel version of count_ctx.
+ *
+ * @param first A pointer to the beginning of the range.
+ * @param last A pointer to the end of the range (one-past-the-end).
+ * @param dtype The size of each element in the range, in bytes.
+ * @param p The unary closure to be applied to each element.
+ * @param pool The pool to run on, NULL selects thread_pool_default.
+ * @return The number of elements in the range that satisfy the closure.
+ */
+size_t count_par(const void *first,
+                 const void *const last,
+                 size_t dtype,
+                 UnaryClosure p,
+                 thread_pool *pool);
+
+/**
+ * @brief Parallel version of find_ctx.
+ *
+ * Chunks are scanned concurrently, the earliest match found so far is shared
+ * between the workers, so chunks located after it are skipped or abandoned.
+ * The result is always the first matching element of the whole range.
+ *
+ * @param first A pointer to the beginning of the range.
+ * @param last A pointer to the end of the range.
+ * @param dtype The size of the type stored by the pointers, must be positive.
+ * @param p The unary closure that determines if an element satisfies the desired condition.
+ * @param pool The pool to run on, NULL selects thread_pool_default.
+ * @return A pointer to the found element, or `last` if no element is found.
+ */
+const void *find_par(const void *first,
+                     const void *const last,
+                     int64_t dtype,
+                     UnaryClosure p,
+                     thread_pool *pool);
+
+/**
+ * @brief Parallel version of any_ctx, cancels the remaining chunks after the first match.
+ *
+ * @param first A pointer to the beginning of the range.
+ * @param last A pointer to the end of the range.
+ * @param dtype The size of the type stored by the pointers.
+ * @param p The unary closure that determines whether an element satisfies a condition or not.
+ * @param pool The pool to run on, NULL selects thread_pool_default.
+ * @return `true` if at least one element in the range satisfy the closure, `false` otherwise.
+ */
+bool any_par(const void *first,
+             const void *const last,
+             size_t dtype,
+             UnaryClosure p,
+             thread_pool *pool);
+
+/**
+ * @brief Parallel version of all_ctx, cancels the remaining chunks after the first mismatch.
+ *
+ * @param first A pointer to the beginning of the range.
+ * @param last A pointer to the end of the range.
+ * @param dtype The size of the type stored by the pointers.
+ * @param p The unary closure that determines whether an element satisfies a condition or not.
+ * @param pool The pool to run on, NULL selects thread_pool_default.
+ * @return `true` if all elements in the range satisfy the closure, `false` otherwise.
+ */
+bool all_par(const void *first,
+             const void *const last,
+             size_t dtype,
+             UnaryClosure p,
+             thread_pool *pool);
+
+/**
+ * @brief Parallel version of transform.
+ *
+ * Transforms min(source size, destination size) elements, the ranges may be the same
+ * but must not partially overlap.
+ *
+ * @param source_first Pointer to the beginning of the source range.
+ * @param source_last Pointer to the end of the source range (exclusive).
+ * @param source_dtype The size (in bytes) of each element in the source range.
+ * @param dest_first Pointer to the beginning of the destination range.
+ * @param dest_last Pointer to the end of the destination range (exclusive).
+ * @param dest_dtype The size (in bytes) of each element in the destination range.
+ * @param op Operator writing the transformed source element into the destination element.
+ * @param ctx Context passed to every call of `op`.
+ * @param pool The pool to run on, NULL selects thread_pool_default.
+ */
+void transform_par(const void *source_first,
+                   const void *const source_last,
+                   int64_t source_dtype,
+                   void *dest_first,
+                   const void *const dest_last,
+                   int64_t dest_dtype,
+                   UnaryOperatorCtx op,
+                   void *ctx,
+                   thread_pool *pool);
+
+/**
+ * @brief Parallel version of sort.
+ *
+ * Sample sort: a sorted sample of the range selects splitters, the workers
+ * distribute the elements into buckets and then sort every bucket with sort
+ * (including the typed radix sort dispatch). Keys repeated often enough to be
+ * sampled as several splitters get buckets of their own, which need no sorting,
+ * so inputs with few distinct keys still spread over the workers. Small ranges
+ * and single threaded pools fall back to sort. The sort is not stable and needs
+ * a temporary buffer of the size of the range.
+ *
+ * @param first A pointer to the first element in the range.
+ * @param last A pointer to one past the last element in the range.
+ * @param dtype The size of each element in bytes, must be positive.
+ * @param less The binary predicate returning `true` if the first argument is ordered before the second.
+ *             Must not depend on global state, as it is called from several threads.
+ * @param pool The pool to run on, NULL selects thread_pool_default.
+ */
+void sort_par(void *first,
+              void *last,
+              int64_t dtype,
+              BinaryPredicate less,
+              thread_pool *pool);
+
+#endif  // MY_ALGORITHMS_PARALLEL_LIB
@@ -0,0 +1,90 @@
+#ifndef MY_GEMM
+#define MY_GEMM
+
+#include <stdbool.h>
+#include <stddef.h>
+//
+#include <types.h>
+
+/**
+ * @brief Instruction set used by the gemm microkernels
+ *
+ */
+typedef enum {
+    GEMM_ISA_SCALAR,
+    GEMM_ISA_SSE2,
+    GEMM_ISA_AVX2,
+    GEMM_ISA_AVX512_VNNI,  // float kernels stay on AVX2
+} gemm_isa;
+
+/**
+ * @brief Returns instruction set picked for the current CPU. The choice is
+ * made once via CPUID on the first call and cached afterwards
+ *
+ */
+gemm_isa gemm_detect_isa();
+
+/**
+ * @brief Makes the following products use the microkernels of `isa` instead of
+ * the detected ones, so every kernel can be checked on a single machine.
+ * `isa` must not be above the one detected for the CPU, passing that one
+ * restores the default. Must not be called while a product is running
+ *
+ */
+void gemm_force_isa(gemm_isa isa);
+
+/**
+ * @brief General matrix multiply on row-major single precision operands
+ *
+ * Computes `c += alpha * a * b` where `a` is `m x k`, `b` is `k x n` and `c` is
+ * `m x n`. Every operand is addressed by its leading dimension (distance in
+ * elements between two consecutive rows), so submatrices of bigger matrices
+ * can be passed directly. `c` must not alias `a` or `b`.
+ *
+ * The product is cache blocked, both operands are packed into contiguous
+ * panels and the innermost tile is computed by a register-tiled microkernel
+ * picked at runtime by `gemm_detect_isa`.
+ *
+ */
+void gemm_f32(size_t m, size_t n, size_t k, f32 alpha, f32 const* a,
+              size_t lda, f32 const* b, size_t ldb, f32* c, size_t ldc);
+
+/**
+ * @brief General matrix multiply on row-major double precision operands, see
+ * `gemm_f32`
+ *
+ */
+void gemm_f64(size_t m, size_t n, size_t k, f64 alpha, f64 const* a,
+              size_t lda, f64 const* b, size_t ldb, f64* c, size_t ldc);
+
+/**
+ * @brief Operand of `gemm_q8`, a row-major matrix of 8 bit integers
+ *
+ */
+typedef struct {
+    void const* data;
+    size_t ld;       // leading dimension in elements
+    bool is_signed;  // holds i8 values, u8 otherwise
+    i32 zero_point;  // subtracted from every element
+} gemm_q8_operand;
+
+/**
+ * @brief General matrix multiply on 8 bit integers with 32 bit accumulators
+ *
+ * Computes `c += (a - a.zero_point) * (b - b.zero_point)` where `a` is
+ * `m x k`, `b` is `k x n` and `c` is `m x n`. Products are summed exactly and
+ * wrap only if a result does not fit in i32, which takes k in the tens of
+ * thousands. `c` must not alias `a` or `b`.
+ *
+ * Operands are packed like in `gemm_f32`, signed ones are moved to the u8 x i8
+ * range of the instructions and the zero points are folded in afterwards from
+ * row and column sums. The microkernel uses vpdpbusd on AVX-512 VNNI and
+ * pmaddubsw with pmaddwd on AVX2. pmaddubsw saturates pairs of products to 16
+ * bits, so blocks of `b` holding values outside of 7 bits take a second
+ * pass on AVX2 to stay exact.
+ *
+ */
+void gemm_q8(size_t m, size_t n, size_t k, gemm_q8_operand const* a,
+             gemm_q8_operand const* b, i32* c, size_t ldc);
+
+#endif  // MY_GEMM
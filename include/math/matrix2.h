@@ -8,16 +8,89 @@
 #include <string.h>
 //
 #include <matrix_segment_view.h>
+#include <thread_pool.h>
 
+// `data` points at the first element, rows are `stride` elements apart. A
+// stride of 0 means `cols`, so matrices initialized without it are contiguous.
+// Views made by m2_slice share the data of their parent and are accepted by
+// every m2_* operation.
 typedef struct {
     size_t rows;
     size_t cols;
     size_t dtype;
     void* const data;
+    size_t stride;
 } matrix2;
 
 typedef void (*Apply)(void* const, void const* const, void const* const);
 
+// distance between the rows of `m` in elements
+
+size_t m2_stride(matrix2 const* const m);
+
+// view of the rows x cols block of `m` starting at (row, col), no data is
+// copied
+
+matrix2 m2_slice(matrix2 const* const m, size_t const row, size_t const col,
+                 size_t const rows, size_t const cols);
+
+// allocation
+
+// alignment of the data and of every row of the allocated matrices
+#define M2_ALIGNMENT 64
+#define M2_PAGE_SIZE 4096
+// size of the first block of an arena created with zero capacity
+#define M2_ARENA_MIN_BLOCK (64 * 1024)
+
+// allocates a rows x cols matrix aligned to M2_ALIGNMENT, when the element
+// size divides M2_ALIGNMENT every row starts on a cache line as well. `data` is
+// NULL if the allocation failed
+
+matrix2 m2_alloc(size_t const rows, size_t const cols, size_t const dtype);
+
+// stride in elements m2_alloc picks for rows of `cols` elements
+
+size_t m2_padded_stride(size_t const cols, size_t const dtype);
+
+// frees a matrix returned by m2_alloc, views of it become invalid
+
+void m2_free(matrix2 const* const m);
+
+// bump allocator for temporary matrices, see m2_arena_reset
+
+typedef struct m2_arena m2_arena;
+
+typedef struct {
+    void* block;
+    size_t used;
+} m2_arena_mark;
+
+m2_arena* m2_arena_create(size_t const capacity);
+
+void m2_arena_destroy(m2_arena* const arena);
+
+// same layout as m2_alloc, valid until the arena is released past it or reset
+
+matrix2 m2_arena_alloc(m2_arena* const arena, size_t const rows,
+                       size_t const cols, size_t const dtype);
+
+// raw storage of `bytes` bytes aligned to M2_ALIGNMENT with the same lifetime
+
+void* m2_arena_take(m2_arena* const arena, size_t const bytes);
+
+// m2_arena_release frees everything allocated after the matching
+// m2_arena_save, marks must be released in reverse order
+
+m2_arena_mark m2_arena_save(m2_arena const* const arena);
+
+void m2_arena_release(m2_arena* const arena, m2_arena_mark const mark);
+
+// frees everything. If the arena had to grow since the last reset its blocks
+// are merged into one, so the next round of the same allocations does not call
+// malloc
+
+void m2_arena_reset(m2_arena* const arena);
+
 matrix_segment_view m2_get_row(matrix2 const* const m, size_t const index);
 
 matrix_segment_view m2_get_column(matrix2 const* const m, size_t const index);
@@ -43,9 +116,73 @@ void m2_set_all(matrix2* const m, void* const data);
 void m2_mult(matrix2* const dest, matrix2 const* const lhs,
              matrix2 const* const rhs, Apply perf);
 
+// m2_mult without zeroing dest first, the products are accumulated into the
+// values dest already holds
+
+void m2_mult_add(matrix2* const dest, matrix2 const* const lhs,
+                 matrix2 const* const rhs, Apply perf);
+
 void m2_apply(matrix2* const dest, matrix2 const* const lhs,
               matrix2 const* const rhs, Apply perf);
 
+// parallel versions of the operations above, the destination is split into
+// blocks processed by the workers of `pool`, NULL selects thread_pool_default
+
+void m2_mult_parallel(matrix2* const dest, matrix2 const* const lhs,
+                      matrix2 const* const rhs, Apply perf,
+                      thread_pool* const pool);
+
+void m2_apply_parallel(matrix2* const dest, matrix2 const* const lhs,
+                       matrix2 const* const rhs, Apply perf,
+                       thread_pool* const pool);
+
+// Strassen-Winograd
+
+// default sizes at or below which the recursion switches to the blocked
+// kernel, every dimension of a product has to exceed it to be split. Measured
+// with the AVX2 kernels: a level saves about a quarter of the time of a 2048
+// f64 product but only a few percent for f32, where it also costs accuracy
+#define M2_STRASSEN_CUTOFF_F32 2048
+#define M2_STRASSEN_CUTOFF_F64 1024
+
+typedef enum {
+    M2_MULT_CLASSIC,
+    M2_MULT_STRASSEN,
+} m2_mult_strategy;
+
+size_t m2_strassen_cutoff(size_t const dtype);
+
+// m2_mult using 7 instead of 8 half size products per level down to
+// `cutoff` (0 selects m2_strassen_cutoff), odd sizes are peeled. Only
+// f32_apply_add and f64_apply_add are accelerated, any other `perf` runs
+// m2_mult. Temporaries take about a third of the size of the operands and come
+// from `workspace`, which is restored on return, NULL uses a private arena.
+// dest must not overlap lhs or rhs. The error bound grows by a constant factor
+// per level compared to m2_mult
+
+void m2_mult_strassen(matrix2* const dest, matrix2 const* const lhs,
+                      matrix2 const* const rhs, Apply perf,
+                      size_t const cutoff, m2_arena* const workspace);
+
+// picks M2_MULT_STRASSEN for the accelerated operators when every dimension
+// exceeds the cutoff of the dtype
+
+m2_mult_strategy m2_mult_select(matrix2 const* const dest,
+                                matrix2 const* const lhs,
+                                matrix2 const* const rhs, Apply perf);
+
+void m2_mult_auto(matrix2* const dest, matrix2 const* const lhs,
+                  matrix2 const* const rhs, Apply perf,
+                  m2_arena* const workspace);
+
+// dest receives the transpose of src, the matrices must not overlap
+
+void m2_transpose(matrix2* const dest, matrix2 const* const src);
+
+// transposes a square matrix in place
+
+void m2_transpose_inplace(matrix2* const m);
+
 int m2_compare(matrix2 const* const lhs, matrix2 const* const rhs);
 
 #endif  // MY_MATRIX2
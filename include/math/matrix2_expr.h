@@ -0,0 +1,82 @@
+#ifndef MY_MATRIX2_EXPR
+#define MY_MATRIX2_EXPR
+
+#include <matrix2.h>
+#include <types.h>
+
+// Deferred elementwise expressions over matrices. Building an expression only
+// records it, m2_expr_eval then computes the whole tree in a single pass over
+// the destination: rows are processed in chunks that fit in L1 and every node
+// computes its chunk into a small scratch buffer, so only the leaves are read
+// from memory and only the destination is written back, with no full size
+// temporaries in between.
+//
+// Operands of a binary node are broadcast like in numpy: a dimension of size 1
+// is repeated along the other operand, so 1 x cols row vectors, rows x 1
+// column vectors and scalars combine with full matrices. Reductions are
+// computed once before the fused pass and then broadcast like leaves.
+//
+// Nodes and evaluation scratch live in the arena passed to the constructors,
+// an expression is valid until the arena is released past it or reset.
+
+typedef struct m2_expr m2_expr;
+
+typedef enum {
+    M2_AXIS_ROWS,  // folds every column into one value, gives 1 x cols
+    M2_AXIS_COLS,  // folds every row into one value, gives rows x 1
+    M2_AXIS_ALL,   // folds everything, gives 1 x 1
+} m2_axis;
+
+// leaf referring to the elements of `m`, which are read during evaluation
+
+m2_expr* m2_expr_matrix(m2_arena* const arena, matrix2 const* const m);
+
+// leaf holding a copy of the `dtype` bytes at `value`
+
+m2_expr* m2_expr_scalar(m2_arena* const arena, void const* const value,
+                        size_t const dtype);
+
+// elementwise `op(dest, lhs, rhs)`, where `op` writes its result into `dest`.
+// The typed operators declared below run vectorized loops, any other Apply is
+// called once per element
+
+m2_expr* m2_expr_binary(m2_arena* const arena, Apply op, m2_expr* const lhs,
+                        m2_expr* const rhs);
+
+// folds `expr` along `axis` with `op` left to right, in row-major order for
+// M2_AXIS_ALL, the first element of every fold is its initial value. The
+// typed add, mult, min and max fold the chunks pairwise instead, so their
+// floating point sums and products may round differently from a sequential
+// fold, every other operator is folded sequentially
+
+m2_expr* m2_expr_reduce(m2_arena* const arena, Apply op, m2_expr* const expr,
+                        m2_axis const axis);
+
+size_t m2_expr_rows(m2_expr const* const expr);
+
+size_t m2_expr_cols(m2_expr const* const expr);
+
+// evaluates `expr` into `dest` of the same shape, `dest` may be one of the
+// full size leaves but must not overlap any other leaf
+
+void m2_expr_eval(matrix2* const dest, m2_expr* const expr);
+
+// Type##_op_add, _op_sub, _op_mult, _op_div, _op_min and _op_max compute
+// `*dest = *lhs op *rhs`, they are recognized by m2_expr_binary and
+// m2_expr_reduce
+
+#define DECLARE_EXPR_OP(dtype, name)                                \
+    void dtype##_op_##name(void* const dest, void const* const lhs, \
+                           void const* const rhs);
+
+#define DECLARE_EXPR_OPS(dtype)  \
+    DECLARE_EXPR_OP(dtype, add)  \
+    DECLARE_EXPR_OP(dtype, sub)  \
+    DECLARE_EXPR_OP(dtype, mult) \
+    DECLARE_EXPR_OP(dtype, div)  \
+    DECLARE_EXPR_OP(dtype, min)  \
+    DECLARE_EXPR_OP(dtype, max)
+
+FOR_ALL_TYPES(DECLARE_EXPR_OPS)
+
+#endif  // MY_MATRIX2_EXPR
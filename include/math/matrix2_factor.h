@@ -0,0 +1,52 @@
+#ifndef MY_MATRIX2_FACTOR
+#define MY_MATRIX2_FACTOR
+
+#include <matrix2.h>
+#include <types.h>
+
+// Factorizations and triangular solves of f32 and f64 matrices. They work in
+// place, one block of columns at a time: the block is factored and the rest of
+// the matrix is updated by gemm_f32 or gemm_f64, which does almost all of the
+// arithmetic of a large matrix. Triangular solves are split in halves
+// recursively, so most of their work is done by gemm as well.
+//
+// For Type of f32 and f64:
+// - m2_lu_Type(m, pivots) factors the rows x cols matrix `m` as P * L * U with
+//   partial pivoting. L is unit lower triangular and is stored below the
+//   diagonal, U is stored on and above it. pivots receives min(rows, cols)
+//   indices, row i was swapped with row pivots[i] >= i, in order of i. Returns
+//   false if a pivot is zero, the factorization is then complete but U is
+//   singular
+// - m2_cholesky_Type(m) factors the symmetric positive definite matrix `m` as
+//   L * L^T, reading only its lower triangle. The lower triangle receives L
+//   and the upper one L^T, so either can be passed to the solves below.
+//   Returns false and leaves `m` partially factored if it is not positive
+//   definite
+// - m2_solve_lower_Type(l, b, unit_diagonal) overwrites b with L^-1 * b where
+//   L is the lower triangle of `l`, its diagonal is taken as ones and not read
+//   if unit_diagonal is set
+// - m2_solve_upper_Type(u, b, unit_diagonal) overwrites b with U^-1 * b where
+//   U is the upper triangle of `u`
+// - m2_lu_solve_Type(lu, pivots, b) overwrites b with A^-1 * b, given the
+//   factorization of a square A by m2_lu_Type
+// - m2_cholesky_solve_Type(l, b) overwrites b with A^-1 * b, given the
+//   factorization of A by m2_cholesky_Type
+//
+// b may hold any number of columns, solving for all of them at once is much
+// faster than one at a time. b must not overlap the factors.
+
+#define DECLARE_MATRIX_FACTOR_OPS(Type)                                        \
+    bool m2_lu_##Type(matrix2* const m, size_t* const pivots);                 \
+    bool m2_cholesky_##Type(matrix2* const m);                                 \
+    void m2_solve_lower_##Type(matrix2 const* const l, matrix2* const b,       \
+                               bool const unit_diagonal);                      \
+    void m2_solve_upper_##Type(matrix2 const* const u, matrix2* const b,       \
+                               bool const unit_diagonal);                      \
+    void m2_lu_solve_##Type(matrix2 const* const lu,                           \
+                            size_t const* const pivots, matrix2* const b);     \
+    void m2_cholesky_solve_##Type(matrix2 const* const l, matrix2* const b);
+
+DECLARE_MATRIX_FACTOR_OPS(f32)
+DECLARE_MATRIX_FACTOR_OPS(f64)
+
+#endif  // MY_MATRIX2_FACTOR
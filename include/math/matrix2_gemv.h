@@ -0,0 +1,38 @@
+#ifndef MY_MATRIX2_GEMV
+#define MY_MATRIX2_GEMV
+
+#include <matrix2.h>
+#include <types.h>
+
+// Products of a matrix and vectors. Vectors are plain arrays of `m->dtype`
+// elements. Products have m2_mult semantics: `perf(dest, lhs, rhs)`
+// accumulates `lhs * rhs` into dest, which starts zeroed. The typed
+// Type##_apply_add callbacks run SIMD kernels that read every element of the
+// matrix once. Rows are processed a column block at a time, so the block of
+// the vector stays in cache. Any other Apply is called once per multiply add.
+// Destinations must not overlap the operands.
+
+// y = m * x, x holds m->cols elements and y m->rows
+
+void m2_gemv(void* const y, matrix2 const* const m, void const* const x,
+             Apply perf);
+
+// y = x * m, x holds m->rows elements and y m->cols
+
+void m2_gevm(void* const y, void const* const x, matrix2 const* const m,
+             Apply perf);
+
+// m2_gemv of every row of xs (k x m->cols) into the same row of ys
+// (k x m->rows). The matrix is read once for all k vectors: every row block
+// loaded from memory is multiplied with all of them before moving on
+
+void m2_gemv_multi(matrix2* const ys, matrix2 const* const m,
+                   matrix2 const* const xs, Apply perf);
+
+// m2_gevm of every row of xs (k x m->rows) into the same row of ys
+// (k x m->cols), the matrix is read once for all k vectors
+
+void m2_gevm_multi(matrix2* const ys, matrix2 const* const xs,
+                   matrix2 const* const m, Apply perf);
+
+#endif  // MY_MATRIX2_GEMV
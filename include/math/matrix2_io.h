@@ -0,0 +1,73 @@
+#ifndef MY_MATRIX2_IO
+#define MY_MATRIX2_IO
+
+#include <matrix2.h>
+#include <types.h>
+
+// Binary matrix files. A file starts with an m2_file_header padded to
+// M2_FILE_DATA_OFFSET bytes, followed by the rows laid out like m2_alloc lays
+// them out, padding included. Data therefore starts on a page and m2_map can
+// hand it out without copying: the mapping is shared, so every process
+// mapping the same file reads the same page cache pages.
+//
+// Values are stored in the byte order of the machine that saved them, files
+// written on a machine of the other byte order are rejected.
+
+#define M2_FILE_MAGIC "M2MATRIX"
+#define M2_FILE_VERSION 1
+#define M2_FILE_BYTE_ORDER 0x01020304u
+#define M2_FILE_DATA_OFFSET 4096
+
+typedef struct {
+    char magic[8];
+    u32 version;
+    u32 byte_order;
+    u64 rows;
+    u64 cols;
+    u64 dtype;
+    u64 stride;     // elements between the starts of two rows
+    u64 alignment;  // of the data offset and of every row, when dtype allows
+    u64 data_offset;
+} m2_file_header;
+
+typedef enum {
+    M2_ACCESS_NORMAL,
+    M2_ACCESS_SEQUENTIAL,  // aggressive read ahead, pages dropped after use
+    M2_ACCESS_RANDOM,      // no read ahead
+    M2_ACCESS_WILLNEED,    // starts reading the whole file in the background
+} m2_access;
+
+// writes `m` to `path`, replacing the file. Returns false if the file could not
+// be written, in which case no partial file is left behind
+
+bool m2_save(matrix2 const* const m, char const* const path);
+
+// reads and validates the header of `path`
+
+bool m2_file_info(char const* const path, m2_file_header* const header);
+
+// maps the matrix stored in `path` read only, writing into it crashes. `data`
+// is NULL if the file could not be opened or is not a valid matrix file. The
+// file may be closed or deleted afterwards, the mapping stays valid until
+// m2_unmap
+
+matrix2 m2_map(char const* const path, m2_access const access);
+
+// releases a matrix returned by m2_map, views of it become invalid
+
+void m2_unmap(matrix2 const* const m);
+
+// multiplies the matrices stored in `lhs_path` and `rhs_path` like m2_mult and
+// stores the product in `dest_path`, without loading the operands whole. The
+// product is computed in tiles sized so that the tile buffers take about
+// `memory_budget` bytes, while one tile is multiplied a reader thread loads the
+// operand tiles of the next one. The operands are read through the page cache
+// and not counted in the budget. Returns false if a file could not be read or
+// written, the shapes or dtypes do not match, or the buffers could not be
+// allocated
+
+bool m2_mult_file(char const* const dest_path, char const* const lhs_path,
+                  char const* const rhs_path, Apply perf,
+                  size_t const memory_budget);
+
+#endif  // MY_MATRIX2_IO
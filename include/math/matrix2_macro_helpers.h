@@ -30,26 +30,26 @@
         *(dtype*)dest op*(dtype*)lhs**(dtype*)rhs;                         \
     }
 
+#define DECLARE_APPLY_LAMBDA(dtype, name)                                  \
+    void dtype##_##apply##_##name(void* const dest, void const* const lhs, \
+                                  void const* const rhs);
+
 #define DEFINE_APPLY_ADD(dtype) DEFINE_APPLY_LAMBDA(dtype, +=, add)
 #define DEFINE_APPLY_MULT(dtype) DEFINE_APPLY_LAMBDA(dtype, *=, mult)
 #define DEFINE_APPLY_DIV(dtype) DEFINE_APPLY_LAMBDA(dtype, /=, div)
 #define DEFINE_APPLY_EQ(dtype) DEFINE_APPLY_LAMBDA(dtype, =, eq)
 
-#define FOR_ALL_TYPES(MACRO) \
-    MACRO(f32)               \
-    MACRO(f64)               \
-    MACRO(i8)                \
-    MACRO(i16)               \
-    MACRO(i32)               \
-    MACRO(i64)               \
-    MACRO(u8)                \
-    MACRO(u16)               \
-    MACRO(u32)               \
-    MACRO(u64)
-
-FOR_ALL_TYPES(DEFINE_APPLY_ADD)
-FOR_ALL_TYPES(DEFINE_APPLY_MULT)
-FOR_ALL_TYPES(DEFINE_APPLY_DIV)
-FOR_ALL_TYPES(DEFINE_APPLY_EQ)
+#define DECLARE_APPLY_ADD(dtype) DECLARE_APPLY_LAMBDA(dtype, add)
+#define DECLARE_APPLY_MULT(dtype) DECLARE_APPLY_LAMBDA(dtype, mult)
+#define DECLARE_APPLY_DIV(dtype) DECLARE_APPLY_LAMBDA(dtype, div)
+#define DECLARE_APPLY_EQ(dtype) DECLARE_APPLY_LAMBDA(dtype, eq)
+
+// defined once in matrix2.c, so m2_* operations can recognize them and
+// dispatch to the specialized kernels
+
+FOR_ALL_TYPES(DECLARE_APPLY_ADD)
+FOR_ALL_TYPES(DECLARE_APPLY_MULT)
+FOR_ALL_TYPES(DECLARE_APPLY_DIV)
+FOR_ALL_TYPES(DECLARE_APPLY_EQ)
 
 #endif  // MY_MATRIX2_MACRO_HELPERS
@@ -0,0 +1,58 @@
+#ifndef MY_MATRIX2_QUANT
+#define MY_MATRIX2_QUANT
+
+#include <matrix2.h>
+#include <types.h>
+
+// Quantized integer products. The Type##_apply_add callbacks accumulate into
+// the element type, which overflows after a few 8 bit products. Here every
+// product is summed exactly in a wider accumulator: i32 for u8 and i8
+// operands, i64 for i16 ones. The accumulators are then requantized into the
+// element type of dest.
+//
+// matrix2 only records the size of an element, m2_quant says how to read it.
+
+typedef enum {
+    M2_QUANT_U8,
+    M2_QUANT_I8,
+    M2_QUANT_I16,
+    M2_QUANT_I32,
+    M2_QUANT_I64,
+    M2_QUANT_F32,
+} m2_quant_type;
+
+typedef enum {
+    M2_QUANT_TENSOR,  // scale[0] and zero_point[0] for every element
+    M2_QUANT_ROW,     // scale[i] and zero_point[i] for row i of dest
+    M2_QUANT_COL,     // scale[j] and zero_point[j] for column j of dest
+} m2_quant_axis;
+
+typedef struct {
+    m2_quant_type lhs;  // u8 or i8, or i16 for both operands
+    m2_quant_type rhs;
+    m2_quant_type dest;  // any type
+    i32 lhs_zero_point;
+    i32 rhs_zero_point;
+    m2_quant_axis axis;
+    f32 const* scale;       // NULL keeps the accumulators unscaled
+    i32 const* zero_point;  // NULL for 0
+} m2_quant;
+
+// size in bytes of an element of `type`
+
+size_t m2_quant_dtype(m2_quant_type const type);
+
+// computes acc = (lhs - lhs_zero_point) * (rhs - rhs_zero_point) and stores
+// acc * scale + zero_point into dest, with the scale and zero point of the
+// row or column `quant->axis` selects. Integer types round to nearest, ties to
+// even, and saturate. Without a scale integer accumulators are stored exactly
+// as long as dest is wide enough. dest must not overlap lhs or rhs.
+//
+// u8 and i8 operands run the packed kernels of gemm_q8, i16 ones a plain loop
+// over i64 accumulators. Returns false if the accumulator buffer could not be
+// allocated
+
+bool m2_mult_quantized(matrix2* const dest, matrix2 const* const lhs,
+                       matrix2 const* const rhs, m2_quant const* const quant);
+
+#endif  // MY_MATRIX2_QUANT
@@ -0,0 +1,50 @@
+#ifndef MY_MATRIX2_SMALL
+#define MY_MATRIX2_SMALL
+
+#include <matrix2.h>
+#include <types.h>
+
+// Fixed size kernels for 2x2, 3x3 and 4x4 matrices. They take plain row-major
+// arrays of N * N elements instead of matrix2, check nothing and are fully
+// unrolled, so a product compiles to a few dozen multiply adds with no calls
+// or loops. Results are computed in registers before they are stored, `dest`
+// may be one of the operands.
+//
+// For every Type of FOR_ALL_TYPES and N of 2, 3 and 4:
+// - m2_mult_NxN_Type(dest, lhs, rhs) computes `dest = lhs * rhs`
+// - m2_det_NxN_Type(m) returns the determinant of `m`
+// - m2_inverse_NxN_Type(dest, m) writes the inverse of `m` to dest and returns
+//   true, or returns false and leaves dest untouched if `m` is singular. For
+//   integer types only matrices with a determinant of 1 or -1 have an integer
+//   inverse, any other one is reported as singular. Integer products wrap like
+//   the arithmetic of their type
+
+#define DECLARE_SMALL_MATRIX_OPS_N(Type, N)                                  \
+    void m2_mult_##N##x##N##_##Type(Type* const dest, Type const* const lhs, \
+                                    Type const* const rhs);                  \
+    Type m2_det_##N##x##N##_##Type(Type const* const m);                     \
+    bool m2_inverse_##N##x##N##_##Type(Type* const dest, Type const* const m);
+
+#define DECLARE_SMALL_MATRIX_OPS(Type)  \
+    DECLARE_SMALL_MATRIX_OPS_N(Type, 2) \
+    DECLARE_SMALL_MATRIX_OPS_N(Type, 3) \
+    DECLARE_SMALL_MATRIX_OPS_N(Type, 4)
+
+FOR_ALL_TYPES(DECLARE_SMALL_MATRIX_OPS)
+
+// Batches of small matrices in SoA layout: element (i, j) of matrix b of a
+// batch of `count` n x n matrices is stored at index (i * n + j) * count + b,
+// so every element position is a contiguous array over the batch and vector
+// lanes run across matrices instead of along their short rows.
+//
+// m2_mult_batched computes dest_b = lhs_b * rhs_b for every b < count with
+// m2_mult semantics: `perf(dest, lhs, rhs)` accumulates `lhs * rhs` into
+// dest, which starts zeroed. The typed Type##_apply_add callbacks run
+// vectorized kernels, unrolled for n of 2, 3 and 4, any other Apply is called
+// once per multiply add. dest must not overlap lhs or rhs
+
+void m2_mult_batched(void* const dest, void const* const lhs,
+                     void const* const rhs, size_t const n, size_t const count,
+                     size_t const dtype, Apply perf);
+
+#endif  // MY_MATRIX2_SMALL
@@ -0,0 +1,84 @@
+#ifndef MY_SPARSE2
+#define MY_SPARSE2
+
+#include <matrix2.h>
+#include <thread_pool.h>
+#include <types.h>
+
+// Sparse matrices storing only their nonzero values. Values are `dtype` bytes
+// each and products go through the same Apply callbacks as m2_mult:
+// `perf(dest, lhs, rhs)` accumulates `lhs * rhs` into `dest`, which starts
+// zeroed. The typed Type##_apply_add callbacks are recognized and run
+// specialized loops, any other Apply is called once per stored value.
+//
+// Row and column indices are u32, so both dimensions must be below 2^32.
+
+typedef enum {
+    S2_COO,  // coordinate list, (row_indices[p], indices[p]) of every value
+    S2_CSR,  // row i holds the values [offsets[i], offsets[i + 1]), indices
+             // are their columns
+    S2_CSC,  // column j holds the values [offsets[j], offsets[j + 1]),
+             // indices are their rows
+} s2_format;
+
+typedef struct {
+    s2_format format;
+    size_t rows;
+    size_t cols;
+    size_t dtype;
+    size_t nnz;
+    size_t* offsets;    // CSR rows + 1 entries, CSC cols + 1, NULL for COO
+    u32* indices;       // nnz entries
+    u32* row_indices;   // nnz entries for COO, NULL otherwise
+    void* values;       // nnz values
+} sparse2;
+
+// builds a matrix from `nnz` triplets, which may come in any order. CSR and
+// CSC keep the order of the triplets inside of a row or a column. Duplicate
+// coordinates are kept and add up in products
+
+sparse2 s2_from_triplets(size_t const rows, size_t const cols,
+                         size_t const dtype, size_t const nnz,
+                         u32 const* const row_indices,
+                         u32 const* const col_indices,
+                         void const* const values, s2_format const format);
+
+// stores the elements of `m` that differ from the `dtype` bytes at `zero`,
+// NULL compares against all bytes zero. Indices are ascending in every row
+// and column
+
+sparse2 s2_from_dense(matrix2 const* const m, s2_format const format,
+                      void const* const zero);
+
+// writes `zero` (NULL for all bytes zero) into every element of `dest` and
+// then the values of `s`, duplicates are resolved by the last one
+
+void s2_to_dense(matrix2* const dest, sparse2 const* const s,
+                 void const* const zero);
+
+sparse2 s2_convert(sparse2 const* const s, s2_format const format);
+
+void s2_free(sparse2 const* const s);
+
+// `dest` of s->rows elements receives `s * x`, `x` holds s->cols elements.
+// The vectors are contiguous and must not overlap
+
+void s2_mult_vector(void* const dest, sparse2 const* const s,
+                    void const* const x, Apply perf);
+
+// parallel version of s2_mult_vector, CSR rows are split into blocks of about
+// the same number of values and processed by the workers of `pool` (NULL
+// selects thread_pool_default). COO and CSC would need to synchronize their
+// scattered updates, so they are multiplied on the calling thread
+
+void s2_mult_vector_parallel(void* const dest, sparse2 const* const s,
+                             void const* const x, Apply perf,
+                             thread_pool* const pool);
+
+// `dest` receives `lhs * rhs` where rhs is a dense lhs->cols x n matrix, dest
+// must not overlap rhs
+
+void s2_mult_dense(matrix2* const dest, sparse2 const* const lhs,
+                   matrix2 const* const rhs, Apply perf);
+
+#endif  // MY_SPARSE2
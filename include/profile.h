@@ -0,0 +1,278 @@
+#ifndef MY_PROFILE
+#define MY_PROFILE
+
+#include <stdbool.h>
+#include <stddef.h>
+//
+#include <types.h>
+
+/**
+ * @brief Operations instrumented by the library, as (group, name) pairs
+ *
+ * The hooks are only compiled in when the library is built with
+ * `PROFILE_ENABLED` defined, otherwise `PROFILE_SCOPE` expands to nothing and
+ * every counter stays zero.
+ *
+ */
+#define FOR_ALL_PROFILE_OPS(MACRO)                     \
+    MACRO(algorithms, reduce)                          \
+    MACRO(algorithms, find)                            \
+    MACRO(algorithms, all)                             \
+    MACRO(algorithms, any)                             \
+    MACRO(algorithms, count)                           \
+    MACRO(algorithms, mismatch)                        \
+    MACRO(algorithms, adjacent_find)                   \
+    MACRO(algorithms, search)                          \
+    MACRO(algorithms, reverse)                         \
+    MACRO(algorithms, generate)                        \
+    MACRO(algorithms, fill)                            \
+    MACRO(algorithms, transform)                       \
+    MACRO(algorithms, rotate)                          \
+    MACRO(algorithms, unique)                          \
+    MACRO(algorithms, shuffle)                         \
+    MACRO(algorithms, find_ctx)                        \
+    MACRO(algorithms, count_ctx)                       \
+    MACRO(algorithms, mismatch_ctx)                    \
+    MACRO(algorithms, adjacent_find_ctx)               \
+    MACRO(algorithms, search_ctx)                      \
+    MACRO(algorithms, unique_ctx)                      \
+    MACRO(algorithms, sort)                            \
+    MACRO(algorithms, stable_sort)                     \
+    MACRO(algorithms, lower_bound)                     \
+    MACRO(algorithms, upper_bound)                     \
+    MACRO(algorithms, equal_range)                     \
+    MACRO(algorithms, binary_search)                   \
+    MACRO(algorithms, search_index_create)             \
+    MACRO(algorithms, search_index_lookup)             \
+    MACRO(algorithms, search_bytes)                    \
+    MACRO(algorithms, find_value)                      \
+    MACRO(algorithms, mismatch_bytes)                  \
+    MACRO(algorithms, adjacent_find_eq)                \
+    MACRO(algorithms, filter)                          \
+    MACRO(algorithms, remove_if)                       \
+    MACRO(algorithms, copy_if)                         \
+    MACRO(algorithms, partition)                       \
+    MACRO(algorithms, stable_partition)                \
+    MACRO(algorithms_parallel, reduce_par)             \
+    MACRO(algorithms_parallel, count_par)              \
+    MACRO(algorithms_parallel, find_par)               \
+    MACRO(algorithms_parallel, transform_par)          \
+    MACRO(algorithms_parallel, sort_par)               \
+    MACRO(matrix2, m2_set_all)                         \
+    MACRO(matrix2, m2_mult)                            \
+    MACRO(matrix2, m2_mult_add)                        \
+    MACRO(matrix2, m2_apply)                           \
+    MACRO(matrix2, m2_mult_parallel)                   \
+    MACRO(matrix2, m2_apply_parallel)                  \
+    MACRO(matrix2, m2_mult_strassen)                   \
+    MACRO(matrix2, m2_transpose)                       \
+    MACRO(matrix2, m2_transpose_inplace)               \
+    MACRO(matrix2, m2_compare)                         \
+    MACRO(matrix2_expr, m2_expr_eval)                  \
+    MACRO(matrix2_small, m2_mult_batched)              \
+    MACRO(matrix2_gemv, m2_gemv)                       \
+    MACRO(matrix2_gemv, m2_gevm)                       \
+    MACRO(matrix2_gemv, m2_gemv_multi)                 \
+    MACRO(matrix2_gemv, m2_gevm_multi)                 \
+    MACRO(matrix2_quant, m2_mult_quantized)            \
+    MACRO(matrix2_factor, m2_lu)                       \
+    MACRO(matrix2_factor, m2_cholesky)                 \
+    MACRO(matrix2_factor, m2_solve_lower)              \
+    MACRO(matrix2_factor, m2_solve_upper)              \
+    MACRO(matrix2_factor, m2_lu_solve)                 \
+    MACRO(matrix2_factor, m2_cholesky_solve)           \
+    MACRO(sparse2, s2_convert)                         \
+    MACRO(sparse2, s2_from_dense)                      \
+    MACRO(sparse2, s2_to_dense)                        \
+    MACRO(sparse2, s2_mult_vector)                     \
+    MACRO(sparse2, s2_mult_vector_parallel)            \
+    MACRO(sparse2, s2_mult_dense)                      \
+    MACRO(matrix2_io, m2_save)                         \
+    MACRO(matrix2_io, m2_map)                          \
+    MACRO(matrix2_io, m2_mult_file)
+
+#define PROFILE_OP_ENUM(Group, Name) PROFILE_OP_##Name,
+
+typedef enum {
+    FOR_ALL_PROFILE_OPS(PROFILE_OP_ENUM) PROFILE_OP_COUNT,
+} profile_op;
+
+#undef PROFILE_OP_ENUM
+
+/**
+ * @brief Counters are kept per element size, the generic interfaces only know
+ * the size of an element and not its type. Slots are 1, 2, 4 and 8 byte
+ * elements followed by every other size
+ *
+ */
+#define PROFILE_DTYPE_COUNT 5
+
+/**
+ * @brief Totals of one operation and element size
+ *
+ * `elements` counts the elements of the ranges or of the destination matrix
+ * the calls work on, `bytes` the minimal memory traffic of the calls (every
+ * input read and every output written once). `ticks` is the summed duration
+ * measured with the time stamp counter, see `profile_stats`. Durations are
+ * inclusive: an instrumented operation calling another one is counted by both.
+ *
+ */
+typedef struct {
+    u64 calls;
+    u64 elements;
+    u64 bytes;
+    u64 ticks;
+} profile_counter;
+
+/**
+ * @brief Totals of every thread since the last `profile_reset`
+ *
+ */
+typedef struct {
+    profile_counter ops[PROFILE_OP_COUNT][PROFILE_DTYPE_COUNT];
+    f64 ticks_per_second;
+} profile_stats;
+
+/**
+ * @brief Operation in progress on the calling thread, see `PROFILE_SCOPE`
+ *
+ */
+typedef struct {
+    u32 op;
+    u32 dtype;
+    u64 elements;
+    u64 bytes;
+    u64 start;
+} profile_span;
+
+/**
+ * @brief Measures the rest of the enclosing block as one call of `Op`
+ *
+ * The span is closed by the cleanup attribute (GNU extension) when the block
+ * is left, including early returns. Arguments are not evaluated when
+ * `PROFILE_ENABLED` is not defined.
+ *
+ * @param Op name of the operation as listed in FOR_ALL_PROFILE_OPS
+ * @param Dtype element size in bytes, negative sizes of reverse ranges count
+ * as their absolute value
+ * @param Elements amount of elements the call works on
+ * @param Bytes minimal amount of bytes the call reads and writes
+ *
+ */
+#ifdef PROFILE_ENABLED
+#define PROFILE_SCOPE(Op, Dtype, Elements, Bytes)                    \
+    profile_span const _profile_span                                 \
+        __attribute__((cleanup(profile_end))) =                      \
+            profile_begin(PROFILE_OP_##Op, Dtype, Elements, Bytes)
+#else
+#define PROFILE_SCOPE(Op, Dtype, Elements, Bytes) ((void)0)
+#endif
+
+/**
+ * @brief `PROFILE_SCOPE` of a call working on the range [First, Last)
+ *
+ */
+#define PROFILE_RANGE(Op, First, Last, Dtype)                               \
+    PROFILE_SCOPE(Op, Dtype,                                                \
+                  ((char const *)(Last) - (char const *)(First)) / (Dtype), \
+                  profile_range_bytes(First, Last))
+
+static inline u64 profile_range_bytes(void const *const first,
+                                      void const *const last) {
+    return last < first ? (char const *)first - (char const *)last
+                        : (char const *)last - (char const *)first;
+}
+
+/**
+ * @brief Whether the library was built with the hooks
+ *
+ */
+bool profile_enabled();
+
+/**
+ * @brief Current value of the time stamp counter, nanoseconds of the monotonic
+ * clock where there is none
+ *
+ */
+u64 profile_ticks();
+
+/**
+ * @brief Opens a span, normally called through `PROFILE_SCOPE`
+ *
+ */
+profile_span profile_begin(profile_op op, i64 dtype, u64 elements, u64 bytes);
+
+/**
+ * @brief Closes a span and adds it to the counters of the calling thread and,
+ * while tracing, to its trace buffer
+ *
+ * Every thread writes only to its own counters, so concurrent calls do not
+ * share cache lines. The counters of a thread are kept after it exits.
+ *
+ */
+void profile_end(profile_span const *span);
+
+/**
+ * @brief Sums the counters of every thread
+ *
+ * May be called while other threads are running, the values of operations in
+ * progress on them are not included.
+ *
+ * @param stats receives the totals since the last `profile_reset`
+ */
+void profile_snapshot(profile_stats *stats);
+
+/**
+ * @brief Starts counting from zero, the counters themselves are not touched,
+ * so resetting is safe while other threads are running
+ *
+ */
+void profile_reset();
+
+/**
+ * @brief Name and group of an operation, e.g. "m2_mult" and "matrix2"
+ *
+ */
+char const *profile_op_name(profile_op op);
+
+char const *profile_op_group(profile_op op);
+
+/**
+ * @brief Element size counted by a dtype slot of `profile_stats`, 0 for the
+ * slot of every other size
+ *
+ */
+size_t profile_dtype_size(size_t slot);
+
+/**
+ * @brief Starts recording spans for `profile_trace_write`, earlier spans are
+ * discarded
+ *
+ * Every thread records up to `capacity` spans into its own buffer, later ones
+ * are dropped and counted. Must not be called concurrently with
+ * `profile_trace_write`.
+ *
+ * @param capacity spans per thread, 0 selects 1 << 16
+ * @return false if the library was built without the hooks
+ */
+bool profile_trace_start(size_t capacity);
+
+/**
+ * @brief Stops recording spans, the recorded ones are kept
+ *
+ */
+void profile_trace_stop();
+
+/**
+ * @brief Writes the recorded spans in the Chrome trace event format
+ *
+ * Every span becomes a complete ("X") event with microsecond timestamps
+ * relative to `profile_trace_start`, one track per thread. The file opens in
+ * chrome://tracing or Perfetto.
+ *
+ * @param path file to write
+ * @return false if the file could not be written
+ */
+bool profile_trace_write(char const *path);
+
+#endif  // MY_PROFILE
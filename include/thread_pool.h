@@ -0,0 +1,81 @@
+#ifndef MY_THREAD_POOL
+#define MY_THREAD_POOL
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Fixed size pool of worker threads
+ *
+ * The thread calling `thread_pool_run` always takes part in the work, so a
+ * pool of size `n` owns `n - 1` background threads.
+ *
+ */
+typedef struct thread_pool thread_pool;
+
+/**
+ * @brief Task executed by the pool, receives user context and index of the
+ * task in range [0, num_tasks)
+ *
+ */
+typedef void (*ThreadTask)(void *ctx, size_t index);
+
+/**
+ * @brief Creates pool with given amount of threads
+ *
+ * When `pin` is set, background threads are pinned to the CPUs the process is
+ * allowed to run on in their natural order, so neighbouring workers share a
+ * NUMA node whenever the system numbers its CPUs node by node. Pinning is
+ * skipped if only one CPU is allowed. It suits a process that owns the
+ * machine; under a scheduler or next to other pools it keeps threads off CPUs
+ * that are free, so it is off unless asked for.
+ *
+ * @param num_threads amount of threads including the calling one, 0 means one
+ * thread per online CPU
+ * @param pin whether background threads are pinned to CPUs
+ * @return thread_pool* created pool or NULL if threads could not be spawned
+ */
+thread_pool *thread_pool_create(size_t num_threads, bool pin);
+
+/**
+ * @brief Stops and joins all background threads and frees the pool
+ *
+ * @param pool pool to destroy, NULL is ignored
+ */
+void thread_pool_destroy(thread_pool *pool);
+
+/**
+ * @brief Shared process-wide pool with one thread per online CPU, not pinned.
+ * Lazily created on the first call and never destroyed
+ *
+ */
+thread_pool *thread_pool_default();
+
+/**
+ * @brief Amount of threads taking part in the work including the calling one
+ *
+ */
+size_t thread_pool_size(thread_pool const *pool);
+
+/**
+ * @brief Runs `task` for every index in [0, num_tasks) and blocks until all of
+ * them are finished
+ *
+ * Indices are split into contiguous equal ranges, one per thread, and the same
+ * thread always receives the same range for the same `num_tasks`. This way
+ * consecutive tasks that touch neighbouring data (e.g. adjacent tiles of a
+ * matrix) keep hitting the same core and its caches across calls. A thread that
+ * finishes its range steals the remaining indices of the others.
+ *
+ * Calls on a single pool are serialized, calling it from inside a task of the
+ * same pool is not supported.
+ *
+ * @param pool pool to run on, NULL runs everything on the calling thread
+ * @param num_tasks amount of tasks
+ * @param task function to execute
+ * @param ctx context passed to every call of the task
+ */
+void thread_pool_run(thread_pool *pool, size_t num_tasks, ThreadTask task,
+                     void *ctx);
+
+#endif  // MY_THREAD_POOL
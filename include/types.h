@@ -16,4 +16,31 @@ typedef uint64_t u64;
 typedef float f32;
 typedef double f64;
 
+#define FOR_ALL_TYPES(MACRO) \
+    MACRO(f32)               \
+    MACRO(f64)               \
+    MACRO(i8)                \
+    MACRO(i16)               \
+    MACRO(i32)               \
+    MACRO(i64)               \
+    MACRO(u8)                \
+    MACRO(u16)               \
+    MACRO(u32)               \
+    MACRO(u64)
+
+#define FOR_ALL_INTEGER_TYPES(MACRO) \
+    MACRO(i8)                        \
+    MACRO(i16)                       \
+    MACRO(i32)                       \
+    MACRO(i64)                       \
+    MACRO(u8)                        \
+    MACRO(u16)                       \
+    MACRO(u32)                       \
+    MACRO(u64)
+
+// the same definition as the one of <sys/param.h>, which may be included too
+#ifndef MIN
+#define MIN(lhs, rhs) ((lhs) < (rhs) ? (lhs) : (rhs))
+#endif
+
 #endif  // MY_TYPES
\ No newline at end of file
@@ -1,4 +1,11 @@
 #include <algorithms.h>
+//
+#include <profile.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ALGORITHMS_X86
+#include <immintrin.h>
+#endif
 
 UnaryPredicate _local_unary_predicate = 0;
 BinaryPredicate _local_binary_predicate = 0;
@@ -24,9 +31,276 @@ BinaryPredicate not_binary_predicate(BinaryPredicate p) {
     return &_binary_not_predicate_wrapper;
 }
 
+UnaryClosure unary_closure(UnaryPredicateCtx fn, void *ctx) {
+    return (UnaryClosure){.fn = fn, .ctx = ctx, .negate = false};
+}
+
+BinaryClosure binary_closure(BinaryPredicateCtx fn, void *ctx) {
+    return (BinaryClosure){.fn = fn, .ctx = ctx, .negate = false};
+}
+
+static bool _unary_predicate_adapter(const void *const any, void *ctx) {
+    return ((UnaryPredicate)ctx)(any);
+}
+
+static bool _binary_predicate_adapter(const void *const lhs,
+                                      const void *const rhs, void *ctx) {
+    return ((BinaryPredicate)ctx)(lhs, rhs);
+}
+
+UnaryClosure unary_closure_from(UnaryPredicate p) {
+    return unary_closure(&_unary_predicate_adapter, (void *)p);
+}
+
+BinaryClosure binary_closure_from(BinaryPredicate p) {
+    return binary_closure(&_binary_predicate_adapter, (void *)p);
+}
+
+UnaryClosure unary_closure_not(UnaryClosure c) {
+    c.negate = not c.negate;
+    return c;
+}
+
+BinaryClosure binary_closure_not(BinaryClosure c) {
+    c.negate = not c.negate;
+    return c;
+}
+
+/**
+ * Size of the bounce buffer memswap moves data through.
+ */
+#define MEMSWAP_BLOCK 64
+
+#define MEMSWAP_FIXED(size)        \
+    case size:                     \
+        memcpy(block, _lhs, size); \
+        memcpy(_lhs, _rhs, size);  \
+        memcpy(_rhs, block, size); \
+        return;
+
+/**
+ * Rotations whose shorter side fits in this many bytes go through a stack
+ * buffer and a single memmove.
+ */
+#define ROTATE_BUFFER 512
+
+// type-specialized kernels
+
+/**
+ * Number of independent accumulators used by the typed reductions, enough to
+ * fill a 256 bit register for 32 bit types and to break dependency chains.
+ */
+#define TYPED_LANES 8
+
+/**
+ * Size of the block the early exit scans check at once before branching.
+ */
+#define TYPED_BLOCK_BYTES 64
+
+#define TYPED_ADD(lhs, rhs) ((lhs) + (rhs))
+#define TYPED_MULT(lhs, rhs) ((lhs) * (rhs))
+#define TYPED_MIN(lhs, rhs) ((rhs) < (lhs) ? (rhs) : (lhs))
+#define TYPED_MAX(lhs, rhs) ((lhs) < (rhs) ? (rhs) : (lhs))
+
+#define DEFINE_TYPED_ACCUM(Type, name, COMBINE)                         \
+    void Type##_accum_##name(void *const accum,                         \
+                             const void *const value) {                 \
+        *(Type *)accum = COMBINE(*(Type *)accum, *(const Type *)value); \
+    }
+
+#define DEFINE_TYPED_REDUCE(Type, name, identity, COMBINE)                 \
+    Type reduce_##name##_##Type(const Type *first, const Type *const last, \
+                                Type init) {                               \
+        const size_t n = last - first;                                     \
+        Type lanes[TYPED_LANES];                                           \
+        for (size_t k = 0; k < TYPED_LANES; ++k) {                         \
+            lanes[k] = identity;                                           \
+        }                                                                  \
+        size_t i = 0;                                                      \
+        for (; i + TYPED_LANES <= n; i += TYPED_LANES) {                   \
+            for (size_t k = 0; k < TYPED_LANES; ++k) {                     \
+                lanes[k] = COMBINE(lanes[k], first[i + k]);                \
+            }                                                              \
+        }                                                                  \
+        for (; i < n; ++i) {                                               \
+            init = COMBINE(init, first[i]);                                \
+        }                                                                  \
+        for (size_t k = 0; k < TYPED_LANES; ++k) {                         \
+            init = COMBINE(init, lanes[k]);                                \
+        }                                                                  \
+        return init;                                                       \
+    }
+
+#define DEFINE_TYPED_SCAN(Type, name, cmp)                         \
+    const Type *name(const Type *first, const Type *const last,    \
+                     const Type value) {                           \
+        const size_t block = TYPED_BLOCK_BYTES / sizeof(Type);     \
+        while ((size_t)(last - first) >= block) {                  \
+            int hit = 0;                                           \
+            for (size_t k = 0; k < block; ++k) {                   \
+                hit |= first[k] cmp value;                         \
+            }                                                      \
+            if (hit) {                                             \
+                break;                                             \
+            }                                                      \
+            first += block;                                        \
+        }                                                          \
+        for (; first != last and not(*first cmp value); ++first) { \
+        }                                                          \
+        return first;                                              \
+    }
+
+#define DEFINE_TYPED_TRANSFORM(Type, name, op)                                \
+    void transform_##name##_##Type(const Type *first, const Type *const last, \
+                                   Type *dest, const Type value) {            \
+        const size_t n = last - first;                                        \
+        for (size_t i = 0; i < n; ++i) {                                      \
+            dest[i] = first[i] op value;                                      \
+        }                                                                     \
+    }
+
+#define DEFINE_TYPED_ALGORITHMS(Type)                                         \
+    DEFINE_TYPED_ACCUM(Type, add, TYPED_ADD)                                  \
+    DEFINE_TYPED_ACCUM(Type, mult, TYPED_MULT)                                \
+    DEFINE_TYPED_ACCUM(Type, min, TYPED_MIN)                                  \
+    DEFINE_TYPED_ACCUM(Type, max, TYPED_MAX)                                  \
+    DEFINE_TYPED_REDUCE(Type, add, 0, TYPED_ADD)                              \
+    DEFINE_TYPED_REDUCE(Type, mult, 1, TYPED_MULT)                            \
+    DEFINE_TYPED_REDUCE(Type, min, init, TYPED_MIN)                           \
+    DEFINE_TYPED_REDUCE(Type, max, init, TYPED_MAX)                           \
+    DEFINE_TYPED_SCAN(Type, find_##Type, ==)                                  \
+    static DEFINE_TYPED_SCAN(Type, _find_ne_##Type, !=)                       \
+    DEFINE_TYPED_TRANSFORM(Type, add, +)                                      \
+    DEFINE_TYPED_TRANSFORM(Type, mult, *)                                     \
+                                                                              \
+    void fill_##Type(Type *first, const Type *const last, const Type value) { \
+        const size_t n = last - first;                                        \
+        for (size_t i = 0; i < n; ++i) {                                      \
+            first[i] = value;                                                 \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    size_t count_eq_##Type(const Type *first, const Type *const last,         \
+                           const Type value) {                                \
+        const size_t n = last - first;                                        \
+        size_t accum = 0;                                                     \
+        for (size_t i = 0; i < n; ++i) {                                      \
+            accum += first[i] == value;                                       \
+        }                                                                     \
+        return accum;                                                         \
+    }                                                                         \
+                                                                              \
+    bool any_eq_##Type(const Type *first, const Type *const last,             \
+                       const Type value) {                                    \
+        return find_##Type(first, last, value) != last;                       \
+    }                                                                         \
+                                                                              \
+    bool all_eq_##Type(const Type *first, const Type *const last,             \
+                       const Type value) {                                    \
+        return _find_ne_##Type(first, last, value) == last;                   \
+    }                                                                         \
+                                                                              \
+    bool Type##_equal(const void *const lhs, const void *const rhs) {         \
+        return *(const Type *)lhs == *(const Type *)rhs;                      \
+    }
+
+FOR_ALL_TYPES(DEFINE_TYPED_ALGORITHMS)
+
+#define DISPATCH_TYPED_REDUCE(Type, name)                                     \
+    if (dtype == sizeof(Type) and op == &Type##_accum_##name) {               \
+        *(Type *)accum = reduce_##name##_##Type(first, last, *(Type *)accum); \
+        return true;                                                          \
+    }
+
+#define DISPATCH_TYPED_REDUCE_ALL(Type) \
+    DISPATCH_TYPED_REDUCE(Type, add)    \
+    DISPATCH_TYPED_REDUCE(Type, mult)   \
+    DISPATCH_TYPED_REDUCE(Type, min)    \
+    DISPATCH_TYPED_REDUCE(Type, max)
+
+static bool _reduce_typed(const void *first, const void *const last,
+                          int64_t dtype, void *const accum,
+                          BinaryLApplicator op) {
+    FOR_ALL_TYPES(DISPATCH_TYPED_REDUCE_ALL)
+    return false;
+}
+
+#define DISPATCH_BITWISE_EQUAL(Type)  \
+    if (p == &Type##_equal) {         \
+        return dtype == sizeof(Type); \
+    }
+
+// whether p compares values of dtype bytes exactly like memcmp does
+static bool _is_bitwise_equal(BinaryPredicate p, int64_t dtype) {
+    FOR_ALL_INTEGER_TYPES(DISPATCH_BITWISE_EQUAL)
+    return false;
+}
+
+static bool _fill_typed(void *first, const void *const last, int64_t dtype,
+                        const void *const value) {
+    if (dtype <= 0 or (uintptr_t)first % dtype) {
+        return false;
+    }
+    switch (dtype) {
+        case sizeof(u8):
+            memset(first, *(const u8 *)value,
+                   PTR_DIFFERENCE_BYTES(last, first));
+            return true;
+        case sizeof(u16): {
+            u16 v;
+            memcpy(&v, value, sizeof(v));
+            fill_u16(first, last, v);
+            return true;
+        }
+        case sizeof(u32): {
+            u32 v;
+            memcpy(&v, value, sizeof(v));
+            fill_u32(first, last, v);
+            return true;
+        }
+        case sizeof(u64): {
+            u64 v;
+            memcpy(&v, value, sizeof(v));
+            fill_u64(first, last, v);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
 void memswap(void *lhs, void *rhs, size_t nbytes) {
-    for (char *_lhs = (char *)lhs, *_rhs = (char *)rhs; nbytes--;
-         _lhs++, _rhs++) {
+    char *_lhs = lhs;
+    char *_rhs = rhs;
+    char block[MEMSWAP_BLOCK];
+
+    // fixed size copies of primitive sized elements compile to plain register
+    // moves
+    switch (nbytes) {
+        MEMSWAP_FIXED(2)
+        MEMSWAP_FIXED(4)
+        MEMSWAP_FIXED(8)
+        MEMSWAP_FIXED(16)
+    }
+
+    for (; nbytes >= MEMSWAP_BLOCK; nbytes -= MEMSWAP_BLOCK,
+                                    _lhs += MEMSWAP_BLOCK,
+                                    _rhs += MEMSWAP_BLOCK) {
+        memcpy(block, _lhs, MEMSWAP_BLOCK);
+        memcpy(_lhs, _rhs, MEMSWAP_BLOCK);
+        memcpy(_rhs, block, MEMSWAP_BLOCK);
+    }
+
+    for (; nbytes >= sizeof(u64); nbytes -= sizeof(u64),
+                                  _lhs += sizeof(u64),
+                                  _rhs += sizeof(u64)) {
+        u64 word;
+        memcpy(&word, _lhs, sizeof(word));
+        memcpy(_lhs, _rhs, sizeof(word));
+        memcpy(_rhs, &word, sizeof(word));
+    }
+
+    for (; nbytes--; _lhs++, _rhs++) {
         char tmp = *_lhs;
         *_lhs = *_rhs;
         *_rhs = tmp;
@@ -35,6 +309,10 @@ void memswap(void *lhs, void *rhs, size_t nbytes) {
 
 void reduce(const void *first, const void *const last, int64_t dtype,
             void *const accum, BinaryLApplicator op) {
+    PROFILE_RANGE(reduce, first, last, dtype);
+    if (_reduce_typed(first, last, dtype, accum, op)) {
+        return;
+    }
     for (; first != last; ADVANCE(first, dtype)) {
         op(accum, first);
     }
@@ -42,6 +320,7 @@ void reduce(const void *first, const void *const last, int64_t dtype,
 
 const void *find(const void *first, const void *const last, int64_t dtype,
                  UnaryPredicate p) {
+    PROFILE_RANGE(find, first, last, dtype);
     for (; first != last; ADVANCE(first, dtype)) {
         if (p(first)) {
             break;
@@ -50,33 +329,21 @@ const void *find(const void *first, const void *const last, int64_t dtype,
     return first;
 }
 
-void *filter(void *first, const void *const last, size_t dtype,
-             UnaryPredicate p) {
-    first = (void *)find(first, last, dtype, p);
-    if (first == last) {
-        return first;
-    }
-    for (void *i = first; ADVANCE(i, dtype) != last;) {
-        if (not p(i)) {
-            memmove(first, i, dtype);
-            ADVANCE(first, dtype);
-        }
-    }
-    return first;
-}
-
 bool all(const void *first, const void *const last, size_t dtype,
          UnaryPredicate p) {
-    return find(first, last, dtype, not_unary_predicate(p)) == last;
+    PROFILE_RANGE(all, first, last, dtype);
+    return all_ctx(first, last, dtype, unary_closure_from(p));
 }
 
 bool any(const void *first, const void *const last, size_t dtype,
          UnaryPredicate p) {
+    PROFILE_RANGE(any, first, last, dtype);
     return find(first, last, dtype, p) != last;
 }
 
 size_t count(const void *first, const void *const last, size_t dtype,
              UnaryPredicate p) {
+    PROFILE_RANGE(count, first, last, dtype);
     size_t accum = 0;
     for (; first != last; ADVANCE(first, dtype)) {
         accum += p(first);
@@ -87,9 +354,11 @@ size_t count(const void *first, const void *const last, size_t dtype,
 Pair mismatch(const void *first1, const void *const last1, int64_t dtype1,
               const void *first2, const void *const last2, int64_t dtype2,
               BinaryPredicate p) {
-    while (first1 != last1 and first2 != last2 and p(first1, first2)) {
-        ADVANCE(first1, typeSize1);
-        ADVANCE(first2, typeSize2);
+    PROFILE_RANGE(mismatch, first1, last1, dtype1);
+    if (dtype1 == dtype2 and _is_bitwise_equal(p, dtype1)) {
+        return mismatch_bytes(first1, last1, first2, last2, dtype1);
+    }
+
     while (first1 != last1 and first2 != last2 and
            p(first1, first2)) {
         ADVANCE(first1, dtype1);
@@ -100,6 +369,11 @@ Pair mismatch(const void *first1, const void *const last1, int64_t dtype1,
 
 const void *adjacent_find(const void *first, const void *last, size_t dtype,
                           BinaryPredicate p) {
+    PROFILE_RANGE(adjacent_find, first, last, dtype);
+    if (_is_bitwise_equal(p, dtype)) {
+        return adjacent_find_eq(first, last, dtype);
+    }
+
     if (first == last) {
         return first;
     }
@@ -119,6 +393,11 @@ const void *adjacent_find(const void *first, const void *last, size_t dtype,
 const void *search(const void *first1, const void *last1, int64_t dtype1,
                    const void *first2, const void *last2, int64_t dtype2,
                    BinaryPredicate p) {
+    PROFILE_RANGE(search, first1, last1, dtype1);
+    if (dtype1 == dtype2 and _is_bitwise_equal(p, dtype1)) {
+        return search_bytes(first1, last1, first2, last2, dtype1);
+    }
+
     for (;;) {
         for (const void *it1 = first1, *it2 = first2;;) {
             if (it2 == last2) {
@@ -138,6 +417,7 @@ const void *search(const void *first1, const void *last1, int64_t dtype1,
 }
 
 void reverse(void *first, void *last, int64_t dtype) {
+    PROFILE_RANGE(reverse, first, last, dtype);
     if (first == last) {
         return;
     }
@@ -151,6 +431,7 @@ void reverse(void *first, void *last, int64_t dtype) {
 
 void generate(void *first, const void *const last, int64_t dtype,
               Generator gen) {
+    PROFILE_RANGE(generate, first, last, dtype);
     for (; first != last; ADVANCE(first, dtype)) {
         memcpy(first, gen(), dtype);
     }
@@ -158,6 +439,10 @@ void generate(void *first, const void *const last, int64_t dtype,
 
 void fill(void *first, const void *const last, int64_t dtype,
           const void *const value) {
+    PROFILE_RANGE(fill, first, last, dtype);
+    if (_fill_typed(first, last, dtype, value)) {
+        return;
+    }
     for (; first != last; ADVANCE(first, dtype)) {
         memcpy(first, value, dtype);
     }
@@ -167,6 +452,7 @@ void transform(const void *source_first, const void *const source_last,
                int64_t source_dtype, void *dest_first,
                const void *const dest_last, int64_t dest_dtype,
                UnaryOperator op) {
+    PROFILE_RANGE(transform, source_first, source_last, source_dtype);
     while (source_first != source_last and dest_first != dest_last) {
         memcpy(dest_first, op(source_first), dest_dtype);
         ADVANCE(source_first, source_dtype);
@@ -175,6 +461,7 @@ void transform(const void *source_first, const void *const source_last,
 }
 
 void *rotate(void *first, void *around, void *last, int64_t dtype) {
+    PROFILE_RANGE(rotate, first, last, dtype);
     if (first == around) {
         return last;
     }
@@ -183,24 +470,43 @@ void *rotate(void *first, void *around, void *last, int64_t dtype) {
         return first;
     }
 
-    void *read = around;
-    void *write = first;
-    void *nextRead = first;
+    size_t left = PTR_DIFFERENCE_BYTES(around, first);
+    size_t right = PTR_DIFFERENCE_BYTES(last, around);
+    assert(dtype > 0 and left % dtype == 0 and right % dtype == 0);
+    void *const result = (char *)first + right;
 
-    while (read != last) {
-        if (write == nextRead) {
-            nextRead = read;
+    if (left <= ROTATE_BUFFER or right <= ROTATE_BUFFER) {
+        char buffer[ROTATE_BUFFER];
+        if (left <= right) {
+            memcpy(buffer, first, left);
+            memmove(first, around, right);
+            memcpy(result, buffer, left);
+        } else {
+            memcpy(buffer, around, right);
+            memmove(result, first, left);
+            memcpy(first, buffer, right);
         }
-        memswap(write, read, dtype);
-        ADVANCE(write, dtype);
-        ADVANCE(read, dtype);
+        return result;
     }
 
-    rotate(write, nextRead, last, dtype);
-    return write;
+    // Gries-Mills block swaps, every step puts the shorter side into its final
+    // place with a single contiguous memswap
+    for (char *p = first; left and right;) {
+        if (left <= right) {
+            memswap(p, p + left, left);
+            p += left;
+            right -= left;
+        } else {
+            memswap(p + left - right, p + left, right);
+            left -= right;
+        }
+    }
+
+    return result;
 }
 
 void *unique(void *first, void *last, int64_t dtype, BinaryPredicate p) {
+    PROFILE_RANGE(unique, first, last, dtype);
     if (first == last) {
         return last;
     }
@@ -216,10 +522,1467 @@ void *unique(void *first, void *last, int64_t dtype, BinaryPredicate p) {
 
 void shuffle(void *first, const void *last, int64_t dtype,
              RandomGenerator rnd) {
+    PROFILE_RANGE(shuffle, first, last, dtype);
     const void *const initial = first;
-    const size_t size = PTR_DIFFERENCE_BYTES(first, last) / dtype;
+    const size_t size = PTR_DIFFERENCE_BYTES(last, first) / dtype;
 
     for (; first != last; ADVANCE(first, dtype)) {
         memswap(first, (char *)initial + (rnd() % size) * dtype, dtype);
     }
 }
+
+// context-carrying versions
+
+const void *find_ctx(const void *first, const void *const last, int64_t dtype,
+                     UnaryClosure p) {
+    PROFILE_RANGE(find_ctx, first, last, dtype);
+    for (; first != last; ADVANCE(first, dtype)) {
+        if (unary_closure_call(&p, first)) {
+            break;
+        }
+    }
+    return first;
+}
+
+bool all_ctx(const void *first, const void *const last, size_t dtype,
+             UnaryClosure p) {
+    return find_ctx(first, last, dtype, unary_closure_not(p)) == last;
+}
+
+bool any_ctx(const void *first, const void *const last, size_t dtype,
+             UnaryClosure p) {
+    return find_ctx(first, last, dtype, p) != last;
+}
+
+size_t count_ctx(const void *first, const void *const last, size_t dtype,
+                 UnaryClosure p) {
+    PROFILE_RANGE(count_ctx, first, last, dtype);
+    size_t accum = 0;
+    for (; first != last; ADVANCE(first, dtype)) {
+        accum += unary_closure_call(&p, first);
+    }
+    return accum;
+}
+
+Pair mismatch_ctx(const void *first1, const void *const last1, int64_t dtype1,
+                  const void *first2, const void *const last2, int64_t dtype2,
+                  BinaryClosure p) {
+    PROFILE_RANGE(mismatch_ctx, first1, last1, dtype1);
+    while (first1 != last1 and first2 != last2 and
+           binary_closure_call(&p, first1, first2)) {
+        ADVANCE(first1, dtype1);
+        ADVANCE(first2, dtype2);
+    }
+    return (Pair){(void *)first1, (void *)first2};
+}
+
+const void *adjacent_find_ctx(const void *first, const void *last,
+                              size_t dtype, BinaryClosure p) {
+    PROFILE_RANGE(adjacent_find_ctx, first, last, dtype);
+    if (first == last) {
+        return first;
+    }
+
+    const void *next = first;
+    ADVANCE(next, dtype);
+
+    for (; next != last; ADVANCE(next, dtype), ADVANCE(first, dtype)) {
+        if (binary_closure_call(&p, first, next)) {
+            return first;
+        }
+    }
+
+    return last;
+}
+
+const void *search_ctx(const void *first1, const void *last1, int64_t dtype1,
+                       const void *first2, const void *last2, int64_t dtype2,
+                       BinaryClosure p) {
+    PROFILE_RANGE(search_ctx, first1, last1, dtype1);
+    for (;;) {
+        for (const void *it1 = first1, *it2 = first2;;) {
+            if (it2 == last2) {
+                return first1;
+            }
+            if (it1 == last1) {
+                return last1;
+            }
+            if (not binary_closure_call(&p, it1, it2)) {
+                break;
+            }
+            ADVANCE(it1, dtype1);
+            ADVANCE(it2, dtype2);
+        }
+        ADVANCE(first1, dtype1);
+    }
+}
+
+void *unique_ctx(void *first, void *last, int64_t dtype, BinaryClosure p) {
+    PROFILE_RANGE(unique_ctx, first, last, dtype);
+    if (first == last) {
+        return last;
+    }
+
+    void *result = first;
+    while (ADVANCE(first, dtype) != last) {
+        if (not binary_closure_call(&p, result, first) and
+            ADVANCE(result, dtype) != first) {
+            memmove(result, first, dtype);
+        }
+    }
+    return ADVANCE(result, dtype);
+}
+
+// sorting
+
+#define SORT_INSERTION_THRESHOLD 16
+#define SORT_NINTHER_THRESHOLD 128
+#define SORT_PARTIAL_INSERTION_LIMIT 8
+#define SORT_RADIX_THRESHOLD 64
+#define SORT_STACK_BUFFER 256
+
+#define SORT_AT(base, index, dtype) ((char *)(base) + (index) * (dtype))
+
+static void _sort_insertion(char *first, char *last, size_t dtype,
+                            BinaryPredicate less, char *tmp) {
+    for (char *i = first + dtype; i < last; i += dtype) {
+        if (not less(i, i - dtype)) {
+            continue;
+        }
+        memcpy(tmp, i, dtype);
+        char *j = i;
+        do {
+            memcpy(j, j - dtype, dtype);
+            j -= dtype;
+        } while (j > first and less(tmp, j - dtype));
+        memcpy(j, tmp, dtype);
+    }
+}
+
+// insertion sort that gives up after moving too many elements, returns
+// whether the range ended up sorted
+static bool _sort_partial_insertion(char *first, char *last, size_t dtype,
+                                    BinaryPredicate less, char *tmp) {
+    size_t moved = 0;
+    for (char *i = first + dtype; i < last; i += dtype) {
+        if (not less(i, i - dtype)) {
+            continue;
+        }
+        memcpy(tmp, i, dtype);
+        char *j = i;
+        do {
+            memcpy(j, j - dtype, dtype);
+            j -= dtype;
+        } while (j > first and less(tmp, j - dtype));
+        memcpy(j, tmp, dtype);
+
+        moved += PTR_DIFFERENCE_BYTES(i, j) / dtype;
+        if (moved > SORT_PARTIAL_INSERTION_LIMIT) {
+            return i + dtype == last;
+        }
+    }
+    return true;
+}
+
+static void _sort_sift_down(char *first, size_t root, size_t size,
+                            size_t dtype, BinaryPredicate less) {
+    for (size_t child; (child = 2 * root + 1) < size; root = child) {
+        if (child + 1 < size and less(SORT_AT(first, child, dtype),
+                                      SORT_AT(first, child + 1, dtype))) {
+            ++child;
+        }
+        if (not less(SORT_AT(first, root, dtype),
+                     SORT_AT(first, child, dtype))) {
+            return;
+        }
+        memswap(SORT_AT(first, root, dtype), SORT_AT(first, child, dtype),
+                dtype);
+    }
+}
+
+static void _sort_heap(char *first, char *last, size_t dtype,
+                       BinaryPredicate less) {
+    size_t const size = PTR_DIFFERENCE_BYTES(last, first) / dtype;
+    for (size_t i = size / 2; i-- > 0;) {
+        _sort_sift_down(first, i, size, dtype, less);
+    }
+    for (size_t i = size; i-- > 1;) {
+        memswap(first, SORT_AT(first, i, dtype), dtype);
+        _sort_sift_down(first, 0, i, dtype, less);
+    }
+}
+
+// orders three elements in place so that *a <= *b <= *c
+static void _sort3(char *a, char *b, char *c, size_t dtype,
+                   BinaryPredicate less) {
+    if (less(b, a)) {
+        memswap(a, b, dtype);
+    }
+    if (less(c, b)) {
+        memswap(b, c, dtype);
+        if (less(b, a)) {
+            memswap(a, b, dtype);
+        }
+    }
+}
+
+// partitions [first, last) around the pivot stored at first, returns the
+// final position of the pivot and whether no element had to be moved
+static char *_sort_partition(char *first, char *last, size_t dtype,
+                             BinaryPredicate less, bool *already) {
+    char *i = first;
+    char *j = last;
+    *already = true;
+    for (;;) {
+        do {
+            i += dtype;
+        } while (i < last and less(i, first));
+        do {
+            j -= dtype;
+        } while (less(first, j));
+        if (i >= j) {
+            break;
+        }
+        memswap(i, j, dtype);
+        *already = false;
+    }
+    memswap(first, j, dtype);
+    return j;
+}
+
+static void _sort_pdq(char *first, char *last, size_t dtype,
+                      BinaryPredicate less, char *tmp, int bad_allowed) {
+    for (;;) {
+        size_t const size = PTR_DIFFERENCE_BYTES(last, first) / dtype;
+        if (size < SORT_INSERTION_THRESHOLD) {
+            _sort_insertion(first, last, dtype, less, tmp);
+            return;
+        }
+
+        size_t const half = size / 2;
+        char *const mid = SORT_AT(first, half, dtype);
+        char *const back = last - dtype;
+        if (size > SORT_NINTHER_THRESHOLD) {
+            size_t const step = size / 8;
+            _sort3(first, SORT_AT(first, step, dtype),
+                   SORT_AT(first, 2 * step, dtype), dtype, less);
+            _sort3(mid - step * dtype, mid, mid + step * dtype, dtype, less);
+            _sort3(back - 2 * step * dtype, back - step * dtype, back, dtype,
+                   less);
+            _sort3(SORT_AT(first, step, dtype), mid, back - step * dtype,
+                   dtype, less);
+        } else {
+            _sort3(first, mid, back, dtype, less);
+        }
+        memswap(first, mid, dtype);
+
+        bool already;
+        char *const pivot = _sort_partition(first, last, dtype, less, &already);
+        size_t const left = PTR_DIFFERENCE_BYTES(pivot, first) / dtype;
+        size_t const right = size - left - 1;
+
+        if (left < size / 8 or right < size / 8) {
+            if (--bad_allowed == 0) {
+                _sort_heap(first, last, dtype, less);
+                return;
+            }
+            // break up the pattern that led to the bad pivot
+            if (left >= SORT_INSERTION_THRESHOLD) {
+                memswap(first, SORT_AT(first, left / 4, dtype), dtype);
+                memswap(pivot - dtype, pivot - left / 4 * dtype, dtype);
+            }
+            if (right >= SORT_INSERTION_THRESHOLD) {
+                memswap(pivot + dtype, pivot + (1 + right / 4) * dtype, dtype);
+                memswap(back, back - right / 4 * dtype, dtype);
+            }
+        } else if (already and
+                   _sort_partial_insertion(first, pivot, dtype, less, tmp) and
+                   _sort_partial_insertion(pivot + dtype, last, dtype, less,
+                                           tmp)) {
+            return;
+        }
+
+        // recurse into the smaller side to bound the stack depth
+        if (left < right) {
+            _sort_pdq(first, pivot, dtype, less, tmp, bad_allowed);
+            first = pivot + dtype;
+        } else {
+            _sort_pdq(pivot + dtype, last, dtype, less, tmp, bad_allowed);
+            last = pivot;
+        }
+    }
+}
+
+static int _sort_log2(size_t size) {
+    int log = 0;
+    while (size >>= 1) {
+        ++log;
+    }
+    return log;
+}
+
+static void _sort_generic(void *first, void *last, size_t dtype,
+                          BinaryPredicate less) {
+    char stack[SORT_STACK_BUFFER];
+    char *const tmp = dtype <= sizeof(stack) ? stack : malloc(dtype);
+    assert(tmp);
+
+    size_t const size = PTR_DIFFERENCE_BYTES(last, first) / dtype;
+    _sort_pdq(first, last, dtype, less, tmp, _sort_log2(size) + 1);
+
+    if (tmp != stack) {
+        free(tmp);
+    }
+}
+
+static void _sort_merge(char *first, char *last, size_t dtype,
+                        BinaryPredicate less, char *buffer) {
+    size_t const size = PTR_DIFFERENCE_BYTES(last, first) / dtype;
+    if (size <= SORT_INSERTION_THRESHOLD) {
+        _sort_insertion(first, last, dtype, less, buffer);
+        return;
+    }
+
+    char *const mid = SORT_AT(first, size / 2, dtype);
+    _sort_merge(first, mid, dtype, less, buffer);
+    _sort_merge(mid, last, dtype, less, buffer);
+    if (not less(mid, mid - dtype)) {
+        return;
+    }
+
+    size_t const left_bytes = PTR_DIFFERENCE_BYTES(mid, first);
+    memcpy(buffer, first, left_bytes);
+
+    char *left = buffer;
+    char *const left_end = buffer + left_bytes;
+    char *right = mid;
+    char *out = first;
+    while (left < left_end and right < last) {
+        if (less(right, left)) {
+            memcpy(out, right, dtype);
+            right += dtype;
+        } else {
+            memcpy(out, left, dtype);
+            left += dtype;
+        }
+        out += dtype;
+    }
+    memcpy(out, left, PTR_DIFFERENCE_BYTES(left_end, left));
+}
+
+// radix sort
+//
+// Keys are mapped onto unsigned integers preserving the order: sign bit of
+// signed integers is flipped, negative floats are inverted entirely and
+// positive floats get their sign bit set.
+
+#define SORT_KEY_UNSIGNED(bits, sign) ((void)(sign), (bits))
+#define SORT_UNKEY_UNSIGNED(key, sign) ((void)(sign), (key))
+#define SORT_KEY_SIGNED(bits, sign) ((bits) ^ (sign))
+#define SORT_UNKEY_SIGNED(key, sign) ((key) ^ (sign))
+#define SORT_KEY_FLOAT(bits, sign) ((bits) & (sign) ? ~(bits) : (bits) | (sign))
+#define SORT_UNKEY_FLOAT(key, sign) ((key) & (sign) ? (key) ^ (sign) : ~(key))
+
+#define SORT_TRAITS_f32 u32, SORT_KEY_FLOAT, SORT_UNKEY_FLOAT
+#define SORT_TRAITS_f64 u64, SORT_KEY_FLOAT, SORT_UNKEY_FLOAT
+#define SORT_TRAITS_i8 u8, SORT_KEY_SIGNED, SORT_UNKEY_SIGNED
+#define SORT_TRAITS_i16 u16, SORT_KEY_SIGNED, SORT_UNKEY_SIGNED
+#define SORT_TRAITS_i32 u32, SORT_KEY_SIGNED, SORT_UNKEY_SIGNED
+#define SORT_TRAITS_i64 u64, SORT_KEY_SIGNED, SORT_UNKEY_SIGNED
+#define SORT_TRAITS_u8 u8, SORT_KEY_UNSIGNED, SORT_UNKEY_UNSIGNED
+#define SORT_TRAITS_u16 u16, SORT_KEY_UNSIGNED, SORT_UNKEY_UNSIGNED
+#define SORT_TRAITS_u32 u32, SORT_KEY_UNSIGNED, SORT_UNKEY_UNSIGNED
+#define SORT_TRAITS_u64 u64, SORT_KEY_UNSIGNED, SORT_UNKEY_UNSIGNED
+
+#define DEFINE_TYPED_SORT_(Type, Key, KEY, UNKEY)                      \
+    static Key _sort_key_##Type(const void *const value) {             \
+        Key const sign = (Key)((Key)1 << (sizeof(Key) * 8 - 1));       \
+        Key bits;                                                      \
+        memcpy(&bits, value, sizeof(bits));                            \
+        return (Key)KEY(bits, sign);                                   \
+    }                                                                  \
+                                                                       \
+    bool Type##_less(const void *const lhs, const void *const rhs) {   \
+        return _sort_key_##Type(lhs) < _sort_key_##Type(rhs);          \
+    }                                                                  \
+                                                                       \
+    void sort_##Type(Type *first, Type *last) {                        \
+        size_t const size = last - first;                              \
+        if (size < SORT_RADIX_THRESHOLD) {                             \
+            _sort_generic(first, last, sizeof(Type), &Type##_less);    \
+            return;                                                    \
+        }                                                              \
+                                                                       \
+        Key const sign = (Key)((Key)1 << (sizeof(Key) * 8 - 1));       \
+        Key *src = malloc(2 * size * sizeof(Key));                     \
+        assert(src);                                                   \
+        Key *const buffer = src;                                       \
+        Key *dst = src + size;                                         \
+        size_t counts[sizeof(Key)][256] = {{0}};                       \
+                                                                       \
+        for (size_t i = 0; i < size; ++i) {                            \
+            Key const key = _sort_key_##Type(first + i);               \
+            src[i] = key;                                              \
+            for (size_t d = 0; d < sizeof(Key); ++d) {                 \
+                ++counts[d][(key >> (d * 8)) & 0xff];                  \
+            }                                                          \
+        }                                                              \
+                                                                       \
+        for (size_t d = 0; d < sizeof(Key); ++d) {                     \
+            if (counts[d][(src[0] >> (d * 8)) & 0xff] == size) {       \
+                continue;                                              \
+            }                                                          \
+            size_t offset = 0;                                         \
+            for (size_t b = 0; b < 256; ++b) {                         \
+                size_t const count = counts[d][b];                     \
+                counts[d][b] = offset;                                 \
+                offset += count;                                       \
+            }                                                          \
+            for (size_t i = 0; i < size; ++i) {                        \
+                dst[counts[d][(src[i] >> (d * 8)) & 0xff]++] = src[i]; \
+            }                                                          \
+            Key *const swap = src;                                     \
+            src = dst;                                                 \
+            dst = swap;                                                \
+        }                                                              \
+                                                                       \
+        for (size_t i = 0; i < size; ++i) {                            \
+            Key const bits = (Key)UNKEY(src[i], sign);                 \
+            memcpy(first + i, &bits, sizeof(bits));                    \
+        }                                                              \
+        free(buffer);                                                  \
+    }
+
+#define DEFINE_TYPED_SORT_EXPAND(...) DEFINE_TYPED_SORT_(__VA_ARGS__)
+#define DEFINE_TYPED_SORT(Type) \
+    DEFINE_TYPED_SORT_EXPAND(Type, SORT_TRAITS_##Type)
+
+FOR_ALL_TYPES(DEFINE_TYPED_SORT)
+
+#define DISPATCH_TYPED_SORT(Type)                         \
+    if (dtype == sizeof(Type) and less == &Type##_less) { \
+        sort_##Type(first, last);                         \
+        return true;                                      \
+    }
+
+static bool _sort_typed(void *first, void *last, int64_t dtype,
+                        BinaryPredicate less) {
+    FOR_ALL_TYPES(DISPATCH_TYPED_SORT)
+    return false;
+}
+
+void sort(void *first, void *last, int64_t dtype, BinaryPredicate less) {
+    PROFILE_RANGE(sort, first, last, dtype);
+    assert(dtype > 0);
+    if (_sort_typed(first, last, dtype, less)) {
+        return;
+    }
+    _sort_generic(first, last, dtype, less);
+}
+
+void stable_sort(void *first, void *last, int64_t dtype,
+                 BinaryPredicate less) {
+    PROFILE_RANGE(stable_sort, first, last, dtype);
+    assert(dtype > 0);
+    if (_sort_typed(first, last, dtype, less)) {
+        return;
+    }
+
+    size_t const size = PTR_DIFFERENCE_BYTES(last, first) / dtype;
+    char *const buffer = malloc((size / 2 + 1) * dtype);
+    assert(buffer);
+    _sort_merge(first, last, dtype, less, buffer);
+    free(buffer);
+}
+
+// binary search
+//
+// The range is halved without branching on the comparison: the base only
+// moves forward by a conditional move, so the loop runs exactly log2(n)
+// times. Both candidates of the next probe are prefetched while the current
+// one is compared.
+
+static const char *_bound_generic(const char *first, size_t size, size_t dtype,
+                                  const void *const value,
+                                  BinaryPredicate less, bool upper) {
+    if (not size) {
+        return first;
+    }
+    while (size > 1) {
+        size_t const half = size / 2;
+        size_t const next = (size - half) / 2;
+        __builtin_prefetch(first + next * dtype);
+        __builtin_prefetch(first + (half + next) * dtype);
+        const char *const middle = first + half * dtype;
+        bool const right =
+            upper ? not less(value, middle) : less(middle, value);
+        first = right ? middle : first;
+        size -= half;
+    }
+    bool const right = upper ? not less(value, first) : less(first, value);
+    return first + (right ? dtype : 0);
+}
+
+#define DEFINE_TYPED_BOUNDS(Type)                                           \
+    static inline const Type *_bound_##Type(const Type *first, size_t size, \
+                                            const Type value, bool upper) { \
+        if (not size) {                                                     \
+            return first;                                                   \
+        }                                                                   \
+        u64 const key = _sort_key_##Type(&value);                           \
+        while (size > 1) {                                                  \
+            size_t const half = size / 2;                                   \
+            size_t const next = (size - half) / 2;                          \
+            __builtin_prefetch(first + next);                               \
+            __builtin_prefetch(first + half + next);                        \
+            u64 const probe = _sort_key_##Type(first + half);               \
+            first = (upper ? probe <= key : probe < key) ? first + half     \
+                                                         : first;           \
+            size -= half;                                                   \
+        }                                                                   \
+        u64 const probe = _sort_key_##Type(first);                          \
+        return first + (upper ? probe <= key : probe < key);                \
+    }                                                                       \
+                                                                            \
+    const Type *lower_bound_##Type(const Type *first, const Type *last,     \
+                                   const Type value) {                      \
+        return _bound_##Type(first, last - first, value, false);            \
+    }                                                                       \
+                                                                            \
+    const Type *upper_bound_##Type(const Type *first, const Type *last,     \
+                                   const Type value) {                      \
+        return _bound_##Type(first, last - first, value, true);             \
+    }
+
+FOR_ALL_TYPES(DEFINE_TYPED_BOUNDS)
+
+#define DISPATCH_TYPED_BOUND(Type)                                    \
+    if (dtype == sizeof(Type) and less == &Type##_less) {             \
+        Type typed;                                                   \
+        memcpy(&typed, value, sizeof(typed));                         \
+        return _bound_##Type(first, PTR_DIFFERENCE_BYTES(last, first) \
+                                        / sizeof(Type),               \
+                             typed, upper);                           \
+    }
+
+static const void *_bound(const void *first, const void *last, int64_t dtype,
+                          const void *const value, BinaryPredicate less,
+                          bool upper) {
+    assert(dtype > 0);
+    FOR_ALL_TYPES(DISPATCH_TYPED_BOUND)
+    return _bound_generic(first, PTR_DIFFERENCE_BYTES(last, first) / dtype,
+                          dtype, value, less, upper);
+}
+
+const void *lower_bound(const void *first, const void *last, int64_t dtype,
+                        const void *const value, BinaryPredicate less) {
+    PROFILE_RANGE(lower_bound, first, last, dtype);
+    return _bound(first, last, dtype, value, less, false);
+}
+
+const void *upper_bound(const void *first, const void *last, int64_t dtype,
+                        const void *const value, BinaryPredicate less) {
+    PROFILE_RANGE(upper_bound, first, last, dtype);
+    return _bound(first, last, dtype, value, less, true);
+}
+
+Pair equal_range(const void *first, const void *last, int64_t dtype,
+                 const void *const value, BinaryPredicate less) {
+    PROFILE_RANGE(equal_range, first, last, dtype);
+    const void *const lower = _bound(first, last, dtype, value, less, false);
+    const void *const upper = _bound(lower, last, dtype, value, less, true);
+    return (Pair){(void *)lower, (void *)upper};
+}
+
+bool binary_search(const void *first, const void *last, int64_t dtype,
+                   const void *const value, BinaryPredicate less) {
+    PROFILE_RANGE(binary_search, first, last, dtype);
+    const void *const lower = _bound(first, last, dtype, value, less, false);
+    return lower != last and not less(value, lower);
+}
+
+// static search index
+//
+// Entries are stored in Eytzinger (breadth-first) order: the children of node
+// k are 2k and 2k + 1, the hot top levels share a few cache lines and all the
+// descendants of a node four levels down (for 4 byte keys) are contiguous, so
+// they are prefetched with a single request. Every lookup takes the same
+// number of steps, which lets a group of lookups descend in lockstep and keep
+// SEARCH_INDEX_GROUP cache misses in flight. Typed indices store the order
+// preserving radix keys and compare them without calling the predicate.
+
+#define SEARCH_INDEX_GROUP 16
+#define SEARCH_INDEX_LINE 64
+
+struct search_index {
+    size_t size;
+    size_t dtype;
+    unsigned depth;
+    size_t prefetch;
+    BinaryPredicate less;
+    u64 (*key)(const void *const);
+    char *tree;
+};
+
+#define DEFINE_SEARCH_INDEX_KEY(Type)                              \
+    static u64 _search_index_key_##Type(const void *const value) { \
+        return _sort_key_##Type(value);                            \
+    }
+
+FOR_ALL_TYPES(DEFINE_SEARCH_INDEX_KEY)
+
+#define DISPATCH_SEARCH_INDEX_KEY(Type)                   \
+    if (dtype == sizeof(Type) and less == &Type##_less) { \
+        return &_search_index_key_##Type;                 \
+    }
+
+static u64 (*_search_index_key(int64_t dtype, BinaryPredicate less))(
+    const void *const) {
+    FOR_ALL_TYPES(DISPATCH_SEARCH_INDEX_KEY)
+    return NULL;
+}
+
+static void _search_index_store(search_index *const index, size_t node,
+                                const void *const value) {
+    char *const dest = index->tree + node * index->dtype;
+    if (not index->key) {
+        memcpy(dest, value, index->dtype);
+        return;
+    }
+    u64 const key = index->key(value);
+    switch (index->dtype) {
+        case 1: *(u8 *)dest = (u8)key; break;
+        case 2: *(u16 *)dest = (u16)key; break;
+        case 4: *(u32 *)dest = (u32)key; break;
+        default: *(u64 *)dest = key; break;
+    }
+}
+
+// in-order traversal of the implicit tree visits the nodes in sorted order
+static size_t _search_index_build(search_index *const index, const char *src,
+                                  size_t i, size_t node) {
+    if (node > index->size) {
+        return i;
+    }
+    i = _search_index_build(index, src, i, 2 * node);
+    _search_index_store(index, node, src + i * index->dtype);
+    return _search_index_build(index, src, i + 1, 2 * node + 1);
+}
+
+search_index *search_index_create(const void *first, const void *last,
+                                  int64_t dtype, BinaryPredicate less) {
+    PROFILE_RANGE(search_index_create, first, last, dtype);
+    assert(dtype > 0);
+
+    search_index *const index = malloc(sizeof(search_index));
+    assert(index);
+    index->size = PTR_DIFFERENCE_BYTES(last, first) / dtype;
+    index->dtype = dtype;
+    index->depth = index->size ? 64 - __builtin_clzll(index->size) : 0;
+    index->less = less;
+    index->key = _search_index_key(dtype, less);
+
+    // the node `prefetch` times deeper is the leftmost descendant that is
+    // still within the same cache line distance
+    index->prefetch = 2;
+    while (index->prefetch * 2 * dtype <= SEARCH_INDEX_LINE) {
+        index->prefetch *= 2;
+    }
+
+    // node 0 is unused padding that keeps the lines of descendants aligned and
+    // is read instead of missing nodes by the last step of a lookup
+    size_t const bytes = (index->size + 1) * dtype;
+    index->tree = aligned_alloc(SEARCH_INDEX_LINE,
+                                (bytes + SEARCH_INDEX_LINE - 1) /
+                                    SEARCH_INDEX_LINE * SEARCH_INDEX_LINE);
+    assert(index->tree);
+    memset(index->tree, 0, dtype);
+    _search_index_build(index, first, 0, 1);
+    return index;
+}
+
+void search_index_destroy(search_index *index) {
+    if (not index) {
+        return;
+    }
+    free(index->tree);
+    free(index);
+}
+
+size_t search_index_size(const search_index *index) {
+    return index->size;
+}
+
+// lockstep descent of a group of lookups, the first depth - 1 levels are
+// complete so only the last step has to check for missing nodes
+#define DEFINE_SEARCH_INDEX_DESCEND(Key)                                \
+    static void _search_index_descend_##Key(                            \
+        const search_index *const index, const u64 *keys, size_t count, \
+        bool upper, size_t *nodes) {                                    \
+        const Key *const tree = (const Key *)index->tree;               \
+        for (size_t i = 0; i < count; ++i) {                            \
+            nodes[i] = 1;                                               \
+        }                                                               \
+        for (unsigned level = 1; level < index->depth; ++level) {       \
+            for (size_t i = 0; i < count; ++i) {                        \
+                size_t const node = nodes[i];                           \
+                __builtin_prefetch(tree + node * index->prefetch);      \
+                Key const key = (Key)keys[i];                           \
+                nodes[i] = 2 * node + (upper ? tree[node] <= key        \
+                                             : tree[node] < key);       \
+            }                                                           \
+        }                                                               \
+        for (size_t i = 0; i < count; ++i) {                            \
+            size_t const node = nodes[i];                               \
+            bool const present = node <= index->size;                   \
+            Key const probe = tree[present ? node : 0];                 \
+            Key const key = (Key)keys[i];                               \
+            size_t const next =                                         \
+                2 * node + (upper ? probe <= key : probe < key);        \
+            nodes[i] = present ? next : node;                           \
+        }                                                               \
+    }
+
+DEFINE_SEARCH_INDEX_DESCEND(u8)
+DEFINE_SEARCH_INDEX_DESCEND(u16)
+DEFINE_SEARCH_INDEX_DESCEND(u32)
+DEFINE_SEARCH_INDEX_DESCEND(u64)
+
+static bool _search_index_right(const search_index *const index,
+                                size_t node, const void *const value,
+                                bool upper) {
+    const void *const probe = index->tree + node * index->dtype;
+    return upper ? not index->less(value, probe) : index->less(probe, value);
+}
+
+static void _search_index_descend_generic(const search_index *const index,
+                                          const char *values, size_t count,
+                                          bool upper, size_t *nodes) {
+    for (size_t i = 0; i < count; ++i) {
+        nodes[i] = 1;
+    }
+    for (unsigned level = 1; level < index->depth; ++level) {
+        for (size_t i = 0; i < count; ++i) {
+            size_t const node = nodes[i];
+            __builtin_prefetch(index->tree +
+                               node * index->prefetch * index->dtype);
+            nodes[i] = 2 * node + _search_index_right(
+                                      index, node, values + i * index->dtype,
+                                      upper);
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (nodes[i] <= index->size) {
+            nodes[i] = 2 * nodes[i] +
+                       _search_index_right(index, nodes[i],
+                                           values + i * index->dtype, upper);
+        }
+    }
+}
+
+// Position of a node in sorted order. In the perfect tree of the same depth
+// the in-order position of node k at height h above the last level is
+// (2 (k - 2^d) + 1) 2^h - 1, from which the missing last level nodes, that
+// take every other position, are subtracted.
+static size_t _search_index_rank(const search_index *const index,
+                                 size_t node) {
+    if (not node) {
+        return index->size;
+    }
+    unsigned const width = 64 - __builtin_clzll(node);
+    unsigned const height = index->depth - width;
+    size_t const position =
+        ((2 * (node - ((size_t)1 << (width - 1))) + 1) << height) - 1;
+    size_t const present =
+        index->size - ((size_t)1 << (index->depth - 1)) + 1;
+    size_t const before = (position + 1) / 2;
+    return position - (before > present ? before - present : 0);
+}
+
+static void _search_index_lookup(const search_index *const index,
+                                 const void *values, size_t count,
+                                 size_t *ranks, bool upper) {
+    const char *src = values;
+    for (size_t group = 0; group < count; group += SEARCH_INDEX_GROUP) {
+        size_t const size = count - group < SEARCH_INDEX_GROUP
+                                ? count - group
+                                : SEARCH_INDEX_GROUP;
+        const char *const batch = src + group * index->dtype;
+        size_t nodes[SEARCH_INDEX_GROUP];
+
+        if (index->key) {
+            u64 keys[SEARCH_INDEX_GROUP];
+            for (size_t i = 0; i < size; ++i) {
+                keys[i] = index->key(batch + i * index->dtype);
+            }
+            switch (index->dtype) {
+                case 1:
+                    _search_index_descend_u8(index, keys, size, upper, nodes);
+                    break;
+                case 2:
+                    _search_index_descend_u16(index, keys, size, upper,
+                                              nodes);
+                    break;
+                case 4:
+                    _search_index_descend_u32(index, keys, size, upper,
+                                              nodes);
+                    break;
+                default:
+                    _search_index_descend_u64(index, keys, size, upper,
+                                              nodes);
+                    break;
+            }
+        } else {
+            _search_index_descend_generic(index, batch, size, upper, nodes);
+        }
+
+        // the answer is the last node where the lookup turned left, the
+        // turns taken after it are all to the right
+        for (size_t i = 0; i < size; ++i) {
+            ranks[group + i] = _search_index_rank(
+                index, nodes[i] >> __builtin_ffsll(~nodes[i]));
+        }
+    }
+}
+
+size_t search_index_lower_bound(const search_index *index,
+                                const void *const value) {
+    PROFILE_SCOPE(search_index_lookup, index->dtype, 1, index->dtype);
+    size_t rank;
+    _search_index_lookup(index, value, 1, &rank, false);
+    return rank;
+}
+
+size_t search_index_upper_bound(const search_index *index,
+                                const void *const value) {
+    PROFILE_SCOPE(search_index_lookup, index->dtype, 1, index->dtype);
+    size_t rank;
+    _search_index_lookup(index, value, 1, &rank, true);
+    return rank;
+}
+
+void search_index_lower_bound_batch(const search_index *index,
+                                    const void *values, size_t count,
+                                    size_t *ranks) {
+    PROFILE_SCOPE(search_index_lookup, index->dtype, count,
+                  count * index->dtype);
+    _search_index_lookup(index, values, count, ranks, false);
+}
+
+void search_index_upper_bound_batch(const search_index *index,
+                                    const void *values, size_t count,
+                                    size_t *ranks) {
+    PROFILE_SCOPE(search_index_lookup, index->dtype, count,
+                  count * index->dtype);
+    _search_index_lookup(index, values, count, ranks, true);
+}
+
+// byte search
+
+/**
+ * Patterns up to this many bytes are searched by comparing their first and
+ * last bytes, longer ones by Two-Way.
+ */
+#define SEARCH_SHORT_PATTERN 32
+
+#define SEARCH_MAX(lhs, rhs) ((lhs) > (rhs) ? (lhs) : (rhs))
+
+static const u8 *_search_short_scalar(const u8 *haystack, size_t size,
+                                      size_t from, const u8 *needle,
+                                      size_t length, size_t dtype) {
+    for (size_t i = (from + dtype - 1) / dtype * dtype; i + length <= size;
+         i += dtype) {
+        if (haystack[i] == needle[0] and
+            haystack[i + length - 1] == needle[length - 1] and
+            not memcmp(haystack + i, needle, length)) {
+            return haystack + i;
+        }
+    }
+    return NULL;
+}
+
+#ifdef ALGORITHMS_X86
+
+#define DEFINE_SEARCH_SHORT_SIMD(isa, Vector, width, set1, loadu, cmpeq,  \
+                                 both, movemask)                          \
+    static const u8 *_search_short_##isa(const u8 *haystack, size_t size, \
+                                         const u8 *needle, size_t length, \
+                                         size_t dtype) {                  \
+        Vector const first = set1((char)needle[0]);                       \
+        Vector const last = set1((char)needle[length - 1]);               \
+        size_t i = 0;                                                     \
+        for (; i + length - 1 + width <= size; i += width) {              \
+            Vector const head = loadu((Vector const *)(haystack + i));    \
+            Vector const tail =                                           \
+                loadu((Vector const *)(haystack + i + length - 1));       \
+            u32 mask = (u32)movemask(                                     \
+                both(cmpeq(head, first), cmpeq(tail, last)));             \
+            for (; mask; mask &= mask - 1) {                              \
+                size_t const pos = i + __builtin_ctz(mask);               \
+                if (pos % dtype == 0 and                                  \
+                    not memcmp(haystack + pos, needle, length)) {         \
+                    return haystack + pos;                                \
+                }                                                         \
+            }                                                             \
+        }                                                                 \
+        return _search_short_scalar(haystack, size, i, needle, length,    \
+                                    dtype);                               \
+    }
+
+__attribute__((target("sse2")))
+DEFINE_SEARCH_SHORT_SIMD(sse2, __m128i, 16, _mm_set1_epi8, _mm_loadu_si128,
+                         _mm_cmpeq_epi8, _mm_and_si128, _mm_movemask_epi8)
+
+__attribute__((target("avx2")))
+DEFINE_SEARCH_SHORT_SIMD(avx2, __m256i, 32, _mm256_set1_epi8,
+                         _mm256_loadu_si256, _mm256_cmpeq_epi8,
+                         _mm256_and_si256, _mm256_movemask_epi8)
+
+#endif  // ALGORITHMS_X86
+
+static const u8 *_search_short(const u8 *haystack, size_t size,
+                               const u8 *needle, size_t length, size_t dtype) {
+#ifdef ALGORITHMS_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return _search_short_avx2(haystack, size, needle, length, dtype);
+    }
+    return _search_short_sse2(haystack, size, needle, length, dtype);
+#else
+    return _search_short_scalar(haystack, size, 0, needle, length, dtype);
+#endif
+}
+
+// Two-Way string matching (Crochemore-Perrin), the needle is split at its
+// critical factorization, the right part is matched left to right and the
+// left part right to left, which gives linear time with constant memory.
+// Mismatches of the last byte of the window skip ahead like in Horspool.
+
+typedef struct {
+    const u8 *needle;
+    size_t length;
+    size_t split;
+    size_t period;
+    size_t memory;
+    size_t shift[256];
+} search_two_way;
+
+static size_t _two_way_maximal_suffix(const u8 *needle, size_t length,
+                                      bool reversed, size_t *period) {
+    size_t suffix = (size_t)-1;
+    size_t j = 0;
+    size_t k = 1;
+    *period = 1;
+    while (j + k < length) {
+        u8 const a = needle[suffix + k];
+        u8 const b = needle[j + k];
+        if (a == b) {
+            if (k == *period) {
+                j += *period;
+                k = 1;
+            } else {
+                ++k;
+            }
+        } else if (reversed ? a < b : a > b) {
+            j += k;
+            k = 1;
+            *period = j - suffix;
+        } else {
+            suffix = j++;
+            k = *period = 1;
+        }
+    }
+    return suffix;
+}
+
+static void _two_way_init(search_two_way *const tw, const u8 *needle,
+                          size_t length) {
+    tw->needle = needle;
+    tw->length = length;
+
+    memset(tw->shift, 0, sizeof(tw->shift));
+    for (size_t i = 0; i < length; ++i) {
+        tw->shift[needle[i]] = i + 1;
+    }
+
+    size_t period;
+    size_t reversed_period;
+    size_t const split =
+        _two_way_maximal_suffix(needle, length, false, &period);
+    size_t const reversed_split =
+        _two_way_maximal_suffix(needle, length, true, &reversed_period);
+    if (reversed_split + 1 > split + 1) {
+        tw->split = reversed_split;
+        tw->period = reversed_period;
+    } else {
+        tw->split = split;
+        tw->period = period;
+    }
+
+    if (memcmp(needle, needle + tw->period, tw->split + 1)) {
+        tw->memory = 0;
+        tw->period = SEARCH_MAX(tw->split, length - tw->split - 1) + 1;
+    } else {
+        tw->memory = length - tw->period;
+    }
+}
+
+// matches that do not start at a multiple of dtype bytes from `haystack` are
+// stepped over like after any other match, keeping the memory of the matched
+// prefix, so every byte is still compared a bounded number of times
+static const u8 *_two_way_search(search_two_way const *const tw,
+                                 const u8 *const haystack, const u8 *const end,
+                                 size_t const dtype) {
+    const u8 *const needle = tw->needle;
+    size_t const length = tw->length;
+    size_t memory = 0;
+
+    for (const u8 *window = haystack; (size_t)(end - window) >= length;) {
+        size_t const shift = length - tw->shift[window[length - 1]];
+        if (shift) {
+            window += shift;
+            memory = 0;
+            continue;
+        }
+
+        size_t k = SEARCH_MAX(tw->split + 1, memory);
+        for (; k < length and needle[k] == window[k]; ++k) {
+        }
+        if (k < length) {
+            window += k - tw->split;
+            memory = 0;
+            continue;
+        }
+
+        for (k = tw->split + 1; k > memory and needle[k - 1] == window[k - 1];
+             --k) {
+        }
+        if (k <= memory and (size_t)(window - haystack) % dtype == 0) {
+            return window;
+        }
+        window += tw->period;
+        memory = tw->memory;
+    }
+    return NULL;
+}
+
+const void *search_bytes(const void *first1, const void *last1,
+                         const void *first2, const void *last2,
+                         int64_t dtype) {
+    PROFILE_RANGE(search_bytes, first1, last1, dtype);
+    assert(dtype > 0);
+
+    const u8 *const haystack = first1;
+    const u8 *const end = last1;
+    const u8 *const needle = first2;
+    size_t const size = PTR_DIFFERENCE_BYTES(last1, first1);
+    size_t const length = PTR_DIFFERENCE_BYTES(last2, first2);
+
+    if (not length) {
+        return first1;
+    }
+    if (length > size) {
+        return last1;
+    }
+
+    if (length <= SEARCH_SHORT_PATTERN) {
+        const u8 *const found =
+            _search_short(haystack, size, needle, length, dtype);
+        return found ? found : last1;
+    }
+
+    search_two_way tw;
+    _two_way_init(&tw, needle, length);
+
+    const u8 *const found = _two_way_search(&tw, haystack, end, dtype);
+    return found ? found : last1;
+}
+
+// bitwise equality scans
+//
+// Vector kernels compare bytes and fold the byte mask into an element mask:
+// after and-ing the mask with itself shifted by 1, 2, ... dtype / 2 bits the
+// lowest bit of every element lane is set only if all of its bytes matched.
+
+static bool _lanes_supported(size_t dtype, size_t width) {
+    return dtype <= width and not(dtype & (dtype - 1));
+}
+
+static u32 _lanes_first_bits(size_t dtype, size_t width) {
+    u32 lanes = 0;
+    for (size_t i = 0; i < width; i += dtype) {
+        lanes |= (u32)1 << i;
+    }
+    return lanes;
+}
+
+static u32 _lanes_all_equal(u32 mask, size_t dtype, u32 lanes) {
+    for (size_t shift = 1; shift < dtype; shift <<= 1) {
+        mask &= mask >> shift;
+    }
+    return mask & lanes;
+}
+
+static const u8 *_find_value_scalar(const u8 *first, const u8 *last,
+                                    size_t dtype, const u8 *value) {
+    for (; (size_t)(last - first) >= dtype; first += dtype) {
+        if (not memcmp(first, value, dtype)) {
+            return first;
+        }
+    }
+    return last;
+}
+
+static size_t _mismatch_bytes_scalar(const u8 *lhs, const u8 *rhs,
+                                     size_t from, size_t size) {
+    for (; from + sizeof(u64) <= size; from += sizeof(u64)) {
+        u64 a;
+        u64 b;
+        memcpy(&a, lhs + from, sizeof(a));
+        memcpy(&b, rhs + from, sizeof(b));
+        if (a != b) {
+            break;
+        }
+    }
+    for (; from < size and lhs[from] == rhs[from]; ++from) {
+    }
+    return from;
+}
+
+static const u8 *_adjacent_find_eq_scalar(const u8 *first, const u8 *last,
+                                          size_t dtype) {
+    for (; (size_t)(last - first) > dtype; first += dtype) {
+        if (not memcmp(first, first + dtype, dtype)) {
+            return first;
+        }
+    }
+    return last;
+}
+
+#ifdef ALGORITHMS_X86
+
+#define DEFINE_EQUALITY_SIMD(isa, Vector, width, loadu, cmpeq, movemask)      \
+    __attribute__((target(#isa))) static const u8 *_find_value_##isa(         \
+        const u8 *first, const u8 *last, size_t dtype, const u8 *value) {     \
+        u8 pattern[width];                                                    \
+        for (size_t i = 0; i < width; ++i) {                                  \
+            pattern[i] = value[i % dtype];                                    \
+        }                                                                     \
+        Vector const needle = loadu((Vector const *)pattern);                 \
+        u32 const lanes = _lanes_first_bits(dtype, width);                    \
+        for (; last - first >= width; first += width) {                       \
+            u32 const mask = _lanes_all_equal(                                \
+                (u32)movemask(cmpeq(loadu((Vector const *)first), needle)),   \
+                dtype, lanes);                                                \
+            if (mask) {                                                       \
+                return first + __builtin_ctz(mask);                           \
+            }                                                                 \
+        }                                                                     \
+        return _find_value_scalar(first, last, dtype, value);                 \
+    }                                                                         \
+                                                                              \
+    __attribute__((target(#isa))) static size_t _mismatch_bytes_##isa(        \
+        const u8 *lhs, const u8 *rhs, size_t size) {                          \
+        u32 const full = (u32)(((u64)1 << width) - 1);                        \
+        size_t i = 0;                                                         \
+        for (; i + width <= size; i += width) {                               \
+            u32 const mask = (u32)movemask(cmpeq(                             \
+                loadu((Vector const *)(lhs + i)),                             \
+                loadu((Vector const *)(rhs + i))));                           \
+            if (mask != full) {                                               \
+                return i + __builtin_ctz(~mask);                              \
+            }                                                                 \
+        }                                                                     \
+        return _mismatch_bytes_scalar(lhs, rhs, i, size);                     \
+    }                                                                         \
+                                                                              \
+    __attribute__((target(#isa))) static const u8 *_adjacent_find_eq_##isa(   \
+        const u8 *first, const u8 *last, size_t dtype) {                      \
+        u32 const lanes = _lanes_first_bits(dtype, width);                    \
+        for (; (size_t)(last - first) >= width + dtype; first += width) {     \
+            u32 const mask = _lanes_all_equal(                                \
+                (u32)movemask(cmpeq(loadu((Vector const *)first),             \
+                                    loadu((Vector const *)(first + dtype)))), \
+                dtype, lanes);                                                \
+            if (mask) {                                                       \
+                return first + __builtin_ctz(mask);                           \
+            }                                                                 \
+        }                                                                     \
+        return _adjacent_find_eq_scalar(first, last, dtype);                  \
+    }
+
+DEFINE_EQUALITY_SIMD(sse2, __m128i, 16, _mm_loadu_si128, _mm_cmpeq_epi8,
+                     _mm_movemask_epi8)
+
+DEFINE_EQUALITY_SIMD(avx2, __m256i, 32, _mm256_loadu_si256,
+                     _mm256_cmpeq_epi8, _mm256_movemask_epi8)
+
+#endif  // ALGORITHMS_X86
+
+const void *find_value(const void *first, const void *const last,
+                       int64_t dtype, const void *const value) {
+    PROFILE_RANGE(find_value, first, last, dtype);
+    assert(dtype > 0);
+
+    if (dtype == 1) {
+        const void *const found = memchr(first, *(const u8 *)value,
+                                         PTR_DIFFERENCE_BYTES(last, first));
+        return found ? found : last;
+    }
+
+#ifdef ALGORITHMS_X86
+    if (__builtin_cpu_supports("avx2") and _lanes_supported(dtype, 32)) {
+        return _find_value_avx2(first, last, dtype, value);
+    }
+    if (_lanes_supported(dtype, 16)) {
+        return _find_value_sse2(first, last, dtype, value);
+    }
+#endif
+    return _find_value_scalar(first, last, dtype, value);
+}
+
+Pair mismatch_bytes(const void *first1, const void *const last1,
+                    const void *first2, const void *const last2,
+                    int64_t dtype) {
+    PROFILE_RANGE(mismatch_bytes, first1, last1, dtype);
+    assert(dtype > 0);
+
+    size_t const size1 = PTR_DIFFERENCE_BYTES(last1, first1) / dtype;
+    size_t const size2 = PTR_DIFFERENCE_BYTES(last2, first2) / dtype;
+    size_t const size = (size1 < size2 ? size1 : size2) * dtype;
+
+#ifdef ALGORITHMS_X86
+    size_t const byte = __builtin_cpu_supports("avx2")
+                            ? _mismatch_bytes_avx2(first1, first2, size)
+                            : _mismatch_bytes_sse2(first1, first2, size);
+#else
+    size_t const byte = _mismatch_bytes_scalar(first1, first2, 0, size);
+#endif
+    size_t const offset = byte / dtype * dtype;
+    return (Pair){(char *)first1 + offset, (char *)first2 + offset};
+}
+
+const void *adjacent_find_eq(const void *first, const void *last,
+                             size_t dtype) {
+    PROFILE_RANGE(adjacent_find_eq, first, last, dtype);
+    assert(dtype > 0);
+
+#ifdef ALGORITHMS_X86
+    if (__builtin_cpu_supports("avx2") and _lanes_supported(dtype, 32)) {
+        return _adjacent_find_eq_avx2(first, last, dtype);
+    }
+    if (_lanes_supported(dtype, 16)) {
+        return _adjacent_find_eq_sse2(first, last, dtype);
+    }
+#endif
+    return _adjacent_find_eq_scalar(first, last, dtype);
+}
+
+// stream compaction
+//
+// The predicate is evaluated for a block of up to COMPACT_BLOCK elements into
+// a bit mask, the kept elements of the block are then moved at once. Writes
+// never pass the end of the block being read, so the compaction works in
+// place as long as the destination does not run ahead of the source.
+
+#define COMPACT_BLOCK 64
+
+static u64 _compact_mask(const char *src, size_t count, size_t dtype,
+                         UnaryPredicate p) {
+    u64 mask = 0;
+    for (size_t i = 0; i < count; ++i, src += dtype) {
+        mask |= (u64)(p(src) ? 1 : 0) << i;
+    }
+    return mask;
+}
+
+// one memmove per run of consecutive set bits
+static char *_compact_runs(char *dest, const char *src, size_t dtype,
+                           u64 mask) {
+    while (mask) {
+        unsigned const begin = __builtin_ctzll(mask);
+        u64 const rest = ~(mask >> begin);
+        unsigned const length =
+            rest ? (unsigned)__builtin_ctzll(rest) : 64 - begin;
+        memmove(dest, src + begin * dtype, length * dtype);
+        dest += length * dtype;
+        mask = begin + length < 64 ? mask & (~(u64)0 << (begin + length)) : 0;
+    }
+    return dest;
+}
+
+#ifdef ALGORITHMS_X86
+
+// indices of the set bits of a nibble packed one per byte
+static const u32 _compact_nibble[16] = {
+    0x00000000, 0x00000000, 0x00000001, 0x00000100,
+    0x00000002, 0x00000200, 0x00000201, 0x00020100,
+    0x00000003, 0x00000300, 0x00000301, 0x00030100,
+    0x00000302, 0x00030200, 0x00030201, 0x03020100,
+};
+
+// left-packs 8 lanes of 4 bytes per step, the masked store writes only the
+// kept lanes so the destination needs no slack
+__attribute__((target("avx2"))) static char *_compact_avx2_4(char *dest,
+                                                             const char *src,
+                                                             u64 mask,
+                                                             size_t count) {
+    __m256i const lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        unsigned const bits = (mask >> i) & 0xff;
+        unsigned const low = __builtin_popcount(bits & 0xf);
+        unsigned const kept = __builtin_popcount(bits);
+        u64 const indices =
+            _compact_nibble[bits & 0xf] |
+            (u64)(_compact_nibble[bits >> 4] + 0x04040404u) << (8 * low);
+        __m256i const permute =
+            _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const *)&indices));
+        __m256i const values = _mm256_permutevar8x32_epi32(
+            _mm256_loadu_si256((__m256i const *)(src + i * 4)), permute);
+        _mm256_maskstore_epi32(
+            (int *)dest, _mm256_cmpgt_epi32(_mm256_set1_epi32(kept), lanes),
+            values);
+        dest += kept * 4;
+    }
+    return _compact_runs(dest, src + i * 4, 4, i < 64 ? mask >> i : 0);
+}
+
+// left-packs 4 lanes of 8 bytes per step, every lane index is expanded into
+// the pair of 4 byte lanes it covers
+__attribute__((target("avx2"))) static char *_compact_avx2_8(char *dest,
+                                                             const char *src,
+                                                             u64 mask,
+                                                             size_t count) {
+    __m256i const lanes = _mm256_setr_epi64x(0, 1, 2, 3);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        unsigned const bits = (mask >> i) & 0xf;
+        unsigned const kept = __builtin_popcount(bits);
+        u64 const packed = _compact_nibble[bits];
+        u64 const spread = (packed & 0xff) | (packed & 0xff00) << 8 |
+                           (packed & 0xff0000) << 16 |
+                           (packed & 0xff000000) << 24;
+        u64 const indices =
+            spread << 1 | spread << 9 | (u64)0x0100010001000100;
+        __m256i const permute =
+            _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const *)&indices));
+        __m256i const values = _mm256_permutevar8x32_epi32(
+            _mm256_loadu_si256((__m256i const *)(src + i * 8)), permute);
+        _mm256_maskstore_epi64(
+            (long long *)dest,
+            _mm256_cmpgt_epi64(_mm256_set1_epi64x(kept), lanes), values);
+        dest += kept * 8;
+    }
+    return _compact_runs(dest, src + i * 8, 8, i < 64 ? mask >> i : 0);
+}
+
+#endif  // ALGORITHMS_X86
+
+static char *_compact_block(char *dest, const char *src, size_t dtype,
+                            u64 mask, size_t count) {
+    u64 const full = count < 64 ? ((u64)1 << count) - 1 : ~(u64)0;
+    if (mask == full) {
+        memmove(dest, src, count * dtype);
+        return dest + count * dtype;
+    }
+    if (not mask) {
+        return dest;
+    }
+#ifdef ALGORITHMS_X86
+    if (dtype == 4 and __builtin_cpu_supports("avx2")) {
+        return _compact_avx2_4(dest, src, mask, count);
+    }
+    if (dtype == 8 and __builtin_cpu_supports("avx2")) {
+        return _compact_avx2_8(dest, src, mask, count);
+    }
+#endif
+    return _compact_runs(dest, src, dtype, mask);
+}
+
+// moves the elements for which p returns `keep` to dest and, if `rejected` is
+// not NULL, the other ones to *rejected
+static char *_compact(const char *first, const char *last, size_t dtype,
+                      UnaryPredicate p, bool keep, char *dest,
+                      char **rejected) {
+    assert(dtype > 0);
+
+    size_t const size = PTR_DIFFERENCE_BYTES(last, first) / dtype;
+    for (size_t i = 0; i < size; i += COMPACT_BLOCK) {
+        size_t const count =
+            size - i < COMPACT_BLOCK ? size - i : COMPACT_BLOCK;
+        u64 const full = count < 64 ? ((u64)1 << count) - 1 : ~(u64)0;
+        const char *const block = first + i * dtype;
+        u64 mask = _compact_mask(block, count, dtype, p);
+        if (not keep) {
+            mask = ~mask & full;
+        }
+        if (rejected) {
+            *rejected =
+                _compact_block(*rejected, block, dtype, ~mask & full, count);
+        }
+        dest = _compact_block(dest, block, dtype, mask, count);
+    }
+    return dest;
+}
+
+void *filter(void *first, const void *const last, size_t dtype,
+             UnaryPredicate p) {
+    PROFILE_RANGE(filter, first, last, dtype);
+    return _compact(first, last, dtype, p, false, first, NULL);
+}
+
+void *remove_if(void *first, const void *const last, size_t dtype,
+                UnaryPredicate p) {
+    PROFILE_RANGE(remove_if, first, last, dtype);
+    return _compact(first, last, dtype, p, false, first, NULL);
+}
+
+void *copy_if(const void *first, const void *const last, size_t dtype,
+              void *dest, UnaryPredicate p) {
+    PROFILE_RANGE(copy_if, first, last, dtype);
+    return _compact(first, last, dtype, p, true, dest, NULL);
+}
+
+void *partition(void *first, void *last, size_t dtype, UnaryPredicate p) {
+    PROFILE_RANGE(partition, first, last, dtype);
+    assert(dtype > 0);
+
+    char *lo = first;
+    char *hi = last;
+    for (;;) {
+        while (lo != hi and p(lo)) {
+            lo += dtype;
+        }
+        if (lo == hi) {
+            return lo;
+        }
+        do {
+            hi -= dtype;
+        } while (lo != hi and not p(hi));
+        if (lo == hi) {
+            return lo;
+        }
+        memswap(lo, hi, dtype);
+        lo += dtype;
+    }
+}
+
+void *stable_partition(void *first, void *last, size_t dtype,
+                       UnaryPredicate p) {
+    PROFILE_RANGE(stable_partition, first, last, dtype);
+    assert(dtype > 0);
+
+    size_t const bytes = PTR_DIFFERENCE_BYTES(last, first);
+    if (not bytes) {
+        return first;
+    }
+    char *const buffer = malloc(bytes);
+    assert(buffer);
+
+    char *rejected = buffer;
+    char *const middle = _compact(first, last, dtype, p, true, first,
+                                  &rejected);
+    memcpy(middle, buffer, rejected - buffer);
+    free(buffer);
+    return middle;
+}
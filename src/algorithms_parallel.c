@@ -0,0 +1,414 @@
+#include <algorithms_parallel.h>
+//
+#include <profile.h>
+#include <stdatomic.h>
+
+/**
+ * Amount of elements a find worker scans between checks of the shared result.
+ */
+#define PARALLEL_CANCEL_CHECK 1024
+
+/**
+ * Ranges shorter than this are sorted on the calling thread.
+ */
+#define PARALLEL_SORT_THRESHOLD (1 << 16)
+
+/**
+ * Buckets per thread and samples per bucket used by sort_par.
+ */
+#define PARALLEL_SORT_BUCKETS_PER_THREAD 4
+#define PARALLEL_SORT_OVERSAMPLING 32
+
+static size_t _chunk_elements(size_t dtype) {
+    return dtype < PARALLEL_CHUNK_BYTES ? PARALLEL_CHUNK_BYTES / dtype : 1;
+}
+
+static size_t _chunk_count(size_t size, size_t chunk) {
+    return (size + chunk - 1) / chunk;
+}
+
+static thread_pool *_pool_or_default(thread_pool *pool) {
+    return pool ? pool : thread_pool_default();
+}
+
+// reduce
+
+typedef struct {
+    const char *first;
+    size_t size;
+    size_t dtype;
+    size_t chunk;
+    BinaryLApplicator op;
+    const void *identity;
+    char *partials;
+} reduce_par_task;
+
+static void _reduce_par_chunk(void *ctx, size_t index) {
+    reduce_par_task const *const task = ctx;
+    size_t const begin = index * task->chunk;
+    size_t const end = begin + task->chunk < task->size ? begin + task->chunk
+                                                        : task->size;
+    void *const partial = task->partials + index * task->dtype;
+
+    memcpy(partial, task->identity, task->dtype);
+    reduce(task->first + begin * task->dtype, task->first + end * task->dtype,
+           task->dtype, partial, task->op);
+}
+
+void reduce_par(const void *first, const void *const last, int64_t dtype,
+                void *const accum, BinaryLApplicator op,
+                BinaryLApplicator combine, const void *const identity,
+                thread_pool *pool) {
+    PROFILE_RANGE(reduce_par, first, last, dtype);
+    assert(dtype > 0);
+
+    size_t const size = PTR_DIFFERENCE_BYTES(last, first) / dtype;
+    size_t const chunk = _chunk_elements(dtype);
+    size_t const chunks = _chunk_count(size, chunk);
+    if (chunks <= 1) {
+        reduce(first, last, dtype, accum, op);
+        return;
+    }
+
+    reduce_par_task task = {
+        .first = first,
+        .size = size,
+        .dtype = dtype,
+        .chunk = chunk,
+        .op = op,
+        .identity = identity,
+        .partials = malloc(chunks * dtype),
+    };
+    assert(task.partials);
+
+    thread_pool_run(_pool_or_default(pool), chunks, &_reduce_par_chunk, &task);
+
+    for (size_t i = 0; i < chunks; ++i) {
+        combine(accum, task.partials + i * dtype);
+    }
+    free(task.partials);
+}
+
+// count
+
+typedef struct {
+    const char *first;
+    size_t size;
+    size_t dtype;
+    size_t chunk;
+    UnaryClosure p;
+    atomic_size_t result;
+} count_par_task;
+
+static void _count_par_chunk(void *ctx, size_t index) {
+    count_par_task *const task = ctx;
+    size_t const begin = index * task->chunk;
+    size_t const end = begin + task->chunk < task->size ? begin + task->chunk
+                                                        : task->size;
+    size_t const partial =
+        count_ctx(task->first + begin * task->dtype,
+                  task->first + end * task->dtype, task->dtype, task->p);
+
+    atomic_fetch_add_explicit(&task->result, partial, memory_order_relaxed);
+}
+
+size_t count_par(const void *first, const void *const last, size_t dtype,
+                 UnaryClosure p, thread_pool *pool) {
+    PROFILE_RANGE(count_par, first, last, dtype);
+    size_t const size = PTR_DIFFERENCE_BYTES(last, first) / dtype;
+    size_t const chunk = _chunk_elements(dtype);
+    count_par_task task = {
+        .first = first,
+        .size = size,
+        .dtype = dtype,
+        .chunk = chunk,
+        .p = p,
+    };
+    atomic_init(&task.result, 0);
+
+    thread_pool_run(_pool_or_default(pool), _chunk_count(size, chunk),
+                    &_count_par_chunk, &task);
+
+    return atomic_load(&task.result);
+}
+
+// find, any, all
+
+typedef struct {
+    const char *first;
+    size_t size;
+    size_t dtype;
+    size_t chunk;
+    UnaryClosure p;
+    atomic_size_t found;
+} find_par_task;
+
+static void _find_par_publish(find_par_task *const task, size_t index) {
+    size_t current = atomic_load_explicit(&task->found, memory_order_relaxed);
+    while (index < current and
+           not atomic_compare_exchange_weak_explicit(
+               &task->found, &current, index, memory_order_relaxed,
+               memory_order_relaxed)) {
+    }
+}
+
+static void _find_par_chunk(void *ctx, size_t index) {
+    find_par_task *const task = ctx;
+    size_t const begin = index * task->chunk;
+    size_t const end = begin + task->chunk < task->size ? begin + task->chunk
+                                                        : task->size;
+
+    for (size_t i = begin; i < end; ++i) {
+        if ((i - begin) % PARALLEL_CANCEL_CHECK == 0 and
+            atomic_load_explicit(&task->found, memory_order_relaxed) < begin) {
+            return;
+        }
+        if (unary_closure_call(&task->p, task->first + i * task->dtype)) {
+            _find_par_publish(task, i);
+            return;
+        }
+    }
+}
+
+const void *find_par(const void *first, const void *const last, int64_t dtype,
+                     UnaryClosure p, thread_pool *pool) {
+    PROFILE_RANGE(find_par, first, last, dtype);
+    assert(dtype > 0);
+
+    size_t const size = PTR_DIFFERENCE_BYTES(last, first) / dtype;
+    size_t const chunk = _chunk_elements(dtype);
+    find_par_task task = {
+        .first = first,
+        .size = size,
+        .dtype = dtype,
+        .chunk = chunk,
+        .p = p,
+    };
+    atomic_init(&task.found, size);
+
+    thread_pool_run(_pool_or_default(pool), _chunk_count(size, chunk),
+                    &_find_par_chunk, &task);
+
+    size_t const found = atomic_load(&task.found);
+    return found == size ? last : (const char *)first + found * dtype;
+}
+
+bool any_par(const void *first, const void *const last, size_t dtype,
+             UnaryClosure p, thread_pool *pool) {
+    return find_par(first, last, dtype, p, pool) != last;
+}
+
+bool all_par(const void *first, const void *const last, size_t dtype,
+             UnaryClosure p, thread_pool *pool) {
+    return find_par(first, last, dtype, unary_closure_not(p), pool) == last;
+}
+
+// transform
+
+typedef struct {
+    const char *source;
+    size_t source_dtype;
+    char *dest;
+    size_t dest_dtype;
+    size_t size;
+    size_t chunk;
+    UnaryOperatorCtx op;
+    void *ctx;
+} transform_par_task;
+
+static void _transform_par_chunk(void *ctx, size_t index) {
+    transform_par_task const *const task = ctx;
+    size_t const begin = index * task->chunk;
+    size_t const end = begin + task->chunk < task->size ? begin + task->chunk
+                                                        : task->size;
+
+    for (size_t i = begin; i < end; ++i) {
+        task->op(task->dest + i * task->dest_dtype,
+                 task->source + i * task->source_dtype, task->ctx);
+    }
+}
+
+void transform_par(const void *source_first, const void *const source_last,
+                   int64_t source_dtype, void *dest_first,
+                   const void *const dest_last, int64_t dest_dtype,
+                   UnaryOperatorCtx op, void *ctx, thread_pool *pool) {
+    PROFILE_RANGE(transform_par, source_first, source_last, source_dtype);
+    assert(source_dtype > 0 and dest_dtype > 0);
+
+    size_t const source_size =
+        PTR_DIFFERENCE_BYTES(source_last, source_first) / source_dtype;
+    size_t const dest_size =
+        PTR_DIFFERENCE_BYTES(dest_last, dest_first) / dest_dtype;
+    size_t const dtype =
+        source_dtype > dest_dtype ? source_dtype : dest_dtype;
+    transform_par_task task = {
+        .source = source_first,
+        .source_dtype = source_dtype,
+        .dest = dest_first,
+        .dest_dtype = dest_dtype,
+        .size = source_size < dest_size ? source_size : dest_size,
+        .chunk = _chunk_elements(dtype),
+        .op = op,
+        .ctx = ctx,
+    };
+
+    thread_pool_run(_pool_or_default(pool), _chunk_count(task.size, task.chunk),
+                    &_transform_par_chunk, &task);
+}
+
+// sort
+
+typedef struct {
+    char *first;
+    size_t size;
+    size_t dtype;
+    BinaryPredicate less;
+    char *splitters;
+    size_t buckets;
+    size_t slots;
+    bool equal_slots;
+    size_t blocks;
+    u32 *bucket_of;
+    size_t *offsets;
+    size_t *bucket_begin;
+    char *buffer;
+} sort_par_task;
+
+static size_t _sort_par_block_begin(sort_par_task const *const task,
+                                    size_t block) {
+    return block * task->size / task->blocks;
+}
+
+// Elements are distributed into slots: slot 2 * i holds the values between
+// splitter i - 1 and splitter i, slot 2 * i + 1 the values equal to splitter
+// i. Equal slots are only filled when the sample holds repeated splitters,
+// then every heavy key gets a slot of its own which needs no sorting, instead
+// of all of its copies landing in a single bucket sorted by a single worker.
+static u32 _sort_par_bucket(sort_par_task const *const task,
+                            const void *const value) {
+    size_t low = 0;
+    size_t high = task->buckets - 1;
+    while (low < high) {
+        size_t const mid = (low + high) / 2;
+        if (task->less(task->splitters + mid * task->dtype, value)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    bool const equal =
+        task->equal_slots and low < task->buckets - 1 and
+        not task->less(value, task->splitters + low * task->dtype);
+    return 2 * low + equal;
+}
+
+static void _sort_par_classify(void *ctx, size_t block) {
+    sort_par_task *const task = ctx;
+    size_t *const counts = task->offsets + block * task->slots;
+    size_t const end = _sort_par_block_begin(task, block + 1);
+
+    for (size_t i = _sort_par_block_begin(task, block); i < end; ++i) {
+        u32 const bucket =
+            _sort_par_bucket(task, task->first + i * task->dtype);
+        task->bucket_of[i] = bucket;
+        ++counts[bucket];
+    }
+}
+
+static void _sort_par_scatter(void *ctx, size_t block) {
+    sort_par_task *const task = ctx;
+    size_t *const offsets = task->offsets + block * task->slots;
+    size_t const end = _sort_par_block_begin(task, block + 1);
+
+    for (size_t i = _sort_par_block_begin(task, block); i < end; ++i) {
+        memcpy(task->buffer + offsets[task->bucket_of[i]]++ * task->dtype,
+               task->first + i * task->dtype, task->dtype);
+    }
+}
+
+static void _sort_par_bucket_sort(void *ctx, size_t slot) {
+    sort_par_task *const task = ctx;
+    size_t const begin = task->bucket_begin[slot] * task->dtype;
+    size_t const end = task->bucket_begin[slot + 1] * task->dtype;
+
+    if (slot % 2 == 0) {
+        sort(task->buffer + begin, task->buffer + end, task->dtype,
+             task->less);
+    }
+    memcpy(task->first + begin, task->buffer + begin, end - begin);
+}
+
+void sort_par(void *first, void *last, int64_t dtype, BinaryPredicate less,
+              thread_pool *pool) {
+    PROFILE_RANGE(sort_par, first, last, dtype);
+    assert(dtype > 0);
+
+    pool = _pool_or_default(pool);
+    size_t const threads = thread_pool_size(pool);
+    size_t const size = PTR_DIFFERENCE_BYTES(last, first) / dtype;
+    if (threads == 1 or size < PARALLEL_SORT_THRESHOLD) {
+        sort(first, last, dtype, less);
+        return;
+    }
+
+    size_t const buckets = threads * PARALLEL_SORT_BUCKETS_PER_THREAD;
+    size_t const slots = 2 * buckets - 1;
+    size_t const samples = buckets * PARALLEL_SORT_OVERSAMPLING;
+    sort_par_task task = {
+        .first = first,
+        .size = size,
+        .dtype = dtype,
+        .less = less,
+        .splitters = malloc(samples * dtype),
+        .buckets = buckets,
+        .slots = slots,
+        .blocks = buckets,
+        .bucket_of = malloc(size * sizeof(u32)),
+        .offsets = calloc(buckets * slots, sizeof(size_t)),
+        .bucket_begin = malloc((slots + 1) * sizeof(size_t)),
+        .buffer = malloc(size * dtype),
+    };
+    assert(task.splitters and task.bucket_of and task.offsets and
+           task.bucket_begin and task.buffer);
+
+    // evenly spaced sample, every PARALLEL_SORT_OVERSAMPLING-th element of it
+    // becomes a splitter
+    for (size_t i = 0; i < samples; ++i) {
+        memcpy(task.splitters + i * dtype,
+               task.first + (i * size / samples) * dtype, dtype);
+    }
+    sort(task.splitters, task.splitters + samples * dtype, dtype, less);
+    for (size_t i = 1; i < buckets; ++i) {
+        memcpy(task.splitters + (i - 1) * dtype,
+               task.splitters + i * PARALLEL_SORT_OVERSAMPLING * dtype, dtype);
+    }
+    for (size_t i = 1; i + 1 < buckets and not task.equal_slots; ++i) {
+        task.equal_slots = not less(task.splitters + (i - 1) * dtype,
+                                    task.splitters + i * dtype);
+    }
+
+    thread_pool_run(pool, task.blocks, &_sort_par_classify, &task);
+
+    // turn per block counts into scatter offsets, slots are laid out one
+    // after another and inside of a slot blocks keep their order
+    size_t offset = 0;
+    for (size_t slot = 0; slot < slots; ++slot) {
+        task.bucket_begin[slot] = offset;
+        for (size_t block = 0; block < task.blocks; ++block) {
+            size_t *const count = task.offsets + block * slots + slot;
+            size_t const value = *count;
+            *count = offset;
+            offset += value;
+        }
+    }
+    task.bucket_begin[slots] = offset;
+
+    thread_pool_run(pool, task.blocks, &_sort_par_scatter, &task);
+    thread_pool_run(pool, slots, &_sort_par_bucket_sort, &task);
+
+    free(task.splitters);
+    free(task.bucket_of);
+    free(task.offsets);
+    free(task.bucket_begin);
+    free(task.buffer);
+}
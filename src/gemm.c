@@ -0,0 +1,780 @@
+#include <gemm.h>
+//
+#include <assert.h>
+#include <iso646.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GEMM_X86
+#include <immintrin.h>
+#endif
+
+// blocking parameters, MC and NC are multiples of every microkernel tile
+
+#define GEMM_MC 120
+#define GEMM_KC 256
+#define GEMM_NC 2048
+#define GEMM_MAX_MR 8
+#define GEMM_MAX_NR 16
+#define GEMM_ALIGNMENT 64
+
+#define GEMM_ROUND_UP(value, step) (((value) + (step)-1) / (step) * (step))
+
+// Packing buffers are kept per thread and only grow, so repeated calls of
+// similar sizes do not allocate. They are freed when the thread exits.
+
+typedef struct {
+    void *data;
+    size_t size;
+} gemm_scratch;
+
+typedef struct {
+    gemm_scratch a;
+    gemm_scratch b;
+} gemm_buffers;
+
+static pthread_key_t _gemm_buffers_key;
+static pthread_once_t _gemm_buffers_once = PTHREAD_ONCE_INIT;
+
+static void _gemm_buffers_free(void *ptr) {
+    gemm_buffers *const buffers = ptr;
+    free(buffers->a.data);
+    free(buffers->b.data);
+    free(buffers);
+}
+
+static void _gemm_buffers_init() {
+    pthread_key_create(&_gemm_buffers_key, &_gemm_buffers_free);
+}
+
+static gemm_buffers *_gemm_buffers() {
+    pthread_once(&_gemm_buffers_once, &_gemm_buffers_init);
+    gemm_buffers *buffers = pthread_getspecific(_gemm_buffers_key);
+    if (not buffers) {
+        buffers = calloc(1, sizeof(gemm_buffers));
+        assert(buffers);
+        pthread_setspecific(_gemm_buffers_key, buffers);
+    }
+    return buffers;
+}
+
+static void *_gemm_reserve(gemm_scratch *const scratch, size_t const size) {
+    if (scratch->size < size) {
+        free(scratch->data);
+        scratch->data = aligned_alloc(GEMM_ALIGNMENT, size);
+        assert(scratch->data);
+        scratch->size = size;
+    }
+    return scratch->data;
+}
+
+// -1 until the first call of gemm_detect_isa, which stores the detected one
+static atomic_int _gemm_cpu_isa = -1;
+static atomic_int _gemm_forced_isa = -1;
+
+gemm_isa gemm_detect_isa() {
+    int isa = atomic_load_explicit(&_gemm_forced_isa, memory_order_relaxed);
+    if (isa >= 0) {
+        return (gemm_isa)isa;
+    }
+    isa = atomic_load_explicit(&_gemm_cpu_isa, memory_order_relaxed);
+    if (isa >= 0) {
+        return (gemm_isa)isa;
+    }
+#ifdef GEMM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512vnni") and
+        __builtin_cpu_supports("avx512bw") and
+        __builtin_cpu_supports("avx2") and __builtin_cpu_supports("fma")) {
+        isa = GEMM_ISA_AVX512_VNNI;
+    } else if (__builtin_cpu_supports("avx2") and
+               __builtin_cpu_supports("fma")) {
+        isa = GEMM_ISA_AVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        isa = GEMM_ISA_SSE2;
+    } else {
+        isa = GEMM_ISA_SCALAR;
+    }
+#else
+    isa = GEMM_ISA_SCALAR;
+#endif
+    atomic_store_explicit(&_gemm_cpu_isa, isa, memory_order_relaxed);
+    return (gemm_isa)isa;
+}
+
+void gemm_force_isa(gemm_isa isa) {
+    atomic_store_explicit(&_gemm_forced_isa, -1, memory_order_relaxed);
+    gemm_isa const detected = gemm_detect_isa();
+    assert(isa <= detected);
+    atomic_store_explicit(&_gemm_forced_isa, isa == detected ? -1 : (int)isa,
+                          memory_order_relaxed);
+}
+
+// microkernels
+//
+// Every microkernel computes `c += a * b` for a single mr x nr tile, where `a`
+// is a packed panel of mr rows and `b` is a packed panel of nr columns, both
+// `kc` long.
+
+#define DEFINE_GEMM_SCALAR_KERNEL(Type)                                \
+    static void _gemm_kernel_##Type##_scalar(size_t kc, Type const *a, \
+                                             Type const *b, Type *c,   \
+                                             size_t ldc) {             \
+        Type acc[4][4] = {{0}};                                        \
+        for (size_t p = 0; p < kc; ++p, a += 4, b += 4) {              \
+            for (size_t i = 0; i < 4; ++i) {                           \
+                for (size_t j = 0; j < 4; ++j) {                       \
+                    acc[i][j] += a[i] * b[j];                          \
+                }                                                      \
+            }                                                          \
+        }                                                              \
+        for (size_t i = 0; i < 4; ++i) {                               \
+            for (size_t j = 0; j < 4; ++j) {                           \
+                c[i * ldc + j] += acc[i][j];                           \
+            }                                                          \
+        }                                                              \
+    }
+
+DEFINE_GEMM_SCALAR_KERNEL(f32)
+DEFINE_GEMM_SCALAR_KERNEL(f64)
+
+#ifdef GEMM_X86
+
+#define GEMM_SSE2_F32_ROW(i)                            \
+    a_i = _mm_set1_ps(a[i]);                            \
+    c##i##0 = _mm_add_ps(c##i##0, _mm_mul_ps(a_i, b0)); \
+    c##i##1 = _mm_add_ps(c##i##1, _mm_mul_ps(a_i, b1));
+
+#define GEMM_SSE2_F32_STORE(i)                                     \
+    _mm_storeu_ps(c + i * ldc,                                     \
+                  _mm_add_ps(_mm_loadu_ps(c + i * ldc), c##i##0)); \
+    _mm_storeu_ps(c + i * ldc + 4,                                 \
+                  _mm_add_ps(_mm_loadu_ps(c + i * ldc + 4), c##i##1));
+
+__attribute__((target("sse2"))) static void _gemm_kernel_f32_sse2(
+    size_t kc, f32 const *a, f32 const *b, f32 *c, size_t ldc) {
+    __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps();
+    __m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+    __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps();
+    __m128 c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+    for (size_t p = 0; p < kc; ++p, a += 4, b += 8) {
+        __m128 const b0 = _mm_loadu_ps(b);
+        __m128 const b1 = _mm_loadu_ps(b + 4);
+        __m128 a_i;
+        GEMM_SSE2_F32_ROW(0)
+        GEMM_SSE2_F32_ROW(1)
+        GEMM_SSE2_F32_ROW(2)
+        GEMM_SSE2_F32_ROW(3)
+    }
+    GEMM_SSE2_F32_STORE(0)
+    GEMM_SSE2_F32_STORE(1)
+    GEMM_SSE2_F32_STORE(2)
+    GEMM_SSE2_F32_STORE(3)
+}
+
+#define GEMM_SSE2_F64_ROW(i)                            \
+    a_i = _mm_set1_pd(a[i]);                            \
+    c##i##0 = _mm_add_pd(c##i##0, _mm_mul_pd(a_i, b0)); \
+    c##i##1 = _mm_add_pd(c##i##1, _mm_mul_pd(a_i, b1));
+
+#define GEMM_SSE2_F64_STORE(i)                                     \
+    _mm_storeu_pd(c + i * ldc,                                     \
+                  _mm_add_pd(_mm_loadu_pd(c + i * ldc), c##i##0)); \
+    _mm_storeu_pd(c + i * ldc + 2,                                 \
+                  _mm_add_pd(_mm_loadu_pd(c + i * ldc + 2), c##i##1));
+
+__attribute__((target("sse2"))) static void _gemm_kernel_f64_sse2(
+    size_t kc, f64 const *a, f64 const *b, f64 *c, size_t ldc) {
+    __m128d c00 = _mm_setzero_pd(), c01 = _mm_setzero_pd();
+    __m128d c10 = _mm_setzero_pd(), c11 = _mm_setzero_pd();
+    __m128d c20 = _mm_setzero_pd(), c21 = _mm_setzero_pd();
+    __m128d c30 = _mm_setzero_pd(), c31 = _mm_setzero_pd();
+    for (size_t p = 0; p < kc; ++p, a += 4, b += 4) {
+        __m128d const b0 = _mm_loadu_pd(b);
+        __m128d const b1 = _mm_loadu_pd(b + 2);
+        __m128d a_i;
+        GEMM_SSE2_F64_ROW(0)
+        GEMM_SSE2_F64_ROW(1)
+        GEMM_SSE2_F64_ROW(2)
+        GEMM_SSE2_F64_ROW(3)
+    }
+    GEMM_SSE2_F64_STORE(0)
+    GEMM_SSE2_F64_STORE(1)
+    GEMM_SSE2_F64_STORE(2)
+    GEMM_SSE2_F64_STORE(3)
+}
+
+#define GEMM_AVX2_F32_ROW(i)                     \
+    a_i = _mm256_broadcast_ss(a + i);            \
+    c##i##0 = _mm256_fmadd_ps(a_i, b0, c##i##0); \
+    c##i##1 = _mm256_fmadd_ps(a_i, b1, c##i##1);
+
+#define GEMM_AVX2_F32_STORE(i)                                              \
+    _mm256_storeu_ps(c + i * ldc,                                           \
+                     _mm256_add_ps(_mm256_loadu_ps(c + i * ldc), c##i##0)); \
+    _mm256_storeu_ps(                                                       \
+        c + i * ldc + 8,                                                    \
+        _mm256_add_ps(_mm256_loadu_ps(c + i * ldc + 8), c##i##1));
+
+__attribute__((target("avx2,fma"))) static void _gemm_kernel_f32_avx2(
+    size_t kc, f32 const *a, f32 const *b, f32 *c, size_t ldc) {
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    for (size_t p = 0; p < kc; ++p, a += 6, b += 16) {
+        __m256 const b0 = _mm256_loadu_ps(b);
+        __m256 const b1 = _mm256_loadu_ps(b + 8);
+        __m256 a_i;
+        GEMM_AVX2_F32_ROW(0)
+        GEMM_AVX2_F32_ROW(1)
+        GEMM_AVX2_F32_ROW(2)
+        GEMM_AVX2_F32_ROW(3)
+        GEMM_AVX2_F32_ROW(4)
+        GEMM_AVX2_F32_ROW(5)
+    }
+    GEMM_AVX2_F32_STORE(0)
+    GEMM_AVX2_F32_STORE(1)
+    GEMM_AVX2_F32_STORE(2)
+    GEMM_AVX2_F32_STORE(3)
+    GEMM_AVX2_F32_STORE(4)
+    GEMM_AVX2_F32_STORE(5)
+}
+
+#define GEMM_AVX2_F64_ROW(i)                     \
+    a_i = _mm256_broadcast_sd(a + i);            \
+    c##i##0 = _mm256_fmadd_pd(a_i, b0, c##i##0); \
+    c##i##1 = _mm256_fmadd_pd(a_i, b1, c##i##1);
+
+#define GEMM_AVX2_F64_STORE(i)                                              \
+    _mm256_storeu_pd(c + i * ldc,                                           \
+                     _mm256_add_pd(_mm256_loadu_pd(c + i * ldc), c##i##0)); \
+    _mm256_storeu_pd(                                                       \
+        c + i * ldc + 4,                                                    \
+        _mm256_add_pd(_mm256_loadu_pd(c + i * ldc + 4), c##i##1));
+
+__attribute__((target("avx2,fma"))) static void _gemm_kernel_f64_avx2(
+    size_t kc, f64 const *a, f64 const *b, f64 *c, size_t ldc) {
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+    for (size_t p = 0; p < kc; ++p, a += 6, b += 8) {
+        __m256d const b0 = _mm256_loadu_pd(b);
+        __m256d const b1 = _mm256_loadu_pd(b + 4);
+        __m256d a_i;
+        GEMM_AVX2_F64_ROW(0)
+        GEMM_AVX2_F64_ROW(1)
+        GEMM_AVX2_F64_ROW(2)
+        GEMM_AVX2_F64_ROW(3)
+        GEMM_AVX2_F64_ROW(4)
+        GEMM_AVX2_F64_ROW(5)
+    }
+    GEMM_AVX2_F64_STORE(0)
+    GEMM_AVX2_F64_STORE(1)
+    GEMM_AVX2_F64_STORE(2)
+    GEMM_AVX2_F64_STORE(3)
+    GEMM_AVX2_F64_STORE(4)
+    GEMM_AVX2_F64_STORE(5)
+}
+
+#define GEMM_SIMD_KERNEL(Type, isa) &_gemm_kernel_##Type##_##isa
+#else
+#define GEMM_SIMD_KERNEL(Type, isa) &_gemm_kernel_##Type##_scalar
+#endif  // GEMM_X86
+
+// blocked driver
+
+#define DEFINE_GEMM(Type, avx2_mr, avx2_nr, sse2_mr, sse2_nr)                  \
+    typedef struct {                                                           \
+        size_t mr;                                                             \
+        size_t nr;                                                             \
+        void (*kernel)(size_t, Type const *, Type const *, Type *, size_t);    \
+    } gemm_microkernel_##Type;                                                 \
+                                                                               \
+    static gemm_microkernel_##Type _gemm_select_##Type() {                     \
+        switch (gemm_detect_isa()) {                                           \
+            case GEMM_ISA_AVX512_VNNI:                                         \
+            case GEMM_ISA_AVX2:                                                \
+                return (gemm_microkernel_##Type){                              \
+                    avx2_mr, avx2_nr, GEMM_SIMD_KERNEL(Type, avx2)};           \
+            case GEMM_ISA_SSE2:                                                \
+                return (gemm_microkernel_##Type){                              \
+                    sse2_mr, sse2_nr, GEMM_SIMD_KERNEL(Type, sse2)};           \
+            default:                                                           \
+                return (gemm_microkernel_##Type){                              \
+                    4, 4, &_gemm_kernel_##Type##_scalar};                      \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _gemm_pack_a_##Type(size_t mc, size_t kc, Type alpha,          \
+                                    Type const *a, size_t lda, size_t mr,      \
+                                    Type *dest) {                              \
+        for (size_t i = 0; i < mc; i += mr) {                                  \
+            size_t const rows = MIN(mr, mc - i);                               \
+            for (size_t p = 0; p < kc; ++p) {                                  \
+                for (size_t r = 0; r < rows; ++r) {                            \
+                    *dest++ = alpha * a[(i + r) * lda + p];                    \
+                }                                                              \
+                for (size_t r = rows; r < mr; ++r) {                           \
+                    *dest++ = 0;                                               \
+                }                                                              \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _gemm_pack_b_##Type(size_t kc, size_t nc, Type const *b,       \
+                                    size_t ldb, size_t nr, Type *dest) {       \
+        for (size_t j = 0; j < nc; j += nr) {                                  \
+            size_t const cols = MIN(nr, nc - j);                               \
+            for (size_t p = 0; p < kc; ++p) {                                  \
+                Type const *const row = b + p * ldb + j;                       \
+                for (size_t col = 0; col < cols; ++col) {                      \
+                    *dest++ = row[col];                                        \
+                }                                                              \
+                for (size_t col = cols; col < nr; ++col) {                     \
+                    *dest++ = 0;                                               \
+                }                                                              \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _gemm_macro_kernel_##Type(                                     \
+        size_t mc, size_t nc, size_t kc, Type const *ap, Type const *bp,       \
+        Type *c, size_t ldc, gemm_microkernel_##Type const *uk) {              \
+        Type edge[GEMM_MAX_MR * GEMM_MAX_NR];                                  \
+        for (size_t j = 0; j < nc; j += uk->nr) {                              \
+            size_t const cols = MIN(uk->nr, nc - j);                           \
+            for (size_t i = 0; i < mc; i += uk->mr) {                          \
+                size_t const rows = MIN(uk->mr, mc - i);                       \
+                Type *const tile = c + i * ldc + j;                            \
+                if (rows == uk->mr and cols == uk->nr) {                       \
+                    uk->kernel(kc, ap + i * kc, bp + j * kc, tile, ldc);       \
+                    continue;                                                  \
+                }                                                              \
+                memset(edge, 0, sizeof(edge));                                 \
+                uk->kernel(kc, ap + i * kc, bp + j * kc, edge, uk->nr);        \
+                for (size_t r = 0; r < rows; ++r) {                            \
+                    for (size_t col = 0; col < cols; ++col) {                  \
+                        tile[r * ldc + col] += edge[r * uk->nr + col];         \
+                    }                                                          \
+                }                                                              \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    void gemm_##Type(size_t m, size_t n, size_t k, Type alpha, Type const *a,  \
+                     size_t lda, Type const *b, size_t ldb, Type *c,           \
+                     size_t ldc) {                                             \
+        if (not m or not n or not k) {                                         \
+            return;                                                            \
+        }                                                                      \
+                                                                               \
+        gemm_microkernel_##Type const uk = _gemm_select_##Type();              \
+        size_t const kc_max = MIN(k, GEMM_KC);                                 \
+        size_t const ap_size = GEMM_ROUND_UP(                                  \
+            GEMM_ROUND_UP(MIN(m, GEMM_MC), uk.mr) * kc_max *                   \
+                sizeof(Type),                                                  \
+            GEMM_ALIGNMENT);                                                   \
+        size_t const bp_size = GEMM_ROUND_UP(                                  \
+            GEMM_ROUND_UP(MIN(n, GEMM_NC), uk.nr) * kc_max *                   \
+                sizeof(Type),                                                  \
+            GEMM_ALIGNMENT);                                                   \
+        gemm_buffers *const buffers = _gemm_buffers();                         \
+        Type *const ap = _gemm_reserve(&buffers->a, ap_size);                  \
+        Type *const bp = _gemm_reserve(&buffers->b, bp_size);                  \
+                                                                               \
+        for (size_t jc = 0; jc < n; jc += GEMM_NC) {                           \
+            size_t const nc = MIN(GEMM_NC, n - jc);                            \
+            for (size_t pc = 0; pc < k; pc += GEMM_KC) {                       \
+                size_t const kc = MIN(GEMM_KC, k - pc);                        \
+                _gemm_pack_b_##Type(kc, nc, b + pc * ldb + jc, ldb, uk.nr,     \
+                                    bp);                                       \
+                for (size_t ic = 0; ic < m; ic += GEMM_MC) {                   \
+                    size_t const mc = MIN(GEMM_MC, m - ic);                    \
+                    _gemm_pack_a_##Type(mc, kc, alpha, a + ic * lda + pc, lda, \
+                                        uk.mr, ap);                            \
+                    _gemm_macro_kernel_##Type(mc, nc, kc, ap, bp,              \
+                                              c + ic * ldc + jc, ldc, &uk);    \
+                }                                                              \
+            }                                                                  \
+        }                                                                      \
+    }
+
+DEFINE_GEMM(f32, 6, 16, 4, 8)
+DEFINE_GEMM(f64, 6, 8, 4, 4)
+
+// 8 bit integer gemm
+//
+// Packed panels group k by 4: a panel of A stores the 4 consecutive values of
+// each of its mr rows next to each other, a panel of B the 4 values of each of
+// its nr columns, so one 32 bit lane of a vector holds 4 products to sum. A is
+// packed as u8 and B as i8, which is what pmaddubsw and vpdpbusd multiply.
+// Short k is padded with zeros, which add nothing to the products and sums.
+
+#define GEMM_Q8_MAX_MR 6
+#define GEMM_Q8_MAX_NR 32
+#define GEMM_Q8_FLIP 0x80
+
+typedef void (*gemm_q8_kernel)(size_t, u8 const *, i8 const *, i32 *, size_t);
+
+static void _gemm_kernel_q8_scalar(size_t kq, u8 const *a, i8 const *b,
+                                   i32 *c, size_t ldc) {
+    i32 acc[4][4] = {{0}};
+    for (size_t p = 0; p < kq; ++p, a += 16, b += 16) {
+        for (size_t i = 0; i < 4; ++i) {
+            for (size_t j = 0; j < 4; ++j) {
+                for (size_t q = 0; q < 4; ++q) {
+                    acc[i][j] += a[i * 4 + q] * b[j * 4 + q];
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        for (size_t j = 0; j < 4; ++j) {
+            c[i * ldc + j] = (i32)((u32)c[i * ldc + j] + (u32)acc[i][j]);
+        }
+    }
+}
+
+#ifdef GEMM_X86
+
+static inline i32 _gemm_load_i32(void const *const ptr) {
+    i32 value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+#define GEMM_AVX2_Q8_DOT(a, b, weights)                    \
+    _mm256_madd_epi16(_mm256_maddubs_epi16(a, b), weights)
+
+#define GEMM_AVX2_Q8_ROW(i)                                               \
+    a_i = _mm256_set1_epi32(_gemm_load_i32(a + 4 * i));                   \
+    c##i##0 = _mm256_add_epi32(c##i##0, GEMM_AVX2_Q8_DOT(a_i, b0, ones)); \
+    c##i##1 = _mm256_add_epi32(c##i##1, GEMM_AVX2_Q8_DOT(a_i, b1, ones));
+
+// b = 2 * hi + lo, each half keeps pairs of products within 16 bits
+#define GEMM_AVX2_Q8_SPLIT_ROW(i)                                         \
+    a_i = _mm256_set1_epi32(_gemm_load_i32(a + 4 * i));                   \
+    c##i##0 = _mm256_add_epi32(c##i##0, GEMM_AVX2_Q8_DOT(a_i, h0, twos)); \
+    c##i##0 = _mm256_add_epi32(c##i##0, GEMM_AVX2_Q8_DOT(a_i, l0, ones)); \
+    c##i##1 = _mm256_add_epi32(c##i##1, GEMM_AVX2_Q8_DOT(a_i, h1, twos)); \
+    c##i##1 = _mm256_add_epi32(c##i##1, GEMM_AVX2_Q8_DOT(a_i, l1, ones));
+
+#define GEMM_AVX2_Q8_STORE(i)                                              \
+    _mm256_storeu_si256(                                                   \
+        (__m256i *)(c + i * ldc),                                          \
+        _mm256_add_epi32(_mm256_loadu_si256((__m256i *)(c + i * ldc)),     \
+                         c##i##0));                                        \
+    _mm256_storeu_si256(                                                   \
+        (__m256i *)(c + i * ldc + 8),                                      \
+        _mm256_add_epi32(_mm256_loadu_si256((__m256i *)(c + i * ldc + 8)), \
+                         c##i##1));
+
+#define GEMM_AVX2_Q8_ZERO                                          \
+    __m256i const ones = _mm256_set1_epi16(1);                     \
+    __m256i c00 = _mm256_setzero_si256(), c01 = c00, c10 = c00;    \
+    __m256i c11 = c00, c20 = c00, c21 = c00, c30 = c00, c31 = c00;
+
+#define GEMM_AVX2_Q8_STORE_ALL \
+    GEMM_AVX2_Q8_STORE(0)      \
+    GEMM_AVX2_Q8_STORE(1)      \
+    GEMM_AVX2_Q8_STORE(2)      \
+    GEMM_AVX2_Q8_STORE(3)
+
+__attribute__((target("avx2"))) static void _gemm_kernel_q8_avx2(
+    size_t kq, u8 const *a, i8 const *b, i32 *c, size_t ldc) {
+    GEMM_AVX2_Q8_ZERO
+    for (size_t p = 0; p < kq; ++p, a += 16, b += 64) {
+        __m256i const b0 = _mm256_loadu_si256((__m256i const *)b);
+        __m256i const b1 = _mm256_loadu_si256((__m256i const *)(b + 32));
+        __m256i a_i;
+        GEMM_AVX2_Q8_ROW(0)
+        GEMM_AVX2_Q8_ROW(1)
+        GEMM_AVX2_Q8_ROW(2)
+        GEMM_AVX2_Q8_ROW(3)
+    }
+    GEMM_AVX2_Q8_STORE_ALL
+}
+
+__attribute__((target("avx2"))) static void _gemm_kernel_q8_avx2_split(
+    size_t kq, u8 const *a, i8 const *b, i32 *c, size_t ldc) {
+    GEMM_AVX2_Q8_ZERO
+    __m256i const twos = _mm256_set1_epi16(2);
+    for (size_t p = 0; p < kq; ++p, a += 16, b += 128) {
+        __m256i const h0 = _mm256_loadu_si256((__m256i const *)b);
+        __m256i const h1 = _mm256_loadu_si256((__m256i const *)(b + 32));
+        __m256i const l0 = _mm256_loadu_si256((__m256i const *)(b + 64));
+        __m256i const l1 = _mm256_loadu_si256((__m256i const *)(b + 96));
+        __m256i a_i;
+        GEMM_AVX2_Q8_SPLIT_ROW(0)
+        GEMM_AVX2_Q8_SPLIT_ROW(1)
+        GEMM_AVX2_Q8_SPLIT_ROW(2)
+        GEMM_AVX2_Q8_SPLIT_ROW(3)
+    }
+    GEMM_AVX2_Q8_STORE_ALL
+}
+
+#define GEMM_VNNI_Q8_ROW(i)                             \
+    a_i = _mm512_set1_epi32(_gemm_load_i32(a + 4 * i)); \
+    c##i##0 = _mm512_dpbusd_epi32(c##i##0, a_i, b0);    \
+    c##i##1 = _mm512_dpbusd_epi32(c##i##1, a_i, b1);
+
+#define GEMM_VNNI_Q8_STORE(i)                                             \
+    _mm512_storeu_si512(                                                  \
+        c + i * ldc,                                                      \
+        _mm512_add_epi32(_mm512_loadu_si512(c + i * ldc), c##i##0));      \
+    _mm512_storeu_si512(                                                  \
+        c + i * ldc + 16,                                                 \
+        _mm512_add_epi32(_mm512_loadu_si512(c + i * ldc + 16), c##i##1));
+
+// 6 rows, gcc only allocates zmm0 to zmm15 for vpdpbusd
+__attribute__((target("avx512f,avx512bw,avx512vnni"))) static void
+_gemm_kernel_q8_vnni(size_t kq, u8 const *a, i8 const *b, i32 *c, size_t ldc) {
+    __m512i c00 = _mm512_setzero_si512(), c01 = c00, c10 = c00, c11 = c00;
+    __m512i c20 = c00, c21 = c00, c30 = c00, c31 = c00, c40 = c00, c41 = c00;
+    __m512i c50 = c00, c51 = c00;
+    for (size_t p = 0; p < kq; ++p, a += 24, b += 128) {
+        __m512i const b0 = _mm512_loadu_si512(b);
+        __m512i const b1 = _mm512_loadu_si512(b + 64);
+        __m512i a_i;
+        GEMM_VNNI_Q8_ROW(0)
+        GEMM_VNNI_Q8_ROW(1)
+        GEMM_VNNI_Q8_ROW(2)
+        GEMM_VNNI_Q8_ROW(3)
+        GEMM_VNNI_Q8_ROW(4)
+        GEMM_VNNI_Q8_ROW(5)
+    }
+    GEMM_VNNI_Q8_STORE(0)
+    GEMM_VNNI_Q8_STORE(1)
+    GEMM_VNNI_Q8_STORE(2)
+    GEMM_VNNI_Q8_STORE(3)
+    GEMM_VNNI_Q8_STORE(4)
+    GEMM_VNNI_Q8_STORE(5)
+}
+
+#endif  // GEMM_X86
+
+// `split` is set for kernels that need blocks of B with values outside of 7
+// bits packed as halves, NULL if every value is fine
+typedef struct {
+    size_t mr;
+    size_t nr;
+    gemm_q8_kernel kernel;
+    gemm_q8_kernel split;
+} gemm_q8_microkernel;
+
+static gemm_q8_microkernel _gemm_select_q8() {
+    switch (gemm_detect_isa()) {
+#ifdef GEMM_X86
+        case GEMM_ISA_AVX512_VNNI:
+            return (gemm_q8_microkernel){6, 32, &_gemm_kernel_q8_vnni, NULL};
+        case GEMM_ISA_AVX2:
+            return (gemm_q8_microkernel){4, 16, &_gemm_kernel_q8_avx2,
+                                         &_gemm_kernel_q8_avx2_split};
+#endif
+        default:
+            return (gemm_q8_microkernel){4, 4, &_gemm_kernel_q8_scalar, NULL};
+    }
+}
+
+// packs rows [0, mc) and k [0, kc) of `a`, `sums` receives the sum of every
+// packed row
+static void _gemm_pack_a_q8(size_t mc, size_t kc, u8 const *a, size_t lda,
+                            u8 flip, size_t mr, u8 *dest, i32 *sums) {
+    size_t const kq = GEMM_ROUND_UP(kc, 4) / 4;
+    u32 const flips = flip * 0x01010101u;
+    for (size_t i = 0; i < mc; i += mr, dest += kq * mr * 4) {
+        size_t const rows = MIN(mr, mc - i);
+        memset(dest, 0, kq * mr * 4);
+        for (size_t r = 0; r < rows; ++r) {
+            u8 const *const row = a + (i + r) * lda;
+            for (size_t p = 0; p < kc / 4; ++p) {
+                u32 group;
+                memcpy(&group, row + p * 4, sizeof(group));
+                group ^= flips;
+                memcpy(dest + (p * mr + r) * 4, &group, sizeof(group));
+            }
+            for (size_t p = kc / 4 * 4; p < kc; ++p) {
+                dest[(p / 4 * mr + r) * 4 + p % 4] = row[p] ^ flip;
+            }
+            i32 sum = 0;
+            for (size_t p = 0; p < kc; ++p) {
+                sum += (u8)(row[p] ^ flip);
+            }
+            sums[i + r] = sum;
+        }
+    }
+}
+
+// whether a block of `b` holds values pmaddubsw could saturate on
+static bool _gemm_q8_wide(size_t kc, size_t nc, u8 const *b, size_t ldb,
+                          u8 flip) {
+    u8 wide = 0;
+    for (size_t p = 0; p < kc; ++p) {
+        for (size_t j = 0; j < nc; ++j) {
+            // outside of [-64, 64) exactly when the top two bits differ
+            u8 const value = b[p * ldb + j] ^ flip;
+            wide |= (value ^ (value << 1)) & 0x80;
+        }
+    }
+    return wide;
+}
+
+// packs k [0, kc) and columns [0, nc) of `b`, `sums` receives the sum of
+// every packed column. Split panels store the halves hi = b >> 1 and
+// lo = b & 1 of every group of 4 one after the other
+static void _gemm_pack_b_q8(size_t kc, size_t nc, u8 const *b, size_t ldb,
+                            u8 flip, size_t nr, bool split, i8 *dest,
+                            i32 *sums) {
+    size_t const group = nr * 4 * (split ? 2 : 1);
+    size_t const panel = GEMM_ROUND_UP(kc, 4) / 4 * group;
+    memset(sums, 0, nc * sizeof(i32));
+    for (size_t p = 0; p < kc; ++p) {
+        u8 const *const row = b + p * ldb;
+        for (size_t j = 0; j < nc; ++j) {
+            sums[j] += (i8)(row[j] ^ flip);
+        }
+    }
+    for (size_t j = 0; j < nc; j += nr, dest += panel) {
+        size_t const cols = MIN(nr, nc - j);
+        memset(dest, 0, panel);
+        for (size_t p = 0; p < kc; p += 4) {
+            size_t const depth = MIN(4, kc - p);
+            u32 *const hi = (u32 *)(dest + p / 4 * group);
+            u32 *const lo = hi + nr;
+            for (size_t col = 0; col < cols; ++col) {
+                u32 values = 0;
+                for (size_t q = 0; q < depth; ++q) {
+                    values |= (u32)(u8)(b[(p + q) * ldb + j + col] ^ flip)
+                              << q * 8;
+                }
+                if (split) {
+                    // arithmetic shift of every byte
+                    hi[col] =
+                        (values >> 1 & 0x7f7f7f7fu) | (values & 0x80808080u);
+                    lo[col] = values & 0x01010101u;
+                } else {
+                    hi[col] = values;
+                }
+            }
+        }
+    }
+}
+
+// adds `fix_rows[r] + fix_cols[col]` to every element of a tile, which is
+// where the zero points come in
+static void _gemm_q8_fix(size_t rows, size_t cols, u32 *restrict tile,
+                         size_t ldc, u32 const *restrict fix_rows,
+                         u32 const *restrict fix_cols) {
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t col = 0; col < cols; ++col) {
+            tile[r * ldc + col] += fix_rows[r] + fix_cols[col];
+        }
+    }
+}
+
+// `fix_rows` and `fix_cols` are added to every row and column of the block,
+// NULL when the zero points cancel out
+static void _gemm_macro_kernel_q8(size_t mc, size_t nc, size_t kc,
+                                  u8 const *ap, i8 const *bp, size_t b_panel,
+                                  i32 *c, size_t ldc, gemm_q8_kernel kernel,
+                                  gemm_q8_microkernel const *uk,
+                                  i32 const *fix_rows, i32 const *fix_cols) {
+    i32 edge[GEMM_Q8_MAX_MR * GEMM_Q8_MAX_NR];
+    size_t const kq = GEMM_ROUND_UP(kc, 4) / 4;
+    for (size_t j = 0; j < nc; j += uk->nr) {
+        size_t const cols = MIN(uk->nr, nc - j);
+        for (size_t i = 0; i < mc; i += uk->mr) {
+            size_t const rows = MIN(uk->mr, mc - i);
+            i32 *const tile = c + i * ldc + j;
+            u8 const *const a = ap + i * kq * 4;
+            i8 const *const b = bp + j / uk->nr * b_panel;
+            if (rows == uk->mr and cols == uk->nr) {
+                kernel(kq, a, b, tile, ldc);
+            } else {
+                memset(edge, 0, sizeof(edge));
+                kernel(kq, a, b, edge, uk->nr);
+                for (size_t r = 0; r < rows; ++r) {
+                    for (size_t col = 0; col < cols; ++col) {
+                        tile[r * ldc + col] = (i32)(
+                            (u32)tile[r * ldc + col] +
+                            (u32)edge[r * uk->nr + col]);
+                    }
+                }
+            }
+            if (fix_rows) {
+                _gemm_q8_fix(rows, cols, (u32 *)tile, ldc,
+                             (u32 const *)fix_rows + i,
+                             (u32 const *)fix_cols + j);
+            }
+        }
+    }
+}
+
+void gemm_q8(size_t m, size_t n, size_t k, gemm_q8_operand const *a,
+             gemm_q8_operand const *b, i32 *c, size_t ldc) {
+    if (not m or not n or not k) {
+        return;
+    }
+
+    // a - a.zero_point = a_u - za and b - b.zero_point = b_s - zb for the
+    // packed values, so every block of the product is
+    // sum(a_u * b_s) - zb * sum(a_u) - za * sum(b_s) + kc * za * zb
+    u8 const a_flip = a->is_signed ? GEMM_Q8_FLIP : 0;
+    u8 const b_flip = b->is_signed ? 0 : GEMM_Q8_FLIP;
+    u32 const za = (u32)a->zero_point + (a->is_signed ? 128 : 0);
+    u32 const zb = (u32)b->zero_point - (b->is_signed ? 0 : 128);
+    bool const fix = za or zb;
+
+    gemm_q8_microkernel const uk = _gemm_select_q8();
+    size_t const kc_max = GEMM_ROUND_UP(MIN(k, GEMM_KC), 4);
+    size_t const ap_size = GEMM_ROUND_UP(
+        GEMM_ROUND_UP(MIN(m, GEMM_MC), uk.mr) * kc_max, GEMM_ALIGNMENT);
+    size_t const bp_size = GEMM_ROUND_UP(
+        GEMM_ROUND_UP(MIN(n, GEMM_NC), uk.nr) * kc_max * 2,
+        GEMM_ALIGNMENT);
+    gemm_buffers *const buffers = _gemm_buffers();
+    u8 *const ap = _gemm_reserve(&buffers->a, ap_size);
+    i8 *const bp = _gemm_reserve(&buffers->b, bp_size);
+    i32 a_sums[GEMM_MC];
+    i32 b_sums[GEMM_NC];
+
+    for (size_t jc = 0; jc < n; jc += GEMM_NC) {
+        size_t const nc = MIN(GEMM_NC, n - jc);
+        for (size_t pc = 0; pc < k; pc += GEMM_KC) {
+            size_t const kc = MIN(GEMM_KC, k - pc);
+            u8 const *const b_block = (u8 const *)b->data + pc * b->ld + jc;
+            bool const split =
+                uk.split and _gemm_q8_wide(kc, nc, b_block, b->ld, b_flip);
+            size_t const b_panel =
+                uk.nr * GEMM_ROUND_UP(kc, 4) * (split ? 2 : 1);
+            _gemm_pack_b_q8(kc, nc, b_block, b->ld, b_flip, uk.nr, split, bp,
+                            b_sums);
+            for (size_t col = 0; fix and col < nc; ++col) {
+                b_sums[col] = (i32)(0u - za * (u32)b_sums[col]);
+            }
+            for (size_t ic = 0; ic < m; ic += GEMM_MC) {
+                size_t const mc = MIN(GEMM_MC, m - ic);
+                _gemm_pack_a_q8(mc, kc, (u8 const *)a->data + ic * a->ld + pc,
+                                a->ld, a_flip, uk.mr, ap, a_sums);
+                for (size_t row = 0; fix and row < mc; ++row) {
+                    a_sums[row] =
+                        (i32)((u32)kc * za * zb - zb * (u32)a_sums[row]);
+                }
+                _gemm_macro_kernel_q8(mc, nc, kc, ap, bp, b_panel,
+                                      c + ic * ldc + jc, ldc,
+                                      split ? uk.split : uk.kernel, &uk,
+                                      fix ? a_sums : NULL, b_sums);
+            }
+        }
+    }
+}
@@ -1,4 +1,217 @@
 #include <matrix2.h>
+//
+#include <algorithms.h>
+#include <gemm.h>
+#include <matrix2_macro_helpers.h>
+#include <profile.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MATRIX2_X86
+#include <immintrin.h>
+#endif
+
+FOR_ALL_TYPES(DEFINE_APPLY_ADD)
+FOR_ALL_TYPES(DEFINE_APPLY_MULT)
+FOR_ALL_TYPES(DEFINE_APPLY_DIV)
+FOR_ALL_TYPES(DEFINE_APPLY_EQ)
+
+// bytes of the elements of `m`, the traffic counted by the profiler
+#define M2_BYTES(m) ((m)->rows * (m)->cols * (m)->dtype)
+
+// views
+
+size_t m2_stride(matrix2 const *const m) {
+    return m->stride ? m->stride : m->cols;
+}
+
+static inline char *_m2_at(matrix2 const *const m, size_t const row,
+                           size_t const col) {
+    return (char *)m->data + (row * m2_stride(m) + col) * m->dtype;
+}
+
+matrix2 m2_slice(matrix2 const *const m, size_t const row, size_t const col,
+                 size_t const rows, size_t const cols) {
+    assert(row + rows <= m->rows and col + cols <= m->cols);
+
+    return (matrix2){
+        .rows = rows,
+        .cols = cols,
+        .dtype = m->dtype,
+        .data = _m2_at(m, row, col),
+        .stride = m2_stride(m),
+    };
+}
+
+// allocation
+
+// rows are padded to whole cache lines when the element size allows it, and
+// strides that are multiples of a page get one more line so that the rows of
+// a column do not all map to the same cache set
+size_t m2_padded_stride(size_t const cols, size_t const dtype) {
+    if (M2_ALIGNMENT % dtype) {
+        return cols;
+    }
+    size_t bytes =
+        (cols * dtype + M2_ALIGNMENT - 1) / M2_ALIGNMENT * M2_ALIGNMENT;
+    if (bytes >= M2_PAGE_SIZE and bytes % M2_PAGE_SIZE == 0) {
+        bytes += M2_ALIGNMENT;
+    }
+    return bytes / dtype;
+}
+
+static size_t _m2_padded_bytes(size_t const rows, size_t const stride,
+                               size_t const dtype) {
+    size_t const bytes = rows * stride * dtype;
+    return (bytes + M2_ALIGNMENT - 1) / M2_ALIGNMENT * M2_ALIGNMENT;
+}
+
+matrix2 m2_alloc(size_t const rows, size_t const cols, size_t const dtype) {
+    assert(dtype);
+
+    size_t const stride = m2_padded_stride(cols, dtype);
+    size_t const bytes = _m2_padded_bytes(rows, stride, dtype);
+    return (matrix2){
+        .rows = rows,
+        .cols = cols,
+        .dtype = dtype,
+        .data = aligned_alloc(M2_ALIGNMENT, bytes ? bytes : M2_ALIGNMENT),
+        .stride = stride,
+    };
+}
+
+void m2_free(matrix2 const *const m) {
+    free(m->data);
+}
+
+// The arena hands out memory from a chain of blocks. Blocks past the current
+// one are kept for reuse after m2_arena_release, and m2_arena_reset merges the
+// chain into a single block large enough for everything allocated since the
+// previous reset, so a loop that resets the arena once per iteration stops
+// calling malloc after its first iteration.
+
+typedef struct m2_arena_block {
+    struct m2_arena_block *next;
+    size_t size;
+    size_t used;
+    char *data;
+} m2_arena_block;
+
+struct m2_arena {
+    m2_arena_block *first;
+    m2_arena_block *current;
+};
+
+static m2_arena_block *_m2_arena_block(size_t const size) {
+    m2_arena_block *const block = malloc(sizeof(m2_arena_block));
+    assert(block);
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    block->data = aligned_alloc(M2_ALIGNMENT, size);
+    assert(block->data);
+    return block;
+}
+
+static void _m2_arena_free_chain(m2_arena_block *block) {
+    while (block) {
+        m2_arena_block *const next = block->next;
+        free(block->data);
+        free(block);
+        block = next;
+    }
+}
+
+m2_arena *m2_arena_create(size_t const capacity) {
+    m2_arena *const arena = malloc(sizeof(m2_arena));
+    assert(arena);
+    size_t const size =
+        (capacity + M2_ALIGNMENT - 1) / M2_ALIGNMENT * M2_ALIGNMENT;
+    arena->first = _m2_arena_block(size ? size : M2_ARENA_MIN_BLOCK);
+    arena->current = arena->first;
+    return arena;
+}
+
+void m2_arena_destroy(m2_arena *const arena) {
+    if (not arena) {
+        return;
+    }
+    _m2_arena_free_chain(arena->first);
+    free(arena);
+}
+
+static void *_m2_arena_take(m2_arena *const arena, size_t const bytes) {
+    m2_arena_block *block = arena->current;
+    if (block->size - block->used < bytes) {
+        // skip spare blocks that are too small, they stay in the chain
+        m2_arena_block *prev = block;
+        for (block = block->next; block and block->size < bytes;
+             block = block->next) {
+            prev = block;
+        }
+        if (not block) {
+            size_t size = 2 * arena->current->size;
+            block = _m2_arena_block(size > bytes ? size : bytes);
+            block->next = arena->current->next;
+            arena->current->next = block;
+        } else if (prev != arena->current) {
+            // move the block found right behind the current one
+            prev->next = block->next;
+            block->next = arena->current->next;
+            arena->current->next = block;
+        }
+        block->used = 0;
+        arena->current = block;
+    }
+    void *const ptr = block->data + block->used;
+    block->used += bytes;
+    return ptr;
+}
+
+matrix2 m2_arena_alloc(m2_arena *const arena, size_t const rows,
+                       size_t const cols, size_t const dtype) {
+    assert(arena and dtype);
+
+    size_t const stride = m2_padded_stride(cols, dtype);
+    return (matrix2){
+        .rows = rows,
+        .cols = cols,
+        .dtype = dtype,
+        .data = _m2_arena_take(arena, _m2_padded_bytes(rows, stride, dtype)),
+        .stride = stride,
+    };
+}
+
+void *m2_arena_take(m2_arena *const arena, size_t const bytes) {
+    assert(arena);
+    return _m2_arena_take(arena, (bytes + M2_ALIGNMENT - 1) / M2_ALIGNMENT *
+                                     M2_ALIGNMENT);
+}
+
+m2_arena_mark m2_arena_save(m2_arena const *const arena) {
+    return (m2_arena_mark){
+        .block = arena->current,
+        .used = arena->current->used,
+    };
+}
+
+void m2_arena_release(m2_arena *const arena, m2_arena_mark const mark) {
+    arena->current = mark.block;
+    arena->current->used = mark.used;
+}
+
+void m2_arena_reset(m2_arena *const arena) {
+    if (arena->first->next) {
+        size_t total = 0;
+        for (m2_arena_block *block = arena->first; block;
+             block = block->next) {
+            total += block->size;
+        }
+        _m2_arena_free_chain(arena->first);
+        arena->first = _m2_arena_block(total);
+        arena->current = arena->first;
+    }
+    arena->first->used = 0;
+}
 
 // getters
 
@@ -7,8 +220,8 @@ matrix_segment_view m2_get_row(matrix2 const *const m, size_t const index) {
 
     return (matrix_segment_view){
         .ref = (void *const)m,
-        .begin = index * m->cols,
-        .end = index * m->cols + m->rows,
+        .begin = index * m2_stride(m),
+        .end = index * m2_stride(m) + m->cols,
     };
 }
 
@@ -18,7 +231,7 @@ matrix_segment_view m2_get_column(matrix2 const *const m, size_t const index) {
     return (matrix_segment_view){
         .ref = (void *const)m,
         .begin = index,
-        .end = index + m->cols * (m->rows - 1),
+        .end = index + m2_stride(m) * (m->rows - 1),
     };
 }
 
@@ -32,43 +245,48 @@ void *const m2_get_from_column(matrix_segment_view const *const column,
                                size_t const index) {
     matrix2 *const m = (matrix2 *const)column->ref;
     return (void *)((char *)m->data +
-                    (column->begin + index * m->cols) * m->dtype);
+                    (column->begin + index * m2_stride(m)) * m->dtype);
 }
 
 void *const m2_get_from_matrix(matrix2 const *const m, size_t const column,
                                size_t const row) {
-    return (void *)((char *)m->data + (column + row * m->cols) * m->dtype);
+    return (void *)_m2_at(m, row, column);
 }
 
 // setters
 
 void m2_set_row(matrix2 *const m, size_t const index, void *const data) {
-    memcpy((void *)((char *)m->data + index * m->cols * m->dtype), data,
-           m->cols * m->dtype);
+    memcpy((void *)_m2_at(m, index, 0), data, m->cols * m->dtype);
 }
 
 void m2_set_column(matrix2 *const m, size_t const index, void *const data) {
-    for (size_t i = index, j = 0; i < m->rows * m->cols; i += m->cols, ++j) {
-        memcpy((void *)((char *)m->data + i * m->dtype),
-               (void *)((char *)data + j * m->dtype), m->dtype);
+    for (size_t i = 0; i < m->rows; ++i) {
+        memcpy((void *)_m2_at(m, i, index),
+               (void *)((char *)data + i * m->dtype), m->dtype);
     }
 }
 
 void m2_set_at(matrix2 *const m, size_t const x, size_t const y,
                void *const data) {
-    memcpy(m->data + (x + m->cols * y) * m->dtype, data, m->dtype);
+    memcpy(_m2_at(m, y, x), data, m->dtype);
 }
 
 void m2_set_all(matrix2 *const m, void *const data) {
-    for (size_t i = 0; i < m->cols * m->rows; ++i) {
-        memcpy(m->data + i * m->dtype, data, m->dtype);
+    PROFILE_SCOPE(m2_set_all, m->dtype, m->rows * m->cols, M2_BYTES(m));
+    for (size_t i = 0; i < m->rows; ++i) {
+        char *const row = _m2_at(m, i, 0);
+        for (size_t j = 0; j < m->cols; ++j) {
+            memcpy(row + j * m->dtype, data, m->dtype);
+        }
     }
 }
 
 void m2_set_identity(matrix2 *const m, void *const data) {
     size_t const min_dim = (m->rows < m->cols) ? m->rows : m->cols;
 
-    memset(m->data, 0, m->rows * m->cols * m->dtype);
+    for (size_t i = 0; i < m->rows; ++i) {
+        memset(_m2_at(m, i, 0), 0, m->cols * m->dtype);
+    }
 
     for (size_t i = 0; i < min_dim; ++i) {
         m2_set_at(m, i, i, data);
@@ -77,45 +295,741 @@ void m2_set_identity(matrix2 *const m, void *const data) {
 
 // operations
 
-void m2_mult(matrix2 *const dest, matrix2 const *const lhs,
-             matrix2 const *const rhs, Apply perf) {
-    assert(dest->rows == lhs->rows and dest->cols == rhs->cols and
-           dest->dtype == lhs->dtype and dest->dtype == rhs->dtype);
+// tile of the destination handed to a single worker by the parallel
+// operations, multiple of every gemm microkernel tile
+#define M2_TILE_ROWS 96
+#define M2_TILE_COLS 256
+#define M2_APPLY_CHUNK 16384
+
+// the block of dest is zeroed first unless `accumulate` is set
+static void _m2_mult_block(matrix2 *const dest, matrix2 const *const lhs,
+                           matrix2 const *const rhs, Apply perf,
+                           size_t const row_begin, size_t const row_end,
+                           size_t const col_begin, size_t const col_end,
+                           bool const accumulate) {
+    size_t const dtype = dest->dtype;
+
+    for (size_t i = row_begin; not accumulate and i < row_end; ++i) {
+        memset(_m2_at(dest, i, col_begin), 0, (col_end - col_begin) * dtype);
+    }
 
-    memset(dest->data, 0, dest->rows * dest->cols * dest->dtype);
+    if (perf == &f32_apply_add and dtype == sizeof(f32)) {
+        gemm_f32(row_end - row_begin, col_end - col_begin, lhs->cols, 1,
+                 (f32 const *)_m2_at(lhs, row_begin, 0), m2_stride(lhs),
+                 (f32 const *)_m2_at(rhs, 0, col_begin), m2_stride(rhs),
+                 (f32 *)_m2_at(dest, row_begin, col_begin), m2_stride(dest));
+        return;
+    }
+
+    if (perf == &f64_apply_add and dtype == sizeof(f64)) {
+        gemm_f64(row_end - row_begin, col_end - col_begin, lhs->cols, 1,
+                 (f64 const *)_m2_at(lhs, row_begin, 0), m2_stride(lhs),
+                 (f64 const *)_m2_at(rhs, 0, col_begin), m2_stride(rhs),
+                 (f64 *)_m2_at(dest, row_begin, col_begin), m2_stride(dest));
+        return;
+    }
 
-    for (size_t i = 0; i < dest->rows; ++i) {
-        for (size_t j = 0; j < dest->cols; ++j) {
-            void *const dest_val =
-                (void *const)((char *)dest->data +
-                              (i * dest->cols + j) * dest->dtype);
+    for (size_t i = row_begin; i < row_end; ++i) {
+        for (size_t j = col_begin; j < col_end; ++j) {
+            void *const dest_val = (void *const)_m2_at(dest, i, j);
 
             for (size_t k = 0; k < lhs->cols; ++k) {
-                perf(dest_val,
-                     (void const *const)((char *)lhs->data +
-                                         (i * lhs->cols + k) * dest->dtype),
-                     (void const *const)((char *)rhs->data +
-                                         (k * rhs->cols + j) * dest->dtype));
+                perf(dest_val, (void const *const)_m2_at(lhs, i, k),
+                     (void const *const)_m2_at(rhs, k, j));
             }
         }
     }
 }
 
+// applies to the elements [begin, end) counted row by row, one row segment at
+// a time so every operand may have its own stride
+static void _m2_apply_range(matrix2 *const dest, matrix2 const *const lhs,
+                            matrix2 const *const rhs, Apply apply,
+                            size_t const begin, size_t const end) {
+    size_t const dtype = dest->dtype;
+    size_t const cols = dest->cols;
+
+    for (size_t i = begin; i < end;) {
+        size_t const row = i / cols;
+        size_t const col = i % cols;
+        size_t const stop = (row + 1) * cols < end ? (row + 1) * cols : end;
+        char *d = _m2_at(dest, row, col);
+        char const *l = _m2_at(lhs, row, col);
+        char const *r = _m2_at(rhs, row, col);
+        for (; i < stop; ++i, d += dtype, l += dtype, r += dtype) {
+            apply((void *const)d, (void const *const)l, (void const *const)r);
+        }
+    }
+}
+
+void m2_mult(matrix2 *const dest, matrix2 const *const lhs,
+             matrix2 const *const rhs, Apply perf) {
+    PROFILE_SCOPE(m2_mult, dest->dtype, dest->rows * dest->cols,
+                  M2_BYTES(dest) + M2_BYTES(lhs) + M2_BYTES(rhs));
+    assert(dest->rows == lhs->rows and dest->cols == rhs->cols and
+           dest->dtype == lhs->dtype and dest->dtype == rhs->dtype);
+
+    _m2_mult_block(dest, lhs, rhs, perf, 0, dest->rows, 0, dest->cols,
+                   false);
+}
+
+void m2_mult_add(matrix2 *const dest, matrix2 const *const lhs,
+                 matrix2 const *const rhs, Apply perf) {
+    PROFILE_SCOPE(m2_mult_add, dest->dtype, dest->rows * dest->cols,
+                  M2_BYTES(dest) + M2_BYTES(lhs) + M2_BYTES(rhs));
+    assert(dest->rows == lhs->rows and dest->cols == rhs->cols and
+           dest->dtype == lhs->dtype and dest->dtype == rhs->dtype);
+
+    _m2_mult_block(dest, lhs, rhs, perf, 0, dest->rows, 0, dest->cols, true);
+}
+
 void m2_apply(matrix2 *const dest, matrix2 const *const lhs,
               matrix2 const *const rhs, Apply apply) {
+    PROFILE_SCOPE(m2_apply, dest->dtype, dest->rows * dest->cols,
+                  M2_BYTES(dest) + M2_BYTES(lhs) + M2_BYTES(rhs));
+    assert(dest->rows == lhs->rows and dest->cols == lhs->cols and
+           dest->rows == rhs->rows and dest->cols == rhs->cols and
+           dest->dtype == lhs->dtype and dest->dtype == rhs->dtype);
+
+    _m2_apply_range(dest, lhs, rhs, apply, 0, dest->rows * dest->cols);
+}
+
+// parallel operations
+
+typedef struct {
+    matrix2 *dest;
+    matrix2 const *lhs;
+    matrix2 const *rhs;
+    Apply apply;
+    size_t tiles_per_row;
+} m2_parallel_task;
+
+static void _m2_mult_tile(void *ctx, size_t index) {
+    m2_parallel_task const *const task = ctx;
+    size_t const row = index / task->tiles_per_row * M2_TILE_ROWS;
+    size_t const col = index % task->tiles_per_row * M2_TILE_COLS;
+    size_t const row_end = row + M2_TILE_ROWS < task->dest->rows
+                               ? row + M2_TILE_ROWS
+                               : task->dest->rows;
+    size_t const col_end = col + M2_TILE_COLS < task->dest->cols
+                               ? col + M2_TILE_COLS
+                               : task->dest->cols;
+    _m2_mult_block(task->dest, task->lhs, task->rhs, task->apply, row,
+                   row_end, col, col_end, false);
+}
+
+static void _m2_apply_chunk(void *ctx, size_t index) {
+    m2_parallel_task const *const task = ctx;
+    size_t const size = task->dest->rows * task->dest->cols;
+    size_t const begin = index * M2_APPLY_CHUNK;
+    size_t const end =
+        begin + M2_APPLY_CHUNK < size ? begin + M2_APPLY_CHUNK : size;
+    _m2_apply_range(task->dest, task->lhs, task->rhs, task->apply, begin,
+                    end);
+}
+
+void m2_mult_parallel(matrix2 *const dest, matrix2 const *const lhs,
+                      matrix2 const *const rhs, Apply perf,
+                      thread_pool *const pool) {
+    PROFILE_SCOPE(m2_mult_parallel, dest->dtype, dest->rows * dest->cols,
+                  M2_BYTES(dest) + M2_BYTES(lhs) + M2_BYTES(rhs));
+    assert(dest->rows == lhs->rows and dest->cols == rhs->cols and
+           dest->dtype == lhs->dtype and dest->dtype == rhs->dtype);
+
+    // tiles are numbered row by row, so every worker receives a contiguous
+    // band of tiles sharing the same rows of lhs
+    m2_parallel_task task = {
+        .dest = dest,
+        .lhs = lhs,
+        .rhs = rhs,
+        .apply = perf,
+        .tiles_per_row = (dest->cols + M2_TILE_COLS - 1) / M2_TILE_COLS,
+    };
+    size_t const tile_rows = (dest->rows + M2_TILE_ROWS - 1) / M2_TILE_ROWS;
+
+    thread_pool_run(pool ? pool : thread_pool_default(),
+                    tile_rows * task.tiles_per_row, &_m2_mult_tile, &task);
+}
+
+void m2_apply_parallel(matrix2 *const dest, matrix2 const *const lhs,
+                       matrix2 const *const rhs, Apply apply,
+                       thread_pool *const pool) {
+    PROFILE_SCOPE(m2_apply_parallel, dest->dtype, dest->rows * dest->cols,
+                  M2_BYTES(dest) + M2_BYTES(lhs) + M2_BYTES(rhs));
     assert(dest->rows == lhs->rows and dest->cols == lhs->cols and
            dest->rows == rhs->rows and dest->cols == rhs->cols and
            dest->dtype == lhs->dtype and dest->dtype == rhs->dtype);
 
-    for (size_t i = 0; i < dest->cols * dest->rows; ++i) {
-        apply((void *const)((char *)dest->data + i * dest->dtype),
-              (void const *const)((char *)lhs->data + i * dest->dtype),
-              (void const *const)((char *)rhs->data + i * dest->dtype));
+    m2_parallel_task task = {
+        .dest = dest,
+        .lhs = lhs,
+        .rhs = rhs,
+        .apply = apply,
+    };
+    size_t const size = dest->rows * dest->cols;
+
+    thread_pool_run(pool ? pool : thread_pool_default(),
+                    (size + M2_APPLY_CHUNK - 1) / M2_APPLY_CHUNK,
+                    &_m2_apply_chunk, &task);
+}
+
+// Strassen-Winograd
+
+// The recursion runs on views: every level splits the even part of the
+// operands into quadrants, computes the 7 products with the schedule of
+// Boyer, Dumas, Pernet and Zhou that keeps the partial results in the
+// quadrants of dest, and needs only two operand temporaries and the first
+// product besides them. An odd last row, column or inner index is peeled off
+// and handled by gemm after the even part is done.
+
+typedef void (*M2StrassenGemm)(size_t m, size_t n, size_t k, void const *a,
+                               size_t lda, void const *b, size_t ldb, void *c,
+                               size_t ldc);
+
+// computes `d = a + sign * b` on rows x cols views, `d` may be `a` or `b`
+typedef void (*M2StrassenAdd)(size_t rows, size_t cols, void *d, size_t ldd,
+                              void const *a, size_t lda, void const *b,
+                              size_t ldb, int sign);
+
+typedef struct {
+    size_t dtype;
+    size_t cutoff;
+    m2_arena *arena;
+    M2StrassenGemm gemm;
+    M2StrassenAdd add;
+} m2_strassen;
+
+#define DEFINE_STRASSEN_KERNELS(Type)                                 \
+    static void _m2_strassen_gemm_##Type(                             \
+        size_t m, size_t n, size_t k, void const *a, size_t lda,      \
+        void const *b, size_t ldb, void *c, size_t ldc) {             \
+        gemm_##Type(m, n, k, 1, a, lda, b, ldb, c, ldc);              \
+    }                                                                 \
+                                                                      \
+    static void _m2_strassen_add_##Type(                              \
+        size_t rows, size_t cols, void *d, size_t ldd, void const *a, \
+        size_t lda, void const *b, size_t ldb, int sign) {            \
+        Type const s = sign;                                          \
+        for (size_t i = 0; i < rows; ++i) {                           \
+            Type *const dr = (Type *)d + i * ldd;                     \
+            Type const *const ar = (Type const *)a + i * lda;         \
+            Type const *const br = (Type const *)b + i * ldb;         \
+            for (size_t j = 0; j < cols; ++j) {                       \
+                dr[j] = ar[j] + s * br[j];                            \
+            }                                                         \
+        }                                                             \
+    }
+
+DEFINE_STRASSEN_KERNELS(f32)
+DEFINE_STRASSEN_KERNELS(f64)
+
+static bool _m2_strassen_kernels(m2_strassen *const s, Apply perf,
+                                 size_t const dtype) {
+    if (perf == &f32_apply_add and dtype == sizeof(f32)) {
+        s->gemm = &_m2_strassen_gemm_f32;
+        s->add = &_m2_strassen_add_f32;
+        return true;
+    }
+    if (perf == &f64_apply_add and dtype == sizeof(f64)) {
+        s->gemm = &_m2_strassen_gemm_f64;
+        s->add = &_m2_strassen_add_f64;
+        return true;
+    }
+    return false;
+}
+
+static void _m2_strassen_zero(matrix2 const *const m) {
+    for (size_t i = 0; i < m->rows; ++i) {
+        memset(_m2_at(m, i, 0), 0, m->cols * m->dtype);
+    }
+}
+
+// c = a * b
+static void _m2_strassen_gemm(m2_strassen const *const s,
+                              matrix2 const *const c, matrix2 const *const a,
+                              matrix2 const *const b) {
+    _m2_strassen_zero(c);
+    s->gemm(c->rows, c->cols, a->cols, a->data, m2_stride(a), b->data,
+            m2_stride(b), c->data, m2_stride(c));
+}
+
+// d = a + sign * b
+static void _m2_strassen_add(m2_strassen const *const s,
+                             matrix2 const *const d, matrix2 const *const a,
+                             matrix2 const *const b, int const sign) {
+    s->add(d->rows, d->cols, d->data, m2_stride(d), a->data, m2_stride(a),
+           b->data, m2_stride(b), sign);
+}
+
+static void _m2_strassen_rec(m2_strassen const *const s,
+                             matrix2 const *const c, matrix2 const *const a,
+                             matrix2 const *const b) {
+    size_t const m = a->rows;
+    size_t const k = a->cols;
+    size_t const n = b->cols;
+    if (m <= s->cutoff or k <= s->cutoff or n <= s->cutoff) {
+        _m2_strassen_gemm(s, c, a, b);
+        return;
+    }
+
+    size_t const mh = m / 2;
+    size_t const kh = k / 2;
+    size_t const nh = n / 2;
+
+    matrix2 const a11 = m2_slice(a, 0, 0, mh, kh);
+    matrix2 const a12 = m2_slice(a, 0, kh, mh, kh);
+    matrix2 const a21 = m2_slice(a, mh, 0, mh, kh);
+    matrix2 const a22 = m2_slice(a, mh, kh, mh, kh);
+    matrix2 const b11 = m2_slice(b, 0, 0, kh, nh);
+    matrix2 const b12 = m2_slice(b, 0, nh, kh, nh);
+    matrix2 const b21 = m2_slice(b, kh, 0, kh, nh);
+    matrix2 const b22 = m2_slice(b, kh, nh, kh, nh);
+    matrix2 const c11 = m2_slice(c, 0, 0, mh, nh);
+    matrix2 const c12 = m2_slice(c, 0, nh, mh, nh);
+    matrix2 const c21 = m2_slice(c, mh, 0, mh, nh);
+    matrix2 const c22 = m2_slice(c, mh, nh, mh, nh);
+
+    m2_arena_mark const mark = m2_arena_save(s->arena);
+    matrix2 const x = m2_arena_alloc(s->arena, mh, kh, s->dtype);
+    matrix2 const y = m2_arena_alloc(s->arena, kh, nh, s->dtype);
+    matrix2 const p1 = m2_arena_alloc(s->arena, mh, nh, s->dtype);
+
+    _m2_strassen_add(s, &x, &a11, &a21, -1);   // S3 = A11 - A21
+    _m2_strassen_add(s, &y, &b22, &b12, -1);   // T3 = B22 - B12
+    _m2_strassen_rec(s, &c21, &x, &y);         // P7 = S3 T3
+    _m2_strassen_add(s, &x, &a21, &a22, 1);    // S1 = A21 + A22
+    _m2_strassen_add(s, &y, &b12, &b11, -1);   // T1 = B12 - B11
+    _m2_strassen_rec(s, &c22, &x, &y);         // P5 = S1 T1
+    _m2_strassen_add(s, &x, &x, &a11, -1);     // S2 = S1 - A11
+    _m2_strassen_add(s, &y, &b22, &y, -1);     // T2 = B22 - T1
+    _m2_strassen_rec(s, &c12, &x, &y);         // P6 = S2 T2
+    _m2_strassen_add(s, &x, &a12, &x, -1);     // S4 = A12 - S2
+    _m2_strassen_add(s, &y, &y, &b21, -1);     // T4 = T2 - B21
+    _m2_strassen_rec(s, &c11, &x, &b22);       // P3 = S4 B22
+    _m2_strassen_rec(s, &p1, &a11, &b11);      // P1 = A11 B11
+    _m2_strassen_add(s, &c12, &p1, &c12, 1);   // U2 = P1 + P6
+    _m2_strassen_add(s, &c21, &c12, &c21, 1);  // U3 = U2 + P7
+    _m2_strassen_add(s, &c12, &c12, &c22, 1);  // U4 = U2 + P5
+    _m2_strassen_add(s, &c22, &c21, &c22, 1);  // U7 = U3 + P5
+    _m2_strassen_add(s, &c12, &c12, &c11, 1);  // U5 = U4 + P3
+    _m2_strassen_rec(s, &c11, &a22, &y);       // P4 = A22 T4
+    _m2_strassen_add(s, &c21, &c21, &c11, -1); // U6 = U3 - P4
+    _m2_strassen_rec(s, &c11, &a12, &b21);     // P2 = A12 B21
+    _m2_strassen_add(s, &c11, &p1, &c11, 1);   // U1 = P1 + P2
+
+    m2_arena_release(s->arena, mark);
+
+    // peeling: the odd inner index is a rank 1 update of the even block, the
+    // odd column and row of dest are products with the full inner dimension
+    if (k % 2) {
+        s->gemm(2 * mh, 2 * nh, 1, _m2_at(a, 0, k - 1), m2_stride(a),
+                _m2_at(b, k - 1, 0), m2_stride(b), c->data, m2_stride(c));
+    }
+    if (n % 2) {
+        matrix2 const c_col = m2_slice(c, 0, n - 1, 2 * mh, 1);
+        matrix2 const a_rows = m2_slice(a, 0, 0, 2 * mh, k);
+        matrix2 const b_col = m2_slice(b, 0, n - 1, k, 1);
+        _m2_strassen_gemm(s, &c_col, &a_rows, &b_col);
+    }
+    if (m % 2) {
+        matrix2 const c_row = m2_slice(c, m - 1, 0, 1, n);
+        matrix2 const a_row = m2_slice(a, m - 1, 0, 1, k);
+        _m2_strassen_gemm(s, &c_row, &a_row, b);
+    }
+}
+
+size_t m2_strassen_cutoff(size_t const dtype) {
+    return dtype == sizeof(f32) ? M2_STRASSEN_CUTOFF_F32
+                                : M2_STRASSEN_CUTOFF_F64;
+}
+
+void m2_mult_strassen(matrix2 *const dest, matrix2 const *const lhs,
+                      matrix2 const *const rhs, Apply perf,
+                      size_t const cutoff, m2_arena *const workspace) {
+    PROFILE_SCOPE(m2_mult_strassen, dest->dtype, dest->rows * dest->cols,
+                  M2_BYTES(dest) + M2_BYTES(lhs) + M2_BYTES(rhs));
+    assert(dest->rows == lhs->rows and dest->cols == rhs->cols and
+           lhs->cols == rhs->rows and dest->dtype == lhs->dtype and
+           dest->dtype == rhs->dtype);
+
+    m2_strassen s = {
+        .dtype = dest->dtype,
+        .cutoff = cutoff ? cutoff : m2_strassen_cutoff(dest->dtype),
+        .arena = workspace,
+    };
+    if (not _m2_strassen_kernels(&s, perf, dest->dtype)) {
+        m2_mult(dest, lhs, rhs, perf);
+        return;
+    }
+    if (not workspace) {
+        s.arena = m2_arena_create(0);
+        assert(s.arena);
+    }
+    _m2_strassen_rec(&s, dest, lhs, rhs);
+    if (not workspace) {
+        m2_arena_destroy(s.arena);
+    }
+}
+
+m2_mult_strategy m2_mult_select(matrix2 const *const dest,
+                                matrix2 const *const lhs,
+                                matrix2 const *const rhs, Apply perf) {
+    m2_strassen s;
+    if (not _m2_strassen_kernels(&s, perf, dest->dtype)) {
+        return M2_MULT_CLASSIC;
+    }
+    size_t const cutoff = m2_strassen_cutoff(dest->dtype);
+    return lhs->rows > cutoff and lhs->cols > cutoff and rhs->cols > cutoff
+               ? M2_MULT_STRASSEN
+               : M2_MULT_CLASSIC;
+}
+
+void m2_mult_auto(matrix2 *const dest, matrix2 const *const lhs,
+                  matrix2 const *const rhs, Apply perf,
+                  m2_arena *const workspace) {
+    if (m2_mult_select(dest, lhs, rhs, perf) == M2_MULT_STRASSEN) {
+        m2_mult_strassen(dest, lhs, rhs, perf, 0, workspace);
+    } else {
+        m2_mult(dest, lhs, rhs, perf);
     }
 }
 
+// transposition
+//
+// Both versions split the larger dimension in half until a block is small
+// enough that its source and destination rows stay in L1 and in the TLB,
+// which keeps the reads and the writes cache friendly on every level without
+// tuning. Blocks are then walked in tiles transposed in registers: 8x8 (AVX2)
+// or 4x4 (SSE2) for 4 byte elements, 4x4 (AVX2) or 2x2 (SSE2) for 8 byte
+// elements. Tiles are fully loaded before they are stored, so a tile may be
+// transposed onto itself. Leading dimensions are in elements.
+
+#define M2_TRANSPOSE_LEAF_BYTES 4096
+#define M2_TRANSPOSE_MAX_TILE 8
+
+typedef void (*M2TransposeTile)(void *const dst, size_t const dst_ld,
+                                void const *const src, size_t const src_ld);
+
+typedef struct {
+    size_t dtype;
+    size_t tile;
+    M2TransposeTile kernel;
+} m2_transpose_kernel;
+
+#ifdef MATRIX2_X86
+
+__attribute__((target("avx2"))) static void _m2_transpose_tile_avx2_4(
+    void *const dst, size_t const dst_ld, void const *const src,
+    size_t const src_ld) {
+    float const *const s = src;
+    float *const d = dst;
+    __m256 const r0 = _mm256_loadu_ps(s + 0 * src_ld);
+    __m256 const r1 = _mm256_loadu_ps(s + 1 * src_ld);
+    __m256 const r2 = _mm256_loadu_ps(s + 2 * src_ld);
+    __m256 const r3 = _mm256_loadu_ps(s + 3 * src_ld);
+    __m256 const r4 = _mm256_loadu_ps(s + 4 * src_ld);
+    __m256 const r5 = _mm256_loadu_ps(s + 5 * src_ld);
+    __m256 const r6 = _mm256_loadu_ps(s + 6 * src_ld);
+    __m256 const r7 = _mm256_loadu_ps(s + 7 * src_ld);
+
+    __m256 const t0 = _mm256_unpacklo_ps(r0, r1);
+    __m256 const t1 = _mm256_unpackhi_ps(r0, r1);
+    __m256 const t2 = _mm256_unpacklo_ps(r2, r3);
+    __m256 const t3 = _mm256_unpackhi_ps(r2, r3);
+    __m256 const t4 = _mm256_unpacklo_ps(r4, r5);
+    __m256 const t5 = _mm256_unpackhi_ps(r4, r5);
+    __m256 const t6 = _mm256_unpacklo_ps(r6, r7);
+    __m256 const t7 = _mm256_unpackhi_ps(r6, r7);
+
+    __m256 const u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 const u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 const u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 const u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 const u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 const u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 const u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 const u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+    _mm256_storeu_ps(d + 0 * dst_ld, _mm256_permute2f128_ps(u0, u4, 0x20));
+    _mm256_storeu_ps(d + 1 * dst_ld, _mm256_permute2f128_ps(u1, u5, 0x20));
+    _mm256_storeu_ps(d + 2 * dst_ld, _mm256_permute2f128_ps(u2, u6, 0x20));
+    _mm256_storeu_ps(d + 3 * dst_ld, _mm256_permute2f128_ps(u3, u7, 0x20));
+    _mm256_storeu_ps(d + 4 * dst_ld, _mm256_permute2f128_ps(u0, u4, 0x31));
+    _mm256_storeu_ps(d + 5 * dst_ld, _mm256_permute2f128_ps(u1, u5, 0x31));
+    _mm256_storeu_ps(d + 6 * dst_ld, _mm256_permute2f128_ps(u2, u6, 0x31));
+    _mm256_storeu_ps(d + 7 * dst_ld, _mm256_permute2f128_ps(u3, u7, 0x31));
+}
+
+__attribute__((target("avx2"))) static void _m2_transpose_tile_avx2_8(
+    void *const dst, size_t const dst_ld, void const *const src,
+    size_t const src_ld) {
+    double const *const s = src;
+    double *const d = dst;
+    __m256d const r0 = _mm256_loadu_pd(s + 0 * src_ld);
+    __m256d const r1 = _mm256_loadu_pd(s + 1 * src_ld);
+    __m256d const r2 = _mm256_loadu_pd(s + 2 * src_ld);
+    __m256d const r3 = _mm256_loadu_pd(s + 3 * src_ld);
+
+    __m256d const t0 = _mm256_unpacklo_pd(r0, r1);
+    __m256d const t1 = _mm256_unpackhi_pd(r0, r1);
+    __m256d const t2 = _mm256_unpacklo_pd(r2, r3);
+    __m256d const t3 = _mm256_unpackhi_pd(r2, r3);
+
+    _mm256_storeu_pd(d + 0 * dst_ld, _mm256_permute2f128_pd(t0, t2, 0x20));
+    _mm256_storeu_pd(d + 1 * dst_ld, _mm256_permute2f128_pd(t1, t3, 0x20));
+    _mm256_storeu_pd(d + 2 * dst_ld, _mm256_permute2f128_pd(t0, t2, 0x31));
+    _mm256_storeu_pd(d + 3 * dst_ld, _mm256_permute2f128_pd(t1, t3, 0x31));
+}
+
+__attribute__((target("sse2"))) static void _m2_transpose_tile_sse2_4(
+    void *const dst, size_t const dst_ld, void const *const src,
+    size_t const src_ld) {
+    float const *const s = src;
+    float *const d = dst;
+    __m128 r0 = _mm_loadu_ps(s + 0 * src_ld);
+    __m128 r1 = _mm_loadu_ps(s + 1 * src_ld);
+    __m128 r2 = _mm_loadu_ps(s + 2 * src_ld);
+    __m128 r3 = _mm_loadu_ps(s + 3 * src_ld);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(d + 0 * dst_ld, r0);
+    _mm_storeu_ps(d + 1 * dst_ld, r1);
+    _mm_storeu_ps(d + 2 * dst_ld, r2);
+    _mm_storeu_ps(d + 3 * dst_ld, r3);
+}
+
+__attribute__((target("sse2"))) static void _m2_transpose_tile_sse2_8(
+    void *const dst, size_t const dst_ld, void const *const src,
+    size_t const src_ld) {
+    double const *const s = src;
+    double *const d = dst;
+    __m128d const r0 = _mm_loadu_pd(s);
+    __m128d const r1 = _mm_loadu_pd(s + src_ld);
+    _mm_storeu_pd(d, _mm_unpacklo_pd(r0, r1));
+    _mm_storeu_pd(d + dst_ld, _mm_unpackhi_pd(r0, r1));
+}
+
+#endif  // MATRIX2_X86
+
+static m2_transpose_kernel _m2_transpose_kernel(size_t const dtype) {
+    m2_transpose_kernel kernel = {.dtype = dtype, .tile = 0, .kernel = NULL};
+#ifdef MATRIX2_X86
+    bool const avx2 = __builtin_cpu_supports("avx2");
+    if (not avx2 and not __builtin_cpu_supports("sse2")) {
+        return kernel;
+    }
+    if (dtype == 4) {
+        kernel.tile = avx2 ? 8 : 4;
+        kernel.kernel =
+            avx2 ? &_m2_transpose_tile_avx2_4 : &_m2_transpose_tile_sse2_4;
+    } else if (dtype == 8) {
+        kernel.tile = avx2 ? 4 : 2;
+        kernel.kernel =
+            avx2 ? &_m2_transpose_tile_avx2_8 : &_m2_transpose_tile_sse2_8;
+    }
+#endif
+    return kernel;
+}
+
+#define M2_TRANSPOSE_SCALAR(Type)                    \
+    for (size_t i = 0; i < rows; ++i) {              \
+        for (size_t j = 0; j < cols; ++j) {          \
+            ((Type *)dst)[j * dst_ld + i] =          \
+                ((Type const *)src)[i * src_ld + j]; \
+        }                                            \
+    }
+
+// dst must not overlap src
+static void _m2_transpose_scalar(char *const dst, size_t const dst_ld,
+                                 char const *const src, size_t const src_ld,
+                                 size_t const rows, size_t const cols,
+                                 size_t const dtype) {
+    switch (dtype) {
+        case 1: M2_TRANSPOSE_SCALAR(u8) return;
+        case 2: M2_TRANSPOSE_SCALAR(u16) return;
+        case 4: M2_TRANSPOSE_SCALAR(u32) return;
+        case 8: M2_TRANSPOSE_SCALAR(u64) return;
+    }
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < cols; ++j) {
+            memcpy(dst + (j * dst_ld + i) * dtype,
+                   src + (i * src_ld + j) * dtype, dtype);
+        }
+    }
+}
+
+// transposes a block that fits in L1, whole tiles go through the kernel and
+// the remaining right and bottom strips through the scalar loop
+static void _m2_transpose_leaf(m2_transpose_kernel const *const k,
+                               char *const dst, size_t const dst_ld,
+                               char const *const src, size_t const src_ld,
+                               size_t const rows, size_t const cols) {
+    size_t const dtype = k->dtype;
+    size_t const tile = k->tile;
+    size_t const tiled_rows = tile ? rows / tile * tile : 0;
+    size_t const tiled_cols = tile ? cols / tile * tile : 0;
+
+    for (size_t i = 0; i < tiled_rows; i += tile) {
+        for (size_t j = 0; j < tiled_cols; j += tile) {
+            k->kernel(dst + (j * dst_ld + i) * dtype, dst_ld,
+                      src + (i * src_ld + j) * dtype, src_ld);
+        }
+    }
+    _m2_transpose_scalar(dst + tiled_cols * dst_ld * dtype, dst_ld,
+                         src + tiled_cols * dtype, src_ld, rows,
+                         cols - tiled_cols, dtype);
+    _m2_transpose_scalar(dst + tiled_rows * dtype, dst_ld,
+                         src + tiled_rows * src_ld * dtype, src_ld,
+                         rows - tiled_rows, tiled_cols, dtype);
+}
+
+// splits a dimension in half, rounded to whole tiles when possible
+static size_t _m2_transpose_split(size_t const size, size_t const tile) {
+    size_t const half = size / 2;
+    return tile and half >= tile ? half / tile * tile : half;
+}
+
+static void _m2_transpose_rec(m2_transpose_kernel const *const k,
+                              char *const dst, size_t const dst_ld,
+                              char const *const src, size_t const src_ld,
+                              size_t const rows, size_t const cols) {
+    if (rows * cols * k->dtype <= M2_TRANSPOSE_LEAF_BYTES or
+        (rows == 1 or cols == 1)) {
+        _m2_transpose_leaf(k, dst, dst_ld, src, src_ld, rows, cols);
+        return;
+    }
+    if (rows >= cols) {
+        size_t const half = _m2_transpose_split(rows, k->tile);
+        _m2_transpose_rec(k, dst, dst_ld, src, src_ld, half, cols);
+        _m2_transpose_rec(k, dst + half * k->dtype, dst_ld,
+                          src + half * src_ld * k->dtype, src_ld, rows - half,
+                          cols);
+    } else {
+        size_t const half = _m2_transpose_split(cols, k->tile);
+        _m2_transpose_rec(k, dst, dst_ld, src, src_ld, rows, half);
+        _m2_transpose_rec(k, dst + half * dst_ld * k->dtype, dst_ld,
+                          src + half * k->dtype, src_ld, rows, cols - half);
+    }
+}
+
+// exchanges the rows x cols block `a` with the transpose of the cols x rows
+// block `b`, both located in the same matrix and not overlapping
+static void _m2_transpose_swap_leaf(m2_transpose_kernel const *const k,
+                                    char *const a, char *const b,
+                                    size_t const ld, size_t const rows,
+                                    size_t const cols) {
+    size_t const dtype = k->dtype;
+    size_t const tile = k->tile;
+    size_t const tiled_rows = tile ? rows / tile * tile : 0;
+    size_t const tiled_cols = tile ? cols / tile * tile : 0;
+    _Alignas(64) char buffer[M2_TRANSPOSE_MAX_TILE * M2_TRANSPOSE_MAX_TILE *
+                             sizeof(u64)];
+
+    for (size_t i = 0; i < tiled_rows; i += tile) {
+        for (size_t j = 0; j < tiled_cols; j += tile) {
+            char *const lhs = a + (i * ld + j) * dtype;
+            char *const rhs = b + (j * ld + i) * dtype;
+            k->kernel(buffer, tile, lhs, ld);
+            k->kernel(lhs, ld, rhs, ld);
+            for (size_t r = 0; r < tile; ++r) {
+                memcpy(rhs + r * ld * dtype, buffer + r * tile * dtype,
+                       tile * dtype);
+            }
+        }
+    }
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = i < tiled_rows ? tiled_cols : 0; j < cols; ++j) {
+            memswap(a + (i * ld + j) * dtype, b + (j * ld + i) * dtype,
+                    dtype);
+        }
+    }
+}
+
+static void _m2_transpose_swap(m2_transpose_kernel const *const k,
+                               char *const a, char *const b, size_t const ld,
+                               size_t const rows, size_t const cols) {
+    if (2 * rows * cols * k->dtype <= M2_TRANSPOSE_LEAF_BYTES or
+        (rows == 1 or cols == 1)) {
+        _m2_transpose_swap_leaf(k, a, b, ld, rows, cols);
+        return;
+    }
+    if (rows >= cols) {
+        size_t const half = _m2_transpose_split(rows, k->tile);
+        _m2_transpose_swap(k, a, b, ld, half, cols);
+        _m2_transpose_swap(k, a + half * ld * k->dtype, b + half * k->dtype,
+                           ld, rows - half, cols);
+    } else {
+        size_t const half = _m2_transpose_split(cols, k->tile);
+        _m2_transpose_swap(k, a, b, ld, rows, half);
+        _m2_transpose_swap(k, a + half * k->dtype, b + half * ld * k->dtype,
+                           ld, rows, cols - half);
+    }
+}
+
+static void _m2_transpose_square(m2_transpose_kernel const *const k,
+                                 char *const a, size_t const ld,
+                                 size_t const size) {
+    size_t const dtype = k->dtype;
+    if (size * size * dtype > M2_TRANSPOSE_LEAF_BYTES and size > 1) {
+        size_t const half = _m2_transpose_split(size, k->tile);
+        char *const corner = a + half * (ld + 1) * dtype;
+        _m2_transpose_square(k, a, ld, half);
+        _m2_transpose_square(k, corner, ld, size - half);
+        _m2_transpose_swap(k, a + half * dtype, a + half * ld * dtype, ld,
+                           half, size - half);
+        return;
+    }
+
+    // diagonal tiles are transposed onto themselves, the rest of the block
+    // is exchanged with its mirror tile by tile
+    size_t const tile = k->tile;
+    size_t const tiled = tile ? size / tile * tile : 0;
+    for (size_t i = 0; i < tiled; i += tile) {
+        char *const diagonal = a + i * (ld + 1) * dtype;
+        k->kernel(diagonal, ld, diagonal, ld);
+        _m2_transpose_swap_leaf(k, diagonal + tile * dtype,
+                                diagonal + tile * ld * dtype, ld, tile,
+                                tiled - i - tile);
+    }
+    for (size_t i = 0; i < size; ++i) {
+        for (size_t j = i < tiled ? tiled : i + 1; j < size; ++j) {
+            memswap(a + (i * ld + j) * dtype, a + (j * ld + i) * dtype,
+                    dtype);
+        }
+    }
+}
+
+void m2_transpose(matrix2 *const dest, matrix2 const *const src) {
+    PROFILE_SCOPE(m2_transpose, src->dtype, src->rows * src->cols,
+                  M2_BYTES(dest) + M2_BYTES(src));
+    assert(dest->rows == src->cols and dest->cols == src->rows and
+           dest->dtype == src->dtype and dest->data != src->data);
+
+    m2_transpose_kernel const kernel = _m2_transpose_kernel(src->dtype);
+    _m2_transpose_rec(&kernel, dest->data, m2_stride(dest), src->data,
+                      m2_stride(src), src->rows, src->cols);
+}
+
+void m2_transpose_inplace(matrix2 *const m) {
+    PROFILE_SCOPE(m2_transpose_inplace, m->dtype, m->rows * m->cols,
+                  2 * M2_BYTES(m));
+    assert(m->rows == m->cols);
+
+    m2_transpose_kernel const kernel = _m2_transpose_kernel(m->dtype);
+    _m2_transpose_square(&kernel, m->data, m2_stride(m), m->rows);
+}
+
 int m2_compare(matrix2 const *const lhs, matrix2 const *const rhs) {
+    PROFILE_SCOPE(m2_compare, lhs->dtype, lhs->rows * lhs->cols,
+                  M2_BYTES(lhs) + M2_BYTES(rhs));
     assert(lhs->rows == rhs->rows and lhs->cols == rhs->cols and
            lhs->dtype == rhs->dtype);
-    return memcmp(lhs->data, rhs->data, rhs->dtype * lhs->rows * rhs->cols);
+
+    for (size_t i = 0; i < lhs->rows; ++i) {
+        int const result = memcmp(_m2_at(lhs, i, 0), _m2_at(rhs, i, 0),
+                                  lhs->cols * lhs->dtype);
+        if (result) {
+            return result;
+        }
+    }
+    return 0;
 }
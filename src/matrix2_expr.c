@@ -0,0 +1,433 @@
+#include <matrix2_expr.h>
+//
+#include <profile.h>
+//
+#include <assert.h>
+#include <iso646.h>
+#include <stdbool.h>
+#include <string.h>
+
+// number of bytes of a row chunk computed at once by every node
+#define M2_EXPR_CHUNK_BYTES 8192
+
+#define M2_EXPR_ADD(lhs, rhs) ((lhs) + (rhs))
+#define M2_EXPR_SUB(lhs, rhs) ((lhs) - (rhs))
+#define M2_EXPR_MULT(lhs, rhs) ((lhs) * (rhs))
+#define M2_EXPR_DIV(lhs, rhs) ((lhs) / (rhs))
+#define M2_EXPR_MIN(lhs, rhs) ((rhs) < (lhs) ? (rhs) : (lhs))
+#define M2_EXPR_MAX(lhs, rhs) ((lhs) < (rhs) ? (rhs) : (lhs))
+
+// computes `n` results into `out` from operands advancing by `lhs_step` and
+// `rhs_step` elements, a step of 0 repeats the same value. `out` may alias an
+// operand with a step of 1
+typedef void (*M2ExprKernel)(size_t const n, void *const out,
+                             void const *const lhs, size_t const lhs_step,
+                             void const *const rhs, size_t const rhs_step);
+
+// `out` may be the same buffer as an operand, so a plain loop would be
+// vectorized behind a runtime overlap check that fails exactly in that case.
+// Results are written to a local block of M2_EXPR_LANES elements first, which
+// no operand can overlap, and copied out afterwards
+#define M2_EXPR_LANES 8
+
+#define M2_EXPR_BLOCKS(Type, OP, LHS, RHS)               \
+    size_t i = 0;                                        \
+    for (; i + M2_EXPR_LANES <= n; i += M2_EXPR_LANES) { \
+        Type block[M2_EXPR_LANES];                       \
+        for (size_t k = 0; k < M2_EXPR_LANES; ++k) {     \
+            size_t const j = i + k;                      \
+            block[k] = OP(LHS, RHS);                     \
+        }                                                \
+        memcpy(o + i, block, sizeof(block));             \
+    }                                                    \
+    for (size_t j = i; j < n; ++j) {                     \
+        o[j] = OP(LHS, RHS);                             \
+    }
+
+#define DEFINE_EXPR_OP(Type, name, OP)                                         \
+    void Type##_op_##name(void *const dest, void const *const lhs,             \
+                          void const *const rhs) {                             \
+        *(Type *)dest = OP(*(Type const *)lhs, *(Type const *)rhs);            \
+    }                                                                          \
+                                                                               \
+    static void _m2_expr_##Type##_##name(                                      \
+        size_t const n, void *const out, void const *const lhs,                \
+        size_t const lhs_step, void const *const rhs, size_t const rhs_step) { \
+        Type *const o = out;                                                   \
+        Type const *const l = lhs;                                             \
+        Type const *const r = rhs;                                             \
+        if (lhs_step and rhs_step) {                                           \
+            M2_EXPR_BLOCKS(Type, OP, l[j], r[j])                               \
+        } else if (lhs_step) {                                                 \
+            Type const value = *r;                                             \
+            M2_EXPR_BLOCKS(Type, OP, l[j], value)                              \
+        } else if (rhs_step) {                                                 \
+            Type const value = *l;                                             \
+            M2_EXPR_BLOCKS(Type, OP, value, r[j])                              \
+        } else {                                                               \
+            Type const value = OP(*l, *r);                                     \
+            for (size_t j = 0; j < n; ++j) {                                   \
+                o[j] = value;                                                  \
+            }                                                                  \
+        }                                                                      \
+    }
+
+#define DEFINE_EXPR_OPS(Type)                \
+    DEFINE_EXPR_OP(Type, add, M2_EXPR_ADD)   \
+    DEFINE_EXPR_OP(Type, sub, M2_EXPR_SUB)   \
+    DEFINE_EXPR_OP(Type, mult, M2_EXPR_MULT) \
+    DEFINE_EXPR_OP(Type, div, M2_EXPR_DIV)   \
+    DEFINE_EXPR_OP(Type, min, M2_EXPR_MIN)   \
+    DEFINE_EXPR_OP(Type, max, M2_EXPR_MAX)
+
+FOR_ALL_TYPES(DEFINE_EXPR_OPS)
+
+#define DISPATCH_EXPR_OP(Type, name)      \
+    if (op == &Type##_op_##name) {        \
+        assert(dtype == sizeof(Type));    \
+        return &_m2_expr_##Type##_##name; \
+    }
+
+#define DISPATCH_EXPR_OPS(Type)  \
+    DISPATCH_EXPR_OP(Type, add)  \
+    DISPATCH_EXPR_OP(Type, sub)  \
+    DISPATCH_EXPR_OP(Type, mult) \
+    DISPATCH_EXPR_OP(Type, div)  \
+    DISPATCH_EXPR_OP(Type, min)  \
+    DISPATCH_EXPR_OP(Type, max)
+
+static M2ExprKernel _m2_expr_kernel(Apply op, size_t const dtype) {
+    FOR_ALL_TYPES(DISPATCH_EXPR_OPS)
+    return NULL;
+}
+
+#define ASSOCIATIVE_EXPR_OPS(Type)                       \
+    if (op == &Type##_op_add or op == &Type##_op_mult or \
+        op == &Type##_op_min or op == &Type##_op_max) {  \
+        return true;                                     \
+    }
+
+// typed operators whose reductions may be folded in any grouping
+static bool _m2_expr_associative(Apply op) {
+    FOR_ALL_TYPES(ASSOCIATIVE_EXPR_OPS)
+    return false;
+}
+
+// nodes
+
+typedef enum {
+    M2_EXPR_LEAF,
+    M2_EXPR_BINARY,
+    M2_EXPR_REDUCE,
+} m2_expr_kind;
+
+struct m2_expr {
+    m2_expr_kind kind;
+    size_t rows;
+    size_t cols;
+    size_t dtype;
+    m2_arena *arena;
+
+    // elements of a leaf or of a computed reduction, a column stride of 0
+    // repeats the first column
+    char const *data;
+    size_t row_stride;
+    size_t col_stride;
+
+    Apply op;
+    M2ExprKernel kernel;
+    m2_expr *lhs;
+    m2_expr *rhs;
+    m2_axis axis;
+    bool associative;
+    char *buffer;
+    bool ready;
+};
+
+// element pointer and step of a computed row chunk
+typedef struct {
+    char const *data;
+    size_t step;
+} m2_expr_chunk;
+
+static m2_expr *_m2_expr_node(m2_arena *const arena, m2_expr_kind const kind,
+                              size_t const dtype) {
+    m2_expr *const node = m2_arena_take(arena, sizeof(m2_expr));
+    memset(node, 0, sizeof(m2_expr));
+    node->kind = kind;
+    node->dtype = dtype;
+    node->arena = arena;
+    return node;
+}
+
+m2_expr *m2_expr_matrix(m2_arena *const arena, matrix2 const *const m) {
+    m2_expr *const node = _m2_expr_node(arena, M2_EXPR_LEAF, m->dtype);
+    node->rows = m->rows;
+    node->cols = m->cols;
+    node->data = m->data;
+    node->row_stride = m->rows == 1 ? 0 : m2_stride(m);
+    node->col_stride = m->cols == 1 ? 0 : 1;
+    node->ready = true;
+    return node;
+}
+
+m2_expr *m2_expr_scalar(m2_arena *const arena, void const *const value,
+                        size_t const dtype) {
+    m2_expr *const node = _m2_expr_node(arena, M2_EXPR_LEAF, dtype);
+    char *const copy = m2_arena_take(arena, dtype);
+    memcpy(copy, value, dtype);
+    node->rows = 1;
+    node->cols = 1;
+    node->data = copy;
+    node->ready = true;
+    return node;
+}
+
+static size_t _m2_expr_broadcast(size_t const lhs, size_t const rhs) {
+    assert(lhs == rhs or lhs == 1 or rhs == 1);
+    return lhs == 1 ? rhs : lhs;
+}
+
+m2_expr *m2_expr_binary(m2_arena *const arena, Apply op, m2_expr *const lhs,
+                        m2_expr *const rhs) {
+    assert(lhs->dtype == rhs->dtype);
+
+    m2_expr *const node = _m2_expr_node(arena, M2_EXPR_BINARY, lhs->dtype);
+    node->rows = _m2_expr_broadcast(lhs->rows, rhs->rows);
+    node->cols = _m2_expr_broadcast(lhs->cols, rhs->cols);
+    node->op = op;
+    node->kernel = _m2_expr_kernel(op, lhs->dtype);
+    node->lhs = lhs;
+    node->rhs = rhs;
+    return node;
+}
+
+m2_expr *m2_expr_reduce(m2_arena *const arena, Apply op, m2_expr *const expr,
+                        m2_axis const axis) {
+    m2_expr *const node = _m2_expr_node(arena, M2_EXPR_REDUCE, expr->dtype);
+    node->rows = axis == M2_AXIS_COLS ? expr->rows : 1;
+    node->cols = axis == M2_AXIS_ROWS ? expr->cols : 1;
+    node->op = op;
+    node->kernel = _m2_expr_kernel(op, expr->dtype);
+    node->lhs = expr;
+    node->axis = axis;
+    node->associative = _m2_expr_associative(op);
+    return node;
+}
+
+size_t m2_expr_rows(m2_expr const *const expr) {
+    return expr->rows;
+}
+
+size_t m2_expr_cols(m2_expr const *const expr) {
+    return expr->cols;
+}
+
+// evaluation
+
+static void _m2_expr_combine(m2_expr const *const node, size_t const n,
+                             void *const out, m2_expr_chunk const lhs,
+                             m2_expr_chunk const rhs) {
+    if (node->kernel) {
+        node->kernel(n, out, lhs.data, lhs.step, rhs.data, rhs.step);
+        return;
+    }
+    size_t const dtype = node->dtype;
+    for (size_t i = 0; i < n; ++i) {
+        node->op((char *)out + i * dtype, lhs.data + i * lhs.step * dtype,
+                 rhs.data + i * rhs.step * dtype);
+    }
+}
+
+// computes the elements [col, col + n) of `row` of the node, binary nodes
+// write them into `out`, leaves point into their own data. Chunks of nodes
+// that are constant along the row have a step of 0 and a single value.
+static m2_expr_chunk _m2_expr_chunk(m2_expr const *const node,
+                                    size_t const row, size_t const col,
+                                    size_t const n, char *const out) {
+    if (node->kind != M2_EXPR_BINARY) {
+        assert(node->ready);
+        size_t const r = node->rows == 1 ? 0 : row;
+        size_t const c = node->col_stride ? col : 0;
+        return (m2_expr_chunk){
+            .data = node->data + (r * node->row_stride + c) * node->dtype,
+            .step = node->col_stride,
+        };
+    }
+
+    m2_expr_chunk const lhs =
+        _m2_expr_chunk(node->lhs, row, col, n, node->lhs->buffer);
+    m2_expr_chunk const rhs =
+        _m2_expr_chunk(node->rhs, row, col, n, node->rhs->buffer);
+    if (not lhs.step and not rhs.step) {
+        _m2_expr_combine(node, 1, out, lhs, rhs);
+        return (m2_expr_chunk){.data = out, .step = 0};
+    }
+    _m2_expr_combine(node, n, out, lhs, rhs);
+    return (m2_expr_chunk){.data = out, .step = 1};
+}
+
+// folds `n` elements of `chunk` of an associative reduction into its first
+// one pairwise, `scratch` holds a chunk
+static char const *_m2_expr_fold(m2_expr const *const node,
+                                 m2_expr_chunk const chunk, size_t n,
+                                 char *const scratch) {
+    size_t const dtype = node->dtype;
+    if (chunk.step) {
+        memcpy(scratch, chunk.data, n * dtype);
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            memcpy(scratch + i * dtype, chunk.data, dtype);
+        }
+    }
+    while (n > 1) {
+        size_t const half = n / 2;
+        node->kernel(half, scratch, scratch, 1, scratch + (n - half) * dtype,
+                     1);
+        n -= half;
+    }
+    return scratch;
+}
+
+// folds `n` elements of `chunk` into `dest` left to right, starting from the
+// value in `dest` unless `first` is set
+static void _m2_expr_fold_left(m2_expr const *const node, char *const dest,
+                               m2_expr_chunk const chunk, size_t const n,
+                               bool const first) {
+    size_t const dtype = node->dtype;
+    size_t i = 0;
+    if (first) {
+        memcpy(dest, chunk.data, dtype);
+        i = 1;
+    }
+    for (; i < n; ++i) {
+        node->op(dest, dest, chunk.data + i * chunk.step * dtype);
+    }
+}
+
+static void _m2_expr_reduce(m2_expr *const node, size_t const chunk) {
+    m2_expr *const child = node->lhs;
+    size_t const dtype = node->dtype;
+    char *const result = m2_arena_take(node->arena, node->rows * node->cols *
+                                                        dtype);
+    char *const scratch = m2_arena_take(node->arena, chunk * dtype);
+
+    for (size_t row = 0; row < child->rows; ++row) {
+        for (size_t col = 0; col < child->cols; col += chunk) {
+            size_t const n =
+                child->cols - col < chunk ? child->cols - col : chunk;
+            m2_expr_chunk const values =
+                _m2_expr_chunk(child, row, col, n, child->buffer);
+
+            if (node->axis == M2_AXIS_ROWS) {
+                char *const dest = result + col * dtype;
+                m2_expr_chunk const lhs = {.data = dest, .step = 1};
+                if (row) {
+                    _m2_expr_combine(node, n, dest, lhs, values);
+                } else {
+                    for (size_t i = 0; i < n; ++i) {
+                        memcpy(dest + i * dtype,
+                               values.data + i * values.step * dtype, dtype);
+                    }
+                }
+                continue;
+            }
+
+            char *const dest =
+                result + (node->axis == M2_AXIS_COLS ? row : 0) * dtype;
+            bool const first =
+                not col and not(row and node->axis == M2_AXIS_ALL);
+            if (not node->associative) {
+                _m2_expr_fold_left(node, dest, values, n, first);
+                continue;
+            }
+            m2_expr_chunk const folded = {
+                .data = _m2_expr_fold(node, values, n, scratch),
+                .step = 1,
+            };
+            if (not first) {
+                _m2_expr_combine(node, 1, dest,
+                                 (m2_expr_chunk){.data = dest, .step = 1},
+                                 folded);
+            } else {
+                memcpy(dest, folded.data, dtype);
+            }
+        }
+    }
+
+    node->data = result;
+    node->row_stride = node->rows == 1 ? 0 : node->cols;
+    node->col_stride = node->cols == 1 ? 0 : 1;
+    node->ready = true;
+}
+
+// allocates the chunk buffers and computes the reductions bottom up
+static void _m2_expr_prepare(m2_expr *const node, size_t const chunk) {
+    switch (node->kind) {
+        case M2_EXPR_LEAF:
+            return;
+        case M2_EXPR_BINARY:
+            _m2_expr_prepare(node->lhs, chunk);
+            _m2_expr_prepare(node->rhs, chunk);
+            node->buffer = m2_arena_take(node->arena, chunk * node->dtype);
+            return;
+        case M2_EXPR_REDUCE:
+            if (node->ready) {
+                return;
+            }
+            _m2_expr_prepare(node->lhs, chunk);
+            _m2_expr_reduce(node, chunk);
+            return;
+    }
+}
+
+// reductions are recomputed by every evaluation, the leaves they read may
+// have changed in between
+static void _m2_expr_invalidate(m2_expr *const node) {
+    if (node->kind == M2_EXPR_LEAF) {
+        return;
+    }
+    if (node->kind == M2_EXPR_REDUCE) {
+        node->ready = false;
+    } else {
+        _m2_expr_invalidate(node->rhs);
+    }
+    _m2_expr_invalidate(node->lhs);
+}
+
+void m2_expr_eval(matrix2 *const dest, m2_expr *const expr) {
+    PROFILE_SCOPE(m2_expr_eval, dest->dtype, dest->rows * dest->cols,
+                  dest->rows * dest->cols * dest->dtype);
+    assert(dest->rows == expr->rows and dest->cols == expr->cols and
+           dest->dtype == expr->dtype);
+
+    size_t const dtype = expr->dtype;
+    size_t const chunk =
+        M2_EXPR_CHUNK_BYTES > dtype ? M2_EXPR_CHUNK_BYTES / dtype : 1;
+    m2_arena_mark const mark = m2_arena_save(expr->arena);
+
+    _m2_expr_invalidate(expr);
+    _m2_expr_prepare(expr, chunk);
+
+    for (size_t row = 0; row < dest->rows; ++row) {
+        char *const dest_row = m2_get_from_matrix(dest, 0, row);
+        for (size_t col = 0; col < dest->cols; col += chunk) {
+            size_t const n =
+                dest->cols - col < chunk ? dest->cols - col : chunk;
+            char *const out = dest_row + col * dtype;
+            m2_expr_chunk const values =
+                _m2_expr_chunk(expr, row, col, n, out);
+            if (values.step) {
+                if (values.data != out) {
+                    memmove(out, values.data, n * dtype);
+                }
+                continue;
+            }
+            for (size_t i = values.data == out ? 1 : 0; i < n; ++i) {
+                memcpy(out + i * dtype, values.data, dtype);
+            }
+        }
+    }
+
+    m2_arena_release(expr->arena, mark);
+}
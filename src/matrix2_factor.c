@@ -0,0 +1,336 @@
+#include <matrix2_factor.h>
+//
+#include <gemm.h>
+#include <math.h>
+#include <profile.h>
+
+// columns factored per step, the rest of the matrix is updated by a gemm of
+// this depth
+#define M2_FACTOR_BLOCK 128
+
+// panels of LU are halved recursively down to this width, narrower ones are
+// factored a column at a time
+#define M2_FACTOR_PANEL 8
+
+// triangular solves are halved recursively down to this many rows, smaller
+// ones are solved a row at a time, M2_FACTOR_SOLVE_COLS columns of the right
+// hand side at once so they stay in L1 while they are reused
+#define M2_FACTOR_SOLVE 16
+#define M2_FACTOR_SOLVE_COLS 256
+
+// Every operand is addressed like in gemm: a pointer to its first element and
+// the distance in elements between two consecutive rows.
+
+#define DEFINE_MATRIX_FACTOR(Type, Sqrt, Abs)                                  \
+    /* dest -= x * src */                                                      \
+    static void _m2_factor_axpy_##Type(size_t const n, Type const x,           \
+                                       Type const *restrict const src,         \
+                                       Type *restrict const dest) {            \
+        for (size_t j = 0; j < n; ++j) {                                       \
+            dest[j] -= x * src[j];                                             \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    /* swaps row i of a with row pivots[i] for i in [first, last) */           \
+    static void _m2_swap_rows_##Type(Type *const a, size_t const lda,          \
+                                     size_t const cols,                        \
+                                     size_t const *const pivots,               \
+                                     size_t const first, size_t const last) {  \
+        for (size_t i = first; i < last; ++i) {                                \
+            if (pivots[i] == i) {                                              \
+                continue;                                                      \
+            }                                                                  \
+            Type *const lhs = a + i * lda;                                     \
+            Type *const rhs = a + pivots[i] * lda;                             \
+            for (size_t j = 0; j < cols; ++j) {                                \
+                Type const tmp = lhs[j];                                       \
+                lhs[j] = rhs[j];                                               \
+                rhs[j] = tmp;                                                  \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    /* dest (rows x cols) = src^T, row by row of dest */                       \
+    static void _m2_factor_transpose_##Type(                                   \
+        size_t const rows, size_t const cols, Type const *const src,           \
+        size_t const lds, Type *const dest, size_t const ldd) {                \
+        for (size_t i = 0; i < rows; ++i) {                                    \
+            for (size_t j = 0; j < cols; ++j) {                                \
+                dest[i * ldd + j] = src[j * lds + i];                          \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    /* b (n x w) = L^-1 * b, row by row of b */                                \
+    static void _m2_trsm_lower_##Type(size_t const n, size_t const w,          \
+                                      Type const *const l, size_t const ldl,   \
+                                      Type *const b, size_t const ldb,         \
+                                      bool const unit) {                       \
+        for (size_t jc = 0; jc < w; jc += M2_FACTOR_SOLVE_COLS) {              \
+            size_t const cols = MIN(M2_FACTOR_SOLVE_COLS, w - jc);             \
+            for (size_t i = 0; i < n; ++i) {                                   \
+                Type *const row = b + i * ldb + jc;                            \
+                for (size_t p = 0; p < i; ++p) {                               \
+                    _m2_factor_axpy_##Type(cols, l[i * ldl + p],               \
+                                           b + p * ldb + jc, row);             \
+                }                                                              \
+                Type const diagonal = unit ? 1 : l[i * ldl + i];               \
+                for (size_t j = 0; not unit and j < cols; ++j) {               \
+                    row[j] /= diagonal;                                        \
+                }                                                              \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    /* b (n x w) = U^-1 * b, from the last row of b up */                      \
+    static void _m2_trsm_upper_##Type(size_t const n, size_t const w,          \
+                                      Type const *const u, size_t const ldu,   \
+                                      Type *const b, size_t const ldb,         \
+                                      bool const unit) {                       \
+        for (size_t jc = 0; jc < w; jc += M2_FACTOR_SOLVE_COLS) {              \
+            size_t const cols = MIN(M2_FACTOR_SOLVE_COLS, w - jc);             \
+            for (size_t i = n; i-- > 0;) {                                     \
+                Type *const row = b + i * ldb + jc;                            \
+                for (size_t p = i + 1; p < n; ++p) {                           \
+                    _m2_factor_axpy_##Type(cols, u[i * ldu + p],               \
+                                           b + p * ldb + jc, row);             \
+                }                                                              \
+                Type const diagonal = unit ? 1 : u[i * ldu + i];               \
+                for (size_t j = 0; not unit and j < cols; ++j) {               \
+                    row[j] /= diagonal;                                        \
+                }                                                              \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    /* recursive solves, the top (bottom) half of b is solved and removed */   \
+    /* from the other one by gemm, small blocks are solved row by row */       \
+    static void _m2_solve_lower_##Type(size_t const n, size_t const w,         \
+                                       Type const *const l, size_t const ldl,  \
+                                       Type *const b, size_t const ldb,        \
+                                       bool const unit) {                      \
+        if (n <= M2_FACTOR_SOLVE) {                                            \
+            _m2_trsm_lower_##Type(n, w, l, ldl, b, ldb, unit);                 \
+            return;                                                            \
+        }                                                                      \
+        size_t const n1 = n / 2;                                               \
+        _m2_solve_lower_##Type(n1, w, l, ldl, b, ldb, unit);                   \
+        gemm_##Type(n - n1, w, n1, -1, l + n1 * ldl, ldl, b, ldb,              \
+                    b + n1 * ldb, ldb);                                        \
+        _m2_solve_lower_##Type(n - n1, w, l + n1 * ldl + n1, ldl,              \
+                               b + n1 * ldb, ldb, unit);                       \
+    }                                                                          \
+                                                                               \
+    static void _m2_solve_upper_##Type(size_t const n, size_t const w,         \
+                                       Type const *const u, size_t const ldu,  \
+                                       Type *const b, size_t const ldb,        \
+                                       bool const unit) {                      \
+        if (n <= M2_FACTOR_SOLVE) {                                            \
+            _m2_trsm_upper_##Type(n, w, u, ldu, b, ldb, unit);                 \
+            return;                                                            \
+        }                                                                      \
+        size_t const n1 = n / 2;                                               \
+        _m2_solve_upper_##Type(n - n1, w, u + n1 * ldu + n1, ldu,              \
+                               b + n1 * ldb, ldb, unit);                       \
+        gemm_##Type(n1, w, n - n1, -1, u + n1, ldu, b + n1 * ldb, ldb, b,      \
+                    ldb);                                                      \
+        _m2_solve_upper_##Type(n1, w, u, ldu, b, ldb, unit);                   \
+    }                                                                          \
+                                                                               \
+    /* factors the m x n panel a with m >= n, pivots are relative to its */    \
+    /* first row. The left half is factored, applied to the right half and */  \
+    /* the bottom of the right half is factored the same way */                \
+    static bool _m2_lu_panel_##Type(size_t const m, size_t const n,            \
+                                    Type *const a, size_t const lda,           \
+                                    size_t *const pivots) {                    \
+        if (n > M2_FACTOR_PANEL) {                                             \
+            size_t const n1 = n / 2;                                           \
+            size_t const n2 = n - n1;                                          \
+            bool const left = _m2_lu_panel_##Type(m, n1, a, lda, pivots);      \
+            _m2_swap_rows_##Type(a + n1, lda, n2, pivots, 0, n1);              \
+            _m2_solve_lower_##Type(n1, n2, a, lda, a + n1, lda, true);         \
+            gemm_##Type(m - n1, n2, n1, -1, a + n1 * lda, lda, a + n1, lda,    \
+                        a + n1 * lda + n1, lda);                               \
+            bool const right = _m2_lu_panel_##Type(                            \
+                m - n1, n2, a + n1 * lda + n1, lda, pivots + n1);              \
+            for (size_t i = n1; i < n; ++i) {                                  \
+                pivots[i] += n1;                                               \
+            }                                                                  \
+            _m2_swap_rows_##Type(a, lda, n1, pivots, n1, n);                   \
+            return left and right;                                             \
+        }                                                                      \
+                                                                               \
+        bool regular = true;                                                   \
+        for (size_t j = 0; j < n; ++j) {                                       \
+            size_t pivot = j;                                                  \
+            for (size_t i = j + 1; i < m; ++i) {                               \
+                if (Abs(a[i * lda + j]) > Abs(a[pivot * lda + j])) {           \
+                    pivot = i;                                                 \
+                }                                                              \
+            }                                                                  \
+            pivots[j] = pivot;                                                 \
+            _m2_swap_rows_##Type(a, lda, n, pivots, j, j + 1);                 \
+                                                                               \
+            Type const *const top = a + j * lda;                               \
+            if (top[j] == 0) {                                                 \
+                regular = false;                                               \
+                continue;                                                      \
+            }                                                                  \
+            for (size_t i = j + 1; i < m; ++i) {                               \
+                Type *const row = a + i * lda;                                 \
+                row[j] /= top[j];                                              \
+                _m2_factor_axpy_##Type(n - j - 1, row[j], top + j + 1,         \
+                                       row + j + 1);                           \
+            }                                                                  \
+        }                                                                      \
+        return regular;                                                        \
+    }                                                                          \
+                                                                               \
+    /* L * L^T of the n x n block a, L is mirrored into its upper triangle */  \
+    static bool _m2_cholesky_block_##Type(size_t const n, Type *const a,       \
+                                          size_t const lda) {                  \
+        for (size_t i = 0; i < n; ++i) {                                       \
+            Type *const row = a + i * lda;                                     \
+            for (size_t j = 0; j <= i; ++j) {                                  \
+                Type const *const other = a + j * lda;                         \
+                Type sum = row[j];                                             \
+                for (size_t p = 0; p < j; ++p) {                               \
+                    sum -= row[p] * other[p];                                  \
+                }                                                              \
+                if (j < i) {                                                   \
+                    row[j] = sum / other[j];                                   \
+                    continue;                                                  \
+                }                                                              \
+                if (not(sum > 0)) {                                            \
+                    return false;                                              \
+                }                                                              \
+                row[i] = Sqrt(sum);                                            \
+            }                                                                  \
+        }                                                                      \
+        for (size_t i = 0; i < n; ++i) {                                       \
+            for (size_t j = 0; j < i; ++j) {                                   \
+                a[j * lda + i] = a[i * lda + j];                               \
+            }                                                                  \
+        }                                                                      \
+        return true;                                                           \
+    }                                                                          \
+                                                                               \
+    bool m2_lu_##Type(matrix2 *const m, size_t *const pivots) {                \
+        PROFILE_SCOPE(m2_lu, m->dtype, m->rows * m->cols,                      \
+                      m->rows * m->cols * m->dtype);                           \
+        assert(m->dtype == sizeof(Type));                                      \
+                                                                               \
+        Type *const a = m->data;                                               \
+        size_t const lda = m2_stride(m);                                       \
+        size_t const steps = MIN(m->rows, m->cols);                            \
+        bool regular = true;                                                   \
+                                                                               \
+        for (size_t k = 0; k < steps; k += M2_FACTOR_BLOCK) {                  \
+            size_t const kb = MIN(M2_FACTOR_BLOCK, steps - k);                 \
+            size_t const below = m->rows - k - kb;                             \
+            size_t const right = m->cols - k - kb;                             \
+            Type *const diagonal = a + k * lda + k;                            \
+                                                                               \
+            if (not _m2_lu_panel_##Type(m->rows - k, kb, diagonal, lda,        \
+                                        pivots + k)) {                         \
+                regular = false;                                               \
+            }                                                                  \
+            for (size_t i = k; i < k + kb; ++i) {                              \
+                pivots[i] += k;                                                \
+            }                                                                  \
+            _m2_swap_rows_##Type(a, lda, k, pivots, k, k + kb);                \
+            _m2_swap_rows_##Type(a + k + kb, lda, right, pivots, k, k + kb);   \
+                                                                               \
+            _m2_solve_lower_##Type(kb, right, diagonal, lda, diagonal + kb,    \
+                                   lda, true);                                 \
+            gemm_##Type(below, right, kb, -1, diagonal + kb * lda, lda,        \
+                        diagonal + kb, lda, diagonal + kb * lda + kb, lda);    \
+        }                                                                      \
+        return regular;                                                        \
+    }                                                                          \
+                                                                               \
+    bool m2_cholesky_##Type(matrix2 *const m) {                                \
+        PROFILE_SCOPE(m2_cholesky, m->dtype, m->rows * m->cols,                \
+                      m->rows * m->cols * m->dtype);                           \
+        assert(m->rows == m->cols and m->dtype == sizeof(Type));               \
+                                                                               \
+        Type *const a = m->data;                                               \
+        size_t const lda = m2_stride(m);                                       \
+        size_t const n = m->rows;                                              \
+                                                                               \
+        for (size_t k = 0; k < n; k += M2_FACTOR_BLOCK) {                      \
+            size_t const kb = MIN(M2_FACTOR_BLOCK, n - k);                     \
+            size_t const rest = n - k - kb;                                    \
+            Type *const diagonal = a + k * lda + k;                            \
+            Type *const below = diagonal + kb * lda;                           \
+            Type *const right = diagonal + kb;                                 \
+                                                                               \
+            if (not _m2_cholesky_block_##Type(kb, diagonal, lda)) {            \
+                return false;                                                  \
+            }                                                                  \
+                                                                               \
+            /* L21 = A21 * L11^-T is solved transposed, L21^T = L11^-1 * */    \
+            /* A21^T, in the upper triangle and copied back below */           \
+            _m2_factor_transpose_##Type(kb, rest, below, lda, right, lda);     \
+            _m2_solve_lower_##Type(kb, rest, diagonal, lda, right, lda,        \
+                                   false);                                     \
+            _m2_factor_transpose_##Type(rest, kb, right, lda, below, lda);     \
+                                                                               \
+            /* A22 -= L21 * L21^T, only the block columns of its lower */      \
+            /* triangle */                                                     \
+            for (size_t j = 0; j < rest; j += M2_FACTOR_BLOCK) {               \
+                size_t const jb = MIN(M2_FACTOR_BLOCK, rest - j);              \
+                gemm_##Type(rest - j, jb, kb, -1, below + j * lda, lda,        \
+                            right + j, lda, below + j * lda + kb + j, lda);    \
+            }                                                                  \
+        }                                                                      \
+        return true;                                                           \
+    }                                                                          \
+                                                                               \
+    void m2_solve_lower_##Type(matrix2 const *const l, matrix2 *const b,       \
+                               bool const unit_diagonal) {                     \
+        PROFILE_SCOPE(m2_solve_lower, b->dtype, b->rows * b->cols,             \
+                      (l->rows * l->cols / 2 + b->rows * b->cols) * b->dtype); \
+        assert(l->rows == l->cols and l->rows == b->rows and                   \
+               l->dtype == sizeof(Type) and b->dtype == sizeof(Type));         \
+        _m2_solve_lower_##Type(l->rows, b->cols, l->data, m2_stride(l),        \
+                               b->data, m2_stride(b), unit_diagonal);          \
+    }                                                                          \
+                                                                               \
+    void m2_solve_upper_##Type(matrix2 const *const u, matrix2 *const b,       \
+                               bool const unit_diagonal) {                     \
+        PROFILE_SCOPE(m2_solve_upper, b->dtype, b->rows * b->cols,             \
+                      (u->rows * u->cols / 2 + b->rows * b->cols) * b->dtype); \
+        assert(u->rows == u->cols and u->rows == b->rows and                   \
+               u->dtype == sizeof(Type) and b->dtype == sizeof(Type));         \
+        _m2_solve_upper_##Type(u->rows, b->cols, u->data, m2_stride(u),        \
+                               b->data, m2_stride(b), unit_diagonal);          \
+    }                                                                          \
+                                                                               \
+    void m2_lu_solve_##Type(matrix2 const *const lu,                           \
+                            size_t const *const pivots, matrix2 *const b) {    \
+        PROFILE_SCOPE(m2_lu_solve, b->dtype, b->rows * b->cols,                \
+                      (lu->rows * lu->cols + b->rows * b->cols) * b->dtype);   \
+        assert(lu->rows == lu->cols and lu->rows == b->rows and                \
+               lu->dtype == sizeof(Type) and b->dtype == sizeof(Type));        \
+        _m2_swap_rows_##Type(b->data, m2_stride(b), b->cols, pivots, 0,        \
+                             b->rows);                                         \
+        _m2_solve_lower_##Type(lu->rows, b->cols, lu->data, m2_stride(lu),     \
+                               b->data, m2_stride(b), true);                   \
+        _m2_solve_upper_##Type(lu->rows, b->cols, lu->data, m2_stride(lu),     \
+                               b->data, m2_stride(b), false);                  \
+    }                                                                          \
+                                                                               \
+    void m2_cholesky_solve_##Type(matrix2 const *const l, matrix2 *const b) {  \
+        PROFILE_SCOPE(m2_cholesky_solve, b->dtype, b->rows * b->cols,          \
+                      (l->rows * l->cols + b->rows * b->cols) * b->dtype);     \
+        assert(l->rows == l->cols and l->rows == b->rows and                   \
+               l->dtype == sizeof(Type) and b->dtype == sizeof(Type));         \
+        _m2_solve_lower_##Type(l->rows, b->cols, l->data, m2_stride(l),        \
+                               b->data, m2_stride(b), false);                  \
+        _m2_solve_upper_##Type(l->rows, b->cols, l->data, m2_stride(l),        \
+                               b->data, m2_stride(b), false);                  \
+    }
+
+DEFINE_MATRIX_FACTOR(f32, sqrtf, fabsf)
+DEFINE_MATRIX_FACTOR(f64, sqrt, fabs)
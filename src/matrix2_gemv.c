@@ -0,0 +1,295 @@
+#include <matrix2_gemv.h>
+//
+#include <matrix2_macro_helpers.h>
+#include <profile.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define M2_GEMV_X86
+#endif
+
+// Typed kernels work on GNU vectors of M2_GEMV_VECTOR_BYTES, which compile to
+// whatever the target of the function provides. Every kernel is built once for
+// the baseline and once for AVX2 with FMA, picked at runtime.
+#define M2_GEMV_VECTOR_BYTES 32
+
+// columns processed per block. The block of a vector stays in L1 and the 4
+// rows of the matrix multiplied with it in L2 while they are reused, blocks
+// span several pages so the prefetcher keeps up with the row streams
+#define M2_GEMV_BLOCK_BYTES 32768
+
+#define DEFINE_GEMV_VECTOR(Type) \
+    typedef Type m2_gemv_##Type  \
+        __attribute__((vector_size(M2_GEMV_VECTOR_BYTES)));
+
+FOR_ALL_TYPES(DEFINE_GEMV_VECTOR)
+
+#define M2_GEMV_LOAD(dest, src) memcpy(&(dest), src, sizeof(dest))
+#define M2_GEMV_STORE(dest, src) memcpy(dest, &(src), sizeof(src))
+
+#define M2_GEMV_EACH_ROW(X) X(0) X(1) X(2) X(3)
+
+// dots of `u` with 4 rows of `a`
+#define M2_GEMV_DOTS_ZERO(r) Vector acc##r = {0};
+#define M2_GEMV_DOTS_STEP(r)           \
+    M2_GEMV_LOAD(row, a + r * ld + j); \
+    acc##r += row * lanes;
+#define M2_GEMV_DOTS_SUM(r)                  \
+    sums[r] = 0;                             \
+    for (size_t l = 0; l < width; ++l) {     \
+        sums[r] += acc##r[l];                \
+    }                                        \
+    for (size_t k = j; k < n; ++k) {         \
+        sums[r] += a[r * ld + k] * u[k];     \
+    }
+
+// y += c[0] * a[0] + ... + c[3] * a[3] for 4 rows of `a`
+#define M2_GEMV_AXPY_SPLAT(r) Vector const c##r = (Vector){0} + c[r];
+#define M2_GEMV_AXPY_STEP(r)           \
+    M2_GEMV_LOAD(row, a + r * ld + j); \
+    acc += c##r * row;
+
+#define DEFINE_GEMV(Type, isa, TARGET)                                        \
+    TARGET static void _m2_dots4_##Type##_##isa(                              \
+        size_t const n, Type const *const u, Type const *const a,             \
+        size_t const ld, Type *const sums) {                                  \
+        typedef m2_gemv_##Type Vector;                                        \
+        size_t const width = sizeof(Vector) / sizeof(Type);                   \
+        M2_GEMV_EACH_ROW(M2_GEMV_DOTS_ZERO)                                   \
+        size_t j = 0;                                                         \
+        for (; j + width <= n; j += width) {                                  \
+            Vector lanes, row;                                                \
+            M2_GEMV_LOAD(lanes, u + j);                                       \
+            M2_GEMV_EACH_ROW(M2_GEMV_DOTS_STEP)                               \
+        }                                                                     \
+        M2_GEMV_EACH_ROW(M2_GEMV_DOTS_SUM)                                    \
+    }                                                                         \
+                                                                              \
+    TARGET static Type _m2_dot_##Type##_##isa(                                \
+        size_t const n, Type const *const u, Type const *const a) {           \
+        typedef m2_gemv_##Type Vector;                                        \
+        size_t const width = sizeof(Vector) / sizeof(Type);                   \
+        Vector acc = {0};                                                     \
+        size_t j = 0;                                                         \
+        for (; j + width <= n; j += width) {                                  \
+            Vector lanes, row;                                                \
+            M2_GEMV_LOAD(lanes, u + j);                                       \
+            M2_GEMV_LOAD(row, a + j);                                         \
+            acc += row * lanes;                                               \
+        }                                                                     \
+        Type sum = 0;                                                         \
+        for (size_t l = 0; l < width; ++l) {                                  \
+            sum += acc[l];                                                    \
+        }                                                                     \
+        for (; j < n; ++j) {                                                  \
+            sum += a[j] * u[j];                                               \
+        }                                                                     \
+        return sum;                                                           \
+    }                                                                         \
+                                                                              \
+    TARGET static void _m2_axpy4_##Type##_##isa(                              \
+        size_t const n, Type *const y, Type const *const c,                   \
+        Type const *const a, size_t const ld) {                               \
+        typedef m2_gemv_##Type Vector;                                        \
+        size_t const width = sizeof(Vector) / sizeof(Type);                   \
+        M2_GEMV_EACH_ROW(M2_GEMV_AXPY_SPLAT)                                  \
+        size_t j = 0;                                                         \
+        for (; j + width <= n; j += width) {                                  \
+            Vector acc, row;                                                  \
+            M2_GEMV_LOAD(acc, y + j);                                         \
+            M2_GEMV_EACH_ROW(M2_GEMV_AXPY_STEP)                               \
+            M2_GEMV_STORE(y + j, acc);                                        \
+        }                                                                     \
+        for (; j < n; ++j) {                                                  \
+            y[j] += c[0] * a[j] + c[1] * a[ld + j] + c[2] * a[2 * ld + j] +   \
+                    c[3] * a[3 * ld + j];                                     \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    TARGET static void _m2_axpy_##Type##_##isa(                               \
+        size_t const n, Type *const y, Type const c, Type const *const a) {   \
+        typedef m2_gemv_##Type Vector;                                        \
+        size_t const width = sizeof(Vector) / sizeof(Type);                   \
+        Vector const scale = (Vector){0} + c;                                 \
+        size_t j = 0;                                                         \
+        for (; j + width <= n; j += width) {                                  \
+            Vector acc, row;                                                  \
+            M2_GEMV_LOAD(acc, y + j);                                         \
+            M2_GEMV_LOAD(row, a + j);                                         \
+            acc += scale * row;                                               \
+            M2_GEMV_STORE(y + j, acc);                                        \
+        }                                                                     \
+        for (; j < n; ++j) {                                                  \
+            y[j] += c * a[j];                                                 \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    /* every group of 4 rows of m is dotted with the block of every vector */ \
+    TARGET static void _m2_gemv_multi_##Type##_##isa(                         \
+        matrix2 *const ys, matrix2 const *const m, matrix2 const *const xs) { \
+        size_t const ld = m2_stride(m);                                       \
+        size_t const x_ld = m2_stride(xs);                                    \
+        size_t const y_ld = m2_stride(ys);                                    \
+        size_t const block = M2_GEMV_BLOCK_BYTES / sizeof(Type);              \
+        Type const *const data = m->data;                                     \
+        Type *const y = ys->data;                                             \
+        for (size_t col = 0; col < m->cols; col += block) {                   \
+            size_t const n = MIN(block, m->cols - col);                       \
+            size_t i = 0;                                                     \
+            for (; i + 4 <= m->rows; i += 4) {                                \
+                Type const *const a = data + i * ld + col;                    \
+                for (size_t v = 0; v < xs->rows; ++v) {                       \
+                    Type sums[4];                                             \
+                    Type const *const x = (Type const *)xs->data + v * x_ld;  \
+                    _m2_dots4_##Type##_##isa(n, x + col, a, ld, sums);        \
+                    for (size_t r = 0; r < 4; ++r) {                          \
+                        y[v * y_ld + i + r] += sums[r];                       \
+                    }                                                         \
+                }                                                             \
+            }                                                                 \
+            for (; i < m->rows; ++i) {                                        \
+                Type const *const a = data + i * ld + col;                    \
+                for (size_t v = 0; v < xs->rows; ++v) {                       \
+                    Type const *const x = (Type const *)xs->data + v * x_ld;  \
+                    y[v * y_ld + i] += _m2_dot_##Type##_##isa(n, x + col, a); \
+                }                                                             \
+            }                                                                 \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    /* every group of 4 rows of m is added to the block of every result */    \
+    TARGET static void _m2_gevm_multi_##Type##_##isa(                         \
+        matrix2 *const ys, matrix2 const *const xs, matrix2 const *const m) { \
+        size_t const ld = m2_stride(m);                                       \
+        size_t const x_ld = m2_stride(xs);                                    \
+        size_t const y_ld = m2_stride(ys);                                    \
+        size_t const block = M2_GEMV_BLOCK_BYTES / sizeof(Type);              \
+        Type const *const data = m->data;                                     \
+        Type const *const x = xs->data;                                       \
+        for (size_t col = 0; col < m->cols; col += block) {                   \
+            size_t const n = MIN(block, m->cols - col);                       \
+            size_t i = 0;                                                     \
+            for (; i + 4 <= m->rows; i += 4) {                                \
+                Type const *const a = data + i * ld + col;                    \
+                for (size_t v = 0; v < xs->rows; ++v) {                       \
+                    Type *const y = (Type *)ys->data + v * y_ld + col;        \
+                    _m2_axpy4_##Type##_##isa(n, y, x + v * x_ld + i, a, ld);  \
+                }                                                             \
+            }                                                                 \
+            for (; i < m->rows; ++i) {                                        \
+                Type const *const a = data + i * ld + col;                    \
+                for (size_t v = 0; v < xs->rows; ++v) {                       \
+                    Type *const y = (Type *)ys->data + v * y_ld + col;        \
+                    _m2_axpy_##Type##_##isa(n, y, x[v * x_ld + i], a);        \
+                }                                                             \
+            }                                                                 \
+        }                                                                     \
+    }
+
+#define DEFINE_GEMV_BASELINE(Type) DEFINE_GEMV(Type, baseline, )
+
+FOR_ALL_TYPES(DEFINE_GEMV_BASELINE)
+
+#ifdef M2_GEMV_X86
+
+#define DEFINE_GEMV_AVX2(Type) \
+    DEFINE_GEMV(Type, avx2, __attribute__((target("avx2,fma"))))
+
+FOR_ALL_TYPES(DEFINE_GEMV_AVX2)
+
+static bool _m2_gemv_avx2() {
+    return __builtin_cpu_supports("avx2") and __builtin_cpu_supports("fma");
+}
+
+#define M2_GEMV_CALL(Type, name, ...)                          \
+    (_m2_gemv_avx2() ? _m2_##name##_##Type##_avx2(__VA_ARGS__) \
+                     : _m2_##name##_##Type##_baseline(__VA_ARGS__))
+#else
+#define M2_GEMV_CALL(Type, name, ...) \
+    _m2_##name##_##Type##_baseline(__VA_ARGS__)
+#endif  // M2_GEMV_X86
+
+// destinations are zeroed by the callers, the typed drivers only add
+
+#define DISPATCH_GEMV_MULTI(Type)                                 \
+    if (perf == &Type##_apply_add and m->dtype == sizeof(Type)) { \
+        M2_GEMV_CALL(Type, gemv_multi, ys, m, xs);                \
+        return;                                                   \
+    }
+
+#define DISPATCH_GEVM_MULTI(Type)                                 \
+    if (perf == &Type##_apply_add and m->dtype == sizeof(Type)) { \
+        M2_GEMV_CALL(Type, gevm_multi, ys, xs, m);                \
+        return;                                                   \
+    }
+
+static void _m2_gemv_zero(matrix2 *const m) {
+    for (size_t i = 0; i < m->rows; ++i) {
+        memset(m2_get_from_matrix(m, 0, i), 0, m->cols * m->dtype);
+    }
+}
+
+void m2_gemv_multi(matrix2 *const ys, matrix2 const *const m,
+                   matrix2 const *const xs, Apply perf) {
+    PROFILE_SCOPE(m2_gemv_multi, m->dtype, ys->rows * ys->cols,
+                  (m->rows * m->cols + xs->rows * xs->cols +
+                   ys->rows * ys->cols) *
+                      m->dtype);
+    assert(xs->cols == m->cols and ys->rows == xs->rows and
+           ys->cols == m->rows and xs->dtype == m->dtype and
+           ys->dtype == m->dtype);
+
+    _m2_gemv_zero(ys);
+    FOR_ALL_TYPES(DISPATCH_GEMV_MULTI)
+
+    for (size_t v = 0; v < xs->rows; ++v) {
+        for (size_t i = 0; i < m->rows; ++i) {
+            void *const dest = m2_get_from_matrix(ys, i, v);
+            for (size_t j = 0; j < m->cols; ++j) {
+                perf(dest, m2_get_from_matrix(m, j, i),
+                     m2_get_from_matrix(xs, j, v));
+            }
+        }
+    }
+}
+
+void m2_gevm_multi(matrix2 *const ys, matrix2 const *const xs,
+                   matrix2 const *const m, Apply perf) {
+    PROFILE_SCOPE(m2_gevm_multi, m->dtype, ys->rows * ys->cols,
+                  (m->rows * m->cols + xs->rows * xs->cols +
+                   ys->rows * ys->cols) *
+                      m->dtype);
+    assert(xs->cols == m->rows and ys->rows == xs->rows and
+           ys->cols == m->cols and xs->dtype == m->dtype and
+           ys->dtype == m->dtype);
+
+    _m2_gemv_zero(ys);
+    FOR_ALL_TYPES(DISPATCH_GEVM_MULTI)
+
+    for (size_t v = 0; v < xs->rows; ++v) {
+        for (size_t i = 0; i < m->rows; ++i) {
+            void const *const lhs = m2_get_from_matrix(xs, i, v);
+            for (size_t j = 0; j < m->cols; ++j) {
+                perf(m2_get_from_matrix(ys, j, v), lhs,
+                     m2_get_from_matrix(m, j, i));
+            }
+        }
+    }
+}
+
+void m2_gemv(void *const y, matrix2 const *const m, void const *const x,
+             Apply perf) {
+    PROFILE_SCOPE(m2_gemv, m->dtype, m->rows,
+                  (m->rows * m->cols + m->rows + m->cols) * m->dtype);
+    matrix2 ys = {1, m->rows, m->dtype, y, 0};
+    matrix2 const xs = {1, m->cols, m->dtype, (void *)x, 0};
+    m2_gemv_multi(&ys, m, &xs, perf);
+}
+
+void m2_gevm(void *const y, void const *const x, matrix2 const *const m,
+             Apply perf) {
+    PROFILE_SCOPE(m2_gevm, m->dtype, m->cols,
+                  (m->rows * m->cols + m->rows + m->cols) * m->dtype);
+    matrix2 ys = {1, m->cols, m->dtype, y, 0};
+    matrix2 const xs = {1, m->rows, m->dtype, (void *)x, 0};
+    m2_gevm_multi(&ys, &xs, m, perf);
+}
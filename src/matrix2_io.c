@@ -0,0 +1,539 @@
+#include <matrix2_io.h>
+//
+#include <fcntl.h>
+#include <profile.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static size_t _m2_file_data_bytes(m2_file_header const *const header) {
+    if (not header->rows) {
+        return 0;
+    }
+    return ((header->rows - 1) * header->stride + header->cols) *
+           header->dtype;
+}
+
+static bool _m2_file_valid(m2_file_header const *const header) {
+    return memcmp(header->magic, M2_FILE_MAGIC, sizeof(header->magic)) == 0 and
+           header->version == M2_FILE_VERSION and
+           header->byte_order == M2_FILE_BYTE_ORDER and header->dtype and
+           header->stride >= header->cols and
+           header->data_offset == M2_FILE_DATA_OFFSET and
+           header->rows <= SIZE_MAX / header->dtype / (header->stride + 1);
+}
+
+static bool _m2_write(int const fd, void const *const data, size_t size) {
+    char const *bytes = data;
+    while (size) {
+        ssize_t const written = write(fd, bytes, size);
+        if (written < 0) {
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+// rows are gathered into a buffer of about this size before they are written
+#define M2_FILE_WRITE_CHUNK (1 << 20)
+
+static bool _m2_save_rows(int const fd, matrix2 const *const m,
+                          size_t const stride) {
+    size_t const row_bytes = stride * m->dtype;
+    if (not row_bytes) {
+        return true;
+    }
+    size_t const batch =
+        row_bytes < M2_FILE_WRITE_CHUNK ? M2_FILE_WRITE_CHUNK / row_bytes : 1;
+    char *const buffer = calloc(batch, row_bytes);
+    if (not buffer) {
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t row = 0; ok and row < m->rows; row += batch) {
+        size_t const count = m->rows - row < batch ? m->rows - row : batch;
+        for (size_t i = 0; i < count; ++i) {
+            memcpy(buffer + i * row_bytes,
+                   m2_get_from_matrix(m, 0, row + i), m->cols * m->dtype);
+        }
+        // the file ends right after the last element, the padding of the
+        // last row is never read
+        size_t const bytes = row + count == m->rows
+                                 ? (count - 1) * row_bytes + m->cols * m->dtype
+                                 : count * row_bytes;
+        ok = _m2_write(fd, buffer, bytes);
+    }
+    free(buffer);
+    return ok;
+}
+
+static m2_file_header _m2_file_header(size_t const rows, size_t const cols,
+                                      size_t const dtype) {
+    return (m2_file_header){
+        .magic = M2_FILE_MAGIC,
+        .version = M2_FILE_VERSION,
+        .byte_order = M2_FILE_BYTE_ORDER,
+        .rows = rows,
+        .cols = cols,
+        .dtype = dtype,
+        .stride = m2_padded_stride(cols, dtype),
+        .alignment = M2_ALIGNMENT,
+        .data_offset = M2_FILE_DATA_OFFSET,
+    };
+}
+
+// writes `header` zero padded to M2_FILE_DATA_OFFSET bytes
+static bool _m2_write_header(int const fd,
+                             m2_file_header const *const header) {
+    char block[M2_FILE_DATA_OFFSET] = {0};
+    memcpy(block, header, sizeof(*header));
+    return _m2_write(fd, block, sizeof(block));
+}
+
+// files are written next to their destination and renamed over it once
+// complete, so readers never map a half written file
+static char *_m2_temporary_path(char const *const path) {
+    size_t const length = strlen(path);
+    char *const temporary = malloc(length + sizeof(".tmp"));
+    if (temporary) {
+        memcpy(temporary, path, length);
+        memcpy(temporary + length, ".tmp", sizeof(".tmp"));
+    }
+    return temporary;
+}
+
+// closes `fd` and renames the temporary file over `path` if everything
+// succeeded, removes it otherwise
+static bool _m2_commit(int const fd, char *const temporary,
+                       char const *const path, bool ok) {
+    ok = close(fd) == 0 and ok;
+    ok = ok and rename(temporary, path) == 0;
+    if (not ok) {
+        unlink(temporary);
+    }
+    free(temporary);
+    return ok;
+}
+
+bool m2_save(matrix2 const *const m, char const *const path) {
+    PROFILE_SCOPE(m2_save, m->dtype, m->rows * m->cols,
+                  m->rows * m->cols * m->dtype);
+    m2_file_header const header = _m2_file_header(m->rows, m->cols, m->dtype);
+
+    char *const temporary = _m2_temporary_path(path);
+    if (not temporary) {
+        return false;
+    }
+    int const fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(temporary);
+        return false;
+    }
+    bool const ok = _m2_write_header(fd, &header) and
+                    _m2_save_rows(fd, m, header.stride);
+    return _m2_commit(fd, temporary, path, ok);
+}
+
+static bool _m2_read_header(int const fd, m2_file_header *const header) {
+    struct stat st;
+    if (fstat(fd, &st) or
+        pread(fd, header, sizeof(*header), 0) != sizeof(*header) or
+        not _m2_file_valid(header)) {
+        return false;
+    }
+    return (u64)st.st_size >= header->data_offset + _m2_file_data_bytes(header);
+}
+
+bool m2_file_info(char const *const path, m2_file_header *const header) {
+    int const fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool const ok = _m2_read_header(fd, header);
+    close(fd);
+    return ok;
+}
+
+static int const _m2_advice[] = {
+    [M2_ACCESS_NORMAL] = MADV_NORMAL,
+    [M2_ACCESS_SEQUENTIAL] = MADV_SEQUENTIAL,
+    [M2_ACCESS_RANDOM] = MADV_RANDOM,
+    [M2_ACCESS_WILLNEED] = MADV_WILLNEED,
+};
+
+matrix2 m2_map(char const *const path, m2_access const access) {
+    PROFILE_SCOPE(m2_map, 0, 0, 0);
+    matrix2 const failed = {0};
+    m2_file_header header;
+    int const fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return failed;
+    }
+    if (not _m2_read_header(fd, &header)) {
+        close(fd);
+        return failed;
+    }
+
+    size_t const length = header.data_offset + _m2_file_data_bytes(&header);
+    char *const base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return failed;
+    }
+    // advice is only a hint, a kernel ignoring it still gives correct results
+    madvise(base + header.data_offset, length - header.data_offset,
+            _m2_advice[access]);
+
+    return (matrix2){
+        .rows = header.rows,
+        .cols = header.cols,
+        .dtype = header.dtype,
+        .data = base + header.data_offset,
+        .stride = header.stride,
+    };
+}
+
+void m2_unmap(matrix2 const *const m) {
+    if (not m->data) {
+        return;
+    }
+    size_t const bytes =
+        m->rows ? ((m->rows - 1) * m2_stride(m) + m->cols) * m->dtype : 0;
+    munmap((char *)m->data - M2_FILE_DATA_OFFSET, M2_FILE_DATA_OFFSET + bytes);
+}
+
+// out of core multiplication
+
+// Dest is computed one tile at a time, every tile as the sum of the products
+// of the lhs and rhs tiles along the inner dimension. A reader thread copies
+// the operand tiles of the next step out of the mappings into the second of
+// two buffers while the current step is multiplied, so the page faults that
+// read the files overlap with the arithmetic. A tile that is still in its
+// buffer from two steps ago is not copied again. Finished dest tiles are
+// written with pwrite and reach the disk through the page cache.
+
+typedef struct {
+    matrix2 const *lhs;
+    matrix2 const *rhs;
+    Apply perf;
+    size_t tile_rows;
+    size_t tile_inner;
+    size_t tile_cols;
+    size_t tiles_rows;
+    size_t tiles_inner;
+    size_t tiles_cols;
+    size_t steps;
+
+    matrix2 const *a;  // two buffers for each operand
+    matrix2 const *b;
+    size_t a_loaded[2];
+    size_t b_loaded[2];
+
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    bool full[2];
+    bool stop;
+} m2_ooc;
+
+typedef struct {
+    size_t row;
+    size_t inner;
+    size_t col;
+} m2_ooc_step;
+
+static m2_ooc_step _m2_ooc_step(m2_ooc const *const ooc, size_t const step) {
+    size_t const tile = step / ooc->tiles_inner;
+    return (m2_ooc_step){
+        .row = tile / ooc->tiles_cols,
+        .inner = step % ooc->tiles_inner,
+        .col = tile % ooc->tiles_cols,
+    };
+}
+
+static size_t _m2_ooc_extent(size_t const size, size_t const tile,
+                             size_t const index) {
+    return size - index * tile < tile ? size - index * tile : tile;
+}
+
+static void _m2_ooc_copy(matrix2 const *const dest, matrix2 const *const src,
+                         size_t const row, size_t const col) {
+    matrix2 const view = m2_slice(src, row, col, dest->rows, dest->cols);
+    for (size_t i = 0; i < view.rows; ++i) {
+        memcpy(m2_get_from_matrix(dest, 0, i), m2_get_from_matrix(&view, 0, i),
+               view.cols * view.dtype);
+    }
+}
+
+static void _m2_ooc_load(m2_ooc *const ooc, size_t const step,
+                         size_t const slot) {
+    m2_ooc_step const s = _m2_ooc_step(ooc, step);
+    size_t const rows = _m2_ooc_extent(ooc->lhs->rows, ooc->tile_rows, s.row);
+    size_t const inner =
+        _m2_ooc_extent(ooc->lhs->cols, ooc->tile_inner, s.inner);
+    size_t const cols = _m2_ooc_extent(ooc->rhs->cols, ooc->tile_cols, s.col);
+
+    size_t const a_tile = s.row * ooc->tiles_inner + s.inner;
+    if (ooc->a_loaded[slot] != a_tile) {
+        matrix2 const a = m2_slice(&ooc->a[slot], 0, 0, rows, inner);
+        _m2_ooc_copy(&a, ooc->lhs, s.row * ooc->tile_rows,
+                     s.inner * ooc->tile_inner);
+        ooc->a_loaded[slot] = a_tile;
+    }
+    size_t const b_tile = s.inner * ooc->tiles_cols + s.col;
+    if (ooc->b_loaded[slot] != b_tile) {
+        matrix2 const b = m2_slice(&ooc->b[slot], 0, 0, inner, cols);
+        _m2_ooc_copy(&b, ooc->rhs, s.inner * ooc->tile_inner,
+                     s.col * ooc->tile_cols);
+        ooc->b_loaded[slot] = b_tile;
+    }
+}
+
+static void *_m2_ooc_reader(void *arg) {
+    m2_ooc *const ooc = arg;
+    for (size_t step = 0; step < ooc->steps; ++step) {
+        size_t const slot = step % 2;
+        pthread_mutex_lock(&ooc->mutex);
+        while (ooc->full[slot] and not ooc->stop) {
+            pthread_cond_wait(&ooc->changed, &ooc->mutex);
+        }
+        bool const stop = ooc->stop;
+        pthread_mutex_unlock(&ooc->mutex);
+        if (stop) {
+            break;
+        }
+
+        _m2_ooc_load(ooc, step, slot);
+
+        pthread_mutex_lock(&ooc->mutex);
+        ooc->full[slot] = true;
+        pthread_cond_broadcast(&ooc->changed);
+        pthread_mutex_unlock(&ooc->mutex);
+    }
+    return NULL;
+}
+
+// waits until the reader filled `slot`
+static void _m2_ooc_acquire(m2_ooc *const ooc, size_t const slot) {
+    pthread_mutex_lock(&ooc->mutex);
+    while (not ooc->full[slot]) {
+        pthread_cond_wait(&ooc->changed, &ooc->mutex);
+    }
+    pthread_mutex_unlock(&ooc->mutex);
+}
+
+// hands `slot` back to the reader
+static void _m2_ooc_release(m2_ooc *const ooc, size_t const slot) {
+    pthread_mutex_lock(&ooc->mutex);
+    ooc->full[slot] = false;
+    pthread_cond_broadcast(&ooc->changed);
+    pthread_mutex_unlock(&ooc->mutex);
+}
+
+static void _m2_ooc_stop(m2_ooc *const ooc) {
+    pthread_mutex_lock(&ooc->mutex);
+    ooc->stop = true;
+    pthread_cond_broadcast(&ooc->changed);
+    pthread_mutex_unlock(&ooc->mutex);
+}
+
+static size_t _m2_ooc_sqrt(size_t const value) {
+    size_t root = 0;
+    for (size_t bit = (size_t)1 << (sizeof(size_t) * 4 - 1); bit; bit >>= 1) {
+        size_t const next = root | bit;
+        if (next <= value / next) {
+            root = next;
+        }
+    }
+    return root;
+}
+
+// the dest tile and two buffers for each operand tile make up the budget, with
+// square tiles that is 5 t^2 elements. Tiles are rounded down to whole cache
+// lines of elements and the inner size takes what the clamped outer sizes
+// leave
+static void _m2_ooc_tiles(m2_ooc *const ooc, size_t const dtype,
+                          size_t const budget) {
+    size_t const elements = budget / dtype;
+    size_t tile = _m2_ooc_sqrt(elements / 5);
+    size_t const line = M2_ALIGNMENT / dtype ? M2_ALIGNMENT / dtype : 1;
+    if (tile > line) {
+        tile -= tile % line;
+    }
+    tile = tile ? tile : 1;
+
+    size_t const rows = ooc->lhs->rows;
+    size_t const inner = ooc->lhs->cols;
+    size_t const cols = ooc->rhs->cols;
+    ooc->tile_rows = rows < tile ? (rows ? rows : 1) : tile;
+    ooc->tile_cols = cols < tile ? (cols ? cols : 1) : tile;
+    size_t const dest = ooc->tile_rows * ooc->tile_cols;
+    size_t const left = elements > dest ? elements - dest : 0;
+    size_t const fit = left / (2 * (ooc->tile_rows + ooc->tile_cols));
+    ooc->tile_inner = inner < fit ? inner : fit;
+    ooc->tile_inner = ooc->tile_inner ? ooc->tile_inner : 1;
+
+    ooc->tiles_rows = (rows + ooc->tile_rows - 1) / ooc->tile_rows;
+    ooc->tiles_inner = (inner + ooc->tile_inner - 1) / ooc->tile_inner;
+    ooc->tiles_cols = (cols + ooc->tile_cols - 1) / ooc->tile_cols;
+    ooc->steps = ooc->tiles_rows * ooc->tiles_inner * ooc->tiles_cols;
+}
+
+static bool _m2_pwrite(int const fd, void const *const data, size_t size,
+                       off_t offset) {
+    char const *bytes = data;
+    while (size) {
+        ssize_t const written = pwrite(fd, bytes, size, offset);
+        if (written < 0) {
+            return false;
+        }
+        bytes += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+static bool _m2_ooc_store(int const fd, matrix2 const *const tile,
+                          size_t const row, size_t const col,
+                          size_t const stride) {
+    bool ok = true;
+    for (size_t i = 0; ok and i < tile->rows; ++i) {
+        off_t const offset =
+            M2_FILE_DATA_OFFSET + ((row + i) * stride + col) * tile->dtype;
+        ok = _m2_pwrite(fd, m2_get_from_matrix(tile, 0, i),
+                        tile->cols * tile->dtype, offset);
+    }
+    return ok;
+}
+
+static bool _m2_ooc_run(m2_ooc *const ooc, int const fd) {
+    size_t const dtype = ooc->lhs->dtype;
+    size_t const rows = ooc->lhs->rows;
+    size_t const cols = ooc->rhs->cols;
+    size_t const stride = m2_padded_stride(cols, dtype);
+    matrix2 const c = m2_alloc(ooc->tile_rows, ooc->tile_cols, dtype);
+    if (not c.data) {
+        return false;
+    }
+
+    pthread_t reader;
+    if (pthread_create(&reader, NULL, &_m2_ooc_reader, ooc)) {
+        m2_free(&c);
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t step = 0; ok and step < ooc->steps; ++step) {
+        size_t const slot = step % 2;
+        m2_ooc_step const s = _m2_ooc_step(ooc, step);
+        size_t const tile_rows =
+            _m2_ooc_extent(rows, ooc->tile_rows, s.row);
+        size_t const tile_inner =
+            _m2_ooc_extent(ooc->lhs->cols, ooc->tile_inner, s.inner);
+        size_t const tile_cols = _m2_ooc_extent(cols, ooc->tile_cols, s.col);
+        matrix2 const a = m2_slice(&ooc->a[slot], 0, 0, tile_rows, tile_inner);
+        matrix2 const b = m2_slice(&ooc->b[slot], 0, 0, tile_inner, tile_cols);
+        matrix2 dest = m2_slice(&c, 0, 0, tile_rows, tile_cols);
+
+        _m2_ooc_acquire(ooc, slot);
+        if (s.inner) {
+            m2_mult_add(&dest, &a, &b, ooc->perf);
+        } else {
+            m2_mult(&dest, &a, &b, ooc->perf);
+        }
+        _m2_ooc_release(ooc, slot);
+
+        if (s.inner + 1 == ooc->tiles_inner) {
+            ok = _m2_ooc_store(fd, &dest, s.row * ooc->tile_rows,
+                               s.col * ooc->tile_cols, stride);
+        }
+    }
+
+    _m2_ooc_stop(ooc);
+    pthread_join(reader, NULL);
+    m2_free(&c);
+    return ok;
+}
+
+// multiplies into a temporary file renamed to `path` once complete
+static bool _m2_ooc_write(m2_ooc *const ooc, char const *const path) {
+    char *const temporary = _m2_temporary_path(path);
+    if (not temporary) {
+        return false;
+    }
+    int const fd = open(temporary, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(temporary);
+        return false;
+    }
+
+    // the file is sized up front, so the elements of an empty inner dimension
+    // read as zero
+    m2_file_header const header =
+        _m2_file_header(ooc->lhs->rows, ooc->rhs->cols, ooc->lhs->dtype);
+    bool ok = _m2_write_header(fd, &header) and
+              ftruncate(fd, header.data_offset +
+                                _m2_file_data_bytes(&header)) == 0;
+
+    pthread_mutex_init(&ooc->mutex, NULL);
+    pthread_cond_init(&ooc->changed, NULL);
+    ok = ok and _m2_ooc_run(ooc, fd);
+    pthread_cond_destroy(&ooc->changed);
+    pthread_mutex_destroy(&ooc->mutex);
+
+    return _m2_commit(fd, temporary, path, ok);
+}
+
+static bool _m2_ooc_buffers(m2_ooc *const ooc, char const *const path) {
+    size_t const dtype = ooc->lhs->dtype;
+    matrix2 const a[2] = {
+        m2_alloc(ooc->tile_rows, ooc->tile_inner, dtype),
+        m2_alloc(ooc->tile_rows, ooc->tile_inner, dtype),
+    };
+    matrix2 const b[2] = {
+        m2_alloc(ooc->tile_inner, ooc->tile_cols, dtype),
+        m2_alloc(ooc->tile_inner, ooc->tile_cols, dtype),
+    };
+    ooc->a = a;
+    ooc->b = b;
+
+    bool const ok = a[0].data and a[1].data and b[0].data and b[1].data and
+                    _m2_ooc_write(ooc, path);
+    for (size_t slot = 0; slot < 2; ++slot) {
+        m2_free(&a[slot]);
+        m2_free(&b[slot]);
+    }
+    return ok;
+}
+
+bool m2_mult_file(char const *const dest_path, char const *const lhs_path,
+                  char const *const rhs_path, Apply perf,
+                  size_t const memory_budget) {
+    PROFILE_SCOPE(m2_mult_file, 0, 0, 0);
+    matrix2 const lhs = m2_map(lhs_path, M2_ACCESS_NORMAL);
+    matrix2 const rhs = m2_map(rhs_path, M2_ACCESS_NORMAL);
+    bool ok = lhs.data and rhs.data and lhs.cols == rhs.rows and
+              lhs.dtype == rhs.dtype;
+
+    if (ok) {
+        m2_ooc ooc = {
+            .lhs = &lhs,
+            .rhs = &rhs,
+            .perf = perf,
+            .a_loaded = {SIZE_MAX, SIZE_MAX},
+            .b_loaded = {SIZE_MAX, SIZE_MAX},
+        };
+        _m2_ooc_tiles(&ooc, lhs.dtype, memory_budget);
+        ok = _m2_ooc_buffers(&ooc, dest_path);
+    }
+
+    m2_unmap(&lhs);
+    m2_unmap(&rhs);
+    return ok;
+}
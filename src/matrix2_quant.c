@@ -0,0 +1,228 @@
+#include <matrix2_quant.h>
+//
+#include <gemm.h>
+#include <math.h>
+#include <profile.h>
+#include <stdint.h>
+
+// accumulators of 8 bit products are computed for a band of rows of dest at a
+// time and requantized while they are still in cache. Bands hold at least
+// M2_QUANT_MIN_BAND rows, gemm_q8 packs rhs again for every band
+#define M2_QUANT_BAND_BYTES (1 << 20)
+#define M2_QUANT_MIN_BAND 64
+
+size_t m2_quant_dtype(m2_quant_type const type) {
+    switch (type) {
+        case M2_QUANT_U8:
+        case M2_QUANT_I8:
+            return sizeof(u8);
+        case M2_QUANT_I16:
+            return sizeof(i16);
+        case M2_QUANT_I32:
+            return sizeof(i32);
+        case M2_QUANT_I64:
+            return sizeof(i64);
+        case M2_QUANT_F32:
+            return sizeof(f32);
+    }
+    return 0;
+}
+
+// scale and zero point of every element of a row of dest, steps are 0 when
+// they are shared by the whole row
+typedef struct {
+    f32 const *scale;
+    size_t scale_step;
+    i32 const *zero;
+    size_t zero_step;
+} m2_quant_row;
+
+static m2_quant_row _m2_quant_row(m2_quant const *const quant,
+                                  size_t const row) {
+    static i32 const no_zero = 0;
+    size_t const index = quant->axis == M2_QUANT_ROW ? row : 0;
+    size_t const step = quant->axis == M2_QUANT_COL;
+    return (m2_quant_row){
+        quant->scale ? quant->scale + index : NULL,
+        step,
+        quant->zero_point ? quant->zero_point + index : &no_zero,
+        quant->zero_point ? step : 0,
+    };
+}
+
+// requantizes a row of `cols` accumulators, i64 ones if `wide` is set and i32
+// ones otherwise. `dest` may be `acc` when the element sizes match
+
+typedef void (*m2_quant_store)(void *const dest, size_t const cols,
+                               void const *const acc, bool const wide,
+                               m2_quant_row const *const row);
+
+#define DEFINE_QUANT_STORE(Type, Min, Max)                                     \
+    static void _m2_quant_store_##Type(void *const dest, size_t const cols,    \
+                                       void const *const acc, bool const wide, \
+                                       m2_quant_row const *const row) {        \
+        Type *const out = dest;                                                \
+        for (size_t j = 0; j < cols; ++j) {                                    \
+            i64 const value =                                                  \
+                wide ? ((i64 const *)acc)[j] : ((i32 const *)acc)[j];          \
+            i32 const zero = row->zero[j * row->zero_step];                    \
+            if (row->scale) {                                                  \
+                f64 const x =                                                  \
+                    nearbyint(value * (f64)row->scale[j * row->scale_step]) +  \
+                    zero;                                                      \
+                out[j] = x <= (f64)Min ? Min : x >= (f64)Max ? Max : (Type)x;  \
+                continue;                                                      \
+            }                                                                  \
+            i64 sum;                                                           \
+            if (__builtin_add_overflow(value, (i64)zero, &sum)) {              \
+                sum = value < 0 ? INT64_MIN : INT64_MAX;                       \
+            }                                                                  \
+            out[j] = sum <= Min ? Min : sum >= Max ? Max : (Type)sum;          \
+        }                                                                      \
+    }
+
+DEFINE_QUANT_STORE(u8, 0, UINT8_MAX)
+DEFINE_QUANT_STORE(i8, INT8_MIN, INT8_MAX)
+DEFINE_QUANT_STORE(i16, INT16_MIN, INT16_MAX)
+DEFINE_QUANT_STORE(i32, INT32_MIN, INT32_MAX)
+DEFINE_QUANT_STORE(i64, INT64_MIN, INT64_MAX)
+
+static void _m2_quant_store_f32(void *const dest, size_t const cols,
+                                void const *const acc, bool const wide,
+                                m2_quant_row const *const row) {
+    f32 *const out = dest;
+    for (size_t j = 0; j < cols; ++j) {
+        f64 const value = wide ? ((i64 const *)acc)[j] : ((i32 const *)acc)[j];
+        f64 const scale = row->scale ? row->scale[j * row->scale_step] : 1;
+        out[j] = value * scale + row->zero[j * row->zero_step];
+    }
+}
+
+static m2_quant_store _m2_quant_storer(m2_quant_type const type) {
+    switch (type) {
+        case M2_QUANT_U8:
+            return &_m2_quant_store_u8;
+        case M2_QUANT_I8:
+            return &_m2_quant_store_i8;
+        case M2_QUANT_I16:
+            return &_m2_quant_store_i16;
+        case M2_QUANT_I32:
+            return &_m2_quant_store_i32;
+        case M2_QUANT_I64:
+            return &_m2_quant_store_i64;
+        case M2_QUANT_F32:
+            return &_m2_quant_store_f32;
+    }
+    return NULL;
+}
+
+// 8 bit operands, accumulators are computed in place when dest has i32 sized
+// elements and in `buffer` otherwise
+static void _m2_mult_q8(matrix2 *const dest, matrix2 const *const lhs,
+                        matrix2 const *const rhs, m2_quant const *const quant,
+                        i32 *const buffer, size_t const band) {
+    m2_quant_store const store = _m2_quant_storer(quant->dest);
+    bool const in_place = not buffer;
+    size_t const acc_ld = in_place ? m2_stride(dest) : dest->cols;
+    gemm_q8_operand const b = {rhs->data, m2_stride(rhs),
+                               quant->rhs == M2_QUANT_I8,
+                               quant->rhs_zero_point};
+
+    for (size_t row = 0; row < dest->rows; row += band) {
+        size_t const rows = band < dest->rows - row ? band : dest->rows - row;
+        i32 *const acc =
+            in_place ? (i32 *)m2_get_from_matrix(dest, 0, row) : buffer;
+        for (size_t i = 0; i < rows; ++i) {
+            memset(acc + i * acc_ld, 0, dest->cols * sizeof(i32));
+        }
+
+        gemm_q8_operand const a = {m2_get_from_matrix(lhs, 0, row),
+                                   m2_stride(lhs), quant->lhs == M2_QUANT_I8,
+                                   quant->lhs_zero_point};
+        gemm_q8(rows, dest->cols, lhs->cols, &a, &b, acc, acc_ld);
+
+        for (size_t i = 0; i < rows; ++i) {
+            m2_quant_row const scaling = _m2_quant_row(quant, row + i);
+            store(m2_get_from_matrix(dest, 0, row + i), dest->cols,
+                  acc + i * acc_ld, false, &scaling);
+        }
+    }
+}
+
+// i16 operands, one row of i64 accumulators at a time
+static void _m2_mult_q16(matrix2 *const dest, matrix2 const *const lhs,
+                         matrix2 const *const rhs, m2_quant const *const quant,
+                         i64 *const buffer) {
+    m2_quant_store const store = _m2_quant_storer(quant->dest);
+    i64 const lhs_zero = quant->lhs_zero_point;
+    i64 const rhs_zero = quant->rhs_zero_point;
+
+    for (size_t i = 0; i < dest->rows; ++i) {
+        i64 *const acc =
+            buffer ? buffer : (i64 *)m2_get_from_matrix(dest, 0, i);
+        i16 const *const a = (i16 const *)m2_get_from_matrix(lhs, 0, i);
+        memset(acc, 0, dest->cols * sizeof(i64));
+
+        for (size_t k = 0; k < lhs->cols; ++k) {
+            i64 const x = a[k] - lhs_zero;
+            i16 const *const b = (i16 const *)m2_get_from_matrix(rhs, 0, k);
+            for (size_t j = 0; x and j < dest->cols; ++j) {
+                acc[j] += x * (b[j] - rhs_zero);
+            }
+        }
+
+        m2_quant_row const scaling = _m2_quant_row(quant, i);
+        store(m2_get_from_matrix(dest, 0, i), dest->cols, acc, true, &scaling);
+    }
+}
+
+static bool _m2_quant_is_q8(m2_quant_type const type) {
+    return type == M2_QUANT_U8 or type == M2_QUANT_I8;
+}
+
+bool m2_mult_quantized(matrix2 *const dest, matrix2 const *const lhs,
+                       matrix2 const *const rhs, m2_quant const *const quant) {
+    PROFILE_SCOPE(m2_mult_quantized, dest->dtype, dest->rows * dest->cols,
+                  (dest->rows * dest->cols + lhs->rows * lhs->cols +
+                   rhs->rows * rhs->cols) *
+                      dest->dtype);
+    assert(dest->rows == lhs->rows and dest->cols == rhs->cols and
+           lhs->cols == rhs->rows and
+           dest->dtype == m2_quant_dtype(quant->dest) and
+           lhs->dtype == m2_quant_dtype(quant->lhs) and
+           rhs->dtype == m2_quant_dtype(quant->rhs));
+
+    if (not dest->rows or not dest->cols) {
+        return true;
+    }
+
+    if (quant->lhs == M2_QUANT_I16 and quant->rhs == M2_QUANT_I16) {
+        i64 *buffer = NULL;
+        if (dest->dtype != sizeof(i64)) {
+            buffer = malloc(dest->cols * sizeof(i64));
+            if (not buffer) {
+                return false;
+            }
+        }
+        _m2_mult_q16(dest, lhs, rhs, quant, buffer);
+        free(buffer);
+        return true;
+    }
+
+    assert(_m2_quant_is_q8(quant->lhs) and _m2_quant_is_q8(quant->rhs));
+
+    size_t band = M2_QUANT_BAND_BYTES / (dest->cols * sizeof(i32));
+    band = band < M2_QUANT_MIN_BAND ? M2_QUANT_MIN_BAND : band;
+    band = band < dest->rows ? band : dest->rows;
+
+    i32 *buffer = NULL;
+    if (dest->dtype != sizeof(i32)) {
+        buffer = malloc(band * dest->cols * sizeof(i32));
+        if (not buffer) {
+            return false;
+        }
+    }
+    _m2_mult_q8(dest, lhs, rhs, quant, buffer, band);
+    free(buffer);
+    return true;
+}
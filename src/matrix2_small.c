@@ -0,0 +1,302 @@
+#include <matrix2_small.h>
+//
+#include <matrix2_macro_helpers.h>
+#include <profile.h>
+
+// matrices of a batch multiplied together, the unrolled products run over a
+// block of this many lanes, one per matrix, and the last partial block of a
+// batch is zero padded to the same length
+#define M2_SMALL_LANES 16
+
+// Arithmetic is done in `acc`, a local typedef of the type named by the
+// traits below. Integer types compute in an unsigned type at least 32 bits
+// wide, which wraps instead of overflowing and gives the same low bits as
+// the arithmetic of the type itself, floats compute in their own type.
+
+#define M2_SMALL_UNIT_FLOAT(Type, det) ((det) != 0)
+#define M2_SMALL_UNIT_INTEGER(Type, det) ((det) == 1 or (det) == (Type)-1)
+#define M2_SMALL_RECIPROCAL_FLOAT(det) (1 / (det))
+#define M2_SMALL_RECIPROCAL_INTEGER(det) (det)
+
+#define M2_SMALL_TRAITS_f32 f32, M2_SMALL_UNIT_FLOAT, M2_SMALL_RECIPROCAL_FLOAT
+#define M2_SMALL_TRAITS_f64 f64, M2_SMALL_UNIT_FLOAT, M2_SMALL_RECIPROCAL_FLOAT
+#define M2_SMALL_TRAITS_i8 \
+    u32, M2_SMALL_UNIT_INTEGER, M2_SMALL_RECIPROCAL_INTEGER
+#define M2_SMALL_TRAITS_i16 \
+    u32, M2_SMALL_UNIT_INTEGER, M2_SMALL_RECIPROCAL_INTEGER
+#define M2_SMALL_TRAITS_i32 \
+    u32, M2_SMALL_UNIT_INTEGER, M2_SMALL_RECIPROCAL_INTEGER
+#define M2_SMALL_TRAITS_i64 \
+    u64, M2_SMALL_UNIT_INTEGER, M2_SMALL_RECIPROCAL_INTEGER
+#define M2_SMALL_TRAITS_u8 \
+    u32, M2_SMALL_UNIT_INTEGER, M2_SMALL_RECIPROCAL_INTEGER
+#define M2_SMALL_TRAITS_u16 \
+    u32, M2_SMALL_UNIT_INTEGER, M2_SMALL_RECIPROCAL_INTEGER
+#define M2_SMALL_TRAITS_u32 \
+    u32, M2_SMALL_UNIT_INTEGER, M2_SMALL_RECIPROCAL_INTEGER
+#define M2_SMALL_TRAITS_u64 \
+    u64, M2_SMALL_UNIT_INTEGER, M2_SMALL_RECIPROCAL_INTEGER
+
+// element (i, j) of an n x n operand whose elements are `s` apart
+#define M2_SMALL_AT(a, s, n, i, j) ((acc)(a)[((i) * (n) + (j)) * (s)])
+
+#define M2_SMALL_DOT_2(a, b, s, i, j)                          \
+    (M2_SMALL_AT(a, s, 2, i, 0) * M2_SMALL_AT(b, s, 2, 0, j) + \
+     M2_SMALL_AT(a, s, 2, i, 1) * M2_SMALL_AT(b, s, 2, 1, j))
+
+#define M2_SMALL_DOT_3(a, b, s, i, j)                          \
+    (M2_SMALL_AT(a, s, 3, i, 0) * M2_SMALL_AT(b, s, 3, 0, j) + \
+     M2_SMALL_AT(a, s, 3, i, 1) * M2_SMALL_AT(b, s, 3, 1, j) + \
+     M2_SMALL_AT(a, s, 3, i, 2) * M2_SMALL_AT(b, s, 3, 2, j))
+
+#define M2_SMALL_DOT_4(a, b, s, i, j)                          \
+    (M2_SMALL_AT(a, s, 4, i, 0) * M2_SMALL_AT(b, s, 4, 0, j) + \
+     M2_SMALL_AT(a, s, 4, i, 1) * M2_SMALL_AT(b, s, 4, 1, j) + \
+     M2_SMALL_AT(a, s, 4, i, 2) * M2_SMALL_AT(b, s, 4, 2, j) + \
+     M2_SMALL_AT(a, s, 4, i, 3) * M2_SMALL_AT(b, s, 4, 3, j))
+
+// expands X(N, i, j) for every element of an N x N matrix
+#define M2_SMALL_EACH_2(X, N) X(N, 0, 0) X(N, 0, 1) X(N, 1, 0) X(N, 1, 1)
+
+#define M2_SMALL_EACH_3(X, N)                                      \
+    X(N, 0, 0) X(N, 0, 1) X(N, 0, 2) X(N, 1, 0) X(N, 1, 1) X(N, 1, 2) \
+        X(N, 2, 0) X(N, 2, 1) X(N, 2, 2)
+
+#define M2_SMALL_EACH_4(X, N)                                      \
+    X(N, 0, 0) X(N, 0, 1) X(N, 0, 2) X(N, 0, 3) X(N, 1, 0) X(N, 1, 1) \
+        X(N, 1, 2) X(N, 1, 3) X(N, 2, 0) X(N, 2, 1) X(N, 2, 2)        \
+            X(N, 2, 3) X(N, 3, 0) X(N, 3, 1) X(N, 3, 2) X(N, 3, 3)
+
+#define M2_SMALL_PRODUCT(N, i, j) \
+    result[(i) * N + (j)] = M2_SMALL_DOT_##N(lhs, rhs, 1, i, j);
+
+#define M2_SMALL_BATCH_PRODUCT(N, i, j) \
+    result[(i) * N + (j)][k] =          \
+        M2_SMALL_DOT_##N(lhs + k, rhs + k, stride, i, j);
+
+// products
+
+#define DEFINE_SMALL_MULT(Type, Acc, N)                                      \
+    void m2_mult_##N##x##N##_##Type(Type *const dest, Type const *const lhs, \
+                                    Type const *const rhs) {                 \
+        typedef Acc acc;                                                     \
+        Type result[N * N];                                                  \
+        M2_SMALL_EACH_##N(M2_SMALL_PRODUCT, N)                               \
+        memcpy(dest, result, sizeof(result));                                \
+    }                                                                        \
+                                                                             \
+    /* `lanes` matrices of dest starting at `dest`, operand elements are */  \
+    /* `stride` apart and results `count` apart */                           \
+    static void _m2_mult_block_##N##x##N##_##Type(                           \
+        Type *const dest, Type const *const lhs, Type const *const rhs,      \
+        size_t const stride, size_t const count, size_t const lanes) {       \
+        typedef Acc acc;                                                     \
+        Type result[N * N][M2_SMALL_LANES];                                  \
+        for (size_t k = 0; k < M2_SMALL_LANES; ++k) {                        \
+            M2_SMALL_EACH_##N(M2_SMALL_BATCH_PRODUCT, N)                     \
+        }                                                                    \
+        for (size_t e = 0; e < N * N; ++e) {                                 \
+            memcpy(dest + e * count, result[e], lanes * sizeof(Type));       \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    static void _m2_mult_batched_##N##x##N##_##Type(                         \
+        Type *const dest, Type const *const lhs, Type const *const rhs,      \
+        size_t const count) {                                                \
+        size_t base = 0;                                                     \
+        for (; base + M2_SMALL_LANES <= count; base += M2_SMALL_LANES) {     \
+            _m2_mult_block_##N##x##N##_##Type(dest + base, lhs + base,       \
+                                              rhs + base, count, count,      \
+                                              M2_SMALL_LANES);               \
+        }                                                                    \
+        if (base == count) {                                                 \
+            return;                                                          \
+        }                                                                    \
+        /* the last partial block runs on zero padded copies */              \
+        size_t const rest = count - base;                                    \
+        Type l[N * N * M2_SMALL_LANES] = {0};                                \
+        Type r[N * N * M2_SMALL_LANES] = {0};                                \
+        for (size_t e = 0; e < N * N; ++e) {                                 \
+            memcpy(l + e * M2_SMALL_LANES, lhs + e * count + base,           \
+                   rest * sizeof(Type));                                     \
+            memcpy(r + e * M2_SMALL_LANES, rhs + e * count + base,           \
+                   rest * sizeof(Type));                                     \
+        }                                                                    \
+        _m2_mult_block_##N##x##N##_##Type(dest + base, l, r, M2_SMALL_LANES, \
+                                          count, rest);                      \
+    }
+
+// any other size, every result element is accumulated over the inner index
+// one lane array at a time
+#define DEFINE_SMALL_MULT_BATCHED(Type, Acc)                                   \
+    static void _m2_mult_batched_##Type(Type *const dest,                      \
+                                        Type const *const lhs,                 \
+                                        Type const *const rhs, size_t const n, \
+                                        size_t const count) {                  \
+        typedef Acc acc;                                                       \
+        for (size_t base = 0; base < count; base += M2_SMALL_LANES) {          \
+            size_t const end = count - base < M2_SMALL_LANES                   \
+                                   ? count                                     \
+                                   : base + M2_SMALL_LANES;                    \
+            for (size_t i = 0; i < n; ++i) {                                   \
+                for (size_t j = 0; j < n; ++j) {                               \
+                    Type *const d = dest + (i * n + j) * count;                \
+                    for (size_t b = base; b < end; ++b) {                      \
+                        d[b] = 0;                                              \
+                    }                                                          \
+                    for (size_t k = 0; k < n; ++k) {                           \
+                        Type const *const l = lhs + (i * n + k) * count;       \
+                        Type const *const r = rhs + (k * n + j) * count;       \
+                        for (size_t b = base; b < end; ++b) {                  \
+                            d[b] = (acc)d[b] + (acc)l[b] * (acc)r[b];          \
+                        }                                                      \
+                    }                                                          \
+                }                                                              \
+            }                                                                  \
+        }                                                                      \
+    }
+
+// determinants and inverses
+//
+// The 4x4 versions expand along the first two rows: s are the 2x2 minors of
+// rows 0 and 1, c those of rows 2 and 3, and every cofactor is a combination
+// of one row and the minors of the other pair.
+
+#define M2_SMALL_LOAD_2(m) \
+    acc const a00 = m[0], a01 = m[1], a10 = m[2], a11 = m[3];
+
+#define M2_SMALL_LOAD_3(m)                                             \
+    acc const a00 = m[0], a01 = m[1], a02 = m[2], a10 = m[3], a11 = m[4], \
+              a12 = m[5], a20 = m[6], a21 = m[7], a22 = m[8];
+
+#define M2_SMALL_LOAD_4(m)                                                  \
+    acc const a00 = m[0], a01 = m[1], a02 = m[2], a03 = m[3], a10 = m[4],   \
+              a11 = m[5], a12 = m[6], a13 = m[7], a20 = m[8], a21 = m[9],   \
+              a22 = m[10], a23 = m[11], a30 = m[12], a31 = m[13],           \
+              a32 = m[14], a33 = m[15];                                     \
+    acc const s0 = a00 * a11 - a10 * a01, s1 = a00 * a12 - a10 * a02,       \
+              s2 = a00 * a13 - a10 * a03, s3 = a01 * a12 - a11 * a02,       \
+              s4 = a01 * a13 - a11 * a03, s5 = a02 * a13 - a12 * a03;       \
+    acc const c0 = a20 * a31 - a30 * a21, c1 = a20 * a32 - a30 * a22,       \
+              c2 = a20 * a33 - a30 * a23, c3 = a21 * a32 - a31 * a22,       \
+              c4 = a21 * a33 - a31 * a23, c5 = a22 * a33 - a32 * a23;
+
+#define M2_SMALL_DET_2 (a00 * a11 - a01 * a10)
+#define M2_SMALL_DET_3                                                     \
+    (a00 * (a11 * a22 - a12 * a21) - a01 * (a10 * a22 - a12 * a20) + \
+     a02 * (a10 * a21 - a11 * a20))
+#define M2_SMALL_DET_4 \
+    (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0)
+
+#define M2_SMALL_ADJUGATE_2(b) \
+    b[0] = a11;                \
+    b[1] = -a01;               \
+    b[2] = -a10;               \
+    b[3] = a00;
+
+#define M2_SMALL_ADJUGATE_3(b)    \
+    b[0] = a11 * a22 - a12 * a21; \
+    b[1] = a02 * a21 - a01 * a22; \
+    b[2] = a01 * a12 - a02 * a11; \
+    b[3] = a12 * a20 - a10 * a22; \
+    b[4] = a00 * a22 - a02 * a20; \
+    b[5] = a02 * a10 - a00 * a12; \
+    b[6] = a10 * a21 - a11 * a20; \
+    b[7] = a01 * a20 - a00 * a21; \
+    b[8] = a00 * a11 - a01 * a10;
+
+#define M2_SMALL_ADJUGATE_4(b)                  \
+    b[0] = a11 * c5 - a12 * c4 + a13 * c3;      \
+    b[1] = -a01 * c5 + a02 * c4 - a03 * c3;     \
+    b[2] = a31 * s5 - a32 * s4 + a33 * s3;      \
+    b[3] = -a21 * s5 + a22 * s4 - a23 * s3;     \
+    b[4] = -a10 * c5 + a12 * c2 - a13 * c1;     \
+    b[5] = a00 * c5 - a02 * c2 + a03 * c1;      \
+    b[6] = -a30 * s5 + a32 * s2 - a33 * s1;     \
+    b[7] = a20 * s5 - a22 * s2 + a23 * s1;      \
+    b[8] = a10 * c4 - a11 * c2 + a13 * c0;      \
+    b[9] = -a00 * c4 + a01 * c2 - a03 * c0;     \
+    b[10] = a30 * s4 - a31 * s2 + a33 * s0;     \
+    b[11] = -a20 * s4 + a21 * s2 - a23 * s0;    \
+    b[12] = -a10 * c3 + a11 * c1 - a12 * c0;    \
+    b[13] = a00 * c3 - a01 * c1 + a02 * c0;     \
+    b[14] = -a30 * s3 + a31 * s1 - a32 * s0;    \
+    b[15] = a20 * s3 - a21 * s1 + a22 * s0;
+
+#define DEFINE_SMALL_INVERSE(Type, Acc, UNIT, RECIPROCAL, N)                  \
+    Type m2_det_##N##x##N##_##Type(Type const *const m) {                     \
+        typedef Acc acc;                                                      \
+        M2_SMALL_LOAD_##N(m);                                                 \
+        return M2_SMALL_DET_##N;                                              \
+    }                                                                         \
+                                                                              \
+    bool m2_inverse_##N##x##N##_##Type(Type *const dest,                      \
+                                       Type const *const m) {                 \
+        typedef Acc acc;                                                      \
+        M2_SMALL_LOAD_##N(m);                                                 \
+        Type const det = M2_SMALL_DET_##N;                                    \
+        if (not UNIT(Type, det)) {                                            \
+            return false;                                                     \
+        }                                                                     \
+        acc const scale = RECIPROCAL((acc)det);                               \
+        acc adjugate[N * N];                                                  \
+        M2_SMALL_ADJUGATE_##N(adjugate)                                       \
+        for (size_t i = 0; i < N * N; ++i) {                                  \
+            dest[i] = adjugate[i] * scale;                                    \
+        }                                                                     \
+        return true;                                                          \
+    }
+
+#define DEFINE_SMALL_MATRIX_OPS_(Type, Acc, UNIT, RECIPROCAL) \
+    DEFINE_SMALL_MULT(Type, Acc, 2)                           \
+    DEFINE_SMALL_MULT(Type, Acc, 3)                           \
+    DEFINE_SMALL_MULT(Type, Acc, 4)                           \
+    DEFINE_SMALL_MULT_BATCHED(Type, Acc)                      \
+    DEFINE_SMALL_INVERSE(Type, Acc, UNIT, RECIPROCAL, 2)      \
+    DEFINE_SMALL_INVERSE(Type, Acc, UNIT, RECIPROCAL, 3)      \
+    DEFINE_SMALL_INVERSE(Type, Acc, UNIT, RECIPROCAL, 4)
+
+#define DEFINE_SMALL_MATRIX_OPS_EXPAND(...) DEFINE_SMALL_MATRIX_OPS_(__VA_ARGS__)
+#define DEFINE_SMALL_MATRIX_OPS(Type) \
+    DEFINE_SMALL_MATRIX_OPS_EXPAND(Type, M2_SMALL_TRAITS_##Type)
+
+FOR_ALL_TYPES(DEFINE_SMALL_MATRIX_OPS)
+
+// batched products
+
+#define DISPATCH_SMALL_BATCHED(Type)                                          \
+    if (perf == &Type##_apply_add and dtype == sizeof(Type)) {                \
+        switch (n) {                                                          \
+            case 2: _m2_mult_batched_2x2_##Type(dest, lhs, rhs, count); break; \
+            case 3: _m2_mult_batched_3x3_##Type(dest, lhs, rhs, count); break; \
+            case 4: _m2_mult_batched_4x4_##Type(dest, lhs, rhs, count); break; \
+            default: _m2_mult_batched_##Type(dest, lhs, rhs, n, count);       \
+        }                                                                     \
+        return;                                                               \
+    }
+
+void m2_mult_batched(void *const dest, void const *const lhs,
+                     void const *const rhs, size_t const n, size_t const count,
+                     size_t const dtype, Apply perf) {
+    PROFILE_SCOPE(m2_mult_batched, dtype, n * n * count,
+                  3 * n * n * count * dtype);
+    assert(dtype);
+
+    FOR_ALL_TYPES(DISPATCH_SMALL_BATCHED)
+
+    memset(dest, 0, n * n * count * dtype);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            char *const d = (char *)dest + (i * n + j) * count * dtype;
+            for (size_t k = 0; k < n; ++k) {
+                char const *const l =
+                    (char const *)lhs + (i * n + k) * count * dtype;
+                char const *const r =
+                    (char const *)rhs + (k * n + j) * count * dtype;
+                for (size_t b = 0; b < count; ++b) {
+                    perf(d + b * dtype, l + b * dtype, r + b * dtype);
+                }
+            }
+        }
+    }
+}
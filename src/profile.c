@@ -0,0 +1,360 @@
+#include <profile.h>
+//
+#include <assert.h>
+#include <iso646.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PROFILE_X86
+#include <x86intrin.h>
+#endif
+
+#define PROFILE_TRACE_DEFAULT_CAPACITY (1 << 16)
+// interval the time stamp counter is measured against the monotonic clock
+#define PROFILE_CALIBRATION_NS 20000000
+
+enum {
+    PROFILE_CALLS,
+    PROFILE_ELEMENTS,
+    PROFILE_BYTES,
+    PROFILE_TICKS,
+    PROFILE_FIELDS,
+};
+
+typedef struct {
+    u32 op;
+    u32 dtype;
+    u64 elements;
+    u64 bytes;
+    u64 start;
+    u64 end;
+} profile_event;
+
+// Every thread owns one of these and is the only one writing it. Counters are
+// atomics only so that profile_snapshot may read them at any time, the owner
+// updates them with a relaxed load and store that compile to plain moves.
+// Entries are never freed, so the totals of exited threads are kept.
+typedef struct profile_thread {
+    struct profile_thread *next;
+    size_t id;
+    _Atomic u64 counters[PROFILE_OP_COUNT][PROFILE_DTYPE_COUNT]
+                        [PROFILE_FIELDS];
+
+    profile_event *events;
+    size_t capacity;
+    _Atomic size_t count;
+    _Atomic u64 dropped;
+    _Atomic u64 generation;
+} profile_thread;
+
+static pthread_mutex_t _profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static profile_thread *_profile_threads;
+static size_t _profile_thread_count;
+static _Thread_local profile_thread *_profile_self;
+
+// totals at the last profile_reset, subtracted by profile_snapshot
+static u64 _profile_baseline[PROFILE_OP_COUNT][PROFILE_DTYPE_COUNT]
+                            [PROFILE_FIELDS];
+
+// tracing is active while the generation is odd, buffers recorded for an
+// older generation are restarted by their owner on its next span
+static _Atomic u64 _profile_trace_generation;
+static _Atomic size_t _profile_trace_capacity;
+static u64 _profile_trace_origin;
+
+#define PROFILE_OP_NAME(Group, Name) #Name,
+#define PROFILE_OP_GROUP(Group, Name) #Group,
+
+static char const *const _profile_op_names[] = {
+    FOR_ALL_PROFILE_OPS(PROFILE_OP_NAME)};
+static char const *const _profile_op_groups[] = {
+    FOR_ALL_PROFILE_OPS(PROFILE_OP_GROUP)};
+
+static size_t const _profile_dtype_sizes[PROFILE_DTYPE_COUNT] = {1, 2, 4, 8,
+                                                                 0};
+
+bool profile_enabled() {
+#ifdef PROFILE_ENABLED
+    return true;
+#else
+    return false;
+#endif
+}
+
+static u64 _profile_clock_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64)now.tv_sec * 1000000000ull + (u64)now.tv_nsec;
+}
+
+u64 profile_ticks() {
+#ifdef PROFILE_X86
+    return __rdtsc();
+#else
+    return _profile_clock_ns();
+#endif
+}
+
+static f64 _profile_ticks_per_second_value = 1e9;
+static pthread_once_t _profile_calibration_once = PTHREAD_ONCE_INIT;
+
+static void _profile_calibrate() {
+#ifdef PROFILE_X86
+    u64 const ns0 = _profile_clock_ns();
+    u64 const tsc0 = __rdtsc();
+    u64 ns1;
+    do {
+        ns1 = _profile_clock_ns();
+    } while (ns1 - ns0 < PROFILE_CALIBRATION_NS);
+    u64 const tsc1 = __rdtsc();
+    _profile_ticks_per_second_value = (f64)(tsc1 - tsc0) * 1e9 / (ns1 - ns0);
+#endif
+}
+
+static f64 _profile_ticks_per_second() {
+    pthread_once(&_profile_calibration_once, &_profile_calibrate);
+    return _profile_ticks_per_second_value;
+}
+
+static size_t _profile_dtype_slot(i64 const dtype) {
+    switch (dtype < 0 ? -dtype : dtype) {
+        case 1: return 0;
+        case 2: return 1;
+        case 4: return 2;
+        case 8: return 3;
+        default: return 4;
+    }
+}
+
+static profile_thread *_profile_register() {
+    profile_thread *const self = calloc(1, sizeof(profile_thread));
+    assert(self);
+    pthread_mutex_lock(&_profile_lock);
+    self->id = ++_profile_thread_count;
+    self->next = _profile_threads;
+    _profile_threads = self;
+    pthread_mutex_unlock(&_profile_lock);
+    return self;
+}
+
+static inline void _profile_add(_Atomic u64 *const counter, u64 const value) {
+    atomic_store_explicit(
+        counter, atomic_load_explicit(counter, memory_order_relaxed) + value,
+        memory_order_relaxed);
+}
+
+static void _profile_record(profile_thread *const self,
+                            profile_span const *const span, u64 const end) {
+    u64 const generation = atomic_load_explicit(&_profile_trace_generation,
+                                                memory_order_acquire);
+    if (not(generation & 1)) {
+        return;
+    }
+    if (atomic_load_explicit(&self->generation, memory_order_relaxed) !=
+        generation) {
+        size_t const capacity = atomic_load_explicit(
+            &_profile_trace_capacity, memory_order_relaxed);
+        if (self->capacity != capacity) {
+            free(self->events);
+            self->events = malloc(capacity * sizeof(profile_event));
+            self->capacity = self->events ? capacity : 0;
+        }
+        atomic_store_explicit(&self->count, 0, memory_order_relaxed);
+        atomic_store_explicit(&self->dropped, 0, memory_order_relaxed);
+        atomic_store_explicit(&self->generation, generation,
+                              memory_order_release);
+    }
+
+    size_t const count =
+        atomic_load_explicit(&self->count, memory_order_relaxed);
+    if (count == self->capacity) {
+        _profile_add(&self->dropped, 1);
+        return;
+    }
+    self->events[count] = (profile_event){
+        .op = span->op,
+        .dtype = span->dtype,
+        .elements = span->elements,
+        .bytes = span->bytes,
+        .start = span->start,
+        .end = end,
+    };
+    atomic_store_explicit(&self->count, count + 1, memory_order_release);
+}
+
+profile_span profile_begin(profile_op const op, i64 const dtype,
+                           u64 const elements, u64 const bytes) {
+    return (profile_span){
+        .op = op,
+        .dtype = _profile_dtype_slot(dtype),
+        .elements = elements,
+        .bytes = bytes,
+        .start = profile_ticks(),
+    };
+}
+
+void profile_end(profile_span const *const span) {
+    u64 const end = profile_ticks();
+    profile_thread *self = _profile_self;
+    if (not self) {
+        self = _profile_self = _profile_register();
+    }
+
+    _Atomic u64 *const counters = self->counters[span->op][span->dtype];
+    _profile_add(counters + PROFILE_CALLS, 1);
+    _profile_add(counters + PROFILE_ELEMENTS, span->elements);
+    _profile_add(counters + PROFILE_BYTES, span->bytes);
+    _profile_add(counters + PROFILE_TICKS, end - span->start);
+    _profile_record(self, span, end);
+}
+
+// sums every thread into `totals`, called with the lock held
+static void _profile_sum(u64 totals[PROFILE_OP_COUNT][PROFILE_DTYPE_COUNT]
+                                   [PROFILE_FIELDS]) {
+    memset(totals, 0, sizeof(_profile_baseline));
+    for (profile_thread *t = _profile_threads; t; t = t->next) {
+        for (size_t op = 0; op < PROFILE_OP_COUNT; ++op) {
+            for (size_t d = 0; d < PROFILE_DTYPE_COUNT; ++d) {
+                for (size_t f = 0; f < PROFILE_FIELDS; ++f) {
+                    totals[op][d][f] += atomic_load_explicit(
+                        &t->counters[op][d][f], memory_order_relaxed);
+                }
+            }
+        }
+    }
+}
+
+void profile_snapshot(profile_stats *const stats) {
+    static u64 totals[PROFILE_OP_COUNT][PROFILE_DTYPE_COUNT][PROFILE_FIELDS];
+
+    pthread_mutex_lock(&_profile_lock);
+    _profile_sum(totals);
+    for (size_t op = 0; op < PROFILE_OP_COUNT; ++op) {
+        for (size_t d = 0; d < PROFILE_DTYPE_COUNT; ++d) {
+            u64 const *const total = totals[op][d];
+            u64 const *const base = _profile_baseline[op][d];
+            stats->ops[op][d] = (profile_counter){
+                .calls = total[PROFILE_CALLS] - base[PROFILE_CALLS],
+                .elements = total[PROFILE_ELEMENTS] - base[PROFILE_ELEMENTS],
+                .bytes = total[PROFILE_BYTES] - base[PROFILE_BYTES],
+                .ticks = total[PROFILE_TICKS] - base[PROFILE_TICKS],
+            };
+        }
+    }
+    pthread_mutex_unlock(&_profile_lock);
+    stats->ticks_per_second = _profile_ticks_per_second();
+}
+
+void profile_reset() {
+    pthread_mutex_lock(&_profile_lock);
+    _profile_sum(_profile_baseline);
+    pthread_mutex_unlock(&_profile_lock);
+}
+
+char const *profile_op_name(profile_op const op) {
+    assert(op < PROFILE_OP_COUNT);
+    return _profile_op_names[op];
+}
+
+char const *profile_op_group(profile_op const op) {
+    assert(op < PROFILE_OP_COUNT);
+    return _profile_op_groups[op];
+}
+
+size_t profile_dtype_size(size_t const slot) {
+    assert(slot < PROFILE_DTYPE_COUNT);
+    return _profile_dtype_sizes[slot];
+}
+
+// tracing
+
+bool profile_trace_start(size_t const capacity) {
+    if (not profile_enabled()) {
+        return false;
+    }
+    _profile_ticks_per_second();
+
+    pthread_mutex_lock(&_profile_lock);
+    u64 generation = atomic_load_explicit(&_profile_trace_generation,
+                                          memory_order_relaxed);
+    generation += generation & 1 ? 2 : 1;
+    atomic_store_explicit(&_profile_trace_capacity,
+                          capacity ? capacity : PROFILE_TRACE_DEFAULT_CAPACITY,
+                          memory_order_relaxed);
+    _profile_trace_origin = profile_ticks();
+    atomic_store_explicit(&_profile_trace_generation, generation,
+                          memory_order_release);
+    pthread_mutex_unlock(&_profile_lock);
+    return true;
+}
+
+void profile_trace_stop() {
+    pthread_mutex_lock(&_profile_lock);
+    u64 const generation = atomic_load_explicit(&_profile_trace_generation,
+                                                memory_order_relaxed);
+    // the next even generation keeps the buffers of this one readable
+    if (generation & 1) {
+        atomic_store_explicit(&_profile_trace_generation, generation + 1,
+                              memory_order_release);
+    }
+    pthread_mutex_unlock(&_profile_lock);
+}
+
+bool profile_trace_write(char const *const path) {
+    FILE *const file = fopen(path, "w");
+    if (not file) {
+        return false;
+    }
+
+    f64 const us_per_tick = 1e6 / _profile_ticks_per_second();
+    long const pid = (long)getpid();
+    u64 dropped = 0;
+    bool first = true;
+
+    pthread_mutex_lock(&_profile_lock);
+    // spans of the last started trace, whether it is still running or not
+    u64 const current = atomic_load_explicit(&_profile_trace_generation,
+                                             memory_order_acquire);
+    u64 const generation = current & 1 ? current : current - 1;
+    fprintf(file, "{\"traceEvents\":[");
+    for (profile_thread *t = _profile_threads; t; t = t->next) {
+        if (atomic_load_explicit(&t->generation, memory_order_acquire) !=
+            generation) {
+            continue;
+        }
+        size_t const count =
+            atomic_load_explicit(&t->count, memory_order_acquire);
+        dropped += atomic_load_explicit(&t->dropped, memory_order_relaxed);
+        for (size_t i = 0; i < count; ++i) {
+            profile_event const *const e = t->events + i;
+            fprintf(file,
+                    "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                    "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%zu,"
+                    "\"args\":{\"dtype\":%zu,\"elements\":%llu,"
+                    "\"bytes\":%llu}}",
+                    first ? "" : ",", _profile_op_names[e->op],
+                    _profile_op_groups[e->op],
+                    ((f64)e->start - (f64)_profile_trace_origin) *
+                        us_per_tick,
+                    (f64)(e->end - e->start) * us_per_tick, pid, t->id,
+                    _profile_dtype_sizes[e->dtype],
+                    (unsigned long long)e->elements,
+                    (unsigned long long)e->bytes);
+            first = false;
+        }
+    }
+    pthread_mutex_unlock(&_profile_lock);
+
+    fprintf(file,
+            "\n],\"displayTimeUnit\":\"ns\","
+            "\"otherData\":{\"dropped_spans\":%llu}}\n",
+            (unsigned long long)dropped);
+    bool const ok = not ferror(file);
+    return fclose(file) == 0 and ok;
+}
@@ -0,0 +1,502 @@
+#include <sparse2.h>
+//
+#include <matrix2_macro_helpers.h>
+#include <profile.h>
+#include <stdint.h>
+
+// amount of tasks per worker used by s2_mult_vector_parallel, more tasks than
+// workers let the pool balance rows that are slower than their share
+#define S2_TASKS_PER_THREAD 4
+
+// The typed axpy runs in steps of S2_AXPY_STEP elements. A constant trip
+// count is what the cheap cost model of -O2 needs to vectorize the inner loop,
+// a loop over all n elements stays scalar there
+#define S2_AXPY_STEP 8
+
+// kernels
+
+typedef struct s2_op s2_op;
+
+// `*dest` accumulates values[p] * x[indices[p]] for p in [0, n)
+typedef void (*S2Dot)(s2_op const *op, size_t n, void *dest,
+                      u32 const *indices, char const *values, char const *x);
+
+// dest[rows[p]] accumulates values[p] * x[cols[p]] for p in [0, n), a NULL
+// `cols` multiplies every value by x[0]
+typedef void (*S2Scatter)(s2_op const *op, size_t n, char *dest,
+                          u32 const *rows, char const *values, char const *x,
+                          u32 const *cols);
+
+// dest[c] accumulates *value * src[c] for c in [0, n)
+typedef void (*S2Axpy)(s2_op const *op, size_t n, char *dest,
+                       char const *value, char const *src);
+
+struct s2_op {
+    size_t dtype;
+    Apply perf;
+    S2Dot dot;
+    S2Scatter scatter;
+    S2Axpy axpy;
+};
+
+static void _s2_dot_generic(s2_op const *op, size_t n, void *dest,
+                            u32 const *indices, char const *values,
+                            char const *x) {
+    for (size_t p = 0; p < n; ++p) {
+        op->perf(dest, values + p * op->dtype, x + indices[p] * op->dtype);
+    }
+}
+
+static void _s2_scatter_generic(s2_op const *op, size_t n, char *dest,
+                                u32 const *rows, char const *values,
+                                char const *x, u32 const *cols) {
+    for (size_t p = 0; p < n; ++p) {
+        op->perf(dest + rows[p] * op->dtype, values + p * op->dtype,
+                 x + (cols ? cols[p] : 0) * op->dtype);
+    }
+}
+
+static void _s2_axpy_generic(s2_op const *op, size_t n, char *dest,
+                             char const *value, char const *src) {
+    for (size_t c = 0; c < n; ++c) {
+        op->perf(dest + c * op->dtype, value, src + c * op->dtype);
+    }
+}
+
+// the dot products keep four partial sums, so floating point results may
+// differ from the generic path in the last bits
+#define DEFINE_S2_KERNELS(Type)                                           \
+    static void _s2_dot_##Type(s2_op const *op, size_t n, void *dest,     \
+                               u32 const *indices, char const *values,    \
+                               char const *x) {                           \
+        (void)op;                                                         \
+        Type const *const v = (Type const *)values;                       \
+        Type const *const xs = (Type const *)x;                           \
+        Type s0 = 0, s1 = 0, s2 = 0, s3 = 0;                              \
+        size_t p = 0;                                                     \
+        for (; p + 4 <= n; p += 4) {                                      \
+            s0 += v[p] * xs[indices[p]];                                  \
+            s1 += v[p + 1] * xs[indices[p + 1]];                          \
+            s2 += v[p + 2] * xs[indices[p + 2]];                          \
+            s3 += v[p + 3] * xs[indices[p + 3]];                          \
+        }                                                                 \
+        for (; p < n; ++p) {                                              \
+            s0 += v[p] * xs[indices[p]];                                  \
+        }                                                                 \
+        *(Type *)dest += (s0 + s1) + (s2 + s3);                           \
+    }                                                                     \
+                                                                          \
+    static void _s2_scatter_##Type(s2_op const *op, size_t n, char *dest, \
+                                   u32 const *rows, char const *values,   \
+                                   char const *x, u32 const *cols) {      \
+        (void)op;                                                         \
+        Type *const d = (Type *)dest;                                     \
+        Type const *const v = (Type const *)values;                       \
+        Type const *const xs = (Type const *)x;                           \
+        if (cols) {                                                       \
+            for (size_t p = 0; p < n; ++p) {                              \
+                d[rows[p]] += v[p] * xs[cols[p]];                         \
+            }                                                             \
+            return;                                                       \
+        }                                                                 \
+        Type const value = *xs;                                           \
+        for (size_t p = 0; p < n; ++p) {                                  \
+            d[rows[p]] += v[p] * value;                                   \
+        }                                                                 \
+    }                                                                     \
+                                                                          \
+    static void _s2_axpy_##Type(s2_op const *op, size_t n,                \
+                                char *restrict dest, char const *value,   \
+                                char const *restrict src) {               \
+        (void)op;                                                         \
+        Type *const d = (Type *)dest;                                     \
+        Type const *const s = (Type const *)src;                          \
+        Type const a = *(Type const *)value;                              \
+        size_t c = 0;                                                     \
+        for (; c + S2_AXPY_STEP <= n; c += S2_AXPY_STEP) {                \
+            for (size_t k = 0; k < S2_AXPY_STEP; ++k) {                   \
+                d[c + k] += a * s[c + k];                                 \
+            }                                                             \
+        }                                                                 \
+        for (; c < n; ++c) {                                              \
+            d[c] += a * s[c];                                             \
+        }                                                                 \
+    }
+
+FOR_ALL_TYPES(DEFINE_S2_KERNELS)
+
+#define DISPATCH_S2_KERNELS(Type)                              \
+    if (perf == &Type##_apply_add and dtype == sizeof(Type)) { \
+        return (s2_op){                                        \
+            .dtype = dtype,                                    \
+            .perf = perf,                                      \
+            .dot = &_s2_dot_##Type,                            \
+            .scatter = &_s2_scatter_##Type,                    \
+            .axpy = &_s2_axpy_##Type,                          \
+        };                                                     \
+    }
+
+static s2_op _s2_op(Apply perf, size_t const dtype) {
+    FOR_ALL_TYPES(DISPATCH_S2_KERNELS)
+    return (s2_op){
+        .dtype = dtype,
+        .perf = perf,
+        .dot = &_s2_dot_generic,
+        .scatter = &_s2_scatter_generic,
+        .axpy = &_s2_axpy_generic,
+    };
+}
+
+// construction
+
+static void *_s2_malloc(size_t const bytes) {
+    void *const ptr = malloc(bytes ? bytes : 1);
+    assert(ptr);
+    return ptr;
+}
+
+sparse2 s2_from_triplets(size_t const rows, size_t const cols,
+                         size_t const dtype, size_t const nnz,
+                         u32 const *const row_indices,
+                         u32 const *const col_indices,
+                         void const *const values, s2_format const format) {
+    assert(rows <= UINT32_MAX and cols <= UINT32_MAX and dtype);
+
+    sparse2 s = {
+        .format = format,
+        .rows = rows,
+        .cols = cols,
+        .dtype = dtype,
+        .nnz = nnz,
+        .indices = _s2_malloc(nnz * sizeof(u32)),
+        .values = _s2_malloc(nnz * dtype),
+    };
+
+    if (format == S2_COO) {
+        s.row_indices = _s2_malloc(nnz * sizeof(u32));
+        for (size_t p = 0; p < nnz; ++p) {
+            assert(row_indices[p] < rows and col_indices[p] < cols);
+        }
+        memcpy(s.row_indices, row_indices, nnz * sizeof(u32));
+        memcpy(s.indices, col_indices, nnz * sizeof(u32));
+        memcpy(s.values, values, nnz * dtype);
+        return s;
+    }
+
+    // counting sort by the outer index, stable so the order of the triplets
+    // is kept inside of every row or column
+    bool const csr = format == S2_CSR;
+    size_t const outer = csr ? rows : cols;
+    u32 const *const keys = csr ? row_indices : col_indices;
+    u32 const *const inner = csr ? col_indices : row_indices;
+
+    s.offsets = calloc(outer + 1, sizeof(size_t));
+    assert(s.offsets);
+    for (size_t p = 0; p < nnz; ++p) {
+        assert(row_indices[p] < rows and col_indices[p] < cols);
+        ++s.offsets[keys[p] + 1];
+    }
+    for (size_t i = 0; i < outer; ++i) {
+        s.offsets[i + 1] += s.offsets[i];
+    }
+    // every slot is advanced past its own values while placing them, which
+    // leaves offsets[i] at the start of i + 1, shifting restores the starts
+    for (size_t p = 0; p < nnz; ++p) {
+        size_t const slot = s.offsets[keys[p]]++;
+        s.indices[slot] = inner[p];
+        memcpy((char *)s.values + slot * dtype,
+               (char const *)values + p * dtype, dtype);
+    }
+    memmove(s.offsets + 1, s.offsets, outer * sizeof(size_t));
+    s.offsets[0] = 0;
+
+    return s;
+}
+
+// row and column of every value, in storage order. The arrays are owned by
+// the caller when `*owned` is set, otherwise they belong to `s`
+static void _s2_coordinates(sparse2 const *const s, u32** const rows,
+                            u32** const cols, bool *const owned) {
+    if (s->format == S2_COO) {
+        *rows = s->row_indices;
+        *cols = s->indices;
+        *owned = false;
+        return;
+    }
+
+    size_t const outer = s->format == S2_CSR ? s->rows : s->cols;
+    u32 *const expanded = _s2_malloc(s->nnz * sizeof(u32));
+    for (size_t i = 0; i < outer; ++i) {
+        for (size_t p = s->offsets[i]; p < s->offsets[i + 1]; ++p) {
+            expanded[p] = i;
+        }
+    }
+    *rows = s->format == S2_CSR ? expanded : s->indices;
+    *cols = s->format == S2_CSR ? s->indices : expanded;
+    *owned = true;
+}
+
+static void _s2_free_coordinates(u32 *const rows, u32 *const cols,
+                                 sparse2 const *const s, bool const owned) {
+    if (owned) {
+        free(s->format == S2_CSR ? rows : cols);
+    }
+}
+
+sparse2 s2_convert(sparse2 const *const s, s2_format const format) {
+    PROFILE_SCOPE(s2_convert, s->dtype, s->nnz,
+                  2 * s->nnz * (s->dtype + sizeof(u32)));
+    u32 *rows;
+    u32 *cols;
+    bool owned;
+    _s2_coordinates(s, &rows, &cols, &owned);
+    sparse2 const result = s2_from_triplets(s->rows, s->cols, s->dtype, s->nnz,
+                                            rows, cols, s->values, format);
+    _s2_free_coordinates(rows, cols, s, owned);
+    return result;
+}
+
+static bool _s2_is_zero(char const *const value, void const *const zero,
+                        size_t const dtype) {
+    if (zero) {
+        return memcmp(value, zero, dtype) == 0;
+    }
+    for (size_t i = 0; i < dtype; ++i) {
+        if (value[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+sparse2 s2_from_dense(matrix2 const *const m, s2_format const format,
+                      void const *const zero) {
+    PROFILE_SCOPE(s2_from_dense, m->dtype, m->rows * m->cols,
+                  m->rows * m->cols * m->dtype);
+    size_t const dtype = m->dtype;
+    size_t const stride = m2_stride(m);
+    char const *const data = m->data;
+
+    size_t nnz = 0;
+    for (size_t i = 0; i < m->rows; ++i) {
+        for (size_t j = 0; j < m->cols; ++j) {
+            nnz += not _s2_is_zero(data + (i * stride + j) * dtype, zero,
+                                   dtype);
+        }
+    }
+
+    // the triplets are collected row by row, which the counting sort of CSC
+    // turns into ascending rows inside of every column
+    u32 *const rows = _s2_malloc(nnz * sizeof(u32));
+    u32 *const cols = _s2_malloc(nnz * sizeof(u32));
+    char *const values = _s2_malloc(nnz * dtype);
+    size_t p = 0;
+    for (size_t i = 0; i < m->rows; ++i) {
+        for (size_t j = 0; j < m->cols; ++j) {
+            char const *const value = data + (i * stride + j) * dtype;
+            if (_s2_is_zero(value, zero, dtype)) {
+                continue;
+            }
+            rows[p] = i;
+            cols[p] = j;
+            memcpy(values + p * dtype, value, dtype);
+            ++p;
+        }
+    }
+
+    sparse2 const result = s2_from_triplets(m->rows, m->cols, dtype, nnz, rows,
+                                            cols, values, format);
+    free(rows);
+    free(cols);
+    free(values);
+    return result;
+}
+
+void s2_to_dense(matrix2 *const dest, sparse2 const *const s,
+                 void const *const zero) {
+    PROFILE_SCOPE(s2_to_dense, dest->dtype, dest->rows * dest->cols,
+                  dest->rows * dest->cols * dest->dtype +
+                      s->nnz * (s->dtype + sizeof(u32)));
+    assert(dest->rows == s->rows and dest->cols == s->cols and
+           dest->dtype == s->dtype);
+
+    size_t const dtype = s->dtype;
+    size_t const stride = m2_stride(dest);
+    char *const data = dest->data;
+
+    for (size_t i = 0; i < dest->rows; ++i) {
+        char *const row = data + i * stride * dtype;
+        if (not zero) {
+            memset(row, 0, dest->cols * dtype);
+            continue;
+        }
+        for (size_t j = 0; j < dest->cols; ++j) {
+            memcpy(row + j * dtype, zero, dtype);
+        }
+    }
+
+    u32 *rows;
+    u32 *cols;
+    bool owned;
+    _s2_coordinates(s, &rows, &cols, &owned);
+    for (size_t p = 0; p < s->nnz; ++p) {
+        memcpy(data + (rows[p] * stride + cols[p]) * dtype,
+               (char const *)s->values + p * dtype, dtype);
+    }
+    _s2_free_coordinates(rows, cols, s, owned);
+}
+
+void s2_free(sparse2 const *const s) {
+    free(s->offsets);
+    free(s->indices);
+    free(s->row_indices);
+    free(s->values);
+}
+
+// products
+
+static void _s2_mult_rows(s2_op const *const op, void *const dest,
+                          sparse2 const *const s, void const *const x,
+                          size_t const row_begin, size_t const row_end) {
+    for (size_t i = row_begin; i < row_end; ++i) {
+        size_t const begin = s->offsets[i];
+        op->dot(op, s->offsets[i + 1] - begin, (char *)dest + i * op->dtype,
+                s->indices + begin, (char const *)s->values + begin * op->dtype,
+                x);
+    }
+}
+
+void s2_mult_vector(void *const dest, sparse2 const *const s,
+                    void const *const x, Apply perf) {
+    PROFILE_SCOPE(s2_mult_vector, s->dtype, s->nnz,
+                  s->nnz * (s->dtype + sizeof(u32)) +
+                      (s->rows + s->cols) * s->dtype);
+    s2_op const op = _s2_op(perf, s->dtype);
+    memset(dest, 0, s->rows * s->dtype);
+
+    switch (s->format) {
+        case S2_CSR:
+            _s2_mult_rows(&op, dest, s, x, 0, s->rows);
+            return;
+        case S2_CSC:
+            for (size_t j = 0; j < s->cols; ++j) {
+                size_t const begin = s->offsets[j];
+                op.scatter(&op, s->offsets[j + 1] - begin, dest,
+                           s->indices + begin,
+                           (char const *)s->values + begin * s->dtype,
+                           (char const *)x + j * s->dtype, NULL);
+            }
+            return;
+        case S2_COO:
+            op.scatter(&op, s->nnz, dest, s->row_indices, s->values, x,
+                       s->indices);
+            return;
+    }
+}
+
+typedef struct {
+    s2_op op;
+    void *dest;
+    sparse2 const *s;
+    void const *x;
+    size_t tasks;
+} s2_parallel_task;
+
+// first row whose values and rows before it make up `target`, counting a row
+// as a value as well keeps long runs of empty rows balanced
+static size_t _s2_split_row(sparse2 const *const s, size_t const target) {
+    size_t low = 0;
+    size_t high = s->rows;
+    while (low < high) {
+        size_t const mid = low + (high - low) / 2;
+        if (s->offsets[mid] + mid < target) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static void _s2_mult_rows_task(void *ctx, size_t index) {
+    s2_parallel_task const *const task = ctx;
+    size_t const work = task->s->nnz + task->s->rows;
+    size_t const begin = _s2_split_row(task->s, index * work / task->tasks);
+    size_t const end =
+        _s2_split_row(task->s, (index + 1) * work / task->tasks);
+    _s2_mult_rows(&task->op, task->dest, task->s, task->x, begin, end);
+}
+
+void s2_mult_vector_parallel(void *const dest, sparse2 const *const s,
+                             void const *const x, Apply perf,
+                             thread_pool *const pool) {
+    PROFILE_SCOPE(s2_mult_vector_parallel, s->dtype, s->nnz,
+                  s->nnz * (s->dtype + sizeof(u32)) +
+                      (s->rows + s->cols) * s->dtype);
+    thread_pool *const workers = pool ? pool : thread_pool_default();
+    size_t const threads = thread_pool_size(workers);
+    if (s->format != S2_CSR or threads == 1) {
+        s2_mult_vector(dest, s, x, perf);
+        return;
+    }
+
+    s2_parallel_task task = {
+        .op = _s2_op(perf, s->dtype),
+        .dest = dest,
+        .s = s,
+        .x = x,
+        .tasks = threads * S2_TASKS_PER_THREAD,
+    };
+    memset(dest, 0, s->rows * s->dtype);
+    thread_pool_run(workers, task.tasks, &_s2_mult_rows_task, &task);
+}
+
+void s2_mult_dense(matrix2 *const dest, sparse2 const *const lhs,
+                   matrix2 const *const rhs, Apply perf) {
+    PROFILE_SCOPE(s2_mult_dense, dest->dtype, lhs->nnz * rhs->cols,
+                  lhs->nnz * (lhs->dtype + sizeof(u32)) +
+                      (dest->rows + rhs->rows) * rhs->cols * dest->dtype);
+    assert(dest->rows == lhs->rows and dest->cols == rhs->cols and
+           lhs->cols == rhs->rows and dest->dtype == lhs->dtype and
+           dest->dtype == rhs->dtype);
+
+    s2_op const op = _s2_op(perf, lhs->dtype);
+    size_t const dtype = lhs->dtype;
+    size_t const n = dest->cols;
+    size_t const dest_stride = m2_stride(dest) * dtype;
+    size_t const rhs_stride = m2_stride(rhs) * dtype;
+    char *const d = dest->data;
+    char const *const r = rhs->data;
+    char const *const values = lhs->values;
+
+    for (size_t i = 0; i < dest->rows; ++i) {
+        memset(d + i * dest_stride, 0, n * dtype);
+    }
+
+    switch (lhs->format) {
+        case S2_CSR:
+            for (size_t i = 0; i < lhs->rows; ++i) {
+                for (size_t p = lhs->offsets[i]; p < lhs->offsets[i + 1];
+                     ++p) {
+                    op.axpy(&op, n, d + i * dest_stride, values + p * dtype,
+                            r + lhs->indices[p] * rhs_stride);
+                }
+            }
+            return;
+        case S2_CSC:
+            for (size_t j = 0; j < lhs->cols; ++j) {
+                for (size_t p = lhs->offsets[j]; p < lhs->offsets[j + 1];
+                     ++p) {
+                    op.axpy(&op, n, d + lhs->indices[p] * dest_stride,
+                            values + p * dtype, r + j * rhs_stride);
+                }
+            }
+            return;
+        case S2_COO:
+            for (size_t p = 0; p < lhs->nnz; ++p) {
+                op.axpy(&op, n, d + lhs->row_indices[p] * dest_stride,
+                        values + p * dtype, r + lhs->indices[p] * rhs_stride);
+            }
+            return;
+    }
+}
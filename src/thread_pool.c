@@ -0,0 +1,243 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+
+#include <thread_pool.h>
+//
+#include <iso646.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define THREAD_POOL_CACHE_LINE 64
+
+typedef struct {
+    _Alignas(THREAD_POOL_CACHE_LINE) atomic_size_t next;
+    size_t end;
+} thread_pool_range;
+
+typedef struct {
+    thread_pool *pool;
+    size_t index;
+} thread_pool_worker;
+
+struct thread_pool {
+    size_t size;
+    pthread_t *threads;
+    thread_pool_worker *workers;
+    thread_pool_range *ranges;
+
+    pthread_mutex_t run_mutex;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    size_t generation;
+    size_t active;
+    bool stop;
+
+    ThreadTask task;
+    void *ctx;
+};
+
+static void _thread_pool_work(thread_pool *const pool, size_t const index) {
+    for (size_t i = 0; i < pool->size; ++i) {
+        thread_pool_range *const range =
+            &pool->ranges[(index + i) % pool->size];
+        for (size_t task;
+             (task = atomic_fetch_add_explicit(&range->next, 1,
+                                               memory_order_relaxed)) <
+             range->end;) {
+            pool->task(pool->ctx, task);
+        }
+    }
+}
+
+static void *_thread_pool_loop(void *arg) {
+    thread_pool_worker *const worker = arg;
+    thread_pool *const pool = worker->pool;
+    size_t seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->mutex);
+        while (seen == pool->generation and not pool->stop) {
+            pthread_cond_wait(&pool->wake, &pool->mutex);
+        }
+        if (pool->stop) {
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        _thread_pool_work(pool, worker->index);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->active == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+// pins background thread i to the i-th allowed CPU, wrapping around. With a
+// single allowed CPU every thread already runs there, so nothing is done
+static void _thread_pool_pin(thread_pool const *const pool) {
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+        return;
+    }
+    size_t const available = CPU_COUNT(&allowed);
+    if (available <= 1) {
+        return;
+    }
+    for (size_t i = 1; i < pool->size; ++i) {
+        size_t target = i % available;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed) and target-- == 0) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                pthread_setaffinity_np(pool->threads[i], sizeof(set), &set);
+                break;
+            }
+        }
+    }
+#else
+    (void)pool;
+#endif
+}
+
+static size_t _thread_pool_online_cpus() {
+    long const cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (size_t)cpus : 1;
+}
+
+thread_pool *thread_pool_create(size_t num_threads, bool pin) {
+    if (not num_threads) {
+        num_threads = _thread_pool_online_cpus();
+    }
+
+    thread_pool *const pool = calloc(1, sizeof(thread_pool));
+    if (not pool) {
+        return NULL;
+    }
+    pool->size = num_threads;
+    pool->threads = calloc(num_threads, sizeof(pthread_t));
+    pool->workers = calloc(num_threads, sizeof(thread_pool_worker));
+    pool->ranges =
+        aligned_alloc(THREAD_POOL_CACHE_LINE,
+                      num_threads * sizeof(thread_pool_range));
+    if (not pool->threads or not pool->workers or not pool->ranges) {
+        free(pool->threads);
+        free(pool->workers);
+        free(pool->ranges);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->run_mutex, NULL);
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (size_t i = 0; i < num_threads; ++i) {
+        atomic_init(&pool->ranges[i].next, 0);
+        pool->ranges[i].end = 0;
+        pool->workers[i] = (thread_pool_worker){.pool = pool, .index = i};
+    }
+
+    for (size_t i = 1; i < num_threads; ++i) {
+        if (pthread_create(&pool->threads[i], NULL, &_thread_pool_loop,
+                           &pool->workers[i])) {
+            pool->size = i;
+            thread_pool_destroy(pool);
+            return NULL;
+        }
+    }
+    if (pin) {
+        _thread_pool_pin(pool);
+    }
+
+    return pool;
+}
+
+void thread_pool_destroy(thread_pool *pool) {
+    if (not pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (size_t i = 1; i < pool->size; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_mutex_destroy(&pool->run_mutex);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool->ranges);
+    free(pool);
+}
+
+static thread_pool *_thread_pool_default = NULL;
+static pthread_once_t _thread_pool_default_once = PTHREAD_ONCE_INIT;
+
+static void _thread_pool_default_init() {
+    _thread_pool_default = thread_pool_create(0, false);
+}
+
+thread_pool *thread_pool_default() {
+    pthread_once(&_thread_pool_default_once, &_thread_pool_default_init);
+    return _thread_pool_default;
+}
+
+size_t thread_pool_size(thread_pool const *pool) {
+    return pool ? pool->size : 1;
+}
+
+void thread_pool_run(thread_pool *pool, size_t num_tasks, ThreadTask task,
+                     void *ctx) {
+    if (not pool or pool->size == 1 or num_tasks <= 1) {
+        for (size_t i = 0; i < num_tasks; ++i) {
+            task(ctx, i);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->run_mutex);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->task = task;
+    pool->ctx = ctx;
+    for (size_t i = 0; i < pool->size; ++i) {
+        atomic_store_explicit(&pool->ranges[i].next,
+                              i * num_tasks / pool->size,
+                              memory_order_relaxed);
+        pool->ranges[i].end = (i + 1) * num_tasks / pool->size;
+    }
+    pool->active = pool->size - 1;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    _thread_pool_work(pool, 0);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->active) {
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    pthread_mutex_unlock(&pool->run_mutex);
+}
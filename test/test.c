@@ -0,0 +1,1818 @@
+// Regression tests of the library, grouped by the header of the operations
+// they check.
+//
+// Every test checks its results with assert and aborts on the first failure,
+// the program prints one line per passed test.
+//
+// Build it together with the library sources, for example
+//     cc -O2 -Iinclude -Iinclude/math test/test.c src/*.c -lpthread -lm
+// asserts must stay enabled, do not define NDEBUG.
+
+#undef NDEBUG
+
+#include <algorithms.h>
+#include <algorithms_parallel.h>
+#include <gemm.h>
+#include <matrix2_expr.h>
+#include <matrix2_factor.h>
+#include <matrix2_gemv.h>
+#include <matrix2_io.h>
+#include <matrix2_macro_helpers.h>
+#include <matrix2_quant.h>
+#include <matrix2_small.h>
+#include <sparse2.h>
+//
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST(name) static void test_##name()
+#define RUN(name)                 \
+    do {                          \
+        test_##name();            \
+        printf("ok %s\n", #name); \
+    } while (0)
+
+// matrices holding f32 or f64, read and written as f64
+
+static f64 _get(matrix2 const *const m, size_t const i, size_t const j) {
+    void const *const value = m2_get_from_matrix(m, j, i);
+    return m->dtype == sizeof(f32) ? *(f32 const *)value : *(f64 const *)value;
+}
+
+static void _set(matrix2 const *const m, size_t const i, size_t const j,
+                 f64 const value) {
+    void *const dest = m2_get_from_matrix(m, j, i);
+    if (m->dtype == sizeof(f32)) {
+        *(f32 *)dest = value;
+    } else {
+        *(f64 *)dest = value;
+    }
+}
+
+// small integers, every sum of their products is exact in f32 and f64
+static void _fill_integers(matrix2 const *const m) {
+    for (size_t i = 0; i < m->rows; ++i) {
+        for (size_t j = 0; j < m->cols; ++j) {
+            _set(m, i, j, rand() % 7 - 3);
+        }
+    }
+}
+
+// search_bytes
+
+// first aligned match of needle in haystack, compared the obvious way
+static size_t _naive_search(char const *const haystack, size_t const size,
+                            char const *const needle, size_t const length,
+                            size_t const dtype) {
+    for (size_t i = 0; i + length <= size; i += dtype) {
+        if (not memcmp(haystack + i, needle, length)) {
+            return i;
+        }
+    }
+    return size;
+}
+
+static size_t _search_offset(char const *const haystack, size_t const size,
+                             char const *const needle, size_t const length,
+                             size_t const dtype) {
+    char const *const found =
+        search_bytes(haystack, haystack + size, needle, needle + length, dtype);
+    return found - haystack;
+}
+
+// a periodic needle matches at every other byte of a periodic haystack, none
+// of the matches is on an element boundary until the one placed at the end
+TEST(search_bytes_misaligned) {
+    size_t const size = 1 << 20;
+    size_t const dtype = 2;
+    char *const haystack = malloc(size);
+    char *const needle = malloc(size);
+    assert(haystack and needle);
+
+    for (size_t i = 0; i < size; ++i) {
+        haystack[i] = i % 2 ? 'a' : 'x';
+    }
+
+    for (size_t length = 64; length <= 16384; length *= 4) {
+        for (size_t i = 0; i < length; ++i) {
+            needle[i] = i % 2 ? 'x' : 'a';
+        }
+        assert(_search_offset(haystack, size, needle, length, dtype) == size);
+
+        // an aligned copy at the end
+        memcpy(haystack + size - length, needle, length);
+        size_t const expected =
+            _naive_search(haystack, size, needle, length, dtype);
+        assert(expected == size - length);
+        assert(_search_offset(haystack, size, needle, length, dtype) ==
+               expected);
+        for (size_t i = size - length; i < size; ++i) {
+            haystack[i] = i % 2 ? 'a' : 'x';
+        }
+    }
+
+    free(haystack);
+    free(needle);
+}
+
+// random needles over a two letter alphabet against the obvious search
+TEST(search_bytes_random) {
+    size_t const size = 4096;
+    char haystack[4096];
+    char needle[256];
+    srand(1);
+
+    for (size_t round = 0; round < 2000; ++round) {
+        size_t const dtype = 1 + rand() % 4;
+        size_t const length = dtype * (1 + rand() % (sizeof(needle) / dtype));
+        for (size_t i = 0; i < size; ++i) {
+            haystack[i] = 'a' + (rand() % 8 == 0);
+        }
+        for (size_t i = 0; i < length; ++i) {
+            needle[i] = 'a' + (rand() % 8 == 0);
+        }
+        if (round % 2) {
+            size_t const at = rand() % (size - length);
+            memcpy(haystack + at, needle, length);
+        }
+        assert(_search_offset(haystack, size, needle, length, dtype) ==
+               _naive_search(haystack, size, needle, length, dtype));
+    }
+}
+
+// filter, remove_if, copy_if, partition and stable_partition
+
+// the first byte of an element decides whether it satisfies the predicate,
+// the next two hold its index and the rest random bytes
+static bool _is_odd_byte(const void *const value) {
+    return *(u8 const *)value & 1;
+}
+
+// element size of _less_bytes
+static size_t _element_size;
+
+static bool _less_bytes(const void *const lhs, const void *const rhs) {
+    return memcmp(lhs, rhs, _element_size) < 0;
+}
+
+static bool _is_odd(const void *const value) {
+    return *(i32 const *)value % 2;
+}
+
+// filter drops the elements satisfying the predicate, like remove_if
+TEST(filter_removes) {
+    i32 values[200];
+    for (size_t i = 0; i < 200; ++i) {
+        values[i] = i;
+    }
+    i32 *const end = filter(values, values + 200, sizeof(i32), &_is_odd);
+    assert(end == values + 100);
+    for (size_t i = 0; i < 100; ++i) {
+        assert(values[i] == (i32)(2 * i));
+    }
+}
+
+// `size` elements of `dtype` bytes, pattern 0 is random, 1 has every element
+// satisfying the predicate, 2 none and 3 alternates runs of 13 elements
+static void _fill_compaction(u8 *const values, size_t const size,
+                             size_t const dtype, int const pattern) {
+    for (size_t i = 0; i < size; ++i) {
+        u8 *const value = values + i * dtype;
+        int const odd = pattern == 0   ? rand() % 2
+                        : pattern == 1 ? 1
+                        : pattern == 2 ? 0
+                                       : (int)(i / 13 % 2);
+        value[0] = (rand() & 0xfe) | odd;
+        for (size_t b = 1; b < dtype; ++b) {
+            value[b] = b < 3 ? i >> (8 * (b - 1)) : (size_t)rand();
+        }
+    }
+}
+
+// the elements of `values` satisfying the predicate if `keep` is set and the
+// other ones otherwise, in order, copied to `dest`. Returns their number
+static size_t _select(u8 *const dest, u8 const *const values,
+                      size_t const size, size_t const dtype, bool const keep) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (_is_odd_byte(values + i * dtype) == keep) {
+            memcpy(dest + count++ * dtype, values + i * dtype, dtype);
+        }
+    }
+    return count;
+}
+
+// element sizes of the generic runs and of both AVX2 left-packs, sizes around
+// and between the 64 element blocks
+TEST(compaction_order) {
+    size_t const dtypes[] = {1, 3, 4, 8};
+    size_t const sizes[] = {0, 1, 7, 63, 64, 65, 200, 1001};
+
+    for (size_t d = 0; d < sizeof(dtypes) / sizeof(size_t); ++d) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(size_t); ++s) {
+            for (int pattern = 0; pattern < 4; ++pattern) {
+                size_t const dtype = dtypes[d];
+                size_t const size = sizes[s];
+                size_t const bytes = size * dtype;
+                u8 *const values = malloc(bytes + 1);
+                u8 *const actual = malloc(bytes + 1);
+                u8 *const kept = malloc(bytes + 1);
+                u8 *const removed = malloc(bytes + 1);
+                assert(values and actual and kept and removed);
+                _fill_compaction(values, size, dtype, pattern);
+                size_t const n_kept = _select(kept, values, size, dtype, true);
+                size_t const n_removed =
+                    _select(removed, values, size, dtype, false);
+                u8 *end;
+
+                memcpy(actual, values, bytes);
+                end = remove_if(actual, actual + bytes, dtype, &_is_odd_byte);
+                assert(end == actual + n_removed * dtype);
+                assert(not memcmp(actual, removed, n_removed * dtype));
+
+                memcpy(actual, values, bytes);
+                end = filter(actual, actual + bytes, dtype, &_is_odd_byte);
+                assert(end == actual + n_removed * dtype);
+                assert(not memcmp(actual, removed, n_removed * dtype));
+
+                end = copy_if(values, values + bytes, dtype, actual,
+                              &_is_odd_byte);
+                assert(end == actual + n_kept * dtype);
+                assert(not memcmp(actual, kept, n_kept * dtype));
+
+                memcpy(actual, values, bytes);
+                end = stable_partition(actual, actual + bytes, dtype,
+                                       &_is_odd_byte);
+                assert(end == actual + n_kept * dtype);
+                assert(not memcmp(actual, kept, n_kept * dtype));
+                assert(not memcmp(end, removed, n_removed * dtype));
+
+                // partition only has to keep the elements, compared sorted
+                memcpy(actual, values, bytes);
+                end = partition(actual, actual + bytes, dtype, &_is_odd_byte);
+                assert(end == actual + n_kept * dtype);
+                _element_size = dtype;
+                sort(actual, end, dtype, &_less_bytes);
+                sort(end, actual + bytes, dtype, &_less_bytes);
+                sort(kept, kept + n_kept * dtype, dtype, &_less_bytes);
+                sort(removed, removed + n_removed * dtype, dtype,
+                     &_less_bytes);
+                assert(not memcmp(actual, kept, n_kept * dtype));
+                assert(not memcmp(end, removed, n_removed * dtype));
+
+                free(values);
+                free(actual);
+                free(kept);
+                free(removed);
+            }
+        }
+    }
+}
+
+// sort
+
+// reference orders for qsort. Floats follow IEEE 754 totalOrder: flipping
+// every bit but the sign of negative values makes their bits compare as
+// signed integers in that order
+#define DEFINE_INTEGER_COMPARE(Type)                               \
+    static int _compare_##Type(const void *lhs, const void *rhs) { \
+        Type const a = *(Type const *)lhs;                         \
+        Type const b = *(Type const *)rhs;                         \
+        return (a > b) - (a < b);                                  \
+    }                                                              \
+                                                                   \
+    static Type const _specials_##Type[] = {                       \
+        0, 1, (Type)-1, (Type)((u64)1 << (sizeof(Type) * 8 - 1)),  \
+    };
+
+#define DEFINE_FLOAT_COMPARE(Type, Bits, Max)                      \
+    static int _compare_##Type(const void *lhs, const void *rhs) { \
+        Bits a;                                                    \
+        Bits b;                                                    \
+        memcpy(&a, lhs, sizeof(a));                                \
+        memcpy(&b, rhs, sizeof(b));                                \
+        a ^= a < 0 ? Max : 0;                                      \
+        b ^= b < 0 ? Max : 0;                                      \
+        return (a > b) - (a < b);                                  \
+    }                                                              \
+                                                                   \
+    static Type const _specials_##Type[] = {                       \
+        0, -0.0, INFINITY, -INFINITY, NAN, -NAN, 1, -1,            \
+    };
+
+FOR_ALL_INTEGER_TYPES(DEFINE_INTEGER_COMPARE)
+DEFINE_FLOAT_COMPARE(f32, i32, INT32_MAX)
+DEFINE_FLOAT_COMPARE(f64, i64, INT64_MAX)
+
+// random bits, for floats NaN of both signs and every payload among them,
+// mixed with the special values of the type repeated many times
+#define DEFINE_SORT_CHECK(Type)                                              \
+    static bool _callback_less_##Type(const void *lhs, const void *rhs) {    \
+        return _compare_##Type(lhs, rhs) < 0;                                \
+    }                                                                        \
+                                                                             \
+    static void _check_sort_##Type(size_t const size) {                      \
+        size_t const specials =                                              \
+            sizeof(_specials_##Type) / sizeof(_specials_##Type[0]);          \
+        Type *const values = malloc((size + 1) * sizeof(Type));              \
+        Type *const expected = malloc((size + 1) * sizeof(Type));            \
+        Type *const actual = malloc((size + 1) * sizeof(Type));              \
+        assert(values and expected and actual);                              \
+        for (size_t i = 0; i < size; ++i) {                                  \
+            u64 const bits = (u64)rand() << 40 ^ (u64)rand() << 20 ^ rand(); \
+            memcpy(values + i, &bits, sizeof(Type));                         \
+            if (rand() % 4 == 0) {                                           \
+                values[i] = _specials_##Type[rand() % specials];             \
+            }                                                                \
+        }                                                                    \
+        memcpy(expected, values, size * sizeof(Type));                       \
+        qsort(expected, size, sizeof(Type), &_compare_##Type);               \
+                                                                             \
+        BinaryPredicate const orders[] = {&Type##_less,                      \
+                                          &_callback_less_##Type};           \
+        for (size_t o = 0; o < 2; ++o) {                                     \
+            memcpy(actual, values, size * sizeof(Type));                     \
+            sort(actual, actual + size, sizeof(Type), orders[o]);            \
+            assert(not memcmp(actual, expected, size * sizeof(Type)));       \
+            memcpy(actual, values, size * sizeof(Type));                     \
+            stable_sort(actual, actual + size, sizeof(Type), orders[o]);     \
+            assert(not memcmp(actual, expected, size * sizeof(Type)));       \
+        }                                                                    \
+        memcpy(actual, values, size * sizeof(Type));                         \
+        sort_##Type(actual, actual + size);                                  \
+        assert(not memcmp(actual, expected, size * sizeof(Type)));           \
+                                                                             \
+        free(values);                                                        \
+        free(expected);                                                      \
+        free(actual);                                                        \
+    }
+
+FOR_ALL_TYPES(DEFINE_SORT_CHECK)
+
+#define CHECK_SORT(Type) _check_sort_##Type(sizes[s]);
+
+// SORT_RADIX_THRESHOLD of src/algorithms.c
+#define SORT_RADIX_THRESHOLD 64
+
+// the typed radix sort, the typed comparators below the radix threshold and
+// the generic sorts through callbacks, for every type against qsort
+TEST(sort_types) {
+    size_t const sizes[] = {0,  1,  2,  15, 17, SORT_RADIX_THRESHOLD - 1,
+                            SORT_RADIX_THRESHOLD, SORT_RADIX_THRESHOLD + 1,
+                            1000, 20000};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(size_t); ++s) {
+        FOR_ALL_TYPES(CHECK_SORT)
+    }
+}
+
+static int _compare_3_bytes(const void *lhs, const void *rhs) {
+    return memcmp(lhs, rhs, 3);
+}
+
+static bool _less_3_bytes(const void *lhs, const void *rhs) {
+    return memcmp(lhs, rhs, 3) < 0;
+}
+
+// elements of 3 bytes, which no typed comparator matches
+TEST(sort_odd_dtype) {
+    size_t const sizes[] = {0, 1, 5, 16, 17, 300, 10000};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(size_t); ++s) {
+        size_t const bytes = 3 * sizes[s];
+        u8 *const values = malloc(bytes + 1);
+        u8 *const expected = malloc(bytes + 1);
+        u8 *const actual = malloc(bytes + 1);
+        assert(values and expected and actual);
+        for (size_t i = 0; i < bytes; ++i) {
+            values[i] = i % 3 ? rand() : rand() % 4;
+        }
+        memcpy(expected, values, bytes);
+        qsort(expected, sizes[s], 3, &_compare_3_bytes);
+
+        memcpy(actual, values, bytes);
+        sort(actual, actual + bytes, 3, &_less_3_bytes);
+        assert(not memcmp(actual, expected, bytes));
+        memcpy(actual, values, bytes);
+        stable_sort(actual, actual + bytes, 3, &_less_3_bytes);
+        assert(not memcmp(actual, expected, bytes));
+
+        free(values);
+        free(expected);
+        free(actual);
+    }
+}
+
+typedef struct {
+    i32 key;
+    u32 id;
+} keyed;
+
+static bool _keyed_less(const void *const lhs, const void *const rhs) {
+    return ((keyed const *)lhs)->key < ((keyed const *)rhs)->key;
+}
+
+// few distinct keys, elements carry their original index
+TEST(stable_sort_stability) {
+    size_t const sizes[] = {2, 16, 17, 100, 5000};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(size_t); ++s) {
+        size_t const size = sizes[s];
+        keyed *const items = malloc(size * sizeof(keyed));
+        assert(items);
+        for (size_t i = 0; i < size; ++i) {
+            items[i] = (keyed){rand() % 5, i};
+        }
+        stable_sort(items, items + size, sizeof(keyed), &_keyed_less);
+        for (size_t i = 1; i < size; ++i) {
+            assert(items[i - 1].key < items[i].key or
+                   (items[i - 1].key == items[i].key and
+                    items[i - 1].id < items[i].id));
+        }
+        free(items);
+    }
+}
+
+// lower_bound, upper_bound and search_index
+
+// sorted values drawn from a pool of about size / 2 random values and the
+// special values of the type, so most of them repeat. Queries are values of
+// the range, random values and the special ones, every lookup is compared
+// with a linear scan of the range
+#define DEFINE_SEARCH_CHECK(Type)                                            \
+    static void _check_search_##Type(size_t const size) {                    \
+        size_t const specials =                                              \
+            sizeof(_specials_##Type) / sizeof(_specials_##Type[0]);          \
+        size_t const pool = size / 2 + 1;                                    \
+        size_t const count = (size < 256 ? size : 256) + 64 + specials;      \
+        Type *const values = malloc((size + 1) * sizeof(Type));              \
+        Type *const queries = malloc(count * sizeof(Type));                  \
+        size_t *const lower = malloc(count * sizeof(size_t));                \
+        size_t *const upper = malloc(count * sizeof(size_t));                \
+        size_t *const ranks = malloc(count * sizeof(size_t));                \
+        assert(values and queries and lower and upper and ranks);            \
+        for (size_t i = 0; i < size; ++i) {                                  \
+            u64 bits = rand() % pool;                                        \
+            bits = bits * 0x9e3779b97f4a7c15 ^ bits >> 3;                    \
+            memcpy(values + i, &bits, sizeof(Type));                         \
+            if (rand() % 8 == 0) {                                           \
+                values[i] = _specials_##Type[rand() % specials];             \
+            }                                                                \
+        }                                                                    \
+        qsort(values, size, sizeof(Type), &_compare_##Type);                 \
+        for (size_t q = 0; q < count; ++q) {                                 \
+            u64 const bits = (u64)rand() << 40 ^ (u64)rand() << 20 ^ rand(); \
+            memcpy(queries + q, &bits, sizeof(Type));                        \
+            if (q < count - 64 - specials) {                                 \
+                queries[q] = values[rand() % size];                          \
+            } else if (q >= count - specials) {                              \
+                queries[q] = _specials_##Type[q - (count - specials)];       \
+            }                                                                \
+            lower[q] = 0;                                                    \
+            upper[q] = 0;                                                    \
+            for (size_t i = 0; i < size; ++i) {                              \
+                int const order = _compare_##Type(values + i, queries + q);  \
+                lower[q] += order < 0;                                       \
+                upper[q] += order <= 0;                                      \
+            }                                                                \
+        }                                                                    \
+                                                                             \
+        for (size_t q = 0; q < count; ++q) {                                 \
+            Type const *const value = queries + q;                           \
+            assert(lower_bound_##Type(values, values + size, *value) ==      \
+                   values + lower[q]);                                       \
+            assert(upper_bound_##Type(values, values + size, *value) ==      \
+                   values + upper[q]);                                       \
+        }                                                                    \
+        BinaryPredicate const orders[] = {&Type##_less,                      \
+                                          &_callback_less_##Type};           \
+        for (size_t o = 0; o < 2; ++o) {                                     \
+            for (size_t q = 0; q < count; ++q) {                             \
+                assert(lower_bound(values, values + size, sizeof(Type),      \
+                                   queries + q, orders[o]) ==                \
+                       values + lower[q]);                                   \
+                assert(upper_bound(values, values + size, sizeof(Type),      \
+                                   queries + q, orders[o]) ==                \
+                       values + upper[q]);                                   \
+            }                                                                \
+                                                                             \
+            search_index *const index = search_index_create(                 \
+                values, values + size, sizeof(Type), orders[o]);             \
+            assert(search_index_size(index) == size);                        \
+            for (size_t q = 0; q < count; ++q) {                             \
+                assert(search_index_lower_bound(index, queries + q) ==       \
+                       lower[q]);                                            \
+                assert(search_index_upper_bound(index, queries + q) ==       \
+                       upper[q]);                                            \
+            }                                                                \
+            search_index_lower_bound_batch(index, queries, count, ranks);    \
+            assert(not memcmp(ranks, lower, count * sizeof(size_t)));        \
+            search_index_upper_bound_batch(index, queries, count, ranks);    \
+            assert(not memcmp(ranks, upper, count * sizeof(size_t)));        \
+            search_index_destroy(index);                                     \
+        }                                                                    \
+                                                                             \
+        free(values);                                                        \
+        free(queries);                                                       \
+        free(lower);                                                         \
+        free(upper);                                                         \
+        free(ranks);                                                         \
+    }
+
+FOR_ALL_TYPES(DEFINE_SEARCH_CHECK)
+
+#define CHECK_SEARCH(Type) _check_search_##Type(sizes[s]);
+
+// sizes around powers of two, where the index trees become complete, through
+// the typed searches, the typed comparators and callbacks
+TEST(search_bounds) {
+    size_t const sizes[] = {0,  1,  2,  3,   4,   5,   7,    8,
+                            9,  15, 16, 17,  31,  32,  33,   255,
+                            256, 257, 1023, 1024, 1025, 4095, 4096, 4097};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(size_t); ++s) {
+        FOR_ALL_TYPES(CHECK_SEARCH)
+    }
+}
+
+// gemm
+
+// blocking sizes of src/gemm.c, the products below cross every block edge
+#define GEMM_MC 120
+#define GEMM_KC 256
+#define GEMM_NC 2048
+
+// dest (+)= lhs * rhs through m2_mult or m2_mult_add against a triple loop.
+// Every operand is a view one row and one column into a bigger matrix, so
+// strides differ from cols and rows do not start on a cache line
+static void _check_mult(size_t const dtype, size_t const m, size_t const n,
+                        size_t const k, bool const accumulate) {
+    matrix2 const lhs_parent = m2_alloc(m + 1, k + 2, dtype);
+    matrix2 const rhs_parent = m2_alloc(k + 1, n + 2, dtype);
+    matrix2 const dest_parent = m2_alloc(m + 1, n + 2, dtype);
+    assert(lhs_parent.data and rhs_parent.data and dest_parent.data);
+    matrix2 const lhs = m2_slice(&lhs_parent, 1, 1, m, k);
+    matrix2 const rhs = m2_slice(&rhs_parent, 1, 1, k, n);
+    matrix2 dest = m2_slice(&dest_parent, 1, 1, m, n);
+    _fill_integers(&lhs);
+    _fill_integers(&rhs);
+    _fill_integers(&dest_parent);
+
+    f64 *const expected = malloc(m * n * sizeof(f64));
+    assert(expected);
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            f64 sum = accumulate ? _get(&dest, i, j) : 0;
+            for (size_t p = 0; p < k; ++p) {
+                sum += _get(&lhs, i, p) * _get(&rhs, p, j);
+            }
+            expected[i * n + j] = sum;
+        }
+    }
+    f64 const outside = _get(&dest_parent, 0, 0);
+
+    Apply const perf = dtype == sizeof(f32) ? &f32_apply_add : &f64_apply_add;
+    if (accumulate) {
+        m2_mult_add(&dest, &lhs, &rhs, perf);
+    } else {
+        m2_mult(&dest, &lhs, &rhs, perf);
+    }
+
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            assert(_get(&dest, i, j) == expected[i * n + j]);
+        }
+    }
+    assert(_get(&dest_parent, 0, 0) == outside);
+
+    free(expected);
+    m2_free(&lhs_parent);
+    m2_free(&rhs_parent);
+    m2_free(&dest_parent);
+}
+
+// every microkernel the CPU supports on sizes around the block edges
+TEST(gemm_kernels) {
+    size_t const sizes[][3] = {
+        {1, 1, 1},
+        {1, 7, 1},
+        {5, 1, 3},
+        {GEMM_MC - 1, 9, 11},
+        {GEMM_MC, 16, 8},
+        {GEMM_MC + 1, 13, 5},
+        {7, 11, GEMM_KC - 1},
+        {6, 8, GEMM_KC},
+        {9, 17, GEMM_KC + 1},
+        {3, GEMM_NC - 1, 2},
+        {2, GEMM_NC, 3},
+        {4, GEMM_NC + 1, 3},
+        {GEMM_MC + 1, 33, GEMM_KC + 1},
+        {2 * GEMM_MC + 3, 31, 2 * GEMM_KC + 5},
+    };
+    gemm_isa const detected = gemm_detect_isa();
+
+    for (int isa = GEMM_ISA_SCALAR; isa <= (int)detected; ++isa) {
+        gemm_force_isa((gemm_isa)isa);
+        assert(gemm_detect_isa() == (gemm_isa)isa);
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+            for (int accumulate = 0; accumulate < 2; ++accumulate) {
+                _check_mult(sizeof(f32), sizes[s][0], sizes[s][1],
+                            sizes[s][2], accumulate);
+                _check_mult(sizeof(f64), sizes[s][0], sizes[s][1],
+                            sizes[s][2], accumulate);
+            }
+        }
+    }
+    gemm_force_isa(detected);
+}
+
+// m2_gemv, m2_gevm and their multi variants
+
+// columns of f64 in one block of src/matrix2_gemv.c, the widest types have
+// the fewest columns per block
+#define M2_GEMV_BLOCK_F64 4096
+
+// the products against m2_mult, through the typed Type##_apply_add and an
+// untyped wrapper of it. Operands are views one row and one column into
+// bigger matrices, the results start out filled with garbage. Values are
+// small integers, so float sums are exact and integer sums wrap the same way
+// in any order
+#define DEFINE_GEMV_CHECK(Type)                                                \
+    static void _apply_add_##Type(void *const dest, const void *const lhs,     \
+                                  const void *const rhs) {                     \
+        Type##_apply_add(dest, lhs, rhs);                                      \
+    }                                                                          \
+                                                                               \
+    static void _fill_small_##Type(matrix2 const *const m) {                   \
+        for (size_t i = 0; i < m->rows; ++i) {                                 \
+            Type *const row = m2_get_from_matrix(m, 0, i);                     \
+            for (size_t j = 0; j < m->cols; ++j) {                             \
+                row[j] = (Type)(rand() % 7 - 3);                               \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void _check_gemv_##Type(size_t const rows, size_t const cols,       \
+                                   size_t const k) {                           \
+        matrix2 const m_parent = m2_alloc(rows + 1, cols + 1, sizeof(Type));   \
+        matrix2 const x_parent =                                               \
+            m2_alloc(k + 1, rows + cols + 1, sizeof(Type));                    \
+        matrix2 const y_parent =                                               \
+            m2_alloc(k + 1, rows + cols + 1, sizeof(Type));                    \
+        matrix2 transposed = m2_alloc(cols, k, sizeof(Type));                  \
+        matrix2 gemv_expected = m2_alloc(rows, k, sizeof(Type));               \
+        matrix2 gevm_expected = m2_alloc(k, cols, sizeof(Type));               \
+        Type *const y = malloc((rows + cols) * sizeof(Type));                  \
+        assert(m_parent.data and x_parent.data and y_parent.data and           \
+               transposed.data and gemv_expected.data and                      \
+               gevm_expected.data and y);                                      \
+        matrix2 const m = m2_slice(&m_parent, 1, 1, rows, cols);               \
+        matrix2 const gemv_xs = m2_slice(&x_parent, 1, 1, k, cols);            \
+        matrix2 const gevm_xs = m2_slice(&x_parent, 1, 1, k, rows);            \
+        matrix2 gemv_ys = m2_slice(&y_parent, 1, 1, k, rows);                  \
+        matrix2 gevm_ys = m2_slice(&y_parent, 1, 1, k, cols);                  \
+        _fill_small_##Type(&m_parent);                                         \
+        _fill_small_##Type(&x_parent);                                         \
+                                                                               \
+        Apply const perfs[] = {&Type##_apply_add, &_apply_add_##Type};         \
+        for (size_t p = 0; p < 2; ++p) {                                       \
+            m2_transpose(&transposed, &gemv_xs);                               \
+            m2_mult(&gemv_expected, &m, &transposed, perfs[p]);                \
+            _fill_small_##Type(&y_parent);                                     \
+            m2_gemv_multi(&gemv_ys, &m, &gemv_xs, perfs[p]);                   \
+            for (size_t v = 0; v < k; ++v) {                                   \
+                for (size_t i = 0; i < rows; ++i) {                            \
+                    assert(*(Type *)m2_get_from_matrix(&gemv_ys, i, v) ==      \
+                           *(Type *)m2_get_from_matrix(&gemv_expected, v, i)); \
+                }                                                              \
+            }                                                                  \
+            m2_gemv(y, &m, gemv_xs.data, perfs[p]);                            \
+            for (size_t i = 0; i < rows; ++i) {                                \
+                assert(y[i] ==                                                 \
+                       *(Type *)m2_get_from_matrix(&gemv_expected, 0, i));     \
+            }                                                                  \
+                                                                               \
+            m2_mult(&gevm_expected, &gevm_xs, &m, perfs[p]);                   \
+            _fill_small_##Type(&y_parent);                                     \
+            m2_gevm_multi(&gevm_ys, &gevm_xs, &m, perfs[p]);                   \
+            for (size_t v = 0; v < k; ++v) {                                   \
+                assert(not memcmp(m2_get_from_matrix(&gevm_ys, 0, v),          \
+                                  m2_get_from_matrix(&gevm_expected, 0, v),    \
+                                  cols * sizeof(Type)));                       \
+            }                                                                  \
+            m2_gevm(y, gevm_xs.data, &m, perfs[p]);                            \
+            assert(not memcmp(y, gevm_expected.data, cols * sizeof(Type)));    \
+        }                                                                      \
+                                                                               \
+        m2_free(&m_parent);                                                    \
+        m2_free(&x_parent);                                                    \
+        m2_free(&y_parent);                                                    \
+        m2_free(&transposed);                                                  \
+        m2_free(&gemv_expected);                                               \
+        m2_free(&gevm_expected);                                               \
+        free(y);                                                               \
+    }
+
+FOR_ALL_TYPES(DEFINE_GEMV_CHECK)
+
+#define CHECK_GEMV(Type)                                         \
+    _check_gemv_##Type(sizes[s][0],                              \
+                       sizes[s][1] * sizeof(f64) / sizeof(Type), \
+                       sizes[s][2]);
+
+// row counts around the groups of 4 rows, columns around the vector width
+// and one past the block of every type
+TEST(m2_gemv_products) {
+    size_t const sizes[][3] = {
+        {1, 1, 1},  {3, 5, 2},  {4, 4, 1},   {5, 7, 3},
+        {8, 33, 5}, {13, 2, 4}, {2, 17, 1},  {6, M2_GEMV_BLOCK_F64 + 1, 3},
+    };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        FOR_ALL_TYPES(CHECK_GEMV)
+    }
+}
+
+// m2_mult_NxN, m2_det_NxN, m2_inverse_NxN and m2_mult_batched
+
+// M2_SMALL_LANES of src/matrix2_small.c
+#define M2_SMALL_LANES 16
+
+#define DEFINE_SMALL_CHECK(Type)                                               \
+    static void (*const _mult_nxn_##Type[])(Type *const, Type const *const,    \
+                                            Type const *const) = {             \
+        NULL, NULL, &m2_mult_2x2_##Type, &m2_mult_3x3_##Type,                  \
+        &m2_mult_4x4_##Type,                                                   \
+    };                                                                         \
+    static Type (*const _det_nxn_##Type[])(Type const *const) = {              \
+        NULL, NULL, &m2_det_2x2_##Type, &m2_det_3x3_##Type,                    \
+        &m2_det_4x4_##Type,                                                    \
+    };                                                                         \
+    static bool (*const _inverse_nxn_##Type[])(Type *const,                    \
+                                               Type const *const) = {          \
+        NULL, NULL, &m2_inverse_2x2_##Type, &m2_inverse_3x3_##Type,            \
+        &m2_inverse_4x4_##Type,                                                \
+    };                                                                         \
+                                                                               \
+    /* dest = lhs * rhs of row-major n x n matrices, through apply_add */      \
+    static void _small_product_##Type(Type *const dest, Type const *const lhs, \
+                                      Type const *const rhs, size_t const n) { \
+        for (size_t i = 0; i < n; ++i) {                                       \
+            for (size_t j = 0; j < n; ++j) {                                   \
+                Type sum = 0;                                                  \
+                for (size_t k = 0; k < n; ++k) {                               \
+                    Type##_apply_add(&sum, lhs + i * n + k, rhs + k * n + j);  \
+                }                                                              \
+                dest[i * n + j] = sum;                                         \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    /* compares values, so float results may differ in the sign of zero */     \
+    static bool _small_equal_##Type(Type const *const lhs,                     \
+                                    Type const *const rhs,                     \
+                                    size_t const size) {                       \
+        for (size_t e = 0; e < size; ++e) {                                    \
+            if (lhs[e] != rhs[e]) {                                            \
+                return false;                                                  \
+            }                                                                  \
+        }                                                                      \
+        return true;                                                           \
+    }                                                                          \
+                                                                               \
+    /* the product of unit lower and upper triangular matrices with small */   \
+    /* entries, with its first and last rows swapped half of the time. */      \
+    /* Returns its determinant, 1 or -1 */                                     \
+    static Type _small_unimodular_##Type(Type *const m, size_t const n) {      \
+        Type lower[16];                                                        \
+        Type upper[16];                                                        \
+        for (size_t i = 0; i < n; ++i) {                                       \
+            for (size_t j = 0; j < n; ++j) {                                   \
+                lower[i * n + j] = i > j ? (Type)(rand() % 5 - 2) : i == j;    \
+                upper[i * n + j] = i < j ? (Type)(rand() % 5 - 2) : i == j;    \
+            }                                                                  \
+        }                                                                      \
+        _small_product_##Type(m, lower, upper, n);                             \
+        if (rand() % 2) {                                                      \
+            return 1;                                                          \
+        }                                                                      \
+        for (size_t j = 0; j < n; ++j) {                                       \
+            Type const swap = m[j];                                            \
+            m[j] = m[(n - 1) * n + j];                                         \
+            m[(n - 1) * n + j] = swap;                                         \
+        }                                                                      \
+        return (Type)-1;                                                       \
+    }                                                                          \
+                                                                               \
+    /* products with and without aliasing, determinants and inverses of */     \
+    /* unimodular matrices, which are exact for every type, and inverses */    \
+    /* of singular ones. Floats also invert random diagonally dominant */      \
+    /* matrices within a few ulps */                                           \
+    static void _check_small_##Type(size_t const n) {                          \
+        bool const is_float = (Type)0.5 != 0;                                  \
+        size_t const bytes = n * n * sizeof(Type);                             \
+        Type identity[16];                                                     \
+        for (size_t e = 0; e < n * n; ++e) {                                   \
+            identity[e] = e / n == e % n;                                      \
+        }                                                                      \
+        for (size_t trial = 0; trial < 200; ++trial) {                         \
+            Type a[16], b[16], expected[16], actual[16], inverse[16];          \
+            Type const det = _small_unimodular_##Type(a, n);                   \
+            assert(_det_nxn_##Type[n](a) == det);                              \
+            for (size_t e = 0; e < n * n; ++e) {                               \
+                b[e] = (Type)(rand() % 7 - 3);                                 \
+            }                                                                  \
+                                                                               \
+            _small_product_##Type(expected, a, b, n);                          \
+            _mult_nxn_##Type[n](actual, a, b);                                 \
+            assert(_small_equal_##Type(actual, expected, n * n));              \
+            memcpy(actual, a, bytes);                                          \
+            _mult_nxn_##Type[n](actual, actual, b);                            \
+            assert(_small_equal_##Type(actual, expected, n * n));              \
+            memcpy(actual, b, bytes);                                          \
+            _mult_nxn_##Type[n](actual, a, actual);                            \
+            assert(_small_equal_##Type(actual, expected, n * n));              \
+                                                                               \
+            assert(_inverse_nxn_##Type[n](inverse, a));                        \
+            _mult_nxn_##Type[n](actual, inverse, a);                           \
+            assert(_small_equal_##Type(actual, identity, n * n));              \
+            _mult_nxn_##Type[n](actual, a, inverse);                           \
+            assert(_small_equal_##Type(actual, identity, n * n));              \
+            memcpy(actual, a, bytes);                                          \
+            assert(_inverse_nxn_##Type[n](actual, actual));                    \
+            assert(not memcmp(actual, inverse, bytes));                        \
+                                                                               \
+            /* equal first and last rows, then for integers a determinant */   \
+            /* of 2, dest must stay untouched */                               \
+            memcpy(a + (n - 1) * n, a, n * sizeof(Type));                      \
+            memcpy(actual, b, bytes);                                          \
+            assert(_det_nxn_##Type[n](a) == 0);                                \
+            assert(not _inverse_nxn_##Type[n](actual, a));                     \
+            assert(not memcmp(actual, b, bytes));                              \
+            memcpy(a, identity, bytes);                                        \
+            a[n * n - 1] = 2;                                                  \
+            assert(_inverse_nxn_##Type[n](actual, a) == is_float);             \
+            if (not is_float) {                                                \
+                assert(not memcmp(actual, b, bytes));                          \
+                continue;                                                      \
+            }                                                                  \
+                                                                               \
+            f64 const epsilon =                                                \
+                sizeof(Type) == sizeof(f32) ? FLT_EPSILON : DBL_EPSILON;       \
+            for (size_t e = 0; e < n * n; ++e) {                               \
+                a[e] = (Type)(rand() / (f64)RAND_MAX * 2 - 1) +                \
+                       (Type)(e / n == e % n ? n : 0);                         \
+            }                                                                  \
+            assert(_inverse_nxn_##Type[n](inverse, a));                        \
+            _mult_nxn_##Type[n](actual, inverse, a);                           \
+            for (size_t e = 0; e < n * n; ++e) {                               \
+                assert(fabs((f64)actual[e] - identity[e]) < 16 * epsilon);     \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    /* every matrix of the batch against _small_product and the unrolled */    \
+    /* product, through the typed kernels and an untyped Apply */              \
+    static void _check_batched_##Type(size_t const n, size_t const count) {    \
+        size_t const size = n * n * count;                                     \
+        Type *const lhs = malloc(size * sizeof(Type) + 1);                     \
+        Type *const rhs = malloc(size * sizeof(Type) + 1);                     \
+        Type *const dest = malloc(size * sizeof(Type) + 1);                    \
+        assert(lhs and rhs and dest);                                          \
+        for (size_t e = 0; e < size; ++e) {                                    \
+            lhs[e] = (Type)(rand() % 7 - 3);                                   \
+            rhs[e] = (Type)(rand() % 7 - 3);                                   \
+        }                                                                      \
+                                                                               \
+        Apply const perfs[] = {&Type##_apply_add, &_apply_add_##Type};         \
+        for (size_t p = 0; p < 2; ++p) {                                       \
+            for (size_t e = 0; e < size; ++e) {                                \
+                dest[e] = (Type)rand();                                        \
+            }                                                                  \
+            m2_mult_batched(dest, lhs, rhs, n, count, sizeof(Type), perfs[p]); \
+            for (size_t b = 0; b < count; ++b) {                               \
+                Type l[25], r[25], expected[25], unrolled[16];                 \
+                for (size_t e = 0; e < n * n; ++e) {                           \
+                    l[e] = lhs[e * count + b];                                 \
+                    r[e] = rhs[e * count + b];                                 \
+                }                                                              \
+                _small_product_##Type(expected, l, r, n);                      \
+                if (n >= 2 and n <= 4) {                                       \
+                    _mult_nxn_##Type[n](unrolled, l, r);                       \
+                    assert(_small_equal_##Type(unrolled, expected, n * n));    \
+                }                                                              \
+                for (size_t e = 0; e < n * n; ++e) {                           \
+                    assert(dest[e * count + b] == expected[e]);                \
+                }                                                              \
+            }                                                                  \
+        }                                                                      \
+                                                                               \
+        free(lhs);                                                             \
+        free(rhs);                                                             \
+        free(dest);                                                            \
+    }
+
+FOR_ALL_TYPES(DEFINE_SMALL_CHECK)
+
+#define CHECK_SMALL(Type) _check_small_##Type(n);
+
+TEST(m2_small_inverse) {
+    for (size_t n = 2; n <= 4; ++n) {
+        FOR_ALL_TYPES(CHECK_SMALL)
+    }
+}
+
+#define CHECK_BATCHED(Type) _check_batched_##Type(n, counts[c]);
+
+// the unrolled sizes and 1 and 5 of the generic kernel, on batches ending in
+// a partial block of lanes and on whole blocks
+TEST(m2_small_batched) {
+    size_t const counts[] = {1,  3,  M2_SMALL_LANES - 1, M2_SMALL_LANES,
+                             M2_SMALL_LANES + 1, 2 * M2_SMALL_LANES + 5, 100};
+    for (size_t n = 1; n <= 5; ++n) {
+        for (size_t c = 0; c < sizeof(counts) / sizeof(size_t); ++c) {
+            FOR_ALL_TYPES(CHECK_BATCHED)
+        }
+    }
+}
+
+// m2_mult_quantized
+
+static i64 _quant_get(matrix2 const *const m, m2_quant_type const type,
+                      size_t const i, size_t const j) {
+    void const *const value = m2_get_from_matrix(m, j, i);
+    switch (type) {
+        case M2_QUANT_U8:
+            return *(u8 const *)value;
+        case M2_QUANT_I8:
+            return *(i8 const *)value;
+        case M2_QUANT_I16:
+            return *(i16 const *)value;
+        case M2_QUANT_I32:
+            return *(i32 const *)value;
+        case M2_QUANT_I64:
+            return *(i64 const *)value;
+        case M2_QUANT_F32:
+            break;
+    }
+    assert(false);
+    return 0;
+}
+
+// random values of `type`. 8 bit rhs operands are kept inside of [-64, 64)
+// once moved to i8 when `narrow` is set, so the AVX2 product needs no split
+static void _quant_fill(matrix2 const *const m, m2_quant_type const type,
+                        bool const narrow) {
+    for (size_t i = 0; i < m->rows; ++i) {
+        for (size_t j = 0; j < m->cols; ++j) {
+            void *const dest = m2_get_from_matrix(m, j, i);
+            int const value = rand();
+            switch (type) {
+                case M2_QUANT_U8:
+                    *(u8 *)dest = narrow ? 64 + value % 128 : value;
+                    break;
+                case M2_QUANT_I8:
+                    *(i8 *)dest = narrow ? value % 128 - 64 : value;
+                    break;
+                case M2_QUANT_I16:
+                    *(i16 *)dest = value;
+                    break;
+                default:
+                    assert(false);
+            }
+        }
+    }
+}
+
+// what m2_mult_quantized stores for the exact accumulator `acc` of element
+// (i, j): rounded to nearest even, shifted by the zero point and saturated
+static f64 _quant_expected(m2_quant const *const quant, i64 const acc,
+                           size_t const i, size_t const j) {
+    size_t const index =
+        quant->axis == M2_QUANT_ROW ? i : quant->axis == M2_QUANT_COL ? j : 0;
+    f64 const zero = quant->zero_point ? quant->zero_point[index] : 0;
+    f64 const scale = quant->scale ? quant->scale[index] : 1;
+    if (quant->dest == M2_QUANT_F32) {
+        return (f32)(acc * scale + zero);
+    }
+    f64 const limits[][2] = {
+        [M2_QUANT_U8] = {0, UINT8_MAX},
+        [M2_QUANT_I8] = {INT8_MIN, INT8_MAX},
+        [M2_QUANT_I16] = {INT16_MIN, INT16_MAX},
+        [M2_QUANT_I32] = {INT32_MIN, INT32_MAX},
+        [M2_QUANT_I64] = {INT64_MIN, INT64_MAX},
+    };
+    f64 const x = quant->scale ? nearbyint(acc * scale) + zero : acc + zero;
+    return fmin(fmax(x, limits[quant->dest][0]), limits[quant->dest][1]);
+}
+
+// dest configurations every product is stored with
+typedef struct {
+    m2_quant_type dest;
+    m2_quant_axis axis;
+    bool scaled;
+    bool shifted;
+} quant_dest;
+
+// products of random m x k and k x n operands, views inside of bigger
+// matrices, through every dest configuration against an i64 reference.
+// Returns the number of saturated elements
+static size_t _check_quant(m2_quant_type const type_lhs,
+                           m2_quant_type const type_rhs, bool const narrow,
+                           size_t const m, size_t const n, size_t const k) {
+    quant_dest const dests[] = {
+        {M2_QUANT_I32, M2_QUANT_TENSOR, false, false},
+        {M2_QUANT_I64, M2_QUANT_TENSOR, false, true},
+        {M2_QUANT_I32, M2_QUANT_COL, false, true},
+        {M2_QUANT_U8, M2_QUANT_ROW, true, true},
+        {M2_QUANT_I8, M2_QUANT_COL, true, true},
+        {M2_QUANT_I16, M2_QUANT_TENSOR, true, false},
+        {M2_QUANT_F32, M2_QUANT_COL, true, true},
+        {M2_QUANT_F32, M2_QUANT_TENSOR, false, false},
+    };
+    size_t const lhs_dtype = m2_quant_dtype(type_lhs);
+    size_t const rhs_dtype = m2_quant_dtype(type_rhs);
+    matrix2 const lhs_parent = m2_alloc(m + 1, k + 3, lhs_dtype);
+    matrix2 const rhs_parent = m2_alloc(k + 2, n + 1, rhs_dtype);
+    assert(lhs_parent.data and rhs_parent.data);
+    matrix2 const lhs = m2_slice(&lhs_parent, 1, 3, m, k);
+    matrix2 const rhs = m2_slice(&rhs_parent, 2, 1, k, n);
+    _quant_fill(&lhs, type_lhs, false);
+    _quant_fill(&rhs, type_rhs, narrow);
+    i32 const lhs_zero = type_lhs == M2_QUANT_I16 ? -1234 : 3;
+    i32 const rhs_zero = type_rhs == M2_QUANT_I16 ? 321 : -5;
+
+    i64 *const acc = malloc(m * n * sizeof(i64));
+    f32 *const scale = malloc((m + n) * sizeof(f32));
+    i32 *const zero = malloc((m + n) * sizeof(i32));
+    assert(acc and scale and zero);
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            i64 sum = 0;
+            for (size_t p = 0; p < k; ++p) {
+                sum += (_quant_get(&lhs, type_lhs, i, p) - lhs_zero) *
+                       (_quant_get(&rhs, type_rhs, p, j) - rhs_zero);
+            }
+            acc[i * n + j] = sum;
+        }
+    }
+    // wide enough for some of the 8 bit destinations to saturate
+    f64 const unit = type_lhs == M2_QUANT_I16 ? 1e-9 : 1e-5;
+    for (size_t i = 0; i < m + n; ++i) {
+        scale[i] = (1 + rand() % 1000) * unit;
+        zero[i] = rand() % 21 - 10;
+    }
+
+    size_t saturated = 0;
+    for (size_t d = 0; d < sizeof(dests) / sizeof(dests[0]); ++d) {
+        m2_quant const quant = {
+            type_lhs,
+            type_rhs,
+            dests[d].dest,
+            lhs_zero,
+            rhs_zero,
+            dests[d].axis,
+            dests[d].scaled ? scale : NULL,
+            dests[d].shifted ? zero : NULL,
+        };
+        matrix2 const dest_parent =
+            m2_alloc(m + 2, n + 2, m2_quant_dtype(quant.dest));
+        assert(dest_parent.data);
+        matrix2 dest = m2_slice(&dest_parent, 2, 1, m, n);
+        assert(m2_mult_quantized(&dest, &lhs, &rhs, &quant));
+
+        for (size_t i = 0; i < m; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                f64 const expected =
+                    _quant_expected(&quant, acc[i * n + j], i, j);
+                f64 actual;
+                if (quant.dest == M2_QUANT_F32) {
+                    actual = *(f32 const *)m2_get_from_matrix(&dest, j, i);
+                } else {
+                    actual = _quant_get(&dest, quant.dest, i, j);
+                }
+                assert(actual == expected);
+                saturated += quant.dest == M2_QUANT_U8 and
+                             (expected == 0 or expected == UINT8_MAX);
+            }
+        }
+        m2_free(&dest_parent);
+    }
+
+    free(acc);
+    free(scale);
+    free(zero);
+    m2_free(&lhs_parent);
+    m2_free(&rhs_parent);
+    return saturated;
+}
+
+// every pairing of u8 and i8 operands on every kernel the CPU supports, with
+// and without the values of rhs that need the split AVX2 kernel, then i16
+TEST(m2_mult_quantized_exact) {
+    size_t const sizes[][3] = {
+        {1, 1, 1},
+        {5, 3, 7},
+        {GEMM_MC + 1, 37, GEMM_KC + 5},
+        {9, 70, 2 * GEMM_KC + 3},
+    };
+    m2_quant_type const types[] = {M2_QUANT_U8, M2_QUANT_I8};
+    gemm_isa const detected = gemm_detect_isa();
+    size_t saturated = 0;
+
+    for (int isa = GEMM_ISA_SCALAR; isa <= (int)detected; ++isa) {
+        gemm_force_isa((gemm_isa)isa);
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+            for (size_t l = 0; l < 2; ++l) {
+                for (size_t r = 0; r < 2; ++r) {
+                    for (int narrow = 0; narrow < 2; ++narrow) {
+                        saturated += _check_quant(types[l], types[r], narrow,
+                                                  sizes[s][0], sizes[s][1],
+                                                  sizes[s][2]);
+                    }
+                }
+            }
+        }
+    }
+    gemm_force_isa(detected);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        _check_quant(M2_QUANT_I16, M2_QUANT_I16, false, sizes[s][0],
+                     sizes[s][1], sizes[s][2]);
+    }
+    assert(saturated);
+}
+
+// m2_lu and m2_cholesky
+
+// M2_FACTOR_BLOCK of src/matrix2_factor.c
+#define M2_FACTOR_BLOCK 128
+
+// max of |a * x - b| over the max of |a| * |x| * n * epsilon, a backward
+// stable solve keeps it below a small constant
+static f64 _relative_residual(matrix2 const *const a, matrix2 const *const x,
+                              matrix2 const *const b) {
+    size_t const n = a->rows;
+    f64 residual = 0;
+    f64 a_norm = 0;
+    f64 x_norm = 0;
+    for (size_t i = 0; i < n; ++i) {
+        f64 row_norm = 0;
+        for (size_t p = 0; p < n; ++p) {
+            row_norm += fabs(_get(a, i, p));
+        }
+        a_norm = fmax(a_norm, row_norm);
+        for (size_t j = 0; j < b->cols; ++j) {
+            f64 sum = -_get(b, i, j);
+            for (size_t p = 0; p < n; ++p) {
+                sum += _get(a, i, p) * _get(x, p, j);
+            }
+            residual = fmax(residual, fabs(sum));
+            x_norm = fmax(x_norm, fabs(_get(x, i, j)));
+        }
+    }
+    f64 const epsilon = a->dtype == sizeof(f32) ? FLT_EPSILON : DBL_EPSILON;
+    return residual / (a_norm * x_norm * n * epsilon);
+}
+
+static void _copy(matrix2 const *const dest, matrix2 const *const src) {
+    for (size_t i = 0; i < src->rows; ++i) {
+        for (size_t j = 0; j < src->cols; ++j) {
+            _set(dest, i, j, _get(src, i, j));
+        }
+    }
+}
+
+static void _fill_uniform(matrix2 const *const m) {
+    for (size_t i = 0; i < m->rows; ++i) {
+        for (size_t j = 0; j < m->cols; ++j) {
+            _set(m, i, j, 2.0 * rand() / RAND_MAX - 1);
+        }
+    }
+}
+
+// solves a general and a symmetric positive definite system of size n with 3
+// right hand sides, from a copy of every operand so the residual is measured
+// against the original ones
+static void _check_factor(size_t const dtype, size_t const n) {
+    matrix2 const a = m2_alloc(n, n, dtype);
+    matrix2 factors = m2_alloc(n, n, dtype);
+    matrix2 const b = m2_alloc(n, 3, dtype);
+    matrix2 x = m2_alloc(n, 3, dtype);
+    size_t *const pivots = malloc(n * sizeof(size_t));
+    assert(a.data and factors.data and b.data and x.data and pivots);
+    _fill_uniform(&a);
+    _fill_uniform(&b);
+
+    _copy(&factors, &a);
+    _copy(&x, &b);
+    if (dtype == sizeof(f32)) {
+        assert(m2_lu_f32(&factors, pivots));
+        m2_lu_solve_f32(&factors, pivots, &x);
+    } else {
+        assert(m2_lu_f64(&factors, pivots));
+        m2_lu_solve_f64(&factors, pivots, &x);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        assert(pivots[i] >= i and pivots[i] < n);
+    }
+    assert(_relative_residual(&a, &x, &b) < 10);
+
+    // a * a^T / n + I, only the lower triangle is read so the upper one holds
+    // NaN
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j <= i; ++j) {
+            f64 sum = i == j;
+            for (size_t p = 0; p < n; ++p) {
+                sum += _get(&a, i, p) * _get(&a, j, p) / n;
+            }
+            _set(&factors, j, i, NAN);
+            _set(&factors, i, j, sum);
+        }
+    }
+    matrix2 const spd = m2_alloc(n, n, dtype);
+    assert(spd.data);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            _set(&spd, i, j, _get(&factors, i > j ? i : j, i > j ? j : i));
+        }
+    }
+
+    _copy(&x, &b);
+    if (dtype == sizeof(f32)) {
+        assert(m2_cholesky_f32(&factors));
+        m2_cholesky_solve_f32(&factors, &x);
+    } else {
+        assert(m2_cholesky_f64(&factors));
+        m2_cholesky_solve_f64(&factors, &x);
+    }
+    assert(_relative_residual(&spd, &x, &b) < 10);
+
+    free(pivots);
+    m2_free(&a);
+    m2_free(&factors);
+    m2_free(&b);
+    m2_free(&x);
+    m2_free(&spd);
+}
+
+TEST(m2_factor_residual) {
+    size_t const sizes[] = {1, 2, M2_FACTOR_BLOCK - 1, M2_FACTOR_BLOCK,
+                            M2_FACTOR_BLOCK + 1, 300};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(size_t); ++s) {
+        _check_factor(sizeof(f32), sizes[s]);
+        _check_factor(sizeof(f64), sizes[s]);
+    }
+}
+
+// a zero column makes a pivot exactly zero, past the first block, and a
+// negative diagonal element stops the Cholesky factorization
+TEST(m2_factor_failures) {
+    size_t const n = M2_FACTOR_BLOCK + 2;
+    matrix2 m = m2_alloc(n, n, sizeof(f64));
+    size_t *const pivots = malloc(n * sizeof(size_t));
+    assert(m.data and pivots);
+
+    _fill_uniform(&m);
+    for (size_t i = 0; i < n; ++i) {
+        _set(&m, i, n - 1, 0);
+    }
+    assert(not m2_lu_f64(&m, pivots));
+
+    f64 twice[] = {1, 2, 2, 4};
+    matrix2 rank_one = CREATE_MATRIX2(f64, 2, 2, twice);
+    assert(not m2_lu_f64(&rank_one, pivots));
+
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            _set(&m, i, j, i == j ? (i == n - 2 ? -1 : 2) : 0.01);
+        }
+    }
+    assert(not m2_cholesky_f64(&m));
+
+    f32 indefinite[] = {1, 2, 2, 1};
+    matrix2 small = CREATE_MATRIX2(f32, 2, 2, indefinite);
+    assert(not m2_cholesky_f32(&small));
+
+    free(pivots);
+    m2_free(&m);
+}
+
+// m2_mult_strassen
+
+// max of |dest - lhs * rhs| over max |lhs| * max |rhs| * k * epsilon, the
+// product of m2_mult is the reference
+static f64 _strassen_error(size_t const dtype, size_t const m, size_t const n,
+                           size_t const k, size_t const cutoff) {
+    matrix2 const lhs = m2_alloc(m, k, dtype);
+    matrix2 const rhs = m2_alloc(k, n, dtype);
+    matrix2 const dest_parent = m2_alloc(m + 1, n + 3, dtype);
+    matrix2 expected = m2_alloc(m, n, dtype);
+    assert(lhs.data and rhs.data and dest_parent.data and expected.data);
+    matrix2 dest = m2_slice(&dest_parent, 1, 2, m, n);
+    _fill_uniform(&lhs);
+    _fill_uniform(&rhs);
+    _fill_uniform(&dest_parent);
+    f64 const outside = _get(&dest_parent, 0, 0);
+
+    // a block from a previous user of the workspace, and a small first
+    // block so the recursion has to grow it
+    m2_arena *const workspace = m2_arena_create(4096);
+    assert(workspace);
+    assert(m2_arena_take(workspace, 1000));
+    m2_arena_mark const before = m2_arena_save(workspace);
+
+    Apply const perf = dtype == sizeof(f32) ? &f32_apply_add : &f64_apply_add;
+    m2_mult(&expected, &lhs, &rhs, perf);
+    m2_mult_strassen(&dest, &lhs, &rhs, perf, cutoff, workspace);
+
+    m2_arena_mark const after = m2_arena_save(workspace);
+    assert(after.block == before.block and after.used == before.used);
+    assert(_get(&dest_parent, 0, 0) == outside);
+
+    f64 error = 0;
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            f64 const difference = _get(&dest, i, j) - _get(&expected, i, j);
+            error = fmax(error, fabs(difference));
+        }
+    }
+
+    m2_arena_destroy(workspace);
+    m2_free(&lhs);
+    m2_free(&rhs);
+    m2_free(&dest_parent);
+    m2_free(&expected);
+    f64 const epsilon = dtype == sizeof(f32) ? FLT_EPSILON : DBL_EPSILON;
+    return error / (k * epsilon);
+}
+
+// number of halvings of m, n and k before one of them reaches the cutoff
+static size_t _strassen_levels(size_t const sizes[3], size_t const cutoff) {
+    size_t levels = 0;
+    for (size_t m = sizes[0], n = sizes[1], k = sizes[2];
+         m > cutoff and n > cutoff and k > cutoff; m /= 2, n /= 2, k /= 2) {
+        ++levels;
+    }
+    return levels;
+}
+
+// odd sizes peel a row, a column or an inner index on some of the up to 4
+// levels above the cutoff, the error may grow by a constant factor per level
+TEST(m2_mult_strassen) {
+    size_t const sizes[][3] = {
+        {1, 1, 1},    {16, 16, 16}, {17, 17, 17},   {33, 34, 35},
+        {64, 64, 64}, {65, 97, 80}, {130, 67, 129}, {200, 201, 199},
+    };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        for (size_t dtype = sizeof(f32); dtype <= sizeof(f64); dtype *= 2) {
+            f64 const error = _strassen_error(dtype, sizes[s][0], sizes[s][1],
+                                              sizes[s][2], 16);
+            assert(error <= 2 * pow(3, _strassen_levels(sizes[s], 16)));
+        }
+    }
+
+    // other operators run m2_mult
+    i32 lhs[3 * 5];
+    i32 rhs[5 * 2];
+    i32 dest[3 * 2];
+    i32 expected[3 * 2];
+    for (size_t i = 0; i < 15; ++i) {
+        lhs[i] = i - 7;
+    }
+    for (size_t i = 0; i < 10; ++i) {
+        rhs[i] = 3 * i;
+    }
+    matrix2 const l = CREATE_MATRIX2(i32, 3, 5, lhs);
+    matrix2 const r = CREATE_MATRIX2(i32, 5, 2, rhs);
+    matrix2 d = CREATE_MATRIX2(i32, 3, 2, dest);
+    matrix2 e = CREATE_MATRIX2(i32, 3, 2, expected);
+    m2_mult_strassen(&d, &l, &r, &i32_apply_add, 1, NULL);
+    m2_mult(&e, &l, &r, &i32_apply_add);
+    assert(not memcmp(dest, expected, sizeof(dest)));
+}
+
+// sparse2
+
+static s2_format const s2_formats[] = {S2_COO, S2_CSR, S2_CSC};
+
+// the same product as i32_apply_add through a callback s2_* does not know,
+// which runs the generic kernels
+static void _i32_multiply_add(void *const dest, void const *const lhs,
+                              void const *const rhs) {
+    *(i32 *)dest += *(i32 const *)lhs * *(i32 const *)rhs;
+}
+
+// view of a rows x cols i32 matrix with about one nonzero in `density`
+// elements, rows divisible by 5 are empty and row 1 is full
+static matrix2 _sparse_dense(matrix2 const *const parent, size_t const rows,
+                             size_t const cols, int const density) {
+    matrix2 const m = m2_slice(parent, 1, 2, rows, cols);
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < cols; ++j) {
+            bool const set = i == 1 or (i % 5 and rand() % density == 0);
+            *(i32 *)m2_get_from_matrix(&m, j, i) = set ? rand() % 19 - 9 : 0;
+        }
+    }
+    return m;
+}
+
+static void _check_equal_i32(matrix2 const *const lhs,
+                             matrix2 const *const rhs) {
+    assert(lhs->rows == rhs->rows and lhs->cols == rhs->cols);
+    for (size_t i = 0; i < lhs->rows; ++i) {
+        for (size_t j = 0; j < lhs->cols; ++j) {
+            assert(*(i32 const *)m2_get_from_matrix(lhs, j, i) ==
+                   *(i32 const *)m2_get_from_matrix(rhs, j, i));
+        }
+    }
+}
+
+// dense to every format, between every pair of formats and back to dense,
+// with all bytes zero and with another value standing for zero
+TEST(s2_round_trip) {
+    size_t const rows = 37;
+    size_t const cols = 53;
+    matrix2 const parent = m2_alloc(rows + 2, cols + 3, sizeof(i32));
+    matrix2 out = m2_alloc(rows, cols, sizeof(i32));
+    assert(parent.data and out.data);
+    matrix2 const m = _sparse_dense(&parent, rows, cols, 7);
+    i32 const five = 5;
+
+    size_t nnz = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < cols; ++j) {
+            nnz += *(i32 const *)m2_get_from_matrix(&m, j, i) != 0;
+        }
+    }
+
+    for (size_t f = 0; f < 3; ++f) {
+        sparse2 const s = s2_from_dense(&m, s2_formats[f], NULL);
+        assert(s.nnz == nnz);
+        if (s.format != S2_COO) {
+            size_t const outer = s.format == S2_CSR ? rows : cols;
+            assert(s.offsets[0] == 0 and s.offsets[outer] == nnz);
+            for (size_t i = 0; i < outer; ++i) {
+                for (size_t p = s.offsets[i] + 1; p < s.offsets[i + 1]; ++p) {
+                    assert(s.indices[p - 1] < s.indices[p]);
+                }
+            }
+        }
+        s2_to_dense(&out, &s, NULL);
+        _check_equal_i32(&out, &m);
+
+        for (size_t g = 0; g < 3; ++g) {
+            sparse2 const converted = s2_convert(&s, s2_formats[g]);
+            assert(converted.format == s2_formats[g] and converted.nnz == nnz);
+            s2_to_dense(&out, &converted, NULL);
+            _check_equal_i32(&out, &m);
+            s2_free(&converted);
+        }
+        s2_free(&s);
+
+        // every element but the fives, which come back from `zero`
+        sparse2 const fives = s2_from_dense(&m, s2_formats[f], &five);
+        assert(fives.nnz > nnz);
+        s2_to_dense(&out, &fives, &five);
+        _check_equal_i32(&out, &m);
+        s2_free(&fives);
+    }
+
+    m2_free(&parent);
+    m2_free(&out);
+}
+
+// shuffled triplets with duplicates: products add them up, s2_to_dense keeps
+// the last one of every coordinate
+TEST(s2_triplets) {
+    size_t const rows = 6;
+    size_t const cols = 4;
+    u32 const row_indices[] = {3, 0, 3, 5, 0, 3, 2, 5};
+    u32 const col_indices[] = {1, 2, 1, 0, 2, 3, 3, 0};
+    i32 const values[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    i32 const x[] = {1, 10, 100, 1000};
+    i32 const product[] = {700, 0, 7000, 6040, 0, 12};
+    i32 const dense[6][4] = {
+        {0, 0, 5, 0}, {0}, {0, 0, 0, 7}, {0, 3, 0, 6}, {0}, {8, 0, 0, 0},
+    };
+
+    for (size_t f = 0; f < 3; ++f) {
+        sparse2 const s = s2_from_triplets(rows, cols, sizeof(i32), 8,
+                                           row_indices, col_indices, values,
+                                           s2_formats[f]);
+        i32 dest[6];
+        s2_mult_vector(dest, &s, x, &i32_apply_add);
+        assert(not memcmp(dest, product, sizeof(product)));
+        s2_mult_vector(dest, &s, x, &_i32_multiply_add);
+        assert(not memcmp(dest, product, sizeof(product)));
+
+        i32 out[6][4];
+        matrix2 m = CREATE_MATRIX2(i32, rows, cols, out);
+        s2_to_dense(&m, &s, NULL);
+        assert(not memcmp(out, dense, sizeof(dense)));
+        s2_free(&s);
+    }
+}
+
+// products of every format with the typed and the generic kernels against
+// the dense ones, the parallel CSR product splits rows of very different
+// lengths over more tasks than there are rows with values
+TEST(s2_products) {
+    size_t const rows = 301;
+    size_t const cols = 257;
+    size_t const n = 19;
+    matrix2 const parent = m2_alloc(rows + 2, cols + 3, sizeof(i32));
+    matrix2 const rhs_parent = m2_alloc(cols + 1, n + 1, sizeof(i32));
+    matrix2 expected = m2_alloc(rows, n, sizeof(i32));
+    matrix2 dest = m2_alloc(rows, n, sizeof(i32));
+    i32 *const x = malloc(cols * sizeof(i32));
+    i32 *const y = malloc(rows * sizeof(i32));
+    i32 *const y_expected = malloc(rows * sizeof(i32));
+    thread_pool *const pool = thread_pool_create(4, false);
+    assert(parent.data and rhs_parent.data and expected.data and dest.data and
+           x and y and y_expected and pool);
+
+    matrix2 const m = _sparse_dense(&parent, rows, cols, 11);
+    matrix2 const rhs = m2_slice(&rhs_parent, 1, 1, cols, n);
+    matrix2 const xs = CREATE_MATRIX2(i32, cols, 1, x);
+    matrix2 ys = CREATE_MATRIX2(i32, rows, 1, y_expected);
+    for (size_t j = 0; j < cols; ++j) {
+        x[j] = rand() % 7 - 3;
+        for (size_t c = 0; c < n; ++c) {
+            *(i32 *)m2_get_from_matrix(&rhs, c, j) = rand() % 7 - 3;
+        }
+    }
+    m2_mult(&expected, &m, &rhs, &i32_apply_add);
+    m2_mult(&ys, &m, &xs, &i32_apply_add);
+
+    Apply const perfs[] = {&i32_apply_add, &_i32_multiply_add};
+    for (size_t f = 0; f < 3; ++f) {
+        sparse2 const s = s2_from_dense(&m, s2_formats[f], NULL);
+        for (size_t k = 0; k < 2; ++k) {
+            s2_mult_vector(y, &s, x, perfs[k]);
+            assert(not memcmp(y, y_expected, rows * sizeof(i32)));
+            memset(y, 0x55, rows * sizeof(i32));
+            s2_mult_vector_parallel(y, &s, x, perfs[k], pool);
+            assert(not memcmp(y, y_expected, rows * sizeof(i32)));
+            s2_mult_dense(&dest, &s, &rhs, perfs[k]);
+            _check_equal_i32(&dest, &expected);
+        }
+        s2_free(&s);
+    }
+
+    thread_pool_destroy(pool);
+    free(x);
+    free(y);
+    free(y_expected);
+    m2_free(&parent);
+    m2_free(&rhs_parent);
+    m2_free(&expected);
+    m2_free(&dest);
+}
+
+// matrix2_io
+
+// path of `name` in /tmp, unique to the process
+static char const *_temporary_file(char const *const name) {
+    static char path[128];
+    snprintf(path, sizeof(path), "/tmp/m2_test_%d_%s", (int)getpid(), name);
+    return path;
+}
+
+static void _check_file(char const *const path, matrix2 const *const m) {
+    m2_file_header header;
+    assert(m2_file_info(path, &header));
+    assert(header.rows == m->rows and header.cols == m->cols and
+           header.dtype == m->dtype);
+    matrix2 const mapped = m2_map(path, M2_ACCESS_SEQUENTIAL);
+    assert(mapped.data and mapped.rows == m->rows and mapped.cols == m->cols);
+    assert((size_t)mapped.data % M2_ALIGNMENT == 0);
+    assert(m2_compare(&mapped, m) == 0);
+    m2_unmap(&mapped);
+}
+
+// overwrites `size` bytes at `offset` of the file, or truncates it there
+// when `bytes` is NULL
+static void _corrupt(char const *const path, size_t const offset,
+                     void const *const bytes, size_t const size) {
+    FILE *const file = fopen(path, "r+b");
+    assert(file);
+    if (bytes) {
+        assert(fseek(file, offset, SEEK_SET) == 0);
+        assert(fwrite(bytes, 1, size, file) == size);
+    } else {
+        assert(ftruncate(fileno(file), offset) == 0);
+    }
+    fclose(file);
+}
+
+// m2_save of a strided view, m2_map of the file, and files with every kind
+// of broken header rejected by m2_file_info and m2_map
+TEST(m2_save_map) {
+    matrix2 const parent = m2_alloc(40, 30, sizeof(f64));
+    assert(parent.data);
+    matrix2 const m = m2_slice(&parent, 3, 1, 37, 27);
+    _fill_uniform(&m);
+    char const *const path = _temporary_file("saved");
+    m2_file_header header;
+
+    assert(m2_save(&m, path));
+    _check_file(path, &m);
+
+    u32 const version = M2_FILE_VERSION + 1;
+    u32 const byte_order = __builtin_bswap32(M2_FILE_BYTE_ORDER);
+    u64 const stride = 26;
+    struct {
+        size_t offset;
+        void const *bytes;
+        size_t size;
+    } const corruptions[] = {
+        {0, "M3", 2},
+        {offsetof(m2_file_header, version), &version, sizeof(version)},
+        {offsetof(m2_file_header, byte_order), &byte_order,
+         sizeof(byte_order)},
+        {offsetof(m2_file_header, stride), &stride, sizeof(stride)},
+        {M2_FILE_DATA_OFFSET + 36 * m2_padded_stride(27, sizeof(f64)) * 8,
+         NULL, 0},
+        {sizeof(m2_file_header) - 1, NULL, 0},
+    };
+    for (size_t c = 0; c < sizeof(corruptions) / sizeof(corruptions[0]);
+         ++c) {
+        assert(m2_save(&m, path));
+        _corrupt(path, corruptions[c].offset, corruptions[c].bytes,
+                 corruptions[c].size);
+        assert(not m2_file_info(path, &header));
+        assert(not m2_map(path, M2_ACCESS_NORMAL).data);
+    }
+    unlink(path);
+    assert(not m2_file_info(path, &header));
+    assert(not m2_map(path, M2_ACCESS_NORMAL).data);
+
+    m2_free(&parent);
+}
+
+// products of files against m2_mult, from budgets so small that tiles hold
+// a single element to budgets holding the whole product
+TEST(m2_mult_file) {
+    size_t const budgets[] = {1, 200, 4096, 30000, 1 << 20};
+    size_t const m = 37;
+    size_t const k = 45;
+    size_t const n = 29;
+    matrix2 const lhs = m2_alloc(m, k, sizeof(f64));
+    matrix2 const rhs = m2_alloc(k, n, sizeof(f64));
+    matrix2 expected = m2_alloc(m, n, sizeof(f64));
+    assert(lhs.data and rhs.data and expected.data);
+    _fill_integers(&lhs);
+    _fill_integers(&rhs);
+    m2_mult(&expected, &lhs, &rhs, &f64_apply_add);
+
+    char lhs_path[128];
+    char rhs_path[128];
+    strcpy(lhs_path, _temporary_file("lhs"));
+    strcpy(rhs_path, _temporary_file("rhs"));
+    char const *const dest_path = _temporary_file("product");
+    assert(m2_save(&lhs, lhs_path) and m2_save(&rhs, rhs_path));
+
+    for (size_t b = 0; b < sizeof(budgets) / sizeof(size_t); ++b) {
+        assert(m2_mult_file(dest_path, lhs_path, rhs_path, &f64_apply_add,
+                            budgets[b]));
+        _check_file(dest_path, &expected);
+    }
+
+    // the inner dimensions do not match
+    assert(not m2_mult_file(dest_path, lhs_path, lhs_path, &f64_apply_add,
+                            1 << 20));
+    unlink(dest_path);
+    unlink(lhs_path);
+    unlink(rhs_path);
+    m2_free(&lhs);
+    m2_free(&rhs);
+    m2_free(&expected);
+}
+
+// m2_expr_reduce
+
+// reduces the rows x cols matrix holding 1, 2, 3, ... in row-major order
+static void _reduce(Apply op, size_t const rows, size_t const cols,
+                    m2_axis const axis, f64 *const out) {
+    m2_arena *const arena = m2_arena_create(1 << 20);
+    assert(arena);
+    matrix2 m = m2_arena_alloc(arena, rows, cols, sizeof(f64));
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < cols; ++j) {
+            ((f64 *)m.data)[i * m2_stride(&m) + j] = i * cols + j + 1;
+        }
+    }
+    m2_expr *const expr =
+        m2_expr_reduce(arena, op, m2_expr_matrix(arena, &m), axis);
+    matrix2 dest = m2_arena_alloc(arena, m2_expr_rows(expr),
+                                  m2_expr_cols(expr), sizeof(f64));
+    m2_expr_eval(&dest, expr);
+    for (size_t i = 0; i < dest.rows; ++i) {
+        for (size_t j = 0; j < dest.cols; ++j) {
+            out[i * dest.cols + j] =
+                ((f64 *)dest.data)[i * m2_stride(&dest) + j];
+        }
+    }
+    m2_arena_destroy(arena);
+}
+
+// subtraction is not associative, every axis folds left to right
+TEST(m2_expr_reduce_sub) {
+    f64 out[8];
+
+    _reduce(&f64_op_sub, 1, 8, M2_AXIS_ALL, out);
+    assert(out[0] == -34);
+    _reduce(&f64_op_sub, 8, 1, M2_AXIS_ALL, out);
+    assert(out[0] == -34);
+    _reduce(&f64_op_sub, 8, 1, M2_AXIS_ROWS, out);
+    assert(out[0] == -34);
+    _reduce(&f64_op_sub, 1, 8, M2_AXIS_COLS, out);
+    assert(out[0] == -34);
+
+    _reduce(&f64_op_sub, 2, 4, M2_AXIS_ALL, out);
+    assert(out[0] == -34);
+    _reduce(&f64_op_sub, 2, 4, M2_AXIS_ROWS, out);
+    for (size_t j = 0; j < 4; ++j) {
+        assert(out[j] == -4);
+    }
+    _reduce(&f64_op_sub, 2, 4, M2_AXIS_COLS, out);
+    assert(out[0] == -8 and out[1] == -16);
+
+    // rows longer than an evaluation chunk
+    size_t const n = 5000;
+    _reduce(&f64_op_sub, 1, n, M2_AXIS_ALL, out);
+    assert(out[0] == 1 - (f64)(n * (n + 1) / 2 - 1));
+    _reduce(&f64_op_sub, 1, n, M2_AXIS_COLS, out);
+    assert(out[0] == 1 - (f64)(n * (n + 1) / 2 - 1));
+    _reduce(&f64_op_add, 1, n, M2_AXIS_ALL, out);
+    assert(out[0] == (f64)(n * (n + 1) / 2));
+}
+
+// sort_par
+
+// all equal, few distinct and distinct keys, through the typed comparator
+// and through a callback on elements carrying their original index
+TEST(sort_par_low_cardinality) {
+    size_t const size = 1 << 20;
+    size_t const cardinalities[] = {1, 2, 3, 17, 1000, size};
+    keyed *const items = malloc(size * sizeof(keyed));
+    i32 *const keys = malloc(size * sizeof(i32));
+    bool *const seen = malloc(size * sizeof(bool));
+    thread_pool *const pool = thread_pool_create(4, true);
+    assert(items and keys and seen and pool);
+    srand(2);
+
+    for (size_t c = 0; c < sizeof(cardinalities) / sizeof(size_t); ++c) {
+        for (size_t i = 0; i < size; ++i) {
+            keys[i] = rand() % cardinalities[c];
+            items[i] = (keyed){keys[i], i};
+        }
+
+        sort_par(keys, keys + size, sizeof(i32), &i32_less, pool);
+        sort_par(items, items + size, sizeof(keyed), &_keyed_less, pool);
+
+        memset(seen, 0, size * sizeof(bool));
+        for (size_t i = 0; i < size; ++i) {
+            assert(i == 0 or keys[i - 1] <= keys[i]);
+            assert(i == 0 or items[i - 1].key <= items[i].key);
+            assert(items[i].id < size and not seen[items[i].id]);
+            seen[items[i].id] = true;
+            assert(items[i].key == keys[i]);
+        }
+    }
+
+    thread_pool_destroy(pool);
+    free(items);
+    free(keys);
+    free(seen);
+}
+
+int main() {
+    RUN(search_bytes_misaligned);
+    RUN(search_bytes_random);
+    RUN(filter_removes);
+    RUN(compaction_order);
+    RUN(sort_types);
+    RUN(sort_odd_dtype);
+    RUN(stable_sort_stability);
+    RUN(search_bounds);
+    RUN(gemm_kernels);
+    RUN(m2_gemv_products);
+    RUN(m2_small_inverse);
+    RUN(m2_small_batched);
+    RUN(m2_mult_quantized_exact);
+    RUN(m2_factor_residual);
+    RUN(m2_factor_failures);
+    RUN(m2_mult_strassen);
+    RUN(s2_round_trip);
+    RUN(s2_triplets);
+    RUN(s2_products);
+    RUN(m2_save_map);
+    RUN(m2_mult_file);
+    RUN(m2_expr_reduce_sub);
+    RUN(sort_par_low_cardinality);
+    return 0;
+}